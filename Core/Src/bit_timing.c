@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bit_timing.c
+ * @brief   Bit timing helpers shared by the asynchronous protocol interpreters (UART, CAN).
+ *
+ * 			The bit period of a link is estimated from a histogram of the pulse widths seen on its
+ * 			pins. The narrowest pulse width which occurs often enough to not be a glitch is taken as
+ * 			one bit, and is then refined using every pulse in the capture which is a whole number of
+ * 			bits long. Building the histogram is a single pass over the buffer.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "bit_timing.h"
+#include "stdint.h"
+#include "string.h"
+
+#define BIT_TIMING_HIST_BINS 		1024	//longest pulse in samples considered for detection
+#define BIT_TIMING_MIN_PULSE_COUNT 	4		//pulse widths seen fewer times than this are glitches
+#define BIT_TIMING_PEAK_FRACTION 	16		//or fewer times than 1/16th of the most common width
+#define BIT_TIMING_MAX_REFINE_BITS 	10		//longest run of equal bits used to refine the period
+#define BIT_TIMING_TOLERANCE_PCT 	3
+
+static uint32_t pulse_histogram[BIT_TIMING_HIST_BINS];
+
+/*
+ * Function to estimate the bit period of a link present on the given pins.
+ *
+ * A first pass builds a histogram of the width of every complete pulse on the selected pins.
+ * The narrowest width which is not a glitch gives a first estimate of the bit period, which is
+ * then refined with every pulse that is within a quarter bit of a whole number of bits.
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  pin_mask mask of the pins which carry the link
+ *
+ * Returns:
+ *  samples per bit in 1/256th of a sample
+ *  0 if no stable pulse width could be found
+ */
+uint32_t detect_bit_period(const uint8_t buffer[], uint32_t buf_len, uint8_t pin_mask){
+	uint32_t last_edge[8];
+	uint8_t edge_seen = 0;
+
+	if(buf_len < 2 || pin_mask == 0){
+		return 0;
+	}
+
+	memset(pulse_histogram, 0, sizeof(pulse_histogram));
+
+	uint8_t previous_sample = buffer[0];
+	for(uint32_t i = 1; i < buf_len; i++){
+		uint8_t changed = (buffer[i] ^ previous_sample) & pin_mask;
+		previous_sample = buffer[i];
+		while(changed){
+			uint8_t pin = __builtin_ctz(changed);
+			changed &= changed - 1;
+			if(edge_seen & (1<<pin)){//the first edge only starts a pulse, the capture may have begun in its middle
+				uint32_t width = i - last_edge[pin];
+				if(width < BIT_TIMING_HIST_BINS){
+					pulse_histogram[width]++;
+				}
+			}
+			edge_seen |= (1<<pin);
+			last_edge[pin] = i;
+		}
+	}
+
+	uint32_t peak = 0;
+	for(uint32_t w = 1; w < BIT_TIMING_HIST_BINS; w++){
+		if(pulse_histogram[w] > peak){
+			peak = pulse_histogram[w];
+		}
+	}
+	uint32_t threshold = peak / BIT_TIMING_PEAK_FRACTION;
+	if(threshold < BIT_TIMING_MIN_PULSE_COUNT){
+		threshold = BIT_TIMING_MIN_PULSE_COUNT;
+	}
+
+	uint32_t min_width = 0;
+	for(uint32_t w = 1; w < BIT_TIMING_HIST_BINS; w++){
+		if(pulse_histogram[w] >= threshold){
+			min_width = w;
+			break;
+		}
+	}
+	if(min_width == 0){
+		return 0;
+	}
+
+	//first estimate, mean width of the pulses which are up to 1.5 times the narrowest one
+	uint64_t sum_width = 0, sum_count = 0;
+	for(uint32_t w = min_width; w < BIT_TIMING_HIST_BINS && w <= (min_width * 3) / 2; w++){
+		sum_width += (uint64_t)w * pulse_histogram[w];
+		sum_count += pulse_histogram[w];
+	}
+	uint32_t period_q8 = (uint32_t)((sum_width << 8) / sum_count);
+
+	//refine with every pulse that is a whole number of bits long
+	uint64_t sum_bits = 0;
+	sum_width = 0;
+	for(uint32_t w = min_width; w < BIT_TIMING_HIST_BINS; w++){
+		if(pulse_histogram[w] == 0){
+			continue;
+		}
+		uint32_t width_q8 = w << 8;
+		uint32_t bits = (width_q8 + period_q8 / 2) / period_q8;
+		if(bits == 0 || bits > BIT_TIMING_MAX_REFINE_BITS){
+			continue;
+		}
+		int32_t error = (int32_t)width_q8 - (int32_t)(bits * period_q8);
+		if(error < 0){
+			error = -error;
+		}
+		if((uint32_t)error < period_q8 / 4){
+			sum_width += (uint64_t)w * pulse_histogram[w];
+			sum_bits += (uint64_t)bits * pulse_histogram[w];
+		}
+	}
+	if(sum_bits){
+		period_q8 = (uint32_t)((sum_width << 8) / sum_bits);
+	}
+
+	return period_q8;
+}
+
+/*
+ * Function to convert a bit period to a bit rate, snapping it to the closest standard
+ * rate if the difference is within 3%
+ *
+ * Parameters:
+ *  bit_period_q8 samples per bit in 1/256th of a sample
+ *  sample_rate sampling frequency in Hz
+ *  standard_rates table of standard rates of the protocol
+ *  standard_rates_len number of entries in the table
+ *
+ * Returns:
+ *  bit rate
+ */
+uint32_t bit_period_to_rate(uint32_t bit_period_q8, uint32_t sample_rate,
+		const uint32_t standard_rates[], int standard_rates_len){
+	if(bit_period_q8 == 0){
+		return 0;
+	}
+	uint32_t rate = (uint32_t)(((uint64_t)sample_rate << 8) / bit_period_q8);
+
+	for(int i = 0; i < standard_rates_len; i++){
+		uint32_t standard = standard_rates[i];
+		uint32_t difference = (rate > standard) ? (rate - standard) : (standard - rate);
+		if((uint64_t)difference * 100 <= (uint64_t)standard * BIT_TIMING_TOLERANCE_PCT){
+			return standard;
+		}
+	}
+	return rate;
+}
+
+/*
+ * Function to convert a bit rate to a bit period at a given sample rate
+ *
+ * Parameters:
+ *  rate bit rate of the link
+ *  sample_rate sampling frequency in Hz
+ *
+ * Returns:
+ *  samples per bit in 1/256th of a sample
+ */
+uint32_t rate_to_bit_period(uint32_t rate, uint32_t sample_rate){
+	if(rate == 0){
+		return 0;
+	}
+	return (uint32_t)((((uint64_t)sample_rate << 8) + rate / 2) / rate);
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bit_timing.h
+ * @brief   Header file for the bit timing helpers shared by the asynchronous protocol interpreters
+ * 			(UART, CAN). Bit periods are kept in samples per bit in 1/256th of a sample, so that links
+ * 			which are not a whole number of samples per bit can be decoded without drift.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __BIT_TIMING_H__
+#define __BIT_TIMING_H__
+#include "stdint.h"
+
+/*
+ * Function to estimate the bit period of a link present on the given pins, from a histogram
+ * of the width of every pulse in the capture.
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  pin_mask mask of the pins which carry the link
+ *
+ * Returns:
+ *  samples per bit in 1/256th of a sample
+ *  0 if no stable pulse width could be found
+ */
+uint32_t detect_bit_period(const uint8_t buffer[], uint32_t buf_len, uint8_t pin_mask);
+
+/*
+ * Function to convert a bit period to a bit rate, snapping it to the closest standard
+ * rate if the difference is within 3%
+ *
+ * Parameters:
+ *  bit_period_q8 samples per bit in 1/256th of a sample
+ *  sample_rate sampling frequency in Hz
+ *  standard_rates table of standard rates of the protocol
+ *  standard_rates_len number of entries in the table
+ *
+ * Returns:
+ *  bit rate
+ */
+uint32_t bit_period_to_rate(uint32_t bit_period_q8, uint32_t sample_rate,
+		const uint32_t standard_rates[], int standard_rates_len);
+
+/*
+ * Function to convert a bit rate to a bit period at a given sample rate
+ *
+ * Parameters:
+ *  rate bit rate of the link
+ *  sample_rate sampling frequency in Hz
+ *
+ * Returns:
+ *  samples per bit in 1/256th of a sample
+ */
+uint32_t rate_to_bit_period(uint32_t rate, uint32_t sample_rate);
+
+#endif
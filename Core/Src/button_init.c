@@ -20,11 +20,12 @@
  *
  */
 #include "button_init.h"
-#include "stm32f429xx.h"
+#include "hw_access.h"
 #include "stdbool.h"
 #include "input_capture_dma.h"
 #include "timing_mode_init.h"
 #include "timer_update_event.h"
+#include "capture_health.h"
 static volatile uint8_t _mode;
 
 static void enable_button_interrupt(void);
@@ -62,10 +63,14 @@ void EXTI0_IRQHandler(void){
 	NVIC_ClearPendingIRQ(EXTI0_IRQn);
 	NVIC_DisableIRQ(EXTI0_IRQn);
 	EXTI->PR |= EXTI_PR_PR0;
-	if(_mode == TIMING_MODE)
+	if(_mode == TIMING_MODE){
 		enable_dma_2_stream5();
-	else if(_mode == STATE_MODE)
+		capture_health_stream_started(TIM1->CNT, TIM1->PSC, TIM1->ARR + 1);
+	}
+	else if(_mode == STATE_MODE){
 		enable_dma2_stream_2();
+		capture_health_stream_started((uint16_t)(TIM1->CNT - TIM1->CCR2), TIM1->PSC, 0);
+	}
 	EXTI->IMR &= ~EXTI_IMR_IM0;   // disabling interrupts after one press of button
 
 }
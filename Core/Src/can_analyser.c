@@ -0,0 +1,447 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    can_analyser.c
+ * @brief   CAN 2.0 interpreter. It goes over a given buffer, where data is 8bit format and one pin
+ * 			is selected as the RX line of a CAN transceiver by calling code.
+ *
+ * 			The time to the next sample point is kept in 1/256th of a sample. It is set to the bit centre
+ * 			on the start of frame edge and on every recessive to dominant edge inside the frame, and a
+ * 			bit is sampled each time it runs out. Stuff bits are removed from SOF up to the end of the
+ * 			CRC sequence, the remaining bits are stored so that the frame can be decoded and its CRC
+ * 			checked once the CRC sequence has been received.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "can_analyser.h"
+#include "bit_timing.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "string.h"
+#include "perf.h"
+
+#define CAN_MIN_BIT_PERIOD_Q8 	(3*256)	//a bit must be at least 3 samples to find its centre
+#define CAN_IDLE_BITS 			11		//recessive bits before the bus is considered idle
+#define CAN_STUFF_LIMIT 		5		//a stuff bit follows 5 equal bits
+#define CAN_CRC_LEN 			15
+#define CAN_CRC_POLY 			0x4599
+#define CAN_TRAILER_BITS 		10		//CRC delimiter, ACK slot, ACK delimiter and 7 EOF bits
+
+#define CAN_IDE_POS 			13
+#define CAN_STD_HEADER_LEN 		19		//SOF, 11 bit ID, RTR, IDE, r0, DLC
+#define CAN_EXT_HEADER_LEN 		39		//SOF, 11 bit ID, SRR, IDE, 18 bit ID, RTR, r1, r0, DLC
+
+//the edge is on average half a sample before the sample which sees it, and the countdown is rounded
+//up to whole samples, so one sample is taken off half a bit to land on the bit centre
+#define CAN_SYNC_COUNTDOWN_Q8(period_q8)	((int32_t)((period_q8) / 2) - 256)
+
+static const uint32_t standard_bitrate_table[] = {10000, 20000, 50000, 83333, 100000, 125000, 250000,
+		500000, 800000, 1000000};
+static const int standard_bitrate_table_len = sizeof(standard_bitrate_table)/sizeof(standard_bitrate_table[0]);
+
+/*
+ * Function to compute the CAN CRC15 of a sequence of bits, one bit per byte
+ *
+ * Parameters:
+ *  bits pointer to bit array
+ *  len number of bits
+ *
+ * Returns:
+ *  crc of the bits
+ */
+uint16_t can_crc15(const uint8_t bits[], uint32_t len){
+	uint16_t crc = 0;
+	for(uint32_t i = 0; i < len; i++){
+		uint8_t crc_next = bits[i] ^ ((crc >> 14) & 1);
+		crc = (crc << 1) & 0x7FFF;
+		if(crc_next){
+			crc ^= CAN_CRC_POLY;
+		}
+	}
+	return crc;
+}
+
+/*
+ * Function to read a field of the destuffed frame, MSB first
+ *
+ * Parameters:
+ *  bits pointer to bit array
+ *  start index of the first bit of the field
+ *  len number of bits in the field
+ *
+ * Returns:
+ *  value of the field
+ */
+static uint32_t get_field(const uint8_t bits[], uint8_t start, uint8_t len){
+	uint32_t value = 0;
+	for(uint8_t i = 0; i < len; i++){
+		value = (value << 1) | bits[start + i];
+	}
+	return value;
+}
+
+/*
+ * Function to print a decoded frame in a clear format. It is used when the calling code
+ * does not provide its own frame handler.
+ *
+ * Parameters:
+ *  frame pointer to the decoded frame
+ *  arg unused
+ *
+ * Returns:
+ *  none
+ */
+static void print_can_frame(const can_frame_t *frame, void *arg){
+	(void)arg;
+	printf("FRAME AT %lu: ID %lx%s%s DLC %d", (unsigned long)frame->position, (unsigned long)frame->id,
+			frame->extended ? " EXT" : "", frame->rtr ? " RTR" : "", frame->dlc);
+	if(!frame->rtr){
+		uint8_t len = (frame->dlc > 8) ? 8 : frame->dlc;
+		printf(" DATA");
+		for(uint8_t i = 0; i < len; i++){
+			printf(" %02x", frame->data[i]);
+		}
+	}
+	printf(" CRC %04x", frame->crc);
+	if(frame->flags & CAN_FRAME_ERR_STUFF){
+		printf(" STUFF ERROR");
+	}
+	if(frame->flags & CAN_FRAME_ERR_CRC){
+		printf(" CRC ERROR");
+	}
+	if(frame->flags & CAN_FRAME_ERR_FORM){
+		printf(" FORM ERROR");
+	}
+	if(frame->flags & CAN_FRAME_ERR_NO_ACK){
+		printf(" NO ACK");
+	}
+	printf("\r\n");
+}
+
+/*
+ * Function to hand a frame over to the frame handler. A frame cut short by a stuff or form error
+ * is followed by an error frame from the other nodes, so the bus is only trusted again once it
+ * has been idle.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *
+ * Returns:
+ *  none
+ */
+static void finish_frame(can_analyser_t *ctx){
+	ctx->frames++;
+	if(ctx->frame.flags){
+		ctx->errors++;
+	}
+	if(ctx->frame.flags & (CAN_FRAME_ERR_STUFF | CAN_FRAME_ERR_FORM)){
+		ctx->state = CAN_STATE_WAIT_IDLE;
+		ctx->recessive_run = 0;
+	}else{
+		ctx->state = CAN_STATE_IDLE;
+	}
+	ctx->on_frame(&ctx->frame, ctx->arg);
+}
+
+/*
+ * Function to decode the fields of the frame once all bits up to the end of the CRC
+ * have been received, and check the CRC.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *
+ * Returns:
+ *  none
+ */
+static void decode_fields(can_analyser_t *ctx){
+	can_frame_t *frame = &ctx->frame;
+	const uint8_t *bits = ctx->bits;
+	uint8_t data_len = ctx->crc_start - ctx->header_len;
+
+	for(uint8_t i = 0; i < data_len / 8; i++){
+		frame->data[i] = get_field(bits, ctx->header_len + 8 * i, 8);
+	}
+	frame->crc = get_field(bits, ctx->crc_start, CAN_CRC_LEN);
+	if(can_crc15(bits, ctx->crc_start) != frame->crc){
+		frame->flags |= CAN_FRAME_ERR_CRC;
+	}
+}
+
+/*
+ * Function to handle one sampled bit of the stuffed part of the frame
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  level value of the bus at the sample point
+ *
+ * Returns:
+ *  none
+ */
+static void frame_bit(can_analyser_t *ctx, uint8_t level){
+	can_frame_t *frame = &ctx->frame;
+
+	if(ctx->bit_count == 0){
+		if(level){//start of frame not dominant at its sample point, it was a glitch
+			ctx->state = CAN_STATE_IDLE;
+			return;
+		}
+	}else if(ctx->same_bits == CAN_STUFF_LIMIT){
+		if(level == ctx->last_bit){
+			frame->flags |= CAN_FRAME_ERR_STUFF;
+			finish_frame(ctx);
+			return;
+		}
+		ctx->last_bit = level;//stuff bit is dropped but counts towards the next stuff bit
+		ctx->same_bits = 1;
+		if(ctx->crc_start && ctx->bit_count == ctx->crc_start + CAN_CRC_LEN){
+			ctx->state = CAN_STATE_TRAILER;
+		}
+		return;
+	}
+
+	if(ctx->bit_count && level == ctx->last_bit){
+		ctx->same_bits++;
+	}else{
+		ctx->same_bits = 1;
+		ctx->last_bit = level;
+	}
+	ctx->bits[ctx->bit_count++] = level;
+
+	if(ctx->bit_count == CAN_IDE_POS + 1){
+		frame->extended = ctx->bits[CAN_IDE_POS];
+		ctx->header_len = frame->extended ? CAN_EXT_HEADER_LEN : CAN_STD_HEADER_LEN;
+	}else if(ctx->header_len && ctx->bit_count == ctx->header_len){
+		frame->id = get_field(ctx->bits, 1, 11);
+		if(frame->extended){
+			frame->id = (frame->id << 18) | get_field(ctx->bits, CAN_IDE_POS + 1, 18);
+			frame->rtr = ctx->bits[CAN_EXT_HEADER_LEN - 7];
+		}else{
+			frame->rtr = ctx->bits[CAN_IDE_POS - 1];
+		}
+		frame->dlc = get_field(ctx->bits, ctx->header_len - 4, 4);
+		uint8_t data_bytes = frame->rtr ? 0 : ((frame->dlc > 8) ? 8 : frame->dlc);
+		ctx->crc_start = ctx->header_len + 8 * data_bytes;
+	}else if(ctx->crc_start && ctx->bit_count == ctx->crc_start + CAN_CRC_LEN){
+		decode_fields(ctx);
+		if(ctx->same_bits < CAN_STUFF_LIMIT){//otherwise one more stuff bit follows the crc
+			ctx->state = CAN_STATE_TRAILER;
+		}
+	}
+}
+
+/*
+ * Function to handle one sampled bit of the fixed form part of the frame after the CRC
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  level value of the bus at the sample point
+ *
+ * Returns:
+ *  none
+ */
+static void trailer_bit(can_analyser_t *ctx, uint8_t level){
+	uint8_t bit = ctx->trailer_bit++;
+
+	if(bit == 1){//ack slot, driven dominant by every node which received the frame
+		if(level){
+			ctx->frame.flags |= CAN_FRAME_ERR_NO_ACK;
+		}
+	}else if(!level){//delimiters and EOF are recessive
+		ctx->frame.flags |= CAN_FRAME_ERR_FORM;
+		finish_frame(ctx);
+		return;
+	}
+
+	if(ctx->trailer_bit == CAN_TRAILER_BITS){
+		finish_frame(ctx);
+	}
+}
+
+/*
+ * Function to prepare an analyser context for decoding a capture block by block
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  pin position of the CAN RX line in the sample
+ *  bit_period_q8 samples per bit in 1/256th of a sample
+ *  on_frame function called for each decoded frame, NULL prints it
+ *  arg passed to on_frame
+ *
+ * Returns:
+ *  true if the configuration is valid
+ *  false otherwise
+ */
+bool can_analyser_init(can_analyser_t *ctx, uint8_t pin, uint32_t bit_period_q8,
+		can_frame_handler_t on_frame, void *arg){
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->pin = pin;
+	ctx->bit_period_q8 = bit_period_q8;
+	ctx->on_frame = (on_frame != NULL) ? on_frame : print_can_frame;
+	ctx->arg = arg;
+	ctx->idle_samples = (CAN_IDLE_BITS * bit_period_q8) >> 8;
+	ctx->state = CAN_STATE_WAIT_IDLE;
+
+	return (pin <= 7 && bit_period_q8 >= CAN_MIN_BIT_PERIOD_Q8);
+}
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, frames which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void can_analyser_process(can_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len){
+	uint8_t pin = ctx->pin;
+	uint8_t last_level = ctx->last_level;
+	uint32_t i = 0;
+
+	if(buf_len == 0){
+		return;
+	}
+	if(!ctx->primed){
+		last_level = (buffer[0] >> pin) & 1;
+		ctx->primed = 1;
+	}
+
+	PERF_BEGIN(PERF_CAN_DECODE);
+	for(; i < buf_len; i++){
+		uint8_t level = (buffer[i] >> pin) & 1;
+		uint8_t falling_edge = last_level && !level;
+		last_level = level;
+
+		switch(ctx->state){
+		case CAN_STATE_WAIT_IDLE:
+			if(level){
+				if(++ctx->recessive_run >= ctx->idle_samples){
+					ctx->state = CAN_STATE_IDLE;
+				}
+			}else{
+				ctx->recessive_run = 0;
+			}
+			break;
+
+		case CAN_STATE_IDLE:
+			if(falling_edge){//hard synchronisation on the start of frame
+				memset(&ctx->frame, 0, sizeof(ctx->frame));
+				ctx->frame.position = ctx->position + i;
+				ctx->bit_count = 0;
+				ctx->header_len = 0;
+				ctx->crc_start = 0;
+				ctx->same_bits = 0;
+				ctx->trailer_bit = 0;
+				ctx->countdown_q8 = CAN_SYNC_COUNTDOWN_Q8(ctx->bit_period_q8);
+				ctx->state = CAN_STATE_FRAME;
+			}
+			break;
+
+		default:
+			if(falling_edge){//resynchronisation on recessive to dominant edges
+				ctx->countdown_q8 = CAN_SYNC_COUNTDOWN_Q8(ctx->bit_period_q8);
+				break;
+			}
+			ctx->countdown_q8 -= 256;
+			if(ctx->countdown_q8 <= 0){
+				ctx->countdown_q8 += ctx->bit_period_q8;
+				if(ctx->state == CAN_STATE_FRAME){
+					frame_bit(ctx, level);
+				}else{
+					trailer_bit(ctx, level);
+				}
+			}
+			break;
+		}
+	}
+	PERF_END(PERF_CAN_DECODE);
+
+	ctx->last_level = last_level;
+	ctx->position += buf_len;
+}
+
+/*
+ * Function to prepare an analyser context for a capture, detecting the bit rate from the
+ * samples first if it is 0. Used when the capture is decoded in several blocks, the detection
+ * only looks at the given one.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing the first samples of the capture
+ *  buf_len length of byte array containing samples
+ *  pin position of the CAN RX line in the sample
+ *  bitrate bit rate of the bus, 0 to detect it
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser is ready
+ *  false if the configuration was invalid or the bit rate could not be detected
+ */
+bool can_analyser_start(can_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len, uint8_t pin,
+		uint32_t bitrate, uint32_t sample_rate){
+	uint32_t bit_period_q8 = 0;
+
+	if(bitrate){
+		bit_period_q8 = rate_to_bit_period(bitrate, sample_rate);
+	}else{
+		bit_period_q8 = detect_bit_period(buffer, buf_len, 1<<pin);
+		if(bit_period_q8 == 0){
+			printf("Could not detect bit rate, no stable pulse width found\r\n");
+			return false;
+		}
+		if(sample_rate){
+			bitrate = bit_period_to_rate(bit_period_q8, sample_rate, standard_bitrate_table,
+					standard_bitrate_table_len);
+			bit_period_q8 = rate_to_bit_period(bitrate, sample_rate);
+			printf("Detected bit rate: %lu\r\n", (unsigned long)bitrate);
+		}
+		printf("Samples per bit: %lu.%02lu\r\n", (unsigned long)(bit_period_q8 >> 8),
+				(unsigned long)(((bit_period_q8 & 0xFF) * 100) >> 8));
+	}
+
+	if(!can_analyser_init(ctx, pin, bit_period_q8, NULL, NULL)){
+		printf("Invalid CAN configuration or bit period too short for the sample rate\r\n");
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Function to run the CAN analyzer task on a complete buffer, detecting the bit rate first
+ * if it is 0.
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  pin position of the CAN RX line in the sample
+ *  bitrate bit rate of the bus, 0 to detect it
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser ran
+ *  false if the configuration was invalid or the bit rate could not be detected
+ */
+bool run_can_analyser(const uint8_t buffer[], uint32_t buf_len, uint8_t pin, uint32_t bitrate, uint32_t sample_rate){
+	static can_analyser_t ctx;
+
+	if(!can_analyser_start(&ctx, buffer, buf_len, pin, bitrate, sample_rate)){
+		return false;
+	}
+	can_analyser_process(&ctx, buffer, buf_len);
+	printf("Frames: %lu, Errors: %lu\r\n", (unsigned long)ctx.frames, (unsigned long)ctx.errors);
+
+	return true;
+}
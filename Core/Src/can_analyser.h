@@ -0,0 +1,173 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    can_analyser.h
+ * @brief   Header file for the CAN 2.0 interpreter. It goes over a given buffer, where data is 8bit
+ * 			format and one pin is selected as the RX line of a CAN transceiver by calling code.
+ *
+ * 			The bit rate can be given by the calling code or estimated from the capture itself (see
+ * 			bit_timing.h). Bit timing is recovered with a hard synchronisation on the start of frame
+ * 			and a resynchronisation on every recessive to dominant edge, so captures with any number
+ * 			of samples per bit, including fractional ones, can be decoded.
+ *
+ * 			It can decode:
+ * 			Standard (11 bit) and Extended (29 bit) identifiers
+ * 			Data and Remote frames
+ * 			DLC and up to 8 data bytes
+ * 			CRC15
+ * 			ACK slot
+ *
+ * 			and flags stuff, CRC, form and missing ACK errors on each frame.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __CAN_ANALYSER_H__
+#define __CAN_ANALYSER_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define CAN_FRAME_ERR_STUFF		(1<<0)
+#define CAN_FRAME_ERR_CRC		(1<<1)
+#define CAN_FRAME_ERR_FORM		(1<<2)
+#define CAN_FRAME_ERR_NO_ACK	(1<<3)
+
+#define CAN_MAX_STUFFED_BITS 	128	//longest frame from SOF to the end of the CRC, without stuff bits
+
+typedef struct{
+	uint64_t position;	//sample index of the start of frame
+	uint32_t id;
+	bool extended;
+	bool rtr;
+	uint8_t dlc;
+	uint8_t data[8];
+	uint16_t crc;		//crc received in the frame
+	uint8_t flags;		//CAN_FRAME_ERR_x
+}can_frame_t;
+
+typedef void (*can_frame_handler_t)(const can_frame_t *frame, void *arg);
+
+typedef enum{
+	CAN_STATE_WAIT_IDLE = 0,	//waiting for 11 recessive bits before trusting a start of frame
+	CAN_STATE_IDLE,
+	CAN_STATE_FRAME,			//stuffed part of the frame, SOF to CRC
+	CAN_STATE_TRAILER			//CRC delimiter, ACK and EOF
+}can_state_t;
+
+typedef struct{
+	uint8_t pin;
+	uint32_t bit_period_q8;
+	can_frame_handler_t on_frame;	//NULL prints each frame
+	void *arg;
+
+	can_state_t state;
+	uint8_t last_level;
+	uint8_t primed;
+	int32_t countdown_q8;		//time to the next sample point in 1/256th of a sample
+	uint32_t recessive_run;		//samples since the bus was last dominant
+	uint32_t idle_samples;		//11 bit times
+
+	uint8_t bits[CAN_MAX_STUFFED_BITS];	//destuffed bits of the current frame
+	uint8_t bit_count;
+	uint8_t header_len;			//bits up to and including the DLC, known once IDE is received
+	uint8_t crc_start;			//index of the first CRC bit, known once DLC is received
+	uint8_t same_bits;			//number of consecutive equal bits for destuffing
+	uint8_t last_bit;
+	uint8_t trailer_bit;
+	can_frame_t frame;
+
+	uint64_t position;
+	uint32_t frames;
+	uint32_t errors;
+}can_analyser_t;
+
+/*
+ * Function to compute the CAN CRC15 of a sequence of bits, one bit per byte
+ *
+ * Parameters:
+ *  bits pointer to bit array
+ *  len number of bits
+ *
+ * Returns:
+ *  crc of the bits
+ */
+uint16_t can_crc15(const uint8_t bits[], uint32_t len);
+
+/*
+ * Function to prepare an analyser context for decoding a capture block by block
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  pin position of the CAN RX line in the sample
+ *  bit_period_q8 samples per bit in 1/256th of a sample
+ *  on_frame function called for each decoded frame, NULL prints it
+ *  arg passed to on_frame
+ *
+ * Returns:
+ *  true if the configuration is valid
+ *  false otherwise
+ */
+bool can_analyser_init(can_analyser_t *ctx, uint8_t pin, uint32_t bit_period_q8,
+		can_frame_handler_t on_frame, void *arg);
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, frames which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void can_analyser_process(can_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len);
+
+/*
+ * Function to prepare an analyser context for a capture, detecting the bit rate from the
+ * samples first if it is 0. Used when the capture is decoded in several blocks, the detection
+ * only looks at the given one.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing the first samples of the capture
+ *  buf_len length of byte array containing samples
+ *  pin position of the CAN RX line in the sample
+ *  bitrate bit rate of the bus, 0 to detect it
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser is ready
+ *  false if the configuration was invalid or the bit rate could not be detected
+ */
+bool can_analyser_start(can_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len, uint8_t pin,
+		uint32_t bitrate, uint32_t sample_rate);
+
+/*
+ * Function to run the CAN analyzer task on a complete buffer, detecting the bit rate first
+ * if it is 0.
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  pin position of the CAN RX line in the sample
+ *  bitrate bit rate of the bus, 0 to detect it
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser ran
+ *  false if the configuration was invalid or the bit rate could not be detected
+ */
+bool run_can_analyser(const uint8_t buffer[], uint32_t buf_len, uint8_t pin, uint32_t bitrate, uint32_t sample_rate);
+
+#endif
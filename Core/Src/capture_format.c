@@ -0,0 +1,170 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    capture_format.c
+ * @brief   This file contains the function definitions to build and check the header of a binary
+ * 			capture file. The fields are written byte by byte in little endian, so the layout does
+ * 			not depend on the padding or endianness of the compiler.
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "capture_format.h"
+#include "stdio.h"
+#include "string.h"
+
+#define CAPTURE_OFFSET_MAGIC 		0
+#define CAPTURE_OFFSET_VERSION 		4
+#define CAPTURE_OFFSET_HEADER_SIZE 	6
+#define CAPTURE_OFFSET_SAMPLE_RATE 	8
+#define CAPTURE_OFFSET_WIDTH 		12
+#define CAPTURE_OFFSET_CHANNELS 	13
+#define CAPTURE_OFFSET_COUNT 		16
+#define CAPTURE_OFFSET_TRIGGER 		24
+#define CAPTURE_OFFSET_NAMES 		32
+#define CAPTURE_OFFSET_HEALTH 		160
+#define CAPTURE_HEALTH_FIELDS 		8
+#define CAPTURE_OFFSET_CRC 			(CAPTURE_HEADER_SIZE - 4)
+
+static void put_le(uint8_t *dest, uint64_t value, uint8_t len){
+	for(uint8_t i = 0; i < len; i++){
+		dest[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint64_t get_le(const uint8_t *src, uint8_t len){
+	uint64_t value = 0;
+	for(uint8_t i = 0; i < len; i++){
+		value |= (uint64_t)src[i] << (8 * i);
+	}
+	return value;
+}
+
+//the health fields in the order of the header
+static uint32_t *health_field(capture_health_t *health, uint8_t index){
+	uint32_t *fields[] = {&health->blocks, &health->transfer_errors, &health->fifo_errors,
+			&health->direct_mode_errors, &health->missed_halves, &health->lost_samples,
+			&health->latency_max_ns, &health->block_period_us};
+	return fields[index];
+}
+
+/*
+ * Description: fills a capture info with the defaults of this board, 8 channels named P0..P7
+ * 				in one byte per sample
+ * Parameters:
+ * 		capture_info_t *info info to fill
+ * 		uint32_t sample_rate sampling frequency in Hz, 0 if unknown
+ * 		uint64_t sample_count number of samples
+ * 		uint64_t trigger_position sample index of the trigger, CAPTURE_NO_TRIGGER if none
+ * Returns:
+ *   		None
+ */
+void capture_info_init(capture_info_t *info, uint32_t sample_rate, uint64_t sample_count,
+		uint64_t trigger_position){
+	memset(info, 0, sizeof(*info));
+	info->sample_rate = sample_rate;
+	info->sample_width = 1;
+	info->channel_count = CAPTURE_MAX_CHANNELS;
+	info->sample_count = sample_count;
+	info->trigger_position = trigger_position;
+	for(int ch = 0; ch < CAPTURE_MAX_CHANNELS; ch++){
+		sprintf(info->channel_names[ch], "P%d", ch);
+	}
+}
+
+/*
+ * Description: builds the header of a capture file
+ * Parameters:
+ * 		const capture_info_t *info description of the capture
+ * 		uint8_t header[] buffer of CAPTURE_HEADER_SIZE bytes to fill
+ * Returns:
+ *   		None
+ */
+void capture_header_encode(const capture_info_t *info, uint8_t header[CAPTURE_HEADER_SIZE]){
+	memset(header, 0, CAPTURE_HEADER_SIZE);
+	memcpy(header + CAPTURE_OFFSET_MAGIC, CAPTURE_MAGIC, 4);
+	put_le(header + CAPTURE_OFFSET_VERSION, CAPTURE_VERSION, 2);
+	put_le(header + CAPTURE_OFFSET_HEADER_SIZE, CAPTURE_HEADER_SIZE, 2);
+	put_le(header + CAPTURE_OFFSET_SAMPLE_RATE, info->sample_rate, 4);
+	header[CAPTURE_OFFSET_WIDTH] = info->sample_width;
+	header[CAPTURE_OFFSET_CHANNELS] = info->channel_count;
+	put_le(header + CAPTURE_OFFSET_COUNT, info->sample_count, 8);
+	put_le(header + CAPTURE_OFFSET_TRIGGER, info->trigger_position, 8);
+	for(int ch = 0; ch < CAPTURE_MAX_CHANNELS; ch++){
+		//names are NUL padded but not necessarily NUL terminated in the file
+		strncpy((char*)header + CAPTURE_OFFSET_NAMES + ch * CAPTURE_CHANNEL_NAME_LEN,
+				info->channel_names[ch], CAPTURE_CHANNEL_NAME_LEN);
+	}
+	capture_health_t health = info->health;
+	for(uint8_t i = 0; i < CAPTURE_HEALTH_FIELDS; i++){
+		put_le(header + CAPTURE_OFFSET_HEALTH + 4 * i, *health_field(&health, i), 4);
+	}
+	put_le(header + CAPTURE_OFFSET_CRC, capture_crc32(0, header, CAPTURE_OFFSET_CRC), 4);
+}
+
+/*
+ * Description: checks the header of a capture file and reads the description of the capture
+ * 				out of it
+ * Parameters:
+ * 		const uint8_t header[] first CAPTURE_HEADER_SIZE bytes of the file
+ * 		capture_info_t *info filled with the description of the capture
+ * Returns:
+ *   		bool true if magic, version, size and CRC are correct
+ *   			 false otherwise
+ */
+bool capture_header_decode(const uint8_t header[CAPTURE_HEADER_SIZE], capture_info_t *info){
+	if(memcmp(header + CAPTURE_OFFSET_MAGIC, CAPTURE_MAGIC, 4) != 0)
+		return false;
+	if(get_le(header + CAPTURE_OFFSET_VERSION, 2) != CAPTURE_VERSION)
+		return false;
+	if(get_le(header + CAPTURE_OFFSET_HEADER_SIZE, 2) != CAPTURE_HEADER_SIZE)
+		return false;
+	if(get_le(header + CAPTURE_OFFSET_CRC, 4) != capture_crc32(0, header, CAPTURE_OFFSET_CRC))
+		return false;
+
+	memset(info, 0, sizeof(*info));
+	info->sample_rate = get_le(header + CAPTURE_OFFSET_SAMPLE_RATE, 4);
+	info->sample_width = header[CAPTURE_OFFSET_WIDTH];
+	info->channel_count = header[CAPTURE_OFFSET_CHANNELS];
+	info->sample_count = get_le(header + CAPTURE_OFFSET_COUNT, 8);
+	info->trigger_position = get_le(header + CAPTURE_OFFSET_TRIGGER, 8);
+	for(int ch = 0; ch < CAPTURE_MAX_CHANNELS; ch++){
+		memcpy(info->channel_names[ch], header + CAPTURE_OFFSET_NAMES + ch * CAPTURE_CHANNEL_NAME_LEN,
+				CAPTURE_CHANNEL_NAME_LEN - 1);
+	}
+	for(uint8_t i = 0; i < CAPTURE_HEALTH_FIELDS; i++){
+		*health_field(&info->health, i) = get_le(header + CAPTURE_OFFSET_HEALTH + 4 * i, 4);
+	}
+
+	return (info->sample_width != 0 && info->channel_count <= CAPTURE_MAX_CHANNELS);
+}
+
+/*
+ * Description: computes the standard CRC32 (reflected, polynomial 0xEDB88320) of a buffer,
+ * 				it can be run over a buffer in several parts by passing the previous result
+ * Parameters:
+ * 		uint32_t crc 0 for the first part, the previous result otherwise
+ * 		const uint8_t *data pointer to the data
+ * 		uint32_t len length of the data
+ * Returns:
+ *   		uint32_t CRC32 of the data so far
+ */
+uint32_t capture_crc32(uint32_t crc, const uint8_t *data, uint32_t len){
+	crc = ~crc;
+	for(uint32_t i = 0; i < len; i++){
+		crc ^= data[i];
+		for(int bit = 0; bit < 8; bit++){
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    capture_format.h
+ * @brief   This file contains the layout of the binary capture file saved on the SD card, and the
+ * 			functions to build and check its header. A capture file is a header of CAPTURE_HEADER_SIZE
+ * 			bytes followed by the raw samples exactly as they are in SDRAM, so the samples start on a
+ * 			sector boundary and the file is the size of the capture plus one sector.
+ *
+ * 			All header fields are little endian:
+ *
+ * 			offset	size	field
+ * 			0		4		magic "LPCF"
+ * 			4		2		version
+ * 			6		2		header size in bytes
+ * 			8		4		sample rate in Hz, 0 if unknown (state mode)
+ * 			12		1		sample width in bytes
+ * 			13		1		number of channels
+ * 			14		2		reserved, 0
+ * 			16		8		number of samples
+ * 			24		8		sample index of the trigger, CAPTURE_NO_TRIGGER if none
+ * 			32		128		channel names, 8 x 16 bytes, NUL padded
+ * 			160		4		blocks of 32KB filled, 0 if the health of the capture is unknown
+ * 			164		4		DMA transfer errors
+ * 			168		4		DMA FIFO errors
+ * 			172		4		DMA direct mode errors
+ * 			176		4		pre trigger halves the trigger scan missed
+ * 			180		4		samples lost at block boundaries, 0xFFFFFFFF if unknown
+ * 			184		4		longest block handler latency in ns
+ * 			188		4		average time to fill a block in us
+ * 			192		316		reserved, 0
+ * 			508		4		CRC32 of bytes 0..507
+ *
+ * 			The health fields 160..191 are those of capture_health.h. Files written before them
+ * 			have zeros there, which reads as unknown health.
+ *
+ * 			Nothing in here touches the hardware, so it can be used by host tools as well.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __CAPTURE_FORMAT_H__
+#define __CAPTURE_FORMAT_H__
+#include "stdint.h"
+#include "stdbool.h"
+#include "capture_health.h"
+
+#define CAPTURE_MAGIC 				"LPCF"
+#define CAPTURE_VERSION 			1
+#define CAPTURE_HEADER_SIZE 		512
+#define CAPTURE_MAX_CHANNELS 		8
+#define CAPTURE_CHANNEL_NAME_LEN 	16
+#define CAPTURE_NO_TRIGGER 			UINT64_MAX
+
+typedef struct{
+	uint32_t sample_rate;
+	uint8_t sample_width;
+	uint8_t channel_count;
+	uint64_t sample_count;
+	uint64_t trigger_position;
+	char channel_names[CAPTURE_MAX_CHANNELS][CAPTURE_CHANNEL_NAME_LEN];
+	capture_health_t health;	//all 0 if unknown
+}capture_info_t;
+
+/*
+ * Description: fills a capture info with the defaults of this board, 8 channels named P0..P7
+ * 				in one byte per sample
+ * Parameters:
+ * 		capture_info_t *info info to fill
+ * 		uint32_t sample_rate sampling frequency in Hz, 0 if unknown
+ * 		uint64_t sample_count number of samples
+ * 		uint64_t trigger_position sample index of the trigger, CAPTURE_NO_TRIGGER if none
+ * Returns:
+ *   		None
+ */
+void capture_info_init(capture_info_t *info, uint32_t sample_rate, uint64_t sample_count,
+		uint64_t trigger_position);
+
+/*
+ * Description: builds the header of a capture file
+ * Parameters:
+ * 		const capture_info_t *info description of the capture
+ * 		uint8_t header[] buffer of CAPTURE_HEADER_SIZE bytes to fill
+ * Returns:
+ *   		None
+ */
+void capture_header_encode(const capture_info_t *info, uint8_t header[CAPTURE_HEADER_SIZE]);
+
+/*
+ * Description: checks the header of a capture file and reads the description of the capture
+ * 				out of it
+ * Parameters:
+ * 		const uint8_t header[] first CAPTURE_HEADER_SIZE bytes of the file
+ * 		capture_info_t *info filled with the description of the capture
+ * Returns:
+ *   		bool true if magic, version, size and CRC are correct
+ *   			 false otherwise
+ */
+bool capture_header_decode(const uint8_t header[CAPTURE_HEADER_SIZE], capture_info_t *info);
+
+/*
+ * Description: computes the standard CRC32 (reflected, polynomial 0xEDB88320) of a buffer,
+ * 				it can be run over a buffer in several parts by passing the previous result
+ * Parameters:
+ * 		uint32_t crc 0 for the first part, the previous result otherwise
+ * 		const uint8_t *data pointer to the data
+ * 		uint32_t len length of the data
+ * Returns:
+ *   		uint32_t CRC32 of the data so far
+ */
+uint32_t capture_crc32(uint32_t crc, const uint8_t *data, uint32_t len);
+
+#endif
@@ -0,0 +1,174 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    capture_health.c
+ * @brief   This file contains the health counters of the last capture, see capture_health.h. Times
+ * 			are taken with the DWT cycle counter and the counter of the sampling timer, so they
+ * 			only hold within the 24s the cycle counter takes to wrap at 180MHz.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "capture_health.h"
+#include "hw_access.h"
+#include "pll_clock.h"
+#include "stdio.h"
+#include "string.h"
+
+#define CAPTURE_HEALTH_PRINT_GAPS 4		//boundaries with lost samples printed after a capture
+#define DMA_ERROR_FLAGS (DMA_LISR_TEIF0 | DMA_LISR_DMEIF0 | DMA_LISR_FEIF0)
+
+static const uint8_t flag_shift[4] = {0, 6, 16, 22};	//flags of streams 0..3 in LISR, 4..7 in HISR
+
+static capture_health_t health;
+static capture_boundary_t boundaries[CAPTURE_HEALTH_MAX_BOUNDARIES];
+static uint32_t boundary_count = 0;
+static bool started = false;
+static uint32_t last_sample;		//cycle count of the sampling event before the last start
+static uint32_t last_end;			//cycle count of the handler of the last block
+static uint64_t block_us_total;
+
+/*
+ * Description: converts ticks of TIM1 or TIM8 to core clock cycles
+ * Parameters:
+ * 		uint32_t ticks timer ticks
+ * 		uint16_t psc prescaler of the timer
+ * Returns:
+ *   		uint32_t cycles
+ */
+static uint32_t ticks_to_cycles(uint32_t ticks, uint16_t psc){
+	return (uint32_t)((uint64_t)ticks * (psc + 1) * get_sysclk_freq() / (get_apb2_clk_freq() * 2));
+}
+
+/*
+ * Description: converts core clock cycles to nanoseconds
+ * Parameters:
+ * 		uint32_t cycles cycles
+ * Returns:
+ *   		uint32_t nanoseconds
+ */
+static uint32_t cycles_to_ns(uint32_t cycles){
+	return (uint32_t)((uint64_t)cycles * 1000000000 / get_sysclk_freq());
+}
+
+void capture_health_reset(bool external_clock){
+	memset(&health, 0, sizeof(health));
+	health.lost_samples = external_clock ? CAPTURE_HEALTH_UNKNOWN : 0;
+	boundary_count = 0;
+	started = false;
+	block_us_total = 0;
+}
+
+void capture_health_set(const capture_health_t *counters){
+	capture_health_reset(false);
+	health = *counters;
+}
+
+const capture_health_t *capture_health_get(void){
+	return &health;
+}
+
+const capture_boundary_t *capture_health_get_boundaries(uint32_t *count){
+	*count = boundary_count;
+	return boundaries;
+}
+
+uint32_t capture_health_dma_flags(uint8_t stream){
+	volatile uint32_t *isr = (stream < 4) ? &DMA2->LISR : &DMA2->HISR;
+	volatile uint32_t *ifcr = (stream < 4) ? &DMA2->LIFCR : &DMA2->HIFCR;
+	uint8_t shift = flag_shift[stream & 3];
+	uint32_t flags = (*isr >> shift) & (DMA_LISR_TCIF0 | DMA_LISR_HTIF0 | DMA_ERROR_FLAGS);
+
+	if(flags & DMA_LISR_TEIF0)
+		health.transfer_errors++;
+	if(flags & DMA_LISR_FEIF0)
+		health.fifo_errors++;
+	if(flags & DMA_LISR_DMEIF0)
+		health.direct_mode_errors++;
+	if(flags & DMA_ERROR_FLAGS)
+		*ifcr |= (flags & DMA_ERROR_FLAGS) << shift;
+	return flags;
+}
+
+void capture_health_block_end(uint16_t ticks, uint16_t psc, uint32_t sample_ticks){
+	uint32_t now = DWT->CYCCNT;
+	uint32_t latency = ticks_to_cycles(ticks, psc);
+	uint32_t ns;
+
+	//the counter wraps every sample, but the block ended a block of samples after the sampling
+	//event before the last start, which gives the whole latency
+	if(sample_ticks != 0 && started){
+		uint32_t block = (uint32_t)((uint64_t)ticks_to_cycles(sample_ticks, psc) * CAPTURE_HEALTH_BLOCK);
+		int32_t since = (int32_t)(now - last_sample - block);
+		latency = (since > 0) ? (uint32_t)since : 0;//a start on the sampling event itself reads one early
+	}
+	ns = cycles_to_ns(latency);
+	if(ns > health.latency_max_ns)
+		health.latency_max_ns = ns;
+
+	if(health.blocks > 0){
+		block_us_total += (now - last_end) / (get_sysclk_freq() / 1000000);
+		health.block_period_us = (uint32_t)(block_us_total / health.blocks);
+	}
+	health.blocks++;
+	last_end = now;
+}
+
+void capture_health_stream_started(uint16_t ticks, uint16_t psc, uint32_t sample_ticks){
+	uint32_t sample = DWT->CYCCNT - ticks_to_cycles(ticks, psc);
+	uint32_t lost = 0;
+
+	if(sample_ticks != 0 && started){
+		uint32_t period = ticks_to_cycles(sample_ticks, psc);
+		uint32_t samples = (sample - last_sample + period / 2) / period;
+
+		if(samples > CAPTURE_HEALTH_BLOCK)
+			lost = samples - CAPTURE_HEALTH_BLOCK;
+		health.lost_samples += lost;
+	}
+	if(boundary_count < CAPTURE_HEALTH_MAX_BOUNDARIES){
+		boundaries[boundary_count].ticks = ticks;
+		boundaries[boundary_count].lost = (lost > UINT16_MAX) ? UINT16_MAX : lost;
+		boundary_count++;
+	}
+	last_sample = sample;
+	started = true;
+}
+
+void capture_health_missed_half(void){
+	health.missed_halves++;
+}
+
+void capture_health_print(void){
+	uint32_t shown = 0;
+
+	printf("Health: %lu blocks", (unsigned long) health.blocks);
+	if(health.block_period_us != 0)
+		printf(" of %lu us", (unsigned long) health.block_period_us);
+	printf(", handler latency up to %lu ns\r\n", (unsigned long) health.latency_max_ns);
+	if(health.lost_samples == CAPTURE_HEALTH_UNKNOWN)
+		printf("Samples lost at block boundaries: unknown on an external clock\r\n");
+	else
+		printf("Samples lost at block boundaries: %lu\r\n", (unsigned long) health.lost_samples);
+	if(health.missed_halves != 0)
+		printf("Pre trigger halves the trigger scan missed: %lu\r\n", (unsigned long) health.missed_halves);
+	printf("DMA errors: %lu transfer, %lu FIFO, %lu direct mode\r\n", (unsigned long) health.transfer_errors,
+			(unsigned long) health.fifo_errors, (unsigned long) health.direct_mode_errors);
+	for(uint32_t i = 0; i < boundary_count && shown < CAPTURE_HEALTH_PRINT_GAPS; i++){
+		if(boundaries[i].lost != 0){
+			printf("  block %lu: %u samples lost, restarted %u timer ticks after a sample\r\n",
+					(unsigned long) i, boundaries[i].lost, boundaries[i].ticks);
+			shown++;
+		}
+	}
+}
@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    capture_health.h
+ * @brief   This file contains the health counters of the last capture, kept by the DMA interrupt
+ * 			handlers of timing and state mode and saved in the header of the capture file:
+ *
+ * 			DMA errors		transfer, FIFO and direct mode error flags of the streams, which
+ * 							now raise their interrupt. A transfer error stops the stream and ends
+ * 							the capture as failed
+ * 			missed halves	halves of the pre trigger buffer filled again before the trigger scan
+ * 							took the previous one, so a trigger in there could be missed
+ * 			latency			longest time from the end of a block of 32KB to its handler, against
+ * 							the time a block takes to fill
+ * 			lost samples	samples the sampling timer made while the stream was stopped between
+ * 							two blocks. The stream of timing mode restarts from its handler, so
+ * 							at each block boundary the timer counter and the cycle counter give
+ * 							the sampling event just before the restart; two consecutive ones must
+ * 							be exactly a block apart. On the external clock of state mode the
+ * 							edges cannot be counted and lost samples are CAPTURE_HEALTH_UNKNOWN
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __CAPTURE_HEALTH_H__
+#define __CAPTURE_HEALTH_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define CAPTURE_HEALTH_BLOCK 32768			//samples of a block, one DMA transfer
+#define CAPTURE_HEALTH_MAX_BOUNDARIES 256	//boundaries recorded, a whole SDRAM of blocks
+#define CAPTURE_HEALTH_UNKNOWN UINT32_MAX
+
+typedef struct{
+	uint32_t blocks;				//blocks filled, the halves of the pre trigger buffer included
+	uint32_t transfer_errors;
+	uint32_t fifo_errors;
+	uint32_t direct_mode_errors;
+	uint32_t missed_halves;
+	uint32_t lost_samples;			//CAPTURE_HEALTH_UNKNOWN on an external clock
+	uint32_t latency_max_ns;
+	uint32_t block_period_us;		//average time to fill a block, 0 before the second block
+}capture_health_t;
+
+typedef struct{
+	uint16_t ticks;		//timer counter since the last sampling event, when the stream restarted
+	uint16_t lost;		//samples lost at this boundary
+}capture_boundary_t;
+
+/*
+ * Description: clears the counters, at the start of a capture or when the capture is replaced
+ * 				by one without them
+ * Parameters:
+ * 		bool external_clock true for state mode, where lost samples cannot be counted
+ * Returns:
+ *   		None
+ */
+void capture_health_reset(bool external_clock);
+
+/*
+ * Description: sets the counters, for a capture loaded from a file
+ * Parameters:
+ * 		const capture_health_t *health counters of the capture
+ * Returns:
+ *   		None
+ */
+void capture_health_set(const capture_health_t *health);
+
+/*
+ * Description: gives the counters of the last capture
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const capture_health_t * counters
+ */
+const capture_health_t *capture_health_get(void);
+
+/*
+ * Description: gives the block boundaries recorded in the last capture, where a stream restarted
+ * Parameters:
+ * 		uint32_t *count set to the number of boundaries
+ * Returns:
+ *   		const capture_boundary_t * boundaries, in order
+ */
+const capture_boundary_t *capture_health_get_boundaries(uint32_t *count);
+
+/*
+ * Description: counts and clears the error flags of a DMA2 stream, at the start of its handler
+ * Parameters:
+ * 		uint8_t stream stream number
+ * Returns:
+ *   		uint32_t flags of the stream as those of stream 0, DMA_LISR_TCIF0, DMA_LISR_TEIF0...
+ */
+uint32_t capture_health_dma_flags(uint8_t stream);
+
+/*
+ * Description: records the end of a block, at the start of its handler
+ * Parameters:
+ * 		uint16_t ticks timer counter since the sampling event that ended the block, modulo the
+ * 					   sampling period
+ * 		uint16_t psc prescaler of the timer
+ * 		uint32_t sample_ticks sampling period in timer ticks, 0 on an external clock
+ * Returns:
+ *   		None
+ */
+void capture_health_block_end(uint16_t ticks, uint16_t psc, uint32_t sample_ticks);
+
+/*
+ * Description: records the start or restart of the sampling stream, right after it is enabled,
+ * 				and counts the samples lost since the previous start
+ * Parameters:
+ * 		uint16_t ticks timer counter since the last sampling event
+ * 		uint16_t psc prescaler of the timer
+ * 		uint32_t sample_ticks sampling period in timer ticks, 0 on an external clock
+ * Returns:
+ *   		None
+ */
+void capture_health_stream_started(uint16_t ticks, uint16_t psc, uint32_t sample_ticks);
+
+/*
+ * Description: counts a half of the pre trigger buffer that was filled again before the trigger
+ * 				scan took the previous one
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void capture_health_missed_half(void);
+
+/*
+ * Description: prints the counters and the boundaries where samples were lost
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void capture_health_print(void);
+
+#endif
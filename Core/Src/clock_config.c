@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    clock_config.c
+ * @brief   This file contains the table of clock configurations, see clock_config.h. It touches no
+ * 			register, so the host build uses it for the clocks of the simulated peripherals.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "clock_config.h"
+#include "stddef.h"
+
+#define CLOCK_VCO_IN_MIN 950000
+#define CLOCK_VCO_IN_MAX 2100000
+#define CLOCK_VCO_OUT_MIN 100000000
+#define CLOCK_VCO_OUT_MAX 432000000
+#define CLOCK_MAX_PLLQ_OUT 48000000
+#define CLOCK_MAX_APB1 (CLOCK_MAX_HCLK / 4)
+#define CLOCK_MAX_APB2 (CLOCK_MAX_HCLK / 2)
+#define CLOCK_MAX_APB1_NO_OVERDRIVE (CLOCK_MAX_HCLK_NO_OVERDRIVE / 4)
+#define CLOCK_MAX_APB2_NO_OVERDRIVE (CLOCK_MAX_HCLK_NO_OVERDRIVE / 2)
+
+//order must match clock_config_id_t
+static const clock_config_t configs[] = {
+	{"160MHz HSI", false, 8, 160, 2, 8, 1, 4, 2},
+	{"168MHz HSE", true, 4, 168, 2, 7, 1, 4, 2},
+	{"180MHz HSE", true, 4, 180, 2, 8, 1, 4, 2},
+};
+
+const clock_config_t *clock_config_get(void){
+	return &configs[CLOCK_CONFIG];
+}
+
+const clock_config_t *clock_config_by_id(clock_config_id_t id){
+	if(id >= CLOCK_CONFIGS){
+		return NULL;
+	}
+	return &configs[id];
+}
+
+/*
+ * Description: computes the VCO output of a configuration
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		uint32_t frequency in Hz
+ */
+static uint32_t vco_freq(const clock_config_t *config){
+	uint32_t input = config->hse ? PLL_HSE_FREQ : PLL_HSI_FREQ;
+
+	return (uint32_t)(((uint64_t)input * config->plln) / config->pllm);
+}
+
+uint32_t clock_config_sysclk(const clock_config_t *config){
+	return vco_freq(config) / config->pllp;
+}
+
+uint32_t clock_config_hclk(const clock_config_t *config){
+	return clock_config_sysclk(config) / config->ahb_div;
+}
+
+uint32_t clock_config_apb1(const clock_config_t *config){
+	return clock_config_hclk(config) / config->apb1_div;
+}
+
+uint32_t clock_config_apb2(const clock_config_t *config){
+	return clock_config_hclk(config) / config->apb2_div;
+}
+
+uint8_t clock_config_flash_latency(const clock_config_t *config){
+	return (uint8_t)((clock_config_hclk(config) - 1) / CLOCK_FLASH_HZ_PER_WS);
+}
+
+bool clock_config_overdrive(const clock_config_t *config){
+	return clock_config_hclk(config) > CLOCK_MAX_HCLK_NO_OVERDRIVE;
+}
+
+/*
+ * Description: tells if a divider is a power of two within a range
+ * Parameters:
+ * 		uint32_t div divider
+ * 		uint32_t min smallest divider
+ * 		uint32_t max largest divider
+ * Returns:
+ *   		bool true if it is
+ */
+static bool power_of_two(uint32_t div, uint32_t min, uint32_t max){
+	return div >= min && div <= max && (div & (div - 1)) == 0;
+}
+
+bool clock_config_valid(const clock_config_t *config){
+	uint32_t input = config->hse ? PLL_HSE_FREQ : PLL_HSI_FREQ;
+	bool overdrive = clock_config_overdrive(config);
+
+	if(config->pllm < 2 || config->pllm > 63 || config->plln < 50 || config->plln > 432)
+		return false;
+	if(config->pllq < 2 || config->pllq > 15 || !power_of_two(config->pllp, 2, 8))
+		return false;
+	if(input / config->pllm < CLOCK_VCO_IN_MIN || input / config->pllm > CLOCK_VCO_IN_MAX)
+		return false;
+	if(vco_freq(config) < CLOCK_VCO_OUT_MIN || vco_freq(config) > CLOCK_VCO_OUT_MAX)
+		return false;
+	if(vco_freq(config) / config->pllq > CLOCK_MAX_PLLQ_OUT)
+		return false;
+	if(!power_of_two(config->ahb_div, 1, 512) || config->ahb_div == 32)
+		return false;
+	if(!power_of_two(config->apb1_div, 2, 16) || !power_of_two(config->apb2_div, 2, 16))
+		return false;
+	if(clock_config_hclk(config) > CLOCK_MAX_HCLK)
+		return false;
+	if(clock_config_apb1(config) > (overdrive ? CLOCK_MAX_APB1 : CLOCK_MAX_APB1_NO_OVERDRIVE))
+		return false;
+	return clock_config_apb2(config) <= (overdrive ? CLOCK_MAX_APB2 : CLOCK_MAX_APB2_NO_OVERDRIVE);
+}
@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    clock_config.h
+ * @brief   This file contains the table of clock configurations init_clocks can set, and the
+ * 			frequencies and settings derived from an entry. The entry is chosen at build time with
+ * 			CLOCK_CONFIG. Nothing else in the firmware assumes a frequency: the SysTick reload, the
+ * 			ARR of the sampling timer, the USART BRR, the SPI prescaler and the FMC timings are all
+ * 			computed from the clocks init_clocks left, see pll_clock.h.
+ *
+ * 			160MHz HSI		the PLL from the internal oscillator, what the board ran at first
+ * 			168MHz HSE		the PLL from the 8MHz crystal, the fastest without over-drive
+ * 			180MHz HSE		the PLL from the 8MHz crystal with over-drive, the default. APB1 at
+ * 							45MHz and APB2 at 90MHz, so the sampling timer counts at 180MHz and
+ * 							the SDRAM runs at 90MHz
+ *
+ * 			The flash wait states and over-drive follow from the AHB clock, at 2.7V to 3.6V.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef SRC_CLOCK_CONFIG_H_
+#define SRC_CLOCK_CONFIG_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define PLL_HSI_FREQ 16000000
+#define PLL_HSE_FREQ 8000000	//crystal of the discovery board
+
+#define CLOCK_MAX_HCLK 180000000
+#define CLOCK_MAX_HCLK_NO_OVERDRIVE 168000000
+#define CLOCK_FLASH_HZ_PER_WS 30000000		//at 2.7V to 3.6V
+
+typedef enum{
+	CLOCK_CONFIG_160MHZ_HSI = 0,
+	CLOCK_CONFIG_168MHZ_HSE,
+	CLOCK_CONFIG_180MHZ_HSE,
+	CLOCK_CONFIGS
+}clock_config_id_t;
+
+#ifndef CLOCK_CONFIG
+#define CLOCK_CONFIG CLOCK_CONFIG_180MHZ_HSE
+#endif
+
+typedef struct{
+	const char *name;
+	bool hse;				//PLL input from the crystal, else from HSI
+	uint8_t pllm;			//2..63, the VCO input should be 2MHz
+	uint16_t plln;			//50..432
+	uint8_t pllp;			//2, 4, 6 or 8
+	uint8_t pllq;			//2..15
+	uint16_t ahb_div;		//1, 2, 4 ... 512 but 32
+	uint8_t apb1_div;		//2, 4, 8 or 16, the timer code takes timer clocks as twice APB
+	uint8_t apb2_div;
+}clock_config_t;
+
+/*
+ * Description: gives the configuration the firmware is built for, CLOCK_CONFIG
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const clock_config_t * the configuration
+ */
+const clock_config_t *clock_config_get(void);
+
+/*
+ * Description: gives an entry of the table
+ * Parameters:
+ * 		clock_config_id_t id entry
+ * Returns:
+ *   		const clock_config_t * the configuration, NULL past the end of the table
+ */
+const clock_config_t *clock_config_by_id(clock_config_id_t id);
+
+/*
+ * Description: computes the system clock of a configuration, (input / PLLM * PLLN) / PLLP
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		uint32_t frequency in Hz
+ */
+uint32_t clock_config_sysclk(const clock_config_t *config);
+
+/*
+ * Description: computes the AHB clock of a configuration, the core and the FMC
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		uint32_t frequency in Hz
+ */
+uint32_t clock_config_hclk(const clock_config_t *config);
+
+/*
+ * Description: computes the APB1 clock of a configuration, USART2 and TIM2-5
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		uint32_t frequency in Hz
+ */
+uint32_t clock_config_apb1(const clock_config_t *config);
+
+/*
+ * Description: computes the APB2 clock of a configuration, SPI1, TIM1 and TIM8
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		uint32_t frequency in Hz
+ */
+uint32_t clock_config_apb2(const clock_config_t *config);
+
+/*
+ * Description: gives the flash wait states the AHB clock of a configuration needs
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		uint8_t wait states
+ */
+uint8_t clock_config_flash_latency(const clock_config_t *config);
+
+/*
+ * Description: tells if the AHB clock of a configuration needs the over-drive of the regulator
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		bool true above CLOCK_MAX_HCLK_NO_OVERDRIVE
+ */
+bool clock_config_overdrive(const clock_config_t *config);
+
+/*
+ * Description: checks a configuration against the limits of the reference manual: PLL input and
+ * 				VCO ranges, the 48MHz output, the AHB and APB maximums, with or without over-drive
+ * Parameters:
+ * 		const clock_config_t *config configuration
+ * Returns:
+ *   		bool true if init_clocks can set it
+ */
+bool clock_config_valid(const clock_config_t *config);
+
+#endif /* SRC_CLOCK_CONFIG_H_ */
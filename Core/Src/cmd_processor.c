@@ -36,59 +36,87 @@
 #include "timing_mode_init.h"
 #include "state_mode.h"
 #include "i2c_analyser.h"
+#include "uart_analyser.h"
+#include "can_analyser.h"
+#include "bit_timing.h"
+#include "onewire_analyser.h"
 #include "fmc.h"
 #include "stdlib.h"
 #include "user_fatfs.h"
+#include "capture_format.h"
+#include "sector_cache.h"
+#include "systick.h"
+#include "pll_clock.h"
+#include "sump.h"
+#include "dump.h"
+#include "line_editor.h"
+#include "membench.h"
+#include "perf.h"
+#include "wavegen.h"
+#include "capture_health.h"
+#include "spi.h"
 
-#define CMD_PROCESSOR_LINE_BUFFER_SIZE 256
-#define CMD_PROCESSOR_ARGV_SIZE 64
 #define iseot(x) (((x == ' ')||(x == '\r'))?(1):(0)) //end of token can only be space or cr
 #define ishyphen(x) ((x == '-'))
+#define BAUD_CONFIRM_MS 5000		//time given to the host to confirm a new baud rate
+#define BAUD_TEST_BYTES 65536		//bytes sent by baud -t
+#define ANALYSE_FILE_SLICE 1024	//samples decoded between two steps of the background read of a capture file
+#define RUN_SCRIPT_SIZE 2048	//largest script run can load
+#define RUN_MAX_LINES 64
+#define RUN_MAX_DEPTH 4			//nested loops in a script
+#define RUN_STEP_TEXT 28		//characters of a step shown in the timing table
+#define MEMBENCH_DEFAULT_KB 1024	//SDRAM area membench runs over
+#define MEMBENCH_MIN_KB 128
+#define GEN_DEFAULT_RATE 1000000	//sample rate gen assumes, in Hz
 
-/* Function to get a line input from the uart using get_char. The line is delimited by
- * a  carriage return character. This function also handles the backspace capability of
- * the command processor.
+static line_editor_t editor;
+static bool prompt_shown = false;
+static bool step_failed = false;	//set by a handler when its command fails, so scripts can react
+static bool script_running = false;
+
+static bool execute_line(uint8_t line[]);
+
+/* Function to move the console line along with the characters received so far. It prints the
+ * "> " prompt before the first character of a line and never waits for input, so the main loop
+ * can run background jobs between two calls. A SUMP command as the first character of a line
+ * starts a SUMP session, see sump.h.
  *
  * Parameters:
- * 	line_buffer(out) pointer to byte buffer where the line input is saved and returned
+ * 	none
  *
  * Returns:
- *  none
+ *  true if a line ending with a carriage return is in the line editor
+ *  false otherwise
  */
-void get_line(uint8_t line_buffer[]) {
-	uint8_t *line_wr_ptr = line_buffer;
+static bool poll_line(void) {
 	uint8_t byte;
 
-	while (1) {
+	if (!prompt_shown) {
+		printf("> ");
+		prompt_shown = true;
+	}
+	while (char_available()) {
 		byte = get_char();
-
-		if (byte == '\b') {
-			if (line_wr_ptr == line_buffer) {
-				continue; //to prevent backspace at the start of the line
-			}
-			printf("\b \b");
-			line_wr_ptr--;  //to move the pointer back 1 place to erase previous
-							//character in the line buffer
-			*line_wr_ptr = '\0';
-		} else {
-			printf("%c", byte);	//echo user input and save it in the line buffer
-			*line_wr_ptr = byte;
-			line_wr_ptr++;
+		if (editor.len == 0 && sump_is_start(byte)) {
+			sump_run(byte);	//a SUMP host such as PulseView, the console is back once it sends a carriage return
+			printf("\r\n> ");
+			continue;
 		}
-		if (byte == '\r') {//exit on carriage return
-			printf("\n");
-			break;
+		if (line_editor_feed(&editor, byte)) {
+			return true;
 		}
 	}
+	return false;
 }
 
 /* Function to tokenise a line buffer and return argc and agrv values. argc is the
- * number of tokens and argv is a pointer to the start address of those tokens.
+ * number of tokens and argv is a pointer to the start address of those tokens. Tokens past
+ * CMD_PROCESSOR_ARGV_SIZE - 1 are dropped, so argv[argc] stays NULL for getopt.
  *
  * Parameters:
  * 	line(in/out) pointer to byte buffer where the line input is saved and returned
  * 	argc(out) pointer an integer holding the value of the number of tokens
- * 	argv(out) array of pointers to an byte holding the start address of those tokens
+ * 	argv(out) array of CMD_PROCESSOR_ARGV_SIZE pointers to an byte holding the start address of those tokens
  *
  * Returns:
  *  none
@@ -101,7 +129,7 @@ void get_tokens(uint8_t line[], uint8_t *argc, uint8_t *argv[]) {
 		end++;
 	}
 
-	while (ptr <= end) {
+	while (ptr <= end && *argc < CMD_PROCESSOR_ARGV_SIZE - 1) {
 		if (isalpha(*ptr) || isdigit(*ptr) || ishyphen(*ptr)) {
 			argv[*argc] = ptr;
 			(*argc)++;
@@ -112,6 +140,7 @@ void get_tokens(uint8_t line[], uint8_t *argc, uint8_t *argv[]) {
 		}
 		ptr++;
 	}
+	argv[*argc] = NULL;
 }
 
 typedef void (*command_handler_t)(int argc, char *argv[]);
@@ -120,6 +149,15 @@ void help_handler(int argc, char *argv[]);
 void timing_mode_handler(int argc, char *argv[]);
 void state_mode_handler(int argc, char *argv[]);
 void save_handler(int argc, char *argv[]);
+void jobs_handler(int argc, char *argv[]);
+void baud_handler(int argc, char *argv[]);
+void dump_handler(int argc, char *argv[]);
+void run_handler(int argc, char *argv[]);
+void membench_handler(int argc, char *argv[]);
+void mem_handler(int argc, char *argv[]);
+void perf_handler(int argc, char *argv[]);
+void gen_handler(int argc, char *argv[]);
+void load_handler(int argc, char *argv[]);
 void analyser_handler(int argc, char *argv[]);
 
 typedef struct {
@@ -150,11 +188,62 @@ static const command_table_t commands[] =
 								"	-t -d and -p fields are only used if trigger mode is selected, otherwise they are ignored.}\r\n" },
 				{ "ANALYSE", analyser_handler,
 						"Run the Interpreter of choice on the data\r\n\n"
-								"	-m {select the mode of analysis, it can be [i2c],defaults to i2c mode}\r\n"
-								"	-s {selects the size of interpreter, it can be [s,m,l], it defaults to small}\r\n" },
+								"	-m {select the mode of analysis, it can be [i2c,uart,1wire,can],defaults to i2c mode}\r\n"
+								"	-s {selects the size of interpreter, it can be [s,m,l,a], a is the whole last or loaded capture, it defaults to small}\r\n"
+								"	-t {selects the uart TX pin, the 1-Wire bus pin or the CAN RX pin, it can be from 0..7}\r\n"
+								"	-r {selects the uart RX pin, it can be from 0..7, if neither is given TX is P0 and RX is P1}\r\n"
+								"	-b {selects the uart baud rate or CAN bit rate, or auto to detect it from the capture, defaults to auto}\r\n"
+								"	-d {selects the uart data bits, it can be from 5..9, defaults to 8}\r\n"
+								"	-p {selects the uart parity, it can be [n,e,o], defaults to n}\r\n"
+								"	-x {selects the uart stop bits, it can be [1,2], defaults to 1}\r\n"
+								"	-f {decodes a capture file on the SD card instead of SDRAM, -m none only reads it to measure the card}\r\n" },
 				{ "SAVE", save_handler,
-						"Save the Data on the SD Card\r\n\n"
-								"	-s {selects the size of save, it can be [s,m,l], it defaults to small}\r\n" }, };
+						"Save the Data on the SD Card, in the background so the next capture can be taken meanwhile\r\n\n"
+								"	-s {selects the size of save, it can be [s,m,l], it defaults to small}\r\n"
+								"	-w {waits for the save to end and prints its speed}\r\n" },
+				{ "LOAD", load_handler,
+						"Load a saved capture from the SD Card back into SDRAM, to analyse it again\r\n\n"
+								"	-f {selects the capture file, for example file1.bin, no default value}\r\n" },
+				{ "JOBS", jobs_handler,
+						"Displays the progress of the background save and the sector cache counters\r\n" },
+				{ "BAUD", baud_handler,
+						"Displays or changes the baud rate of the console, up to 5000000\r\n\n"
+								"	-b {selects the new baud rate, press enter at the new rate within 5 s or the old one comes back}\r\n"
+								"	-t {sends 64 KB to measure the throughput at the rate in use, after the switch if -b is given}\r\n" },
+				{ "DUMP", dump_handler,
+						"Send the last or loaded capture to the host as COBS frames with a CRC32, see dump.h for the format\r\n\n"
+								"	-o {selects the first sample to send, defaults to 0}\r\n"
+								"	-n {selects the number of samples to send, defaults to the rest of the capture}\r\n"
+								"	-r {run length encodes the samples, so idle stretches take a few bytes}\r\n" },
+				{ "RUN", run_handler,
+						"Run a script of commands from the SD Card and print the time of each step, a key press stops it\r\n\n"
+								"	-f {selects the script file, for example test.txt, no default value}\r\n"
+								"	-n {runs the whole script this many times, defaults to 1}\r\n"
+								"	in the script: loop <n> ... end, wait (for the background save), wait <ms>,\r\n"
+								"	onfail [stop,next,ignore] (what a failed step or trigger timeout does), # comments\r\n" },
+				{ "MEMBENCH", membench_handler,
+						"Measure the SDRAM bandwidth by CPU and DMA at 8, 16 and 32 bits, it overwrites the last capture\r\n\n"
+								"	-p {switches to an FMC timing profile by name or number first, kept only if the memory check passes}\r\n"
+								"	-l {lists the FMC timing profiles}\r\n"
+								"	-s {selects the size of the area in KB, a power of two from 128 up to what the free SDRAM holds, defaults to 1024}\r\n" },
+				{ "MEM", mem_handler,
+						"Displays the map of the SDRAM regions, captures, saves in progress and buffers,\r\n"
+								"	and the SUMP captures refused for lack of room\r\n" },
+				{ "PERF", perf_handler,
+						"Displays the cycles taken by the interrupt handlers, trigger scan, decoders, SD writes and printf,\r\n"
+								"	and the interrupt entry latencies, since the last perf. Only in the Debug build\r\n" },
+				{ "GEN", gen_handler,
+						"Fill SDRAM with synthetic bus traffic as the last capture, to test and time the analysers\r\n\n"
+								"	-m {selects the protocol, it can be [uart,i2c,spi,1wire,can], defaults to i2c}\r\n"
+								"	-r {selects the sample rate in Hz, defaults to 1000000}\r\n"
+								"	-b {selects the baud rate, SCL or SCK frequency or CAN bit rate, defaults to 8 samples a bit or more}\r\n"
+								"	-k {selects the size in KB, defaults to the whole SDRAM}\r\n"
+								"	-j {selects the jitter of the edges in percent of the shortest pulse, from 0..20, defaults to 0}\r\n"
+								"	-g {selects the percent of frames or bytes given a glitch, defaults to 0}\r\n"
+								"	-e {selects the percent of frames given a protocol error, defaults to 0}\r\n"
+								"	-z {selects the seed, the same seed gives the same traffic, defaults to 1}\r\n"
+								"	the pins are those analyse uses by default: uart TX P0; i2c SCL P0, SDA P1; spi SCK P0, MOSI P1,\r\n"
+								"	MISO P2, CS P3; the 1-Wire bus and CAN RX P0\r\n" }, };
 static const int num_commands = sizeof(commands) / sizeof(commands[0]);
 
 /*
@@ -215,7 +304,7 @@ void timing_mode_handler(int argc, char *argv[]) {
 	int count = 0;
 	int8_t c;
 	bool is_i2c_used = false;
-	char freq[5], mode[10], i[4], s[10];
+	char freq[5], mode[10], i[4] = "", s[10];
 	bool gotfreq = false, gotmode = false, goti = false, gots = false;
 	bool isfreqvalid = false, ismodevalid = false, isi2cvalid = false,
 			issizevalid = false;
@@ -227,23 +316,28 @@ void timing_mode_handler(int argc, char *argv[]) {
 		}
 		switch (c) {
 		case 'f':
-			strcpy(freq, optarg);
+			strncpy(freq, optarg, sizeof(freq) - 1);
+			freq[sizeof(freq) - 1] = '\0';
 			gotfreq = true;
 			break;
 		case 'm':
-			strcpy(mode, optarg);
+			strncpy(mode, optarg, sizeof(mode) - 1);
+			mode[sizeof(mode) - 1] = '\0';
 			gotmode = true;
 			break;
 		case 'i':
-			strcpy(i, optarg);
+			strncpy(i, optarg, sizeof(i) - 1);
+			i[sizeof(i) - 1] = '\0';
 			goti = true;
 			break;
 		case 's':
-			strcpy(s, optarg);
+			strncpy(s, optarg, sizeof(s) - 1);
+			s[sizeof(s) - 1] = '\0';
 			gots = true;
 			break;
 		case '?':
 			printf("\r\n");
+			step_failed = true;
 			return;
 			break;
 		}
@@ -332,6 +426,7 @@ void timing_mode_handler(int argc, char *argv[]) {
 	if ((isfreqvalid && ismodevalid && issizevalid && isi2cvalid) == false) {
 		printf(
 				"Invalid Configuration Provided. Returning without execution\r\n");
+		step_failed = true;
 		return;
 	}
 
@@ -344,13 +439,23 @@ void timing_mode_handler(int argc, char *argv[]) {
 		printf("No Interpreter Selected\r\n");
 	}
 	printf("Size Count is set to %s\r\n", s);
+
+	//the timing capture fills one block more than its size count
+	if (reserve_capture_region(((uint32_t) count + 1) * 32768) == NULL) {
+		printf("Capture does not fit next to the background save\r\n");
+		step_failed = true;
+		printf("Wait for the save to end (see jobs) or choose a smaller size\r\n");
+		return;
+	}
 	printf("Press Button to begin acquisition...\r\n");
 
 	if (timing_mode_init(_mode, timing_freq, is_i2c_used, count) == true) {
 		printf("Logic Capture Completed successfully\r\n");
 	} else {
 		printf("Logic Capture not successful\r\n");
+		step_failed = true;
 	}
+	capture_health_print();
 }
 
 /*
@@ -393,31 +498,38 @@ void state_mode_handler(int argc, char *argv[]) {
 		}
 		switch (c) {
 		case 'e':
-			strcpy(edge, optarg);
+			strncpy(edge, optarg, sizeof(edge) - 1);
+			edge[sizeof(edge) - 1] = '\0';
 			gotedge = true;
 			break;
 		case 'm':
-			strcpy(mode, optarg);
+			strncpy(mode, optarg, sizeof(mode) - 1);
+			mode[sizeof(mode) - 1] = '\0';
 			gotmode = true;
 			break;
 		case 'p':
-			strcpy(pin, optarg);
+			strncpy(pin, optarg, sizeof(pin) - 1);
+			pin[sizeof(pin) - 1] = '\0';
 			gotpin = true;
 			break;
 		case 's':
-			strcpy(size, optarg);
+			strncpy(size, optarg, sizeof(size) - 1);
+			size[sizeof(size) - 1] = '\0';
 			gotsize = true;
 			break;
 		case 't':
-			strcpy(trigger_pattern, optarg);
+			strncpy(trigger_pattern, optarg, sizeof(trigger_pattern) - 1);
+			trigger_pattern[sizeof(trigger_pattern) - 1] = '\0';
 			gotpattern = true;
 			break;
 		case 'd':
-			strcpy(delay, optarg);
+			strncpy(delay, optarg, sizeof(delay) - 1);
+			delay[sizeof(delay) - 1] = '\0';
 			gotdelay = true;
 			break;
 		case '?':
 			printf("\r\n");
+			step_failed = true;
 			return;
 			break;
 		}
@@ -513,11 +625,15 @@ void state_mode_handler(int argc, char *argv[]) {
 		}
 	}
 
-	sscanf(delay, "%d", (int*) &_delay_timeout);
+	if (!gotdelay) {
+		strcpy(delay, "100000");
+	}
+	sscanf(delay, "%lu", (unsigned long*) &_delay_timeout);
 
 	if (invalid_config) {
 		printf(
 				"Invalid Configuration Provided. Returning without execution\r\n");
+		step_failed = true;
 		return;
 	} else {
 		printf("Configuration is Valid!\r\n");
@@ -530,16 +646,124 @@ void state_mode_handler(int argc, char *argv[]) {
 			printf("Trigger Pattern set to 0x%x\r\n", _bitpattern);
 		}
 	}
+	if (reserve_capture_region(((uint32_t) _count + 1) * 32768) == NULL) {
+		printf("Capture does not fit next to the background save\r\n");
+		step_failed = true;
+		printf("Wait for the save to end (see jobs) or choose a smaller size\r\n");
+		return;
+	}
 	if (_mode == 1) {
 		printf("Acquisition will begin on trigger detection...\r\n");
 	} else if (_mode == 2) {
 		printf("Press button to begin acquisition...\r\n");
 	}
-	if (state_timing_init(_edge, _mode, _bitpattern, _count, _pin, 100) == true) {
+	if (state_timing_init(_edge, _mode, _bitpattern, _count, _pin, _delay_timeout) == true) {
 		printf("Logic Capture Completed successfully\r\n");
 	} else {
 		printf("Logic Capture not successful\r\n");
+		step_failed = true;
+	}
+	capture_health_print();
+}
+
+/*
+ * Function to run an analyser over a capture file on the SD card, for captures larger than SDRAM.
+ * The file is handed over in buffers that are read in the background while the previous one is
+ * decoded, so the decoder is given a slice at a time and the read is moved along between slices.
+ * At the end it prints how long the decoder had to wait for the card: if that is most of the time,
+ * decoding is bound by the card and runs as fast as -m none, which only reads the file.
+ *
+ * Parameters:
+ *  filename name of the capture file
+ *  mode_flag analyser to run, as selected in analyser_handler, 5 only reads the file
+ *  uart_config uart configuration, the detected bit period is written back
+ *  onewire_pin 1-Wire bus pin
+ *  can_pin CAN RX pin
+ *  can_bitrate CAN bit rate, 0 to detect it
+ *
+ * Returns:
+ *  none
+ */
+static void analyse_file(const char *filename, uint8_t mode_flag, uart_config_t *uart_config,
+		uint8_t onewire_pin, uint8_t can_pin, uint32_t can_bitrate) {
+	static union {
+		i2c_analyser_t i2c;
+		uart_analyser_t uart;
+		onewire_analyser_t onewire;
+		can_analyser_t can;
+	} ctx;
+	capture_info_t info;
+	capture_stream_stats_t stats;
+	const uint8_t *buf;
+	uint32_t len = 0;
+	bool ready = true;
+
+	if (!user_fatfs_stream_open(filename, &info)) {
+		printf("Could not open %s\r\n", filename);
+		step_failed = true;
+		return;
+	}
+
+	printf("Running Analyzer on %s!\r\n", filename);
+	buf = user_fatfs_stream_next(&len);
+	if (buf != NULL) {
+		if (mode_flag == 1) {
+			i2c_analyser_init(&ctx.i2c, 0, 1);
+		} else if (mode_flag == 2) {
+			ready = uart_analyser_start(&ctx.uart, buf, len, uart_config, info.sample_rate);
+		} else if (mode_flag == 3) {
+			ready = onewire_analyser_init(&ctx.onewire, onewire_pin, info.sample_rate, NULL, NULL);
+			if (!ready) {
+				printf("Sample rate too low, 1-Wire needs at least 200kHz timing mode capture\r\n");
+			}
+		} else if (mode_flag == 4) {
+			ready = can_analyser_start(&ctx.can, buf, len, can_pin, can_bitrate, info.sample_rate);
+		}
+	}
+
+	while (ready && buf != NULL) {
+		for (uint32_t pos = 0; pos < len; pos += ANALYSE_FILE_SLICE) {
+			uint32_t n = (len - pos < ANALYSE_FILE_SLICE) ? len - pos : ANALYSE_FILE_SLICE;
+			if (mode_flag == 1) {
+				i2c_analyser_process(&ctx.i2c, buf + pos, n);
+			} else if (mode_flag == 2) {
+				uart_analyser_process(&ctx.uart, buf + pos, n);
+			} else if (mode_flag == 3) {
+				onewire_analyser_process(&ctx.onewire, buf + pos, n);
+			} else if (mode_flag == 4) {
+				can_analyser_process(&ctx.can, buf + pos, n);
+			}
+			user_fatfs_stream_poll();
+		}
+		buf = user_fatfs_stream_next(&len);
+	}
+
+	if (!user_fatfs_stream_close(&stats)) {
+		printf("SD Card Read Failed after %lu KB!\r\n", (unsigned long) (stats.bytes / 1024));
+		step_failed = true;
+	}
+	if (!ready) {
+		step_failed = true;
+		return;
+	}
+
+	if (mode_flag == 2) {
+		printf("Frames: %lu, Errors: %lu\r\n", (unsigned long) ctx.uart.frames, (unsigned long) ctx.uart.errors);
+	} else if (mode_flag == 3) {
+		printf("Resets: %lu, ROM IDs: %lu, CRC Errors: %lu\r\n", (unsigned long) ctx.onewire.resets,
+				(unsigned long) ctx.onewire.rom_ids, (unsigned long) ctx.onewire.crc_errors);
+	} else if (mode_flag == 4) {
+		printf("Frames: %lu, Errors: %lu\r\n", (unsigned long) ctx.can.frames, (unsigned long) ctx.can.errors);
 	}
+	printf("Done Running Analyzer!\r\n");
+
+	uint32_t kbytes = (uint32_t) (stats.bytes / 1024);
+	printf("%s %lu KB in %lu ms, %lu KB/s\r\n", (mode_flag == 5) ? "Read" : "Decoded",
+			(unsigned long) kbytes, (unsigned long) stats.elapsed_ms,
+			(unsigned long) (stats.elapsed_ms ? ((uint64_t) kbytes * 1000) / stats.elapsed_ms : 0));
+	printf("Waited %lu ms for the card (%lu%%)%s\r\n", (unsigned long) stats.wait_ms,
+			(unsigned long) (stats.elapsed_ms ? ((uint64_t) stats.wait_ms * 100) / stats.elapsed_ms : 0),
+			stats.read_ahead ? "" : ", file too fragmented for read-ahead");
 }
 
 /*
@@ -553,8 +777,15 @@ void state_mode_handler(int argc, char *argv[]) {
  * value. Then it checks if the inputs are in a permissible range or not. After that it runs the function
  * call to run the analyser of the logic analyzer
  *
- * -m {select the mode of analysis, it can be [i2c],defaults to i2c mode}
+ * -m {select the mode of analysis, it can be [i2c,uart,1wire,can],defaults to i2c mode}
  * -s {selects the size of interpreter, it can be [s,m,l], it defaults to small}
+ * -t {selects the uart TX pin, the 1-Wire bus pin or the CAN RX pin, it can be from 0..7}
+ * -r {selects the uart RX pin, it can be from 0..7, if neither is given TX is P0 and RX is P1}
+ * -b {selects the uart baud rate or CAN bit rate, or auto to detect it from the capture, defaults to auto}
+ * -d {selects the uart data bits, it can be from 5..9, defaults to 8}
+ * -p {selects the uart parity, it can be [n,e,o], defaults to n}
+ * -x {selects the uart stop bits, it can be [1,2], defaults to 1}
+ * -f {decodes a capture file on the SD card instead of SDRAM, with mode none it only reads it}
  *
  * Parameters:
  *  argc(in) integer holding the value of the number of tokens
@@ -566,34 +797,79 @@ void state_mode_handler(int argc, char *argv[]) {
 void analyser_handler(int argc, char *argv[]) {
 	optind = 0;
 	int8_t c = 0;
-	char mode[4], size[2];
-	bool gotmode = false, gotsize = false;
+	char mode[8], size[2], tx[4], rx[4], baud[10], data_bits[3], parity[3], stop_bits[3], filename[16];
+	bool gotmode = false, gotsize = false, gottx = false, gotrx = false, gotbaud = false,
+			gotdatabits = false, gotparity = false, gotstopbits = false, gotfile = false;
 	uint8_t mode_flag = 0;
 	bool invalid_config = false;
 	uint8_t _count = 0;
+	capture_info_t file_info;
 
 	while (1) {
-		c = getopt(argc, (char**) argv, "m:s:");
+		c = getopt(argc, (char**) argv, "m:s:t:r:b:d:p:x:f:");
 		if (c == -1) {
 			break;
 		}
 		switch (c) {
 		case 'm':
-			strcpy(mode, optarg);
+			strncpy(mode, optarg, sizeof(mode) - 1);
+			mode[sizeof(mode) - 1] = '\0';
 			gotmode = true;
 			break;
 		case 's':
-			strcpy(size, optarg);
+			strncpy(size, optarg, sizeof(size) - 1);
+			size[sizeof(size) - 1] = '\0';
 			gotsize = true;
 			break;
+		case 't':
+			strncpy(tx, optarg, sizeof(tx) - 1);
+			tx[sizeof(tx) - 1] = '\0';
+			gottx = true;
+			break;
+		case 'r':
+			strncpy(rx, optarg, sizeof(rx) - 1);
+			rx[sizeof(rx) - 1] = '\0';
+			gotrx = true;
+			break;
+		case 'b':
+			strncpy(baud, optarg, sizeof(baud) - 1);
+			baud[sizeof(baud) - 1] = '\0';
+			gotbaud = true;
+			break;
+		case 'd':
+			strncpy(data_bits, optarg, sizeof(data_bits) - 1);
+			data_bits[sizeof(data_bits) - 1] = '\0';
+			gotdatabits = true;
+			break;
+		case 'p':
+			strncpy(parity, optarg, sizeof(parity) - 1);
+			parity[sizeof(parity) - 1] = '\0';
+			gotparity = true;
+			break;
+		case 'x':
+			strncpy(stop_bits, optarg, sizeof(stop_bits) - 1);
+			stop_bits[sizeof(stop_bits) - 1] = '\0';
+			gotstopbits = true;
+			break;
+		case 'f':
+			strncpy(filename, optarg, sizeof(filename) - 1);
+			filename[sizeof(filename) - 1] = '\0';
+			gotfile = true;
+			break;
 		case '?':
 			printf("\r\n");
+			step_failed = true;
 			return;
 			break;
 		}
 	}
 	printf("\r\n");
 
+	if (gotfile && !gotsize) {
+		strcpy(size, "s");	//the whole file is decoded, the size is not used
+		gotsize = true;
+	}
+
 	if ((gotmode && gotsize) == false) {
 		printf("All Arguments not received!\r\n");
 		printf("List of Missing Arguments:\r\n");
@@ -614,42 +890,210 @@ void analyser_handler(int argc, char *argv[]) {
 		_count = MEDIUM_BUF_SIZE;
 	} else if (strcasecmp(size, "l") == 0) {
 		_count = LARGE_BUF_SIZE;
+	} else if (strcasecmp(size, "a") == 0) {
+		if (get_capture_length() == 0) {
+			printf("Nothing captured or loaded yet\r\n");
+			invalid_config = true;
+		}
 	} else {
 		printf("Invalid Option for Count Selected\r\n");
 		printf("Must be one of the following\r\n");
 		printf("S\r\n");
 		printf("M\r\n");
 		printf("L\r\n");
+		printf("A\r\n");
 		invalid_config = true;
 	}
 
 	if (strcasecmp(mode, "i2c") == 0) {
 		mode_flag = 1;
+	} else if (strcasecmp(mode, "uart") == 0) {
+		mode_flag = 2;
+	} else if (strcasecmp(mode, "1wire") == 0) {
+		mode_flag = 3;
+	} else if (strcasecmp(mode, "can") == 0) {
+		mode_flag = 4;
+	} else if (strcasecmp(mode, "none") == 0 && gotfile) {
+		mode_flag = 5;
 	} else {
 		printf("Invalid Option for Mode Selected\r\n");
 		printf("Must be one of the following\r\n");
 		printf("I2C\r\n");
+		printf("UART\r\n");
+		printf("1WIRE\r\n");
+		printf("CAN\r\n");
+		printf("NONE (only with -f)\r\n");
 		invalid_config = true;
 	}
 
+	uint32_t sample_rate = get_sample_rate();
+	if (gotfile) {
+		if (user_fatfs_read_capture(filename, NULL, 0, &file_info)) {
+			sample_rate = file_info.sample_rate;
+		} else {
+			printf("Could not read %s, it is missing or not a capture, or a save is running\r\n", filename);
+			invalid_config = true;
+		}
+	}
+	uart_config_t uart_config = {
+			.pins = { UART_ANALYSER_NO_PIN, UART_ANALYSER_NO_PIN },
+			.data_bits = 8,
+			.parity = UART_PARITY_NONE,
+			.stop_bits = 1,
+			.bit_period_q8 = 0,
+			.on_frame = NULL
+	};
+	if (mode_flag == 2) {
+		if (!gottx && !gotrx) {
+			printf("TX and RX pins not provided, TX initialized to P0 and RX to P1\r\n");
+			strcpy(tx, "0");
+			strcpy(rx, "1");
+			gottx = gotrx = true;
+		}
+		if (gottx) {
+			uart_config.pins[0] = strtoul(tx, NULL, 10);
+		}
+		if (gotrx) {
+			uart_config.pins[1] = strtoul(rx, NULL, 10);
+		}
+		if ((gottx && uart_config.pins[0] >= 8) || (gotrx && uart_config.pins[1] >= 8)) {
+			printf("Invalid Option for TX/RX Pin Selected\r\n");
+			printf("Must range from 0..7\r\n");
+			invalid_config = true;
+		}
+		if (gotbaud && strcasecmp(baud, "auto") != 0) {
+			if (sample_rate == 0) {
+				printf("Sample rate of the capture is unknown, baud rate must be auto\r\n");
+				invalid_config = true;
+			} else {
+				uart_config.bit_period_q8 = rate_to_bit_period(strtoul(baud, NULL, 10), sample_rate);
+			}
+		}
+		if (gotdatabits) {
+			uart_config.data_bits = strtoul(data_bits, NULL, 10);
+			if (uart_config.data_bits < 5 || uart_config.data_bits > 9) {
+				printf("Invalid Option for Data Bits Selected\r\n");
+				printf("Must range from 5..9\r\n");
+				invalid_config = true;
+			}
+		}
+		if (gotparity) {
+			if (strcasecmp(parity, "n") == 0) {
+				uart_config.parity = UART_PARITY_NONE;
+			} else if (strcasecmp(parity, "e") == 0) {
+				uart_config.parity = UART_PARITY_EVEN;
+			} else if (strcasecmp(parity, "o") == 0) {
+				uart_config.parity = UART_PARITY_ODD;
+			} else {
+				printf("Invalid Option for Parity Selected\r\n");
+				printf("Must be one of the following\r\n");
+				printf("N\r\n");
+				printf("E\r\n");
+				printf("O\r\n");
+				invalid_config = true;
+			}
+		}
+		if (gotstopbits) {
+			uart_config.stop_bits = strtoul(stop_bits, NULL, 10);
+			if (uart_config.stop_bits < 1 || uart_config.stop_bits > 2) {
+				printf("Invalid Option for Stop Bits Selected\r\n");
+				printf("Must be 1 or 2\r\n");
+				invalid_config = true;
+			}
+		}
+	}
+
+	uint8_t onewire_pin = 0;
+	if (mode_flag == 3) {
+		if (!gottx) {
+			printf("Bus pin not provided, initialized to P0\r\n");
+			strcpy(tx, "0");
+		}
+		onewire_pin = strtoul(tx, NULL, 10);
+		if (onewire_pin >= 8) {
+			printf("Invalid Option for Bus Pin Selected\r\n");
+			printf("Must range from 0..7\r\n");
+			invalid_config = true;
+		}
+		if (sample_rate == 0) {
+			printf("Sample rate of the capture is unknown, 1-Wire needs a timing mode capture\r\n");
+			invalid_config = true;
+		}
+	}
+
+	uint8_t can_pin = 0;
+	uint32_t can_bitrate = 0;
+	if (mode_flag == 4) {
+		if (!gottx) {
+			printf("RX pin not provided, initialized to P0\r\n");
+			strcpy(tx, "0");
+		}
+		can_pin = strtoul(tx, NULL, 10);
+		if (can_pin >= 8) {
+			printf("Invalid Option for RX Pin Selected\r\n");
+			printf("Must range from 0..7\r\n");
+			invalid_config = true;
+		}
+		if (gotbaud && strcasecmp(baud, "auto") != 0) {
+			if (sample_rate == 0) {
+				printf("Sample rate of the capture is unknown, bit rate must be auto\r\n");
+				invalid_config = true;
+			} else {
+				can_bitrate = strtoul(baud, NULL, 10);
+			}
+		}
+	}
+
 	if (invalid_config) {
 		printf(
 				"Invalid Configuration Provided. Returning without execution\r\n");
+		step_failed = true;
 		return;
 	} else {
 		printf("Configuration is Valid!\r\n");
 		printf("Mode set to %s\r\n", mode);
-		printf("Size set to %s\r\n", size);
+		if (gotfile) {
+			printf("File set to %s\r\n", filename);
+		} else {
+			printf("Size set to %s\r\n", size);
+		}
 	}
 
+	if (gotfile) {
+		analyse_file(filename, mode_flag, &uart_config, onewire_pin, can_pin, can_bitrate);
+		return;
+	}
+
+	uint8_t *buf = get_capture_address();
 	uint32_t buf_len = 0;
-	buf_len = _count * 32768;
+	buf_len = (_count != 0) ? _count * 32768 : get_capture_length();
+	if (buf_len > sdram_room_after(buf)) {
+		buf_len = sdram_room_after(buf);
+	}
 
 	if (mode_flag == 1) {
 		printf("Running I2C Analyzer!\r\n");
-		run_analyser(SDRAM_BANK_ADDR, buf_len, 0, 1);
+		run_analyser(buf, buf_len, 0, 1);
 		printf("Done Running I2C Analyzer!\r\n");
 
+	} else if (mode_flag == 2) {
+		printf("Running UART Analyzer!\r\n");
+		if (!run_uart_analyser(buf, buf_len, &uart_config, sample_rate)) {
+			step_failed = true;
+		}
+		printf("Done Running UART Analyzer!\r\n");
+	} else if (mode_flag == 3) {
+		printf("Running 1-Wire Analyzer!\r\n");
+		if (!run_onewire_analyser(buf, buf_len, onewire_pin, sample_rate)) {
+			step_failed = true;
+		}
+		printf("Done Running 1-Wire Analyzer!\r\n");
+	} else if (mode_flag == 4) {
+		printf("Running CAN Analyzer!\r\n");
+		if (!run_can_analyser(buf, buf_len, can_pin, can_bitrate, sample_rate)) {
+			step_failed = true;
+		}
+		printf("Done Running CAN Analyzer!\r\n");
 	}
 }
 
@@ -662,9 +1106,11 @@ void analyser_handler(int argc, char *argv[]) {
  *
  * This function first validates if all parameters are received, or it initialses them with a default
  * value. Then it checks if the inputs are in a permissible range or not. After that it runs the function
- * call to run the analyser of the logic analyzer
+ * call to start saving the last capture. The save runs in the background while the command processor
+ * waits for input or a new capture waits for its start, unless -w is given
  *
  * -s {selects the size of interpreter, it can be [s,m,l], it defaults to small}
+ * -w {waits for the save to end and prints its speed}
  *
  * Parameters:
  *  argc(in) integer holding the value of the number of tokens
@@ -678,21 +1124,27 @@ void save_handler(int argc, char *argv[]) {
 	int8_t c = 0;
 	char size[2];
 	bool gotsize = false;
+	bool wait = false;
 	uint8_t _count = 0;
 	bool invalid_config = false;
 
 	while (1) {
-		c = getopt(argc, (char**) argv, "s:");
+		c = getopt(argc, (char**) argv, "s:w");
 		if (c == -1) {
 			break;
 		}
 		switch (c) {
 		case 's':
-			strcpy(size, optarg);
+			strncpy(size, optarg, sizeof(size) - 1);
+			size[sizeof(size) - 1] = '\0';
 			gotsize = true;
 			break;
+		case 'w':
+			wait = true;
+			break;
 		case '?':
 			printf("\r\n");
+			step_failed = true;
 			return;
 			break;
 		}
@@ -725,28 +1177,148 @@ void save_handler(int argc, char *argv[]) {
 	if (invalid_config) {
 		printf(
 				"Invalid Configuration Provided. Returning without execution\r\n");
+		step_failed = true;
 		return;
 	} else {
 		printf("Configuration is Valid!\r\n");
 		printf("Size set to %s\r\n", size);
 	}
 
+	if (user_fatfs_get_save_job()->state == SAVE_JOB_RUNNING) {
+		printf("A save is already running, see jobs\r\n");
+		step_failed = true;
+		return;
+	}
+
+	uint8_t *samples = get_capture_address();
+	uint32_t len = (uint32_t) _count * 32768;
+	if (len > sdram_room_after(samples)) {
+		len = sdram_room_after(samples);
+	}
+
 	printf("Saving Data on SD Card!\r\n");
-	if (user_fatfs_init(_count)) {
+	if (!user_fatfs_save_start(samples, len) && !user_fatfs_save_start(samples, len)) {
+		printf("SD Card Save Failed!\r\n");
+		step_failed = true;
+		return;
+	}
+
+	const save_job_t *job = user_fatfs_get_save_job();
+	if (!wait) {
+		printf("Saving %s in the background, see jobs\r\n", job->filename);
+		return;
+	}
+
+	while (user_fatfs_save_poll());
+	if (job->state == SAVE_JOB_DONE) {
+		uint32_t kbytes = job->len / 1024;
 		printf("Done Saving Data on SD Card!\r\n");
+		printf("Saved %lu KB in %lu ms, %lu KB/s\r\n", (unsigned long) kbytes,
+				(unsigned long) job->elapsed_ms,
+				(unsigned long) (job->elapsed_ms ? (kbytes * 1000) / job->elapsed_ms : 0));
 	} else {
-		if (user_fatfs_init(_count)) {
-			printf("Done Saving Data on SD Card!\r\n");
-		} else {
-			printf("SD Card Save Failed!\r\n");
+		printf("SD Card Save Failed!\r\n");
+		step_failed = true;
+	}
+}
+
+/*
+ * Callback function for the load command. It reads a capture file saved by the save command back into
+ * SDRAM, along with its sample rate and trigger position, so the analysers can be run on it with -s a.
+ * The card is shared with the background save, so it waits for the save to end.
+ *
+ * -f {selects the capture file, for example file1.bin, no default value}
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void load_handler(int argc, char *argv[]) {
+	optind = 0;
+	int8_t c = 0;
+	char filename[16];
+	bool gotfile = false;
+
+	while (1) {
+		c = getopt(argc, (char**) argv, "f:");
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'f':
+			strncpy(filename, optarg, sizeof(filename) - 1);
+			filename[sizeof(filename) - 1] = '\0';
+			gotfile = true;
+			break;
+		case '?':
+			printf("\r\n");
+			step_failed = true;
+			return;
+			break;
 		}
+	}
+	printf("\r\n");
+	if (!gotfile) {
+		printf("All Arguments not received!\r\n");
+		printf("File name is required, for example load -f file1.bin\r\n");
+		step_failed = true;
+		return;
+	}
+
+	if (user_fatfs_get_save_job()->state == SAVE_JOB_RUNNING) {
+		printf("A save is running, wait for it to end (see jobs)\r\n");
+		step_failed = true;
+		return;
+	}
+	uint8_t *dest = reserve_capture_region(SDRAM_SIZE);
+	if (dest == NULL) {
+		printf("SDRAM is busy\r\n");
+		step_failed = true;
+		return;
+	}
+
+	printf("Loading %s from SD Card!\r\n", filename);
+	capture_info_t info;
+	ticktime_t start = now();
+	if (!user_fatfs_read_capture(filename, dest, SDRAM_SIZE, &info)) {
+		printf("SD Card Load Failed! The file is missing or is not a capture\r\n");
+		step_failed = true;
+		return;
+	}
+	uint32_t elapsed_ms = now() - start;
+
+	uint64_t len = info.sample_count * info.sample_width;
+	if (len > SDRAM_SIZE) {
+		printf("Capture is larger than SDRAM, only the first %lu KB were loaded\r\n",
+				(unsigned long) (SDRAM_SIZE / 1024));
+		len = SDRAM_SIZE;
+	}
+	set_sample_rate(info.sample_rate);
+	set_trigger_position((info.trigger_position < len) ? (uint32_t) info.trigger_position : NO_TRIGGER_POSITION);
+	set_capture_length((uint32_t) len);
+	capture_health_set(&info.health);
 
+	uint32_t kbytes = (uint32_t) (len / 1024);
+	printf("Done Loading Data from SD Card!\r\n");
+	printf("%lu samples at %lu Hz", (unsigned long) (len / info.sample_width), (unsigned long) info.sample_rate);
+	if (info.trigger_position != CAPTURE_NO_TRIGGER) {
+		printf(", trigger at sample %lu", (unsigned long) info.trigger_position);
+	}
+	printf("\r\n");
+	printf("Loaded %lu KB in %lu ms, %lu KB/s\r\n", (unsigned long) kbytes, (unsigned long) elapsed_ms,
+			(unsigned long) (elapsed_ms ? (kbytes * 1000) / elapsed_ms : 0));
+	if (info.health.blocks != 0) {
+		capture_health_print();
 	}
+	printf("Use analyse -s a to run an analyser on the whole capture\r\n");
 }
 
 /*
- * Callback function to run the help menu, which prints out a list of all the commands as well
- * as their parameters
+ * Callback function for the jobs command. It prints the progress of the running background save,
+ * or the result of the last one
  *
  * Parameters:
  *  argc(in) integer holding the value of the number of tokens
@@ -755,45 +1327,908 @@ void save_handler(int argc, char *argv[]) {
  * Returns:
  *  none
  */
-void help_handler(int argc, char *argv[]) {
-	printf("Commands Available:\r\n");
-	for (int i = 0; i < num_commands; i++) {
-		printf("%s:\r\n", commands[i].name);
-		printf("\t%s\r\n", commands[i].help_string);
+void jobs_handler(int argc, char *argv[]) {
+	(void) argc;
+	(void) argv;
+	const save_job_t *job = user_fatfs_get_save_job();
+	uint32_t kbytes = job->written / 1024;
+	uint32_t elapsed_ms = 0;
+
+	switch (job->state) {
+	case SAVE_JOB_IDLE:
+		printf("No background jobs\r\n");
+		break;
+	case SAVE_JOB_RUNNING:
+		elapsed_ms = now() - job->start_ms;
+		printf("Saving %s: %lu of %lu KB (%lu%%), %lu KB/s\r\n", job->filename,
+				(unsigned long) kbytes, (unsigned long) (job->len / 1024),
+				(unsigned long) (job->len ? ((uint64_t) job->written * 100) / job->len : 0),
+				(unsigned long) (elapsed_ms ? (kbytes * 1000) / elapsed_ms : 0));
+		break;
+	case SAVE_JOB_DONE:
+		printf("Saved %s: %lu KB in %lu ms, %lu KB/s\r\n", job->filename,
+				(unsigned long) kbytes, (unsigned long) job->elapsed_ms,
+				(unsigned long) (job->elapsed_ms ? (kbytes * 1000) / job->elapsed_ms : 0));
+		break;
+	case SAVE_JOB_FAILED:
+		printf("Saving %s failed after %lu KB\r\n", job->filename, (unsigned long) kbytes);
+		if (spi_dma_error_count() != 0) {
+			printf("SD card DMA transfer errors since boot: %lu\r\n", (unsigned long) spi_dma_error_count());
+		}
+		break;
+	}
+
+	if (job->state != SAVE_JOB_IDLE) {
+		const sector_cache_stats_t *cache = sector_cache_get_stats();
+		printf("Sector cache: %lu hits, %lu misses, %lu write-backs, %lu direct transfers\r\n",
+				(unsigned long) cache->hits, (unsigned long) cache->misses,
+				(unsigned long) cache->write_backs, (unsigned long) cache->bypasses);
 	}
 }
 
-/* Function to run the command processor. It first print the "> " prompt onto the screen.
- * After which is accepts user input, which is delimited by a carriage return. Then the
- * line input is tokenised and processed.
+/*
+ * Function to wait while moving the background save along, for the wait step of a script
  *
  * Parameters:
- *	none
+ *  ms time to wait, 0 to wait for the background save to end instead
  *
  * Returns:
  *  none
  */
-void run_command_processor() {
-	uint8_t line[CMD_PROCESSOR_LINE_BUFFER_SIZE] = { 0 };
-	uint8_t argc = 0, *argv[CMD_PROCESSOR_ARGV_SIZE] = { 0 };
+static void run_wait(uint32_t ms) {
+	ticktime_t start = now();
 
-	printf("> ");
-	get_line(line);
-	get_tokens(line, &argc, argv);
-
-	if (argc == 0) {
+	if (ms == 0) {
+		while (user_fatfs_get_save_job()->state == SAVE_JOB_RUNNING) {
+			user_fatfs_save_poll();
+		}
 		return;
 	}
+	while (now() - start < ms) {
+		user_fatfs_save_poll();
+	}
+}
 
-	int i = 0;
-	while (i < num_commands) {
-		if (!strcasecmp((const char*) argv[0], commands[i].name)) {
-			commands[i].handler(argc, (char**) argv);
+/*
+ * Callback function for the run command. It loads a script from the SD Card and runs its lines through
+ * the command table, one step after the other without waiting for the operator, then prints how long
+ * each step took. Besides commands a script can hold
+ *
+ * loop <n> ... end		runs the lines in between n times, loops can be nested
+ * wait					waits for the background save to end, captures already return once taken
+ * wait <ms>			waits a fixed time
+ * onfail stop			a failed step, such as a trigger timeout, stops the script (the default)
+ * onfail next			a failed step goes on with the next pass of the innermost loop
+ * onfail ignore		a failed step goes on with the next line
+ * # text				comment
+ *
+ * -f {selects the script file, for example test.txt, no default value}
+ * -n {runs the whole script this many times, defaults to 1}
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void run_handler(int argc, char *argv[]) {
+	static char script[RUN_SCRIPT_SIZE];
+	char *lines[RUN_MAX_LINES];
+	int16_t match[RUN_MAX_LINES];	//line of the matching loop or end
+	uint32_t runs[RUN_MAX_LINES] = { 0 }, fails[RUN_MAX_LINES] = { 0 };
+	uint32_t total_ms[RUN_MAX_LINES] = { 0 }, min_ms[RUN_MAX_LINES], max_ms[RUN_MAX_LINES] = { 0 };
+	struct {
+		int16_t start;
+		uint32_t left;
+	} loops[RUN_MAX_DEPTH];
+	int depth = 0, num_lines = 0;
+	uint8_t cmd_line[LINE_EDITOR_SIZE];
+	char filename[16];
+	bool gotfile = false, stopped = false;
+	uint32_t passes = 1, len = 0;
+	enum {
+		ON_FAIL_STOP, ON_FAIL_NEXT, ON_FAIL_IGNORE
+	} on_fail = ON_FAIL_STOP;
+	optind = 0;
+	int8_t c = 0;
+
+	while (1) {
+		c = getopt(argc, (char**) argv, "f:n:");
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'f':
+			strncpy(filename, optarg, sizeof(filename) - 1);
+			filename[sizeof(filename) - 1] = '\0';
+			gotfile = true;
+			break;
+		case 'n':
+			passes = strtoul(optarg, NULL, 10);
+			break;
+		case '?':
+			printf("\r\n");
+			step_failed = true;
+			return;
 			break;
 		}
-		i++;
 	}
-	if (i == num_commands) {//if no match occurs after iterating over command table, raise an error
-		invalid_handler(argc, (char**) argv);
+	printf("\r\n");
+	if (!gotfile) {
+		printf("All Arguments not received!\r\n");
+		printf("File name is required, for example run -f test.txt\r\n");
+		step_failed = true;
+		return;
+	}
+	if (script_running) {
+		printf("Scripts cannot run other scripts\r\n");
+		step_failed = true;
+		return;
+	}
+	if (!user_fatfs_read_file(filename, script, sizeof(script), &len)) {
+		printf("Cannot read %s, it is missing, larger than %d bytes, or a save is running\r\n", filename,
+				RUN_SCRIPT_SIZE - 1);
+		step_failed = true;
+		return;
+	}
+
+	//split the script in lines and pair each loop with its end
+	for (char *line = strtok(script, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+		while (*line == ' ' || *line == '\t') {
+			line++;
+		}
+		if (*line == '\0' || *line == '#') {
+			continue;
+		}
+		if (num_lines == RUN_MAX_LINES) {
+			printf("Script has more than %d steps\r\n", RUN_MAX_LINES);
+			step_failed = true;
+			return;
+		}
+		match[num_lines] = -1;
+		if (strncasecmp(line, "loop", 4) == 0) {
+			if (depth == RUN_MAX_DEPTH) {
+				printf("Loops are nested more than %d deep\r\n", RUN_MAX_DEPTH);
+				step_failed = true;
+				return;
+			}
+			loops[depth++].start = num_lines;
+		} else if (strcasecmp(line, "end") == 0) {
+			if (depth == 0) {
+				printf("end without loop: %s\r\n", line);
+				step_failed = true;
+				return;
+			}
+			depth--;
+			match[num_lines] = loops[depth].start;
+			match[loops[depth].start] = num_lines;
+		}
+		min_ms[num_lines] = UINT32_MAX;
+		lines[num_lines++] = line;
+	}
+	if (depth != 0) {
+		printf("loop without end\r\n");
+		step_failed = true;
+		return;
+	}
+
+	printf("Running %s, %d steps, %lu times\r\n", filename, num_lines, (unsigned long) passes);
+	script_running = true;
+	ticktime_t script_start = now();
+	for (uint32_t pass = 0; pass < passes && !stopped; pass++) {
+		depth = 0;
+		for (int pc = 0; pc < num_lines && !stopped; pc++) {
+			char *line = lines[pc];
+
+			if (char_available()) {
+				get_char();
+				printf("Stopped by a key press\r\n");
+				stopped = true;
+				break;
+			}
+
+			if (strncasecmp(line, "loop", 4) == 0) {
+				loops[depth].start = pc;
+				loops[depth++].left = strtoul(line + 4, NULL, 10);
+				if (loops[depth - 1].left == 0) {
+					depth--;
+					pc = match[pc];	//nothing to run, skip past the end
+				}
+				continue;
+			}
+			if (strcasecmp(line, "end") == 0) {
+				if (--loops[depth - 1].left > 0) {
+					pc = loops[depth - 1].start;
+				} else {
+					depth--;
+				}
+				continue;
+			}
+			if (strncasecmp(line, "onfail", 6) == 0) {
+				char *policy = line + 6;
+				while (*policy == ' ') {
+					policy++;
+				}
+				if (strcasecmp(policy, "next") == 0) {
+					on_fail = ON_FAIL_NEXT;
+				} else if (strcasecmp(policy, "ignore") == 0) {
+					on_fail = ON_FAIL_IGNORE;
+				} else {
+					on_fail = ON_FAIL_STOP;
+				}
+				continue;
+			}
+
+			//a step: wait or a command, timed
+			ticktime_t start = now();
+			bool ok = true;
+			if (strncasecmp(line, "wait", 4) == 0 && (line[4] == '\0' || line[4] == ' ')) {
+				run_wait(strtoul(line + 4, NULL, 10));
+			} else {
+				printf("[%d] %s\r\n", pc + 1, line);
+				strncpy((char*) cmd_line, line, sizeof(cmd_line) - 2);
+				cmd_line[sizeof(cmd_line) - 2] = '\0';
+				strcat((char*) cmd_line, "\r");
+				ok = execute_line(cmd_line);
+			}
+			uint32_t elapsed = now() - start;
+			runs[pc]++;
+			total_ms[pc] += elapsed;
+			if (elapsed < min_ms[pc]) {
+				min_ms[pc] = elapsed;
+			}
+			if (elapsed > max_ms[pc]) {
+				max_ms[pc] = elapsed;
+			}
+			if (ok) {
+				continue;
+			}
+
+			fails[pc]++;
+			if (on_fail == ON_FAIL_STOP) {
+				printf("Step %d failed, script stopped\r\n", pc + 1);
+				stopped = true;
+			} else if (on_fail == ON_FAIL_NEXT && depth > 0) {
+				pc = match[loops[depth - 1].start] - 1;	//the end of the loop is run next
+			}
+		}
+	}
+	script_running = false;
+	uint32_t script_ms = now() - script_start;
+
+	printf("\r\n%-5s %-*s %6s %6s %8s %8s %8s\r\n", "Line", RUN_STEP_TEXT, "Step", "Runs", "Fails", "Avg ms",
+			"Min ms", "Max ms");
+	for (int i = 0; i < num_lines; i++) {
+		if (runs[i] == 0) {
+			continue;
+		}
+		printf("%-5d %-*.*s %6lu %6lu %8lu %8lu %8lu\r\n", i + 1, RUN_STEP_TEXT, RUN_STEP_TEXT, lines[i],
+				(unsigned long) runs[i], (unsigned long) fails[i], (unsigned long) (total_ms[i] / runs[i]),
+				(unsigned long) min_ms[i], (unsigned long) max_ms[i]);
+	}
+	printf("Script %s in %lu ms\r\n", stopped ? "stopped" : "done", (unsigned long) script_ms);
+	step_failed = stopped;
+}
+
+/*
+ * Callback function for the dump command. It sends a range of the last or loaded capture to the host
+ * as framed packets, see dump.h. The host can ask for a damaged frame again while the transfer goes on,
+ * or stop it.
+ *
+ * -o {selects the first sample to send, defaults to 0}
+ * -n {selects the number of samples to send, defaults to the rest of the capture}
+ * -r {run length encodes the samples}
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void dump_handler(int argc, char *argv[]) {
+	optind = 0;
+	int8_t c = 0;
+	uint32_t offset = 0, len = 0;
+	bool gotlen = false, rle = false;
+	uint32_t capture_len = get_capture_length();
+
+	if (capture_len > sdram_room_after(get_capture_address())) {
+		capture_len = sdram_room_after(get_capture_address());
+	}
+
+	while (1) {
+		c = getopt(argc, (char**) argv, "o:n:r");
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'o':
+			offset = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			len = strtoul(optarg, NULL, 0);
+			gotlen = true;
+			break;
+		case 'r':
+			rle = true;
+			break;
+		case '?':
+			printf("\r\n");
+			step_failed = true;
+			return;
+			break;
+		}
+	}
+	printf("\r\n");
+
+	if (capture_len == 0) {
+		printf("Nothing captured yet\r\n");
+		step_failed = true;
+		return;
+	}
+	if (offset >= capture_len) {
+		printf("Offset is past the end of the capture, %lu samples\r\n", (unsigned long) capture_len);
+		step_failed = true;
+		return;
+	}
+	if (!gotlen || len > capture_len - offset) {
+		len = capture_len - offset;
+	}
+
+	printf("Dumping %lu samples from %lu%s\r\n", (unsigned long) len, (unsigned long) offset,
+			rle ? ", run length encoded" : "");
+	dump_stats_t stats;
+	ticktime_t start = now();
+	bool ended = dump_run(get_capture_address(), offset, len, rle, &stats);
+	uint32_t elapsed_ms = now() - start;
+
+	printf("\r\n%s: %lu frames, %lu sent again, %lu too old to resend, %lu bytes for %lu samples in %lu ms\r\n",
+			ended ? "Dump done" : "Dump stopped by the host", (unsigned long) stats.frames,
+			(unsigned long) stats.resent, (unsigned long) stats.missed, (unsigned long) stats.bytes_out,
+			(unsigned long) len, (unsigned long) elapsed_ms);
+}
+
+/*
+ * Function to send BAUD_TEST_BYTES of printable text and print the throughput the console reached,
+ * next to the highest possible with 10 bits per byte
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+static void baud_throughput_test(void) {
+	char pattern[64];
+	uint32_t baud = uart_get_baud();
+
+	for (uint32_t i = 0; i < sizeof(pattern) - 2; i++) {
+		pattern[i] = '!' + (i % 94);
+	}
+	pattern[sizeof(pattern) - 2] = '\r';
+	pattern[sizeof(pattern) - 1] = '\n';
+
+	uart_tx_flush();
+	ticktime_t start = now();
+	for (uint32_t sent = 0; sent < BAUD_TEST_BYTES; sent += sizeof(pattern)) {
+		fwrite(pattern, 1, sizeof(pattern), stdout);
+	}
+	uart_tx_flush();
+	uint32_t elapsed_ms = now() - start;
+
+	printf("\r\nSent %lu bytes in %lu ms at %lu baud: %lu bytes/s, line limit %lu bytes/s\r\n",
+			(unsigned long) BAUD_TEST_BYTES, (unsigned long) elapsed_ms, (unsigned long) baud,
+			(unsigned long) (elapsed_ms ? ((uint64_t) BAUD_TEST_BYTES * 1000) / elapsed_ms : 0),
+			(unsigned long) (baud / 10));
+}
+
+/*
+ * Callback function for the baud command. Without arguments it prints the baud rate in use. With -b
+ * the console moves to the new rate once this reply has been sent, and keeps it only if the host
+ * presses enter at the new rate within BAUD_CONFIRM_MS, so a rate the host cannot follow does not
+ * lose the console.
+ *
+ * -b {selects the new baud rate}
+ * -t {sends 64 KB to measure the throughput at the rate in use}
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void baud_handler(int argc, char *argv[]) {
+	optind = 0;
+	int8_t c = 0;
+	uint32_t baud = 0;
+	bool test = false;
+
+	while (1) {
+		c = getopt(argc, (char**) argv, "b:t");
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'b':
+			baud = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			test = true;
+			break;
+		case '?':
+			printf("\r\n");
+			step_failed = true;
+			return;
+			break;
+		}
+	}
+	printf("\r\n");
+
+	if (baud != 0) {
+		uint32_t old_baud = uart_get_baud();
+		uint32_t brr;
+		bool over8;
+		uint32_t actual = uart_compute_brr(baud, &brr, &over8);
+		if (actual == 0) {
+			printf("%lu baud cannot be reached within %d.%d%% from the %lu Hz APB1 clock\r\n",
+					(unsigned long) baud, UART_BAUD_MAX_ERROR_PERMILLE / 10, UART_BAUD_MAX_ERROR_PERMILLE % 10,
+					(unsigned long) get_apb1_clk_freq());
+			step_failed = true;
+			return;
+		}
+		printf("Switching to %lu baud (%lu actual, BRR 0x%04lX, oversampling by %d)\r\n",
+				(unsigned long) baud, (unsigned long) actual, (unsigned long) brr, over8 ? 8 : 16);
+		printf("Press enter at the new rate within %d s to keep it\r\n", BAUD_CONFIRM_MS / 1000);
+		if (uart_switch_baud(baud, BAUD_CONFIRM_MS)) {
+			printf("Now at %lu baud\r\n", (unsigned long) uart_get_baud());
+		} else {
+			printf("No confirmation, back to %lu baud\r\n", (unsigned long) old_baud);
+			step_failed = true;
+			return;
+		}
+	}
+
+	if (test) {
+		baud_throughput_test();
+	} else if (baud == 0) {
+		printf("Console at %lu baud, APB1 clock %lu Hz\r\n", (unsigned long) uart_get_baud(),
+				(unsigned long) get_apb1_clk_freq());
+	}
+}
+
+/*
+ * Function to print an FMC timing profile, with the timings in SDRAM clock cycles
+ *
+ * Parameters:
+ *  index index of the profile
+ *
+ * Returns:
+ *  none
+ */
+static void print_fmc_profile(uint8_t index) {
+	const fmc_profile_t *p = fmc_get_profile(index);
+
+	printf("%c%u %-8s tRCD %u tRP %u tWR %u tRC %u tRAS %u, RPIPE %u, read burst %s\r\n",
+			(index == fmc_get_active_profile()) ? '*' : ' ', index, p->name, p->trcd + 1, p->trp + 1,
+			p->twr + 1, p->trc + 1, p->tras + 1, p->rpipe, p->rburst ? "on" : "off");
+}
+
+/*
+ * Function to print a bandwidth in MB/s with one decimal
+ *
+ * Parameters:
+ *  bytes number of bytes moved
+ *  cycles core clock cycles it took, 0 if the test failed
+ *
+ * Returns:
+ *  none
+ */
+static void print_bandwidth(uint32_t bytes, uint32_t cycles) {
+	if (cycles == 0) {
+		printf("    failed");
+		return;
+	}
+	uint32_t tenths = (uint32_t) (((uint64_t) bytes * get_sysclk_freq()) / cycles / 100000);
+	printf("  %6lu.%lu", (unsigned long) (tenths / 10), (unsigned long) (tenths % 10));
+}
+
+/*
+ * Callback function for the membench command. It checks that the SDRAM holds a pattern, then times
+ * CPU and DMA accesses over an area at the bottom of SDRAM. A profile selected with -p is applied
+ * first and dropped again if the check fails.
+ *
+ * -p {switches to an FMC timing profile by name or number first}
+ * -l {lists the FMC timing profiles}
+ * -s {selects the size of the area in KB, up to the largest power of two the free SDRAM holds}
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void membench_handler(int argc, char *argv[]) {
+	optind = 0;
+	int8_t c = 0;
+	uint32_t kbytes = MEMBENCH_DEFAULT_KB;
+	int profile = -1;
+	bool list = false;
+
+	while (1) {
+		c = getopt(argc, (char**) argv, "p:ls:");
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'p':
+			if (isdigit((unsigned char) optarg[0])) {
+				profile = atoi(optarg);
+			} else {
+				profile = fmc_profile_count();//not found unless a name matches
+				for (uint8_t i = 0; i < fmc_profile_count(); i++) {
+					if (!strcasecmp(optarg, fmc_get_profile(i)->name)) {
+						profile = i;
+					}
+				}
+			}
+			break;
+		case 'l':
+			list = true;
+			break;
+		case 's':
+			kbytes = strtoul(optarg, NULL, 10);
+			break;
+		case '?':
+			printf("\r\n");
+			step_failed = true;
+			return;
+			break;
+		}
+	}
+	printf("\r\n");
+
+	if (list) {
+		for (uint8_t i = 0; i < fmc_profile_count(); i++) {
+			print_fmc_profile(i);
+		}
+		return;
+	}
+	if (profile >= fmc_profile_count()) {
+		printf("No such profile, see membench -l\r\n");
+		step_failed = true;
+		return;
+	}
+	uint32_t room_kbytes = capture_room() / 1024, max_kbytes = MEMBENCH_MIN_KB;
+	while (max_kbytes * 2 <= room_kbytes) {
+		max_kbytes *= 2;//the largest power of two the free SDRAM holds
+	}
+	if (kbytes < MEMBENCH_MIN_KB || kbytes > max_kbytes || (kbytes & (kbytes - 1))) {
+		printf("The size must be a power of two from %d to %lu KB\r\n", MEMBENCH_MIN_KB, (unsigned long) max_kbytes);
+		step_failed = true;
+		return;
+	}
+	if (user_fatfs_get_save_job()->state == SAVE_JOB_RUNNING) {
+		printf("A save is running, wait for it to end (see jobs)\r\n");
+		step_failed = true;
+		return;
+	}
+	uint32_t len = kbytes * 1024;
+	uint8_t *area = reserve_capture_region(len);
+	if (area == NULL) {
+		printf("SDRAM is busy\r\n");
+		step_failed = true;
+		return;
+	}
+	set_capture_length(0);//the capture is overwritten
+
+	uint8_t previous = fmc_get_active_profile();
+	if (profile >= 0) {
+		fmc_apply_profile(profile);
+	}
+	print_fmc_profile(fmc_get_active_profile());
+
+	uint32_t errors = membench_check(area, len);
+	if (errors != 0) {
+		printf("Memory check failed, %lu of %lu words wrong\r\n", (unsigned long) errors,
+				(unsigned long) (len / 4));
+		if (fmc_get_active_profile() != previous) {
+			fmc_apply_profile(previous);
+			printf("Back to profile %s\r\n", fmc_get_profile(previous)->name);
+		}
+		step_failed = true;
+		return;
+	}
+	printf("Memory check of %lu KB passed\r\n", (unsigned long) kbytes);
+
+	membench_result_t results[MEMBENCH_TESTS];
+	membench_run(area, len, results);
+
+	printf("%-16s%10s%10s%10s\r\n", "MB/s", "8 bit", "16 bit", "32 bit");
+	for (uint8_t t = 0; t < MEMBENCH_TESTS; t++) {
+		printf("%-16s", results[t].name);
+		for (uint8_t w = 0; w < MEMBENCH_WIDTHS; w++) {
+			print_bandwidth(len, results[t].cycles[w]);
+		}
+		printf("\r\n");
+	}
+}
+
+/*
+ * Function to print a line of the SDRAM map
+ *
+ * Parameters:
+ *  name name of the region
+ *  start offset of the region from the bottom of SDRAM
+ *  size size of the region in bytes
+ *  flags flags of the region
+ *
+ * Returns:
+ *  none
+ */
+static void print_sdram_line(const char *name, uint32_t start, uint32_t size, uint8_t flags) {
+	printf("%-10s 0x%08lX 0x%08lX %6lu KB%s\r\n", name, (unsigned long) (SDRAM_BANK_ADDR + start),
+			(unsigned long) (SDRAM_BANK_ADDR + start + size - 1), (unsigned long) (size / 1024),
+			(flags & SDRAM_REGION_LOCKED) ? "  locked" : "");
+}
+
+/*
+ * Callback function for the mem command. It prints the regions of SDRAM and the gaps between them
+ * in address order, then the totals of the allocator and the SUMP captures that found no room
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void mem_handler(int argc, char *argv[]) {
+	(void) argc;
+	(void) argv;
+	sdram_arena_t *arena = get_sdram_arena();
+	uint32_t gap_start = 0;
+
+	printf("\r\n%-10s %-10s %-10s %9s\r\n", "Region", "Start", "End", "Size");
+	for (uint8_t i = 0; i <= arena->count; i++) {
+		uint32_t gap_end = (i < arena->count) ? arena->regions[i].offset : arena->size;
+		if (gap_end > gap_start) {
+			print_sdram_line("free", gap_start, gap_end - gap_start, 0);
+		}
+		if (i < arena->count) {
+			sdram_region_t *region = &arena->regions[i];
+			print_sdram_line(region->name, region->offset, region->size, region->flags);
+			gap_start = region->offset + region->size;
+		}
+	}
+	printf("%u of %d regions, %lu KB free, largest gap %lu KB, peak %lu KB, %lu allocations refused\r\n",
+			arena->count, SDRAM_MAX_REGIONS, (unsigned long) (sdram_free_bytes(arena) / 1024),
+			(unsigned long) (sdram_largest_free(arena) / 1024), (unsigned long) (arena->peak / 1024),
+			(unsigned long) arena->failures);
+	if (sump_get_stats()->refused != 0) {
+		printf("%lu SUMP captures refused for lack of room, the last wanted %lu KB\r\n",
+				(unsigned long) sump_get_stats()->refused,
+				(unsigned long) (sump_get_stats()->refused_len / 1024));
+	}
+}
+
+/*
+ * Callback function for the perf command. It prints the count, min, average and max cycles of each
+ * profiled section and the histograms of interrupt entry latency, then clears them so the next
+ * perf shows what ran in between
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void perf_handler(int argc, char *argv[]) {
+	(void) argc;
+	(void) argv;
+	perf_report();
+}
+
+/*
+ * Callback function for the gen command. It fills SDRAM with random traffic of one protocol from
+ * wavegen.c and makes it the last capture, so analyse -s a, dump and save work on it as on a real one
+ *
+ * -m {selects the protocol}
+ * -r {selects the sample rate in Hz}
+ * -b {selects the bus rate}
+ * -k {selects the size in KB}
+ * -j {selects the jitter in percent}
+ * -g {selects the percent of glitches}
+ * -e {selects the percent of errors}
+ * -z {selects the seed}
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void gen_handler(int argc, char *argv[]) {
+	optind = 0;
+	int8_t c = 0;
+	wavegen_protocol_t protocol = WAVEGEN_I2C;
+	uint32_t rate = GEN_DEFAULT_RATE, bus_rate = 0, kbytes = SDRAM_SIZE / 1024, seed = 1;
+	uint32_t jitter = 0, glitches = 0, errors = 0;
+
+	while (1) {
+		c = getopt(argc, (char**) argv, "m:r:b:k:j:g:e:z:");
+		if (c == -1) {
+			break;
+		}
+		switch (c) {
+		case 'm':
+			protocol = wavegen_protocol_by_name(optarg);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			bus_rate = strtoul(optarg, NULL, 10);
+			break;
+		case 'k':
+			kbytes = strtoul(optarg, NULL, 10);
+			break;
+		case 'j':
+			jitter = strtoul(optarg, NULL, 10);
+			break;
+		case 'g':
+			glitches = strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			errors = strtoul(optarg, NULL, 10);
+			break;
+		case 'z':
+			seed = strtoul(optarg, NULL, 10);
+			break;
+		case '?':
+			printf("\r\n");
+			step_failed = true;
+			return;
+			break;
+		}
+	}
+	printf("\r\n");
+
+	if (protocol == WAVEGEN_PROTOCOLS) {
+		printf("Unknown protocol, it can be uart, i2c, spi, 1wire or can\r\n");
+		step_failed = true;
+		return;
+	}
+	if (kbytes == 0 || kbytes > SDRAM_SIZE / 1024 || jitter > WAVEGEN_JITTER_MAX || glitches > 100
+			|| errors > 100) {
+		printf("The size must be from 1 to %d KB, the jitter at most %d, glitches and errors at most 100\r\n",
+				SDRAM_SIZE / 1024, WAVEGEN_JITTER_MAX);
+		step_failed = true;
+		return;
+	}
+
+	wavegen_config_t config;
+	wavegen_default_config(&config, protocol, rate);
+	if (bus_rate != 0) {
+		config.bus_rate = bus_rate;
+	}
+	config.jitter = jitter;
+	config.glitches = glitches;
+	config.errors = errors;
+	config.seed = seed;
+
+	if (user_fatfs_get_save_job()->state == SAVE_JOB_RUNNING) {
+		printf("A save is running, wait for it to end (see jobs)\r\n");
+		step_failed = true;
+		return;
+	}
+	uint32_t len = kbytes * 1024;
+	uint8_t *dest = reserve_capture_region(len);
+	if (dest == NULL) {
+		printf("SDRAM is busy\r\n");
+		step_failed = true;
+		return;
+	}
+
+	wavegen_stats_t stats;
+	ticktime_t start = now();
+	if (!wavegen_generate(&config, dest, len, NULL, 0, &stats)) {
+		set_capture_length(0);//the capture is overwritten
+		printf("The bus rate %lu does not fit the sample rate %lu, or is missing\r\n",
+				(unsigned long) config.bus_rate, (unsigned long) rate);
+		step_failed = true;
+		return;
+	}
+	uint32_t elapsed_ms = now() - start;
+	set_sample_rate(rate);
+	set_trigger_position(NO_TRIGGER_POSITION);
+	set_capture_length(len);
+	capture_health_reset(false);
+
+	printf("%lu KB at %lu Hz, bus at %lu, seed %lu\r\n", (unsigned long) kbytes, (unsigned long) rate,
+			(unsigned long) config.bus_rate, (unsigned long) seed);
+	printf("%lu transactions, %lu events, %lu glitches, %lu errors, idle after sample %lu\r\n",
+			(unsigned long) stats.transactions, (unsigned long) stats.events, (unsigned long) stats.glitches,
+			(unsigned long) stats.errors, (unsigned long) stats.samples);
+	printf("Generated in %lu ms\r\n", (unsigned long) elapsed_ms);
+	printf("Use analyse -s a to run an analyser on the whole capture\r\n");
+}
+
+/*
+ * Callback function to run the help menu, which prints out a list of all the commands as well
+ * as their parameters
+ *
+ * Parameters:
+ *  argc(in) integer holding the value of the number of tokens
+ * 	argv(in) array of pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void help_handler(int argc, char *argv[]) {
+	(void) argc;
+	(void) argv;
+	printf("Commands Available:\r\n");
+	for (int i = 0; i < num_commands; i++) {
+		printf("%s:\r\n", commands[i].name);
+		printf("\t%s\r\n", commands[i].help_string);
+	}
+}
+
+/* Function to tokenise a line ending with a carriage return and run its command from the
+ * command table
+ *
+ * Parameters:
+ *	line(in/out) line to run, it is tokenised in place
+ *
+ * Returns:
+ *  true if the command ran without reporting a failure, or the line was empty
+ *  false otherwise
+ */
+static bool execute_line(uint8_t line[]) {
+	uint8_t argc = 0, *argv[CMD_PROCESSOR_ARGV_SIZE] = { 0 };
+
+	step_failed = false;
+	get_tokens(line, &argc, argv);
+	if (argc == 0) {
+		return true;
+	}
+
+	int i = 0;
+	while (i < num_commands) {
+		if (!strcasecmp((const char*) argv[0], commands[i].name)) {
+			commands[i].handler(argc, (char**) argv);
+			break;
+		}
+		i++;
+	}
+	if (i == num_commands) {//if no match occurs after iterating over command table, raise an error
+		invalid_handler(argc, (char**) argv);
+		step_failed = true;
+	}
+	return !step_failed;
+}
+
+/* Function to poll the command processor. It takes the characters received since the last
+ * call into the line editor, and once a carriage return ends the line, the line is tokenised
+ * and processed. It does not wait for input.
+ *
+ * Parameters:
+ *	none
+ *
+ * Returns:
+ *  none
+ */
+void run_command_processor() {
+	if (!poll_line()) {
+		return;
 	}
+	prompt_shown = false;
+	execute_line(editor.line);
+	line_editor_reset(&editor);//the handlers use the tokens in the line until here
 }
@@ -27,11 +27,27 @@
  */
 #ifndef __CMD_PROCESSOR_H__
 #define __CMD_PROCESSOR_H__
+#include "stdint.h"
 
+#define CMD_PROCESSOR_ARGV_SIZE 64		//tokens of a line, the NULL after the last one included
 
-/* Function to run the command processor. It first print the "> " prompt onto the screen.
- * After which is accepts user input, which is delimited by a carriage return. Then the
- * line input is tokenised and processed.
+/* Function to tokenise a line buffer and return argc and agrv values. argc is the
+ * number of tokens and argv is a pointer to the start address of those tokens. Tokens past
+ * CMD_PROCESSOR_ARGV_SIZE - 1 are dropped, so argv[argc] stays NULL for getopt.
+ *
+ * Parameters:
+ * 	line(in/out) pointer to byte buffer where the line input is saved and returned
+ * 	argc(out) pointer an integer holding the value of the number of tokens
+ * 	argv(out) array of CMD_PROCESSOR_ARGV_SIZE pointers to an byte holding the start address of those tokens
+ *
+ * Returns:
+ *  none
+ */
+void get_tokens(uint8_t line[], uint8_t *argc, uint8_t *argv[]);
+
+/* Function to poll the command processor. It takes the characters received since the last
+ * call into the line editor, and once a carriage return ends the line, the line is tokenised
+ * and processed. It does not wait for input.
  *
  * Parameters:
  *	none
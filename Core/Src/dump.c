@@ -0,0 +1,290 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    dump.c
+ * @brief   This file contains the function definitions to send a range of SDRAM to the host as
+ * 			framed packets. A frame is built again from its offset when the host asks for it, so
+ * 			only the offsets of the last DUMP_HISTORY frames are kept, not the frames.
+ *
+ * 			With run length encoding a frame is cut where the next run does not fit, and it is sent
+ * 			raw instead if that holds more samples, so busy stretches never grow.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "dump.h"
+#include "stdio.h"
+#include "string.h"
+#include "uart.h"
+#include "systick.h"
+#ifndef DUMP_SOFTWARE_CRC
+#include "stm32f429xx.h"
+#endif
+
+#define DUMP_LINGER_MS 1000		//quiet time after the last frame before the transfer ends
+#define DUMP_NAK_TIMEOUT_MS 100	//time for the sequence number to follow DUMP_NAK
+
+typedef struct{
+	uint32_t offset;
+	uint16_t seq;
+	uint8_t valid;
+}dump_history_t;
+
+static dump_history_t history[DUMP_HISTORY];
+
+static void put_le(uint8_t *dest, uint32_t value, uint8_t len){
+	for(uint8_t i = 0; i < len; i++){
+		dest[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static uint32_t put_varint(uint8_t *dest, uint32_t value){
+	uint32_t len = 0;
+	while(value >= 0x80){
+		dest[len++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	dest[len++] = (uint8_t)value;
+	return len;
+}
+
+static uint32_t varint_len(uint32_t value){
+	uint32_t len = 1;
+	while(value >= 0x80){
+		value >>= 7;
+		len++;
+	}
+	return len;
+}
+
+/*
+ * Description: computes the CRC of a frame with the CRC unit
+ * Parameters:
+ * 		const uint8_t *data pointer to the data
+ * 		uint32_t len length of the data, padded with zeros to a multiple of 4
+ * Returns:
+ *   		uint32_t CRC-32/MPEG-2 of the data taken as little endian words
+ */
+uint32_t dump_crc32(const uint8_t *data, uint32_t len){
+#ifndef DUMP_SOFTWARE_CRC
+	RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+	CRC->CR = CRC_CR_RESET;
+#else
+	uint32_t crc = 0xFFFFFFFF;
+#endif
+	for(uint32_t i = 0; i < len; i += 4){
+		uint32_t word = 0;
+		for(uint32_t b = 0; b < 4 && i + b < len; b++){
+			word |= (uint32_t)data[i + b] << (8 * b);
+		}
+#ifndef DUMP_SOFTWARE_CRC
+		CRC->DR = word;
+#else
+		crc ^= word;
+		for(int bit = 0; bit < 32; bit++){
+			crc = (crc << 1) ^ (0x04C11DB7 & (0 - (crc >> 31)));
+		}
+#endif
+	}
+#ifndef DUMP_SOFTWARE_CRC
+	return CRC->DR;
+#else
+	return crc;
+#endif
+}
+
+/*
+ * Description: COBS encodes a buffer, so that it holds no 0x00
+ * Parameters:
+ * 		const uint8_t *src data to encode
+ * 		uint32_t len length of the data
+ * 		uint8_t *dest encoded data, len + len / 254 + 1 bytes
+ * Returns:
+ *   		uint32_t length of the encoded data, without delimiter
+ */
+uint32_t dump_cobs_encode(const uint8_t *src, uint32_t len, uint8_t *dest){
+	uint32_t code_pos = 0, out = 1;
+	uint8_t code = 1;
+
+	for(uint32_t i = 0; i < len; i++){
+		if(src[i] == 0){
+			dest[code_pos] = code;
+			code_pos = out++;
+			code = 1;
+			continue;
+		}
+		dest[out++] = src[i];
+		if(++code == 0xFF){
+			dest[code_pos] = code;
+			code_pos = out++;
+			code = 1;
+		}
+	}
+	dest[code_pos] = code;
+	return out;
+}
+
+/*
+ * Description: builds the frame holding the samples from offset on, as many as fit
+ * Parameters:
+ * 		const uint8_t *samples start of the capture
+ * 		uint32_t offset index of the first sample of the frame
+ * 		uint32_t end index after the last sample of the transfer
+ * 		uint16_t seq sequence number of the frame
+ * 		bool rle true to run length encode the samples when that is shorter
+ * 		uint8_t *frame DUMP_FRAME_MAX bytes to fill with the encoded frame and its delimiter
+ * 		uint32_t *count set to the number of samples in the frame
+ * Returns:
+ *   		uint32_t length of the frame
+ */
+uint32_t dump_build_frame(const uint8_t *samples, uint32_t offset, uint32_t end, uint16_t seq, bool rle,
+		uint8_t *frame, uint32_t *count){
+	uint8_t raw[DUMP_HEADER_SIZE + DUMP_PAYLOAD_MAX + DUMP_CRC_SIZE];
+	uint8_t *payload = raw + DUMP_HEADER_SIZE;
+	uint32_t raw_count = end - offset;
+	uint32_t payload_len, len;
+	uint8_t flags = 0;
+
+	if(raw_count > DUMP_PAYLOAD_MAX)
+		raw_count = DUMP_PAYLOAD_MAX;
+	*count = raw_count;
+	payload_len = raw_count;
+
+	if(rle){
+		uint32_t in = offset, out = 0;
+		while(in < end){
+			uint8_t value = samples[in];
+			uint32_t run = 1;
+			while(in + run < end && samples[in + run] == value)
+				run++;
+			if(out + 1 + varint_len(run) > DUMP_PAYLOAD_MAX)
+				break;
+			payload[out++] = value;
+			out += put_varint(payload + out, run);
+			in += run;
+		}
+		if(in - offset > raw_count){
+			flags |= DUMP_FLAG_RLE;
+			*count = in - offset;
+			payload_len = out;
+		}
+	}
+	if(!(flags & DUMP_FLAG_RLE))
+		memcpy(payload, samples + offset, raw_count);
+	if(offset + *count == end)
+		flags |= DUMP_FLAG_LAST;
+
+	put_le(raw, seq, 2);
+	raw[2] = flags;
+	put_le(raw + 3, offset, 4);
+	put_le(raw + 7, *count, 4);
+	len = DUMP_HEADER_SIZE + payload_len;
+	put_le(raw + len, dump_crc32(raw, len), 4);
+	len += DUMP_CRC_SIZE;
+
+	len = dump_cobs_encode(raw, len, frame);
+	frame[len++] = 0;
+	return len;
+}
+
+/*
+ * reads the rest of a request of the host. Returns false if it asks to stop
+ */
+static bool handle_request(const uint8_t *samples, uint32_t end, bool rle, dump_stats_t *stats){
+	uint8_t frame[DUMP_FRAME_MAX];
+	uint8_t byte = get_char();
+	uint8_t seq_bytes[2];
+	uint32_t count, len;
+
+	if(byte == DUMP_QUIT)
+		return false;
+	if(byte != DUMP_NAK)
+		return true;
+
+	for(int i = 0; i < 2; i++){
+		ticktime_t start = now();
+		while(!char_available()){
+			if(now() - start > DUMP_NAK_TIMEOUT_MS)
+				return true;
+		}
+		seq_bytes[i] = get_char();
+	}
+
+	uint16_t seq = seq_bytes[0] | (seq_bytes[1] << 8);
+	dump_history_t *entry = &history[seq % DUMP_HISTORY];
+	if(!entry->valid || entry->seq != seq){
+		stats->missed++;
+		return true;
+	}
+	len = dump_build_frame(samples, entry->offset, end, seq, rle, frame, &count);
+	fwrite(frame, 1, len, stdout);
+	fflush(stdout);
+	stats->resent++;
+	stats->bytes_out += len;
+	return true;
+}
+
+/*
+ * Description: sends a range of samples to the host, sending frames again as it asks. After the
+ * 				last frame it waits DUMP_LINGER_MS without requests before returning
+ * Parameters:
+ * 		const uint8_t *samples start of the capture
+ * 		uint32_t offset index of the first sample to send
+ * 		uint32_t len number of samples to send
+ * 		bool rle true to run length encode the samples
+ * 		dump_stats_t *stats filled with the counters of the transfer
+ * Returns:
+ *   		bool true if the transfer ended, false if the host stopped it
+ */
+bool dump_run(const uint8_t *samples, uint32_t offset, uint32_t len, bool rle, dump_stats_t *stats){
+	uint8_t frame[DUMP_FRAME_MAX];
+	uint32_t end = offset + len;
+	uint32_t pos = offset, count, frame_len;
+	uint16_t seq = 0;
+
+	memset(stats, 0, sizeof(*stats));
+	memset(history, 0, sizeof(history));
+
+	//a delimiter first, so the host knows where the first frame starts
+	put_char(0);
+	fflush(stdout);
+	stats->bytes_out++;
+
+	while(pos < end){
+		while(char_available()){
+			if(!handle_request(samples, end, rle, stats))
+				return false;
+		}
+
+		frame_len = dump_build_frame(samples, pos, end, seq, rle, frame, &count);
+		history[seq % DUMP_HISTORY].offset = pos;
+		history[seq % DUMP_HISTORY].seq = seq;
+		history[seq % DUMP_HISTORY].valid = 1;
+		fwrite(frame, 1, frame_len, stdout);
+		fflush(stdout);		//a frame ends with a zero, not a line feed
+		stats->frames++;
+		stats->bytes_out += frame_len;
+		pos += count;
+		seq++;
+	}
+
+	ticktime_t quiet = now();
+	while(now() - quiet < DUMP_LINGER_MS){
+		if(char_available()){
+			if(!handle_request(samples, end, rle, stats))
+				return false;
+			quiet = now();
+		}
+	}
+	return true;
+}
@@ -0,0 +1,113 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    dump.h
+ * @brief   This file contains the function prototypes to send a range of SDRAM to the host over the
+ * 			console uart as framed packets. Before COBS encoding a frame is
+ *
+ * 			seq(2) flags(1) offset(4) count(4) payload(0..DUMP_PAYLOAD_MAX) crc(4)
+ *
+ * 			all little endian. offset is the index of the first sample of the frame and count the
+ * 			number of samples it holds. With DUMP_FLAG_RLE the payload is pairs of a sample value and
+ * 			its run length as an LEB128 varint, otherwise it is the samples themselves. The CRC is
+ * 			computed by the CRC unit over the frame up to the CRC, padded with zeros to a multiple of
+ * 			4 bytes and taken as little endian words: CRC-32/MPEG-2 of each word fed from its most
+ * 			significant byte. Every frame is COBS encoded and followed by a 0x00 delimiter.
+ *
+ * 			While frames are sent the host may ask for one again by sending DUMP_NAK and the
+ * 			sequence number (2 bytes little endian), or stop the transfer with DUMP_QUIT.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __DUMP_H__
+#define __DUMP_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define DUMP_HEADER_SIZE 11
+#define DUMP_PAYLOAD_MAX 240
+#define DUMP_CRC_SIZE 4
+//COBS adds one byte every 254 and the frame is followed by the delimiter
+#define DUMP_FRAME_MAX (DUMP_HEADER_SIZE + DUMP_PAYLOAD_MAX + DUMP_CRC_SIZE + 2 + 1)
+
+#define DUMP_FLAG_RLE 0x01
+#define DUMP_FLAG_LAST 0x02
+
+#define DUMP_NAK 'N'
+#define DUMP_QUIT 'Q'
+
+//frames that can still be sent again, older ones are forgotten
+#ifndef DUMP_HISTORY
+#define DUMP_HISTORY 64
+#endif
+
+typedef struct{
+	uint32_t frames;		//frames sent for the first time
+	uint32_t resent;		//frames sent again on request of the host
+	uint32_t missed;		//requests for frames no longer in the history
+	uint32_t bytes_out;		//bytes sent, delimiters included
+}dump_stats_t;
+
+/*
+ * Description: computes the CRC of a frame with the CRC unit
+ * Parameters:
+ * 		const uint8_t *data pointer to the data
+ * 		uint32_t len length of the data, padded with zeros to a multiple of 4
+ * Returns:
+ *   		uint32_t CRC-32/MPEG-2 of the data taken as little endian words
+ */
+uint32_t dump_crc32(const uint8_t *data, uint32_t len);
+
+/*
+ * Description: COBS encodes a buffer, so that it holds no 0x00
+ * Parameters:
+ * 		const uint8_t *src data to encode
+ * 		uint32_t len length of the data
+ * 		uint8_t *dest encoded data, len + len / 254 + 1 bytes
+ * Returns:
+ *   		uint32_t length of the encoded data, without delimiter
+ */
+uint32_t dump_cobs_encode(const uint8_t *src, uint32_t len, uint8_t *dest);
+
+/*
+ * Description: builds the frame holding the samples from offset on, as many as fit
+ * Parameters:
+ * 		const uint8_t *samples start of the capture
+ * 		uint32_t offset index of the first sample of the frame
+ * 		uint32_t end index after the last sample of the transfer
+ * 		uint16_t seq sequence number of the frame
+ * 		bool rle true to run length encode the samples when that is shorter
+ * 		uint8_t *frame DUMP_FRAME_MAX bytes to fill with the encoded frame and its delimiter
+ * 		uint32_t *count set to the number of samples in the frame
+ * Returns:
+ *   		uint32_t length of the frame
+ */
+uint32_t dump_build_frame(const uint8_t *samples, uint32_t offset, uint32_t end, uint16_t seq, bool rle,
+		uint8_t *frame, uint32_t *count);
+
+/*
+ * Description: sends a range of samples to the host, sending frames again as it asks. After the
+ * 				last frame it waits DUMP_LINGER_MS without requests before returning
+ * Parameters:
+ * 		const uint8_t *samples start of the capture
+ * 		uint32_t offset index of the first sample to send
+ * 		uint32_t len number of samples to send
+ * 		bool rle true to run length encode the samples
+ * 		dump_stats_t *stats filled with the counters of the transfer
+ * Returns:
+ *   		bool true if the transfer ended, false if the host stopped it
+ */
+bool dump_run(const uint8_t *samples, uint32_t offset, uint32_t len, bool rle, dump_stats_t *stats);
+
+#endif
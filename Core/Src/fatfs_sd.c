@@ -7,16 +7,19 @@
  *
  *      Note: I have included my SPI drivers and Some functions related to chip select pin
  *       which i did programmed using Bare Metal Programming and also included our own systick.
+ *       Data blocks are moved by the SPI DMA, commands and responses still go byte by byte.
  *
  */
 #define TRUE  1
 #define FALSE 0
 #define bool BYTE
 
+#include "stddef.h"
 #include "diskio.h"
 #include "fatfs_sd.h"
 #include "systick.h"
 #include "spi.h"
+#include "perf.h"
 
 uint16_t Timer1, Timer2;					/* 1ms Timer Counter */
 
@@ -24,6 +27,10 @@ static volatile DSTATUS Stat = STA_NOINIT;	/* Disk Status */
 static uint8_t CardType;                    /* Type 0:MMC, 1:SDC, 2:Block addressing */
 static uint8_t PowerFlag = 0;				/* Power flag */
 
+#define SD_INIT_CLOCK_HZ	400000			/* identification mode limit */
+#define SD_MAX_CLOCK_HZ		25000000		/* default speed limit, high speed is not used in SPI mode */
+#define MMC_MAX_CLOCK_HZ	20000000
+
 /***************************************
  * SPI functions
  **************************************/
@@ -67,12 +74,6 @@ static uint8_t SPI_RxByte(void)
 	return data;
 }
 
-/* SPI receive a byte via pointer */
-static void SPI_RxBytePtr(uint8_t *buff) 
-{
-	*buff = SPI_RxByte();
-}
-
 /***************************************
  * SD functions
  **************************************/
@@ -159,10 +160,8 @@ static bool SD_RxDataBlock(BYTE *buff, UINT len)
 	/* invalid response */
 	if(token != 0xFE) return FALSE;
 
-	/* receive data */
-	do {
-		SPI_RxBytePtr(buff++);
-	} while(len--);
+	/* receive data, 0xFF is clocked out by the DMA */
+	if (!spi_dma_transfer(NULL, buff, len)) return FALSE;
 
 	/* discard CRC */
 	SPI_RxByte();
@@ -175,7 +174,7 @@ static bool SD_RxDataBlock(BYTE *buff, UINT len)
 #if _USE_WRITE == 1
 static bool SD_TxDataBlock(const uint8_t *buff, BYTE token)
 {
-	uint8_t resp;
+	uint8_t resp = 0;
 	uint8_t i = 0;
 
 	/* wait SD ready */
@@ -184,29 +183,39 @@ static bool SD_TxDataBlock(const uint8_t *buff, BYTE token)
 	/* transmit token */
 	SPI_TxByte(token);
 
-	/* if it's not STOP token, transmit data */
-	if (token != 0xFD)
+	/* STOP token, the card is busy programming until it releases the line */
+	if (token == 0xFD)
 	{
-		SPI_TxBuffer((uint8_t*)buff, 512);
-
-		/* discard CRC */
-		SPI_RxByte();
 		SPI_RxByte();
+		return (SD_ReadyWait() == 0xFF) ? TRUE : FALSE;
+	}
 
-		/* receive response */
-		while (i <= 64)
-		{
-			resp = SPI_RxByte();
+	/* transmit data, timed up to the card releasing the line after programming it */
+	PERF_BEGIN(PERF_SD_WRITE_BLOCK);
+	if (!spi_dma_transfer(buff, NULL, 512))
+	{
+		PERF_END(PERF_SD_WRITE_BLOCK);
+		return FALSE;
+	}
 
-			/* transmit 0x05 accepted */
-			if ((resp & 0x1F) == 0x05) break;
-			i++;
-		}
+	/* discard CRC */
+	SPI_RxByte();
+	SPI_RxByte();
+
+	/* receive response */
+	while (i <= 64)
+	{
+		resp = SPI_RxByte();
 
-		/* recv buffer clear */
-		while (SPI_RxByte() == 0);
+		/* transmit 0x05 accepted */
+		if ((resp & 0x1F) == 0x05) break;
+		i++;
 	}
 
+	/* recv buffer clear */
+	while (SPI_RxByte() == 0);
+	PERF_END(PERF_SD_WRITE_BLOCK);
+
 	/* transmit 0x05 accepted */
 	if ((resp & 0x1F) == 0x05) return TRUE;
 
@@ -214,6 +223,39 @@ static bool SD_TxDataBlock(const uint8_t *buff, BYTE token)
 }
 #endif /* _USE_WRITE */
 
+/* transmit command */
+static BYTE SD_SendCmd(BYTE cmd, uint32_t arg);
+
+/* get the highest clock of the card from TRAN_SPEED in the CSD, limited to what SPI mode allows */
+static uint32_t SD_MaxClock(void)
+{
+	static const uint8_t mult[16] = {0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80};
+	uint32_t limit = (CardType & CT_SDC) ? SD_MAX_CLOCK_HZ : MMC_MAX_CLOCK_HZ;
+	uint32_t unit = 10000;	/* 100kbit/s divided by the x10 of the multiplier table */
+	uint8_t csd[16];
+	uint32_t hz;
+
+	SELECT();
+	if ((SD_SendCmd(CMD9, 0) != 0) || !SD_RxDataBlock(csd, 16))
+	{
+		DESELECT();
+		SPI_RxByte();
+		return limit;
+	}
+	DESELECT();
+	SPI_RxByte();
+
+	/* rate unit 0..3 is 100kbit/s..100Mbit/s, the others are reserved */
+	if ((csd[3] & 7) > 3) return limit;
+	for (uint8_t n = csd[3] & 7; n; n--)
+	{
+		unit *= 10;
+	}
+	hz = unit * mult[(csd[3] >> 3) & 15];
+
+	return (hz && hz < limit) ? hz : limit;
+}
+
 /* transmit command */
 static BYTE SD_SendCmd(BYTE cmd, uint32_t arg)
 {
@@ -264,6 +306,9 @@ DSTATUS SD_disk_initialize(BYTE drv)
 	/* no disk */
 	if(Stat & STA_NODISK) return Stat;
 
+	/* identification runs on a slow clock */
+	spi_set_max_clock(SD_INIT_CLOCK_HZ);
+
 	/* power on */
 	SD_PowerOn();
 
@@ -339,6 +384,12 @@ DSTATUS SD_disk_initialize(BYTE drv)
 	DESELECT();
 	SPI_RxByte();
 
+	/* switch to the fastest clock the card accepts */
+	if (type)
+	{
+		spi_set_max_clock(SD_MaxClock());
+	}
+
 	/* Clear STA_NOINIT */
 	if (type)
 	{
@@ -369,8 +420,8 @@ DRESULT SD_disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
 	/* no disk */
 	if (Stat & STA_NOINIT) return RES_NOTRDY;
 
-	/* convert to byte address */
-	if (!(CardType & CT_SD2)) sector *= 512;
+	/* convert to byte address, only block addressed (SDHC/SDXC) cards take the sector number */
+	if (!(CardType & CT_BLOCK)) sector *= 512;
 
 	SELECT();
 
@@ -401,6 +452,140 @@ DRESULT SD_disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
 	return count ? RES_ERROR : RES_OK;
 }
 
+/***************************************
+ * background multi-block read
+ *
+ * One READ_MULTIPLE_BLOCK stays open while its blocks are moved by the SPI DMA, so the
+ * caller can work on other data in the meantime. The caller keeps it going with
+ * SD_stream_poll, which only waits for a few bytes when looking for the next data token.
+ * No other disk access may happen until SD_stream_close.
+ **************************************/
+
+#define STREAM_TOKEN_TRIES	8		/* bytes looked at per poll while waiting for a data token */
+
+typedef enum {
+	STREAM_IDLE,
+	STREAM_WAIT_TOKEN,
+	STREAM_DMA,
+	STREAM_ERROR
+} stream_state_t;
+
+static stream_state_t StreamState = STREAM_IDLE;
+static BYTE *StreamBuff;
+static UINT StreamCount;
+
+/* start a multi-block read at a sector, no block is read until SD_stream_read */
+DRESULT SD_stream_open(DWORD sector)
+{
+	if (Stat & STA_NOINIT) return RES_NOTRDY;
+
+	/* convert to byte address, only block addressed (SDHC/SDXC) cards take the sector number */
+	if (!(CardType & CT_BLOCK)) sector *= 512;
+
+	SELECT();
+	if (SD_SendCmd(CMD18, sector) != 0)
+	{
+		DESELECT();
+		SPI_RxByte();
+		StreamState = STREAM_ERROR;
+		return RES_ERROR;
+	}
+	StreamCount = 0;
+	StreamState = STREAM_IDLE;
+	return RES_OK;
+}
+
+/* read the next count blocks of the open stream into buff, in the background */
+void SD_stream_read(BYTE *buff, UINT count)
+{
+	if (StreamState == STREAM_ERROR || count == 0) return;
+
+	StreamBuff = buff;
+	StreamCount = count;
+	StreamState = STREAM_WAIT_TOKEN;
+	Timer1 = 200;
+	SD_stream_poll();
+}
+
+/* move the stream along, returns the number of blocks still to come or -1 on error */
+int SD_stream_poll(void)
+{
+	uint8_t token;
+	int tries;
+
+	while (1)
+	{
+		switch (StreamState)
+		{
+		case STREAM_WAIT_TOKEN:
+			tries = STREAM_TOKEN_TRIES;
+			do {
+				token = SPI_RxByte();
+			} while ((token == 0xFF) && --tries);
+
+			if (token == 0xFF)
+			{
+				if (Timer1) return StreamCount;
+				StreamState = STREAM_ERROR;
+				break;
+			}
+			if (token != 0xFE)
+			{
+				StreamState = STREAM_ERROR;
+				break;
+			}
+			spi_dma_start(NULL, StreamBuff, 512);
+			StreamState = STREAM_DMA;
+			return StreamCount;
+
+		case STREAM_DMA:
+			if (!spi_dma_is_done()) return StreamCount;
+			if (spi_dma_error())
+			{
+				StreamState = STREAM_ERROR;
+				break;
+			}
+
+			/* discard CRC */
+			SPI_RxByte();
+			SPI_RxByte();
+			StreamBuff += 512;
+			if (--StreamCount == 0)
+			{
+				StreamState = STREAM_IDLE;
+				return 0;
+			}
+			StreamState = STREAM_WAIT_TOKEN;
+			Timer1 = 200;
+			break;
+
+		case STREAM_ERROR:
+			return -1;
+
+		default:
+			return 0;
+		}
+	}
+}
+
+/* stop the multi-block read and release the card */
+DRESULT SD_stream_close(void)
+{
+	DRESULT res = (StreamState == STREAM_ERROR) ? RES_ERROR : RES_OK;
+
+	if (StreamState == STREAM_DMA && !spi_dma_wait()) res = RES_ERROR;
+
+	/* STOP_TRANSMISSION */
+	SD_SendCmd(CMD12, 0);
+
+	/* Idle */
+	DESELECT();
+	SPI_RxByte();
+
+	StreamState = STREAM_IDLE;
+	return res;
+}
+
 /* write sector */
 #if _USE_WRITE == 1
 DRESULT SD_disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count) 
@@ -414,8 +599,8 @@ DRESULT SD_disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
 	/* write protection */
 	if (Stat & STA_PROTECT) return RES_WRPRT;
 
-	/* convert to byte address */
-	if (!(CardType & CT_SD2)) sector *= 512;
+	/* convert to byte address, only block addressed (SDHC/SDXC) cards take the sector number */
+	if (!(CardType & CT_BLOCK)) sector *= 512;
 
 	SELECT();
 
@@ -427,8 +612,9 @@ DRESULT SD_disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
 	}
 	else
 	{
-		/* WRITE_MULTIPLE_BLOCK */
-		if (CardType & CT_SD1)
+		/* WRITE_MULTIPLE_BLOCK, every SD card takes the number of blocks to pre-erase (ACMD23)
+		 * so it can erase the whole span once instead of block by block */
+		if (CardType & CT_SDC)
 		{
 			SD_SendCmd(CMD55, 0);
 			SD_SendCmd(CMD23, count); /* ACMD23 */
@@ -44,4 +44,10 @@ DRESULT SD_disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT SD_disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 DRESULT SD_disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 
+/* Background multi-block read, see fatfs_sd.c */
+DRESULT SD_stream_open (DWORD sector);
+void SD_stream_read (BYTE* buff, UINT count);
+int SD_stream_poll (void);
+DRESULT SD_stream_close (void);
+
 #endif
@@ -35,6 +35,10 @@
 #include "stm32f429xx.h"
 #include "systick.h"
 #include "string.h"
+#include "stddef.h"
+#include "stdbool.h"
+#include "sdram_alloc.h"
+#include "pll_clock.h"
 
 #define TWO_BIT_MASK 0b11
 #define FOUR_BIT_MAKS 0b1111
@@ -42,6 +46,16 @@
 #define ALT_FUNC_12_MASK 0b1100
 #define OSPEED_VHIGH_MASK 0b11
 
+static uint8_t *capture_address = SDRAM_BANK_ADDR;
+static bool capture_allocated = false;		//false until the first capture, capture_address is then the bottom
+static const uint8_t *locked_address = NULL;
+static sdram_arena_t sdram = {.base = SDRAM_BANK_ADDR, .size = SDRAM_SIZE};
+
+//SDRAM is cleared by memory to memory DMA in chunks, cleared_end is where the clear has got to
+static uint32_t clear_value = 0;
+static uint8_t *volatile cleared_end = SDRAM_BANK_ADDR;
+static volatile bool clear_running = false;
+
 /*
  *	Function to set the configuration of a pin which is used for the SDRAM.
  *	The Configuration is:
@@ -127,11 +141,129 @@ void send_sdram_cmd(uint8_t cmd,uint16_t mode_reg){
 	FMC_Bank5_6->SDCMR= to_send;
 }
 
+//The timings are filled in by fmc_compute_timings for the clock in use. Only the first profile
+//keeps to the datasheet, the others are for membench to find out what the part copes with
+static fmc_profile_t profiles[] = {
+	{"default", 0, 0, 0, 0, 0, 0, 0, FMC_CR_RPIPE_1, 0},
+	{"rburst", 0, 0, 0, 0, 0, 0, 0, FMC_CR_RPIPE_1, 1},
+	{"rpipe0", 0, 0, 0, 0, 0, 0, 0, FMC_CR_RPIPE_0, 1},
+	{"tight", 0, 0, 0, 0, 0, 0, 0, FMC_CR_RPIPE_1, 1},	//tRP and tRCD of one cycle, below the datasheet minimum
+};
+#define FMC_PROFILE_TIGHT 3
+static const uint8_t PROFILES_LEN = sizeof(profiles)/sizeof(profiles[0]);
+static uint8_t active_profile = FMC_PROFILE_DEFAULT;
+
+/*
+ *	Function to convert a time to an SDTR field, SDRAM clock cycles minus one, rounded up
+ *
+ * Parameters:
+ *  ns time in nanoseconds
+ *  sdclk SDRAM clock in Hz
+ *
+ * Returns:
+ *  field value, 0 to 15
+ */
+static uint8_t ns_to_field(uint32_t ns, uint32_t sdclk){
+	uint32_t cycles = (uint32_t)(((uint64_t)ns * sdclk + 999999999) / 1000000000);
+
+	if(cycles < 1){
+		cycles = 1;
+	}
+	if(cycles > 16){
+		cycles = 16;
+	}
+	return cycles - 1;
+}
+
+/*
+ *	Function to compute the timings of every profile from the SDRAM datasheet times, for an AHB
+ *	clock. tWR must also cover tRAS - tRCD and tRC - tRCD - tRP for the FMC.
+ *
+ * Parameters:
+ *  hclk AHB clock in Hz, the SDRAM runs at half of it
+ *
+ * Returns:
+ *  refresh count for SDRTR
+ */
+uint16_t fmc_compute_timings(uint32_t hclk){
+	uint32_t sdclk = hclk / 2;	//FMC_CR_SDCLK_2X
+	uint8_t tras = ns_to_field(SDRAM_TRAS_NS, sdclk);
+	uint8_t trc = ns_to_field(SDRAM_TRC_NS, sdclk);
+	uint8_t trp = ns_to_field(SDRAM_TRP_NS, sdclk);
+	uint8_t trcd = ns_to_field(SDRAM_TRCD_NS, sdclk);
+	uint8_t twr = SDRAM_TWR_CYCLES - 1;
+
+	//in cycles, tWR >= tRAS - tRCD and tWR >= tRC - tRCD - tRP, the fields are cycles minus one
+	if(twr + 1 < tras - trcd){
+		twr = tras - trcd - 1;
+	}
+	if(twr + 2 < trc - trcd - trp){
+		twr = trc - trcd - trp - 2;
+	}
+	for(uint8_t i = 0; i < PROFILES_LEN; i++){
+		profiles[i].tmrd = SDRAM_TMRD_CYCLES - 1;
+		profiles[i].txsr = ns_to_field(SDRAM_TXSR_NS, sdclk);
+		profiles[i].tras = tras;
+		profiles[i].trc = trc;
+		profiles[i].twr = twr;
+		profiles[i].trp = trp;
+		profiles[i].trcd = trcd;
+	}
+	profiles[FMC_PROFILE_TIGHT].trp = 0;
+	profiles[FMC_PROFILE_TIGHT].trcd = 0;
+
+	return (uint16_t)((uint64_t)sdclk * SDRAM_REFRESH_MS / 1000 / SDRAM_ROWS - SDRAM_REFRESH_MARGIN);
+}
+
+/*
+ *	Function to write the timing and control registers of the SDRAM bank from a profile. The
+ *	geometry, CAS latency and SDCLK are the same for every profile, so the mode register and the
+ *	clock of the SDRAM stay valid.
+ *
+ * Parameters:
+ *  profile profile to write
+ *
+ * Returns:
+ *  none
+ */
+static void write_sdram_config(const fmc_profile_t *profile){
+    uint32_t fmc_tr = 0, fmc_cr = 0;
+
+    fmc_tr |= profile->tmrd<<FMC_SDTR1_TMRD_Pos;
+    fmc_tr |= profile->txsr<<FMC_SDTR1_TXSR_Pos;
+    fmc_tr |= profile->tras<<FMC_SDTR1_TRAS_Pos;
+    fmc_tr |= profile->trc<<FMC_SDTR1_TRC_Pos;
+    fmc_tr |= profile->twr<<FMC_SDTR1_TWR_Pos;
+    fmc_tr |= profile->trp<<FMC_SDTR1_TRP_Pos;
+    fmc_tr |= profile->trcd<<FMC_SDTR1_TRCD_Pos;
+
+    FMC_Bank5_6->SDTR[1] = fmc_tr;
+    FMC_Bank5_6->SDTR[0] = (fmc_tr & FMC_TR_DNC_MASK);//certain parameters in the TR are DNC for
+    												  //bank 2, therefore they must be copied into
+    												  //TR for bank 1
+
+    fmc_cr |= FMC_CR_NC_8_BITS<<FMC_SDCR1_NC_Pos;
+    fmc_cr |= FMC_CR_NR_12_BITS<<FMC_SDCR1_NR_Pos;
+    fmc_cr |= FMC_CR_MWID_16_BITS<<FMC_SDCR1_MWID_Pos;
+    fmc_cr |= FMC_CR_NB_2_BANKS<<FMC_SDCR1_NB_Pos;
+    fmc_cr |= FMC_CR_CAS_LATENCY_2<<FMC_SDCR1_CAS_Pos;
+    fmc_cr |= FMC_CR_WP_NONE<<FMC_SDCR1_WP_Pos;
+    fmc_cr |= FMC_CR_SDCLK_2X<<FMC_SDCR1_SDCLK_Pos;
+    fmc_cr |= profile->rburst<<FMC_SDCR1_RBURST_Pos;
+    fmc_cr |= profile->rpipe<<FMC_SDCR1_RPIPE_Pos;
+
+    FMC_Bank5_6->SDCR[1] = fmc_cr;
+    FMC_Bank5_6->SDCR[0] = (fmc_cr & FMC_CR_DNC_MASK);//certain parameters in the CR are DNC for
+	  	  	  	  	  	  	  	  	  	  	  	  	  //bank 2, therefore they must be copied into
+	  	  	  	  	  	  	  	  	  	  	  	  	  //CR for bank 1
+}
+
 /*
  *	Function to initialize the SDRAM.
  *	It first configures all the port pins required for functioning, after than it follows the
  *	initialization process provided in the reference manual.
- *	Once that is complete the memory range 0xD0000000 to 0xD08000000 is available for use
+ *	Once that is complete the memory range 0xD0000000 to 0xD08000000 is available for use, and its
+ *	clear to zero goes on in the background
  *
  * Parameters:
  *  none
@@ -140,8 +272,8 @@ void send_sdram_cmd(uint8_t cmd,uint16_t mode_reg){
  *  none
  */
 void init_sdram(){
-    uint32_t fmc_tr = 0, fmc_cr = 0;
     uint16_t fmc_mode_reg = 0;
+    uint16_t refresh_count;
 	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN_Msk | RCC_AHB1ENR_GPIOCEN_Msk | RCC_AHB1ENR_GPIODEN_Msk |
 			  	  	  RCC_AHB1ENR_GPIOEEN_Msk | RCC_AHB1ENR_GPIOFEN_Msk | RCC_AHB1ENR_GPIOGEN_Msk;
 
@@ -175,41 +307,13 @@ void init_sdram(){
     	set_pin_func(GPIOG, GPIOG_FMC_PINS[i]);
     }
 
-    //The values for timings are calculated on the basis of a 160MHz clock
-    fmc_tr |= FMC_TR_TMRD_VAL<<FMC_SDTR1_TMRD_Pos;
-    fmc_tr |= FMC_TR_TXSR_VAL<<FMC_SDTR1_TXSR_Pos;
-    fmc_tr |= FMC_TR_TRAS_VAL<<FMC_SDTR1_TRAS_Pos;
-    fmc_tr |= FMC_TR_TRC_VAL<<FMC_SDTR1_TRC_Pos;
-    fmc_tr |= FMC_TR_TWR_VAL<<FMC_SDTR1_TWR_Pos;
-    fmc_tr |= FMC_TR_TRP_VAL<<FMC_SDTR1_TRP_Pos;
-    fmc_tr |= FMC_TR_TRCD_VAL<<FMC_SDTR1_TRCD_Pos;
-
-    FMC_Bank5_6->SDTR[1] = fmc_tr;
-    FMC_Bank5_6->SDTR[0] = 0;
-    FMC_Bank5_6->SDTR[0] = (fmc_tr & FMC_TR_DNC_MASK);//certain parameters in the TR are DNC for
-    												  //bank 2, therefore they must be copied into
-    												  //TR for bank 1
-
-    fmc_cr |= FMC_CR_NC_8_BITS<<FMC_SDCR1_NC_Pos;
-    fmc_cr |= FMC_CR_NR_12_BITS<<FMC_SDCR1_NR_Pos;
-    fmc_cr |= FMC_CR_MWID_16_BITS<<FMC_SDCR1_MWID_Pos;
-    fmc_cr |= FMC_CR_NB_2_BANKS<<FMC_SDCR1_NB_Pos;
-    fmc_cr |= FMC_CR_CAS_LATENCY_2<<FMC_SDCR1_CAS_Pos;
-    fmc_cr |= FMC_CR_WP_NONE<<FMC_SDCR1_WP_Pos;
-    fmc_cr |= FMC_CR_SDCLK_2X<<FMC_SDCR1_SDCLK_Pos;
-    fmc_cr |= FMC_CR_RPIPE_1<<FMC_SDCR1_RPIPE_Pos;
-
-    FMC_Bank5_6->SDCR[1] = 0;
-    FMC_Bank5_6->SDCR[1] = fmc_cr;
-    FMC_Bank5_6->SDCR[0] = 0;
-    FMC_Bank5_6->SDCR[0] = (fmc_cr & FMC_CR_DNC_MASK);//certain parameters in the CR are DNC for
-	  	  	  	  	  	  	  	  	  	  	  	  	  //bank 2, therefore they must be copied into
-	  	  	  	  	  	  	  	  	  	  	  	  	  //CR for bank 1
+    refresh_count = fmc_compute_timings(get_ahb_clk_freq());
+    write_sdram_config(&profiles[FMC_PROFILE_DEFAULT]);
 
     //following is the initialization process according to the datasheet
     send_sdram_cmd(SDRAM_CMD_CLOCK_ENABLE, SDRAM_DEFAULT_MODE_VAL);
 
-    b_delay(1);//must be more than 100us
+    b_delay_us(SDRAM_POWER_UP_DELAY_US);//must be more than 100us
 
     send_sdram_cmd(SDRAM_CMD_PALL,SDRAM_DEFAULT_MODE_VAL);
 
@@ -226,8 +330,356 @@ void init_sdram(){
     send_sdram_cmd(SDRAM_CMD_LOAD_MODE_REG, fmc_mode_reg);
 
     //refresh counter value based on formula provided in reference manual
-    FMC_Bank5_6->SDRTR = (SDRAM_RTR_COUNT_VAL<<FMC_SDRTR_COUNT_Pos);
+    FMC_Bank5_6->SDRTR = ((uint32_t)refresh_count<<FMC_SDRTR_COUNT_Pos);
+
+    sdram_clear_start();//the console comes up while the memory is cleared
+}
+
+/*
+ *	Function to start the clear of the next chunk of SDRAM
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+static void start_clear_chunk(){
+	SDRAM_CLEAR_STREAM->M0AR = (uint32_t)cleared_end;
+	SDRAM_CLEAR_STREAM->NDTR = SDRAM_CLEAR_CHUNK / sizeof(uint32_t);
+	SDRAM_CLEAR_STREAM->CR |= DMA_SxCR_EN;
+}
+
+/*
+ *	Function to start clearing the whole SDRAM in the background. The clear is done by DMA2 as a
+ *	memory to memory transfer of a word of zeros, in chunks of SDRAM_CLEAR_CHUNK bytes chained by the
+ *	transfer complete interrupt, so it takes no CPU time.
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void sdram_clear_start(void){
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+
+	SDRAM_CLEAR_STREAM->CR = 0;
+	while(SDRAM_CLEAR_STREAM->CR & DMA_SxCR_EN);
+	DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+
+	//memory to memory needs the FIFO, the destination is written in bursts of 4 words
+	SDRAM_CLEAR_STREAM->PAR = (uint32_t)&clear_value;
+	SDRAM_CLEAR_STREAM->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_0 | DMA_SxFCR_FTH_1;
+	SDRAM_CLEAR_STREAM->CR = DMA_SxCR_DIR_1 | DMA_SxCR_MINC | DMA_SxCR_PSIZE_1 | DMA_SxCR_MSIZE_1 |
+			DMA_SxCR_MBURST_0 | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+
+	cleared_end = SDRAM_BANK_ADDR;
+	clear_running = true;
+	NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+	start_clear_chunk();
+}
+
+/*
+ *	Function to wait until the background clear has passed an address. If the DMA stopped on an
+ *	error, the rest is cleared by the CPU.
+ *
+ * Parameters:
+ *  end address after the last byte that must be cleared
+ *
+ * Returns:
+ *  none
+ */
+void sdram_clear_wait(const uint8_t *end){
+	while(clear_running && cleared_end < end);
+
+	if(cleared_end < end){
+		memset(cleared_end, 0, SDRAM_BANK_ADDR + SDRAM_SIZE - cleared_end);
+		cleared_end = SDRAM_BANK_ADDR + SDRAM_SIZE;
+	}
+}
+
+/*
+ *	DMA2 Stream7 interrupt handler, starts the clear of the next chunk of SDRAM when one is done
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void DMA2_Stream7_IRQHandler(void){
+	if(DMA2->HISR & DMA_HISR_TEIF7){
+		DMA2->HIFCR = DMA_HIFCR_CTEIF7 | DMA_HIFCR_CTCIF7;
+		clear_running = false;//sdram_clear_wait finishes the clear
+		return;
+	}
+	if(DMA2->HISR & DMA_HISR_TCIF7){
+		DMA2->HIFCR = DMA_HIFCR_CTCIF7;
+		cleared_end += SDRAM_CLEAR_CHUNK;
+		if(cleared_end < SDRAM_BANK_ADDR + SDRAM_SIZE){
+			start_clear_chunk();
+		}else{
+			clear_running = false;
+		}
+	}
+}
+
+/*
+ *	Function to choose where the next capture is stored. The region of the last capture is given
+ *	back and a new one is allocated in the first gap it fits, so while the last capture is locked by
+ *	a background save the next one goes beside it. The chosen address is returned by
+ *	get_capture_address from now on. Right after boot it waits for the background clear to pass the
+ *	end of the region.
+ *
+ * Parameters:
+ *  len number of bytes the capture will fill
+ *
+ * Returns:
+ *  start address of the capture
+ *  NULL if the capture does not fit, the last capture is then kept
+ */
+uint8_t *reserve_capture_region(uint32_t len){
+	sdram_region_t *previous = capture_allocated ? sdram_find(&sdram, capture_address) : NULL;
+	uint32_t previous_len = 0;
+	bool previous_locked = false;
+
+	if(previous != NULL){
+		previous_len = previous->size;
+		previous_locked = previous->flags & SDRAM_REGION_LOCKED;
+		if(previous_locked){
+			previous->name = SDRAM_SAVING_NAME;//left to the save, unlock_sdram_region frees it
+		}else{
+			sdram_free(&sdram, capture_address);
+		}
+	}
+
+	uint8_t *start = sdram_alloc(&sdram, SDRAM_CAPTURE_NAME, len, SDRAM_CAPTURE_ALIGN);
+	if(start == NULL){
+		if(previous_locked){
+			sdram_find(&sdram, capture_address)->name = SDRAM_CAPTURE_NAME;
+		}else if(previous != NULL){
+			sdram_alloc_at(&sdram, SDRAM_CAPTURE_NAME, capture_address, previous_len);//in the gap it left
+		}
+		return NULL;
+	}
+
+	sdram_clear_wait(start + len);//the clear must not run over the capture
+	capture_address = start;
+	capture_allocated = true;
+	return start;
+}
+
+/*
+ *	Function to get the largest capture reserve_capture_region can place now, in the free SDRAM
+ *	and the region of the last capture, which it gives back first unless a save holds it
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  size in bytes
+ */
+uint32_t capture_room(void){
+	sdram_region_t *previous = capture_allocated ? sdram_find(&sdram, capture_address) : NULL;
+
+	if(previous != NULL && !(previous->flags & SDRAM_REGION_LOCKED)){
+		return sdram_largest_aligned(&sdram, SDRAM_CAPTURE_ALIGN, capture_address);
+	}
+	return sdram_largest_aligned(&sdram, SDRAM_CAPTURE_ALIGN, NULL);
+}
+
+/*
+ *	Function to allocate a named region of SDRAM for other users than captures, such as decoder
+ *	event stores or scratch buffers. Right after boot it waits for the background clear to pass the
+ *	end of the region.
+ *
+ * Parameters:
+ *  name name of the region, shown by the mem command
+ *  len size of the region in bytes
+ *  align alignment of the start, a power of two
+ *
+ * Returns:
+ *  start address of the region
+ *  NULL if it does not fit
+ */
+uint8_t *sdram_region_alloc(const char *name, uint32_t len, uint32_t align){
+	uint8_t *start = sdram_alloc(&sdram, name, len, align);
+
+	if(start != NULL){
+		sdram_clear_wait(start + len);
+	}
+	return start;
+}
+
+/*
+ *	Function to free a region allocated with sdram_region_alloc
+ *
+ * Parameters:
+ *  addr start address of the region
+ *
+ * Returns:
+ *  none
+ */
+void sdram_region_free(uint8_t *addr){
+	sdram_free(&sdram, addr);
+}
+
+/*
+ *	Function to get how many bytes from an address on belong to the same region, so reads of a
+ *	capture stop at the end of its region. Before the first capture no region holds the bottom of
+ *	SDRAM, the room then runs to the end of SDRAM.
+ *
+ * Parameters:
+ *  addr address in SDRAM
+ *
+ * Returns:
+ *  bytes from addr to the end of its region, or of SDRAM if it is in no region
+ */
+uint32_t sdram_room_after(const uint8_t *addr){
+	sdram_region_t *region = sdram_find(&sdram, addr);
+
+	if(region != NULL){
+		return region->size - (uint32_t)(addr - sdram.base - region->offset);
+	}
+	if(addr < SDRAM_BANK_ADDR || addr >= SDRAM_BANK_ADDR + SDRAM_SIZE){
+		return 0;
+	}
+	return SDRAM_BANK_ADDR + SDRAM_SIZE - addr;
+}
+
+/*
+ *	Function to get the arena of the SDRAM, to print its map or check bounds
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  pointer to the arena
+ */
+sdram_arena_t *get_sdram_arena(void){
+	return &sdram;
+}
+
+/*
+ *	Function to get the start address of the last capture
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  start address of the last capture
+ */
+uint8_t *get_capture_address(void){
+	return capture_address;
+}
+
+/*
+ *	Function to lock a region of SDRAM so that no capture is placed over it, used while a capture is
+ *	being saved in the background. Only one region can be locked at a time. If the range is in no
+ *	region yet, a region is allocated over it.
+ *
+ * Parameters:
+ *  addr start of the region
+ *  len length of the region in bytes
+ *
+ * Returns:
+ *  none
+ */
+void lock_sdram_region(const uint8_t *addr, uint32_t len){
+	sdram_region_t *region = sdram_find(&sdram, addr);
+
+	if(region == NULL && sdram_alloc_at(&sdram, SDRAM_SAVING_NAME, (uint8_t*)addr, len)){
+		region = sdram_find(&sdram, addr);
+	}
+	if(region != NULL){
+		region->flags |= SDRAM_REGION_LOCKED;
+		locked_address = sdram.base + region->offset;
+	}
+}
+
+/*
+ *	Function to release the locked region of SDRAM. If a capture has been taken since, the region is
+ *	no longer the capture and is freed.
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void unlock_sdram_region(void){
+	sdram_region_t *region = (locked_address != NULL) ? sdram_find(&sdram, locked_address) : NULL;
+
+	if(region != NULL){
+		region->flags &= ~SDRAM_REGION_LOCKED;
+		if(!capture_allocated || locked_address != capture_address){
+			sdram_free(&sdram, locked_address);
+		}
+	}
+	locked_address = NULL;
+}
+
+/*
+ *	Function to get the number of FMC timing profiles
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  number of profiles
+ */
+uint8_t fmc_profile_count(void){
+	return PROFILES_LEN;
+}
+
+/*
+ *	Function to get an FMC timing profile
+ *
+ * Parameters:
+ *  index index of the profile
+ *
+ * Returns:
+ *  pointer to the profile
+ *  NULL if there is no such profile
+ */
+const fmc_profile_t *fmc_get_profile(uint8_t index){
+	if(index >= PROFILES_LEN){
+		return NULL;
+	}
+	return &profiles[index];
+}
 
-    memset((uint32_t*)SDRAM_BANK_ADDR,0,SDRAM_SIZE);//to clear the memory
-    b_delay(100);
+/*
+ *	Function to get the index of the FMC timing profile in use
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  index of the profile
+ */
+uint8_t fmc_get_active_profile(void){
+	return active_profile;
+}
+
+/*
+ *	Function to switch the SDRAM to another timing profile while it runs. Nothing may access the
+ *	SDRAM meanwhile, so no capture or DMA may be running.
+ *
+ * Parameters:
+ *  index index of the profile
+ *
+ * Returns:
+ *  true if the profile was applied
+ *  false if there is no such profile
+ */
+bool fmc_apply_profile(uint8_t index){
+	if(index >= PROFILES_LEN){
+		return false;
+	}
+	delay_sdram_busy();
+	write_sdram_config(&profiles[index]);
+	active_profile = index;
+	return true;
 }
@@ -33,18 +33,22 @@
 #ifndef __FMC_H__
 #define __FMC_H__
 #include "stm32f429xx.h"
+#include "stdbool.h"
+#include "sdram_alloc.h"
 
 #define FMC_CR_DNC_MASK (FMC_SDCR1_RPIPE_Msk | FMC_SDCR1_RBURST_Msk | FMC_SDCR1_SDCLK_Msk)
 #define FMC_TR_DNC_MASK (FMC_SDTR1_TRP_Msk | FMC_SDTR1_TRC_Msk)
 
-//TODO: Add calculation
-#define FMC_TR_TMRD_VAL 		0b0001
-#define FMC_TR_TXSR_VAL 		0b0101
-#define FMC_TR_TRAS_VAL 		0b0011
-#define FMC_TR_TRC_VAL  		0b0101
-#define FMC_TR_TWR_VAL  		0b0001
-#define FMC_TR_TRP_VAL  		0b0001
-#define FMC_TR_TRCD_VAL 		0b0001
+//minimum times of the IS42S16400J, converted to SDRAM clock cycles by fmc_compute_timings for the
+//clock init_clocks set. SDCLK is HCLK/2
+#define SDRAM_TMRD_CYCLES		2		//load mode register to active
+#define SDRAM_TWR_CYCLES		2		//write recovery, raised by fmc_compute_timings to the FMC rules
+#define SDRAM_TXSR_NS			70		//self refresh exit to active
+#define SDRAM_TRAS_NS			42		//active to precharge
+#define SDRAM_TRC_NS			70		//active to active
+#define SDRAM_TRP_NS			15		//precharge to active
+#define SDRAM_TRCD_NS			15		//active to read or write
+#define SDRAM_MAX_CLK			90000000
 
 #define FMC_CR_NC_8_BITS 		0b00
 #define FMC_CR_NR_12_BITS		0b01
@@ -53,6 +57,7 @@
 #define FMC_CR_CAS_LATENCY_2	0b10
 #define FMC_CR_WP_NONE			0b00
 #define FMC_CR_SDCLK_2X			0b10
+#define FMC_CR_RPIPE_0			0b00
 #define FMC_CR_RPIPE_1			0b01
 
 #define FMC_CMR_NRFS_VAL		0b11
@@ -80,20 +85,54 @@
 #define SDRAM_MODE_REG_BURST_TYPE_SEQUENTIAL			  0b0
 #define SDRAM_MODE_REG_BURST_LEN_1 						  0b0
 
-//TODO: Add calculation
-#define SDRAM_RTR_COUNT_VAL 210
+//every row refreshed within the refresh period, COUNT = period / rows x SDCLK - margin as in the
+//reference manual
+#define SDRAM_REFRESH_MS 64
+#define SDRAM_ROWS 4096
+#define SDRAM_REFRESH_MARGIN 20
 
+#define SDRAM_POWER_UP_DELAY_US 200		//clock enable to precharge, must be more than 100us
+
+#define SDRAM_CLEAR_STREAM DMA2_Stream7	//only DMA2 does memory to memory transfers
+#define SDRAM_CLEAR_CHUNK 0x20000		//bytes per transfer, NDTR counts words and is 16 bits
+
+#ifdef HOST_BUILD
+extern uint8_t host_sdram[];		//the host build has no FMC, an array stands in for the SDRAM
+#define SDRAM_BANK_ADDR (host_sdram)
+#else
 #define SDRAM_BANK_ADDR ((uint8_t*)0xD0000000)
+#endif
 #define SDRAM_SIZE 0x800000
 
 #define SMALL_BUF_SIZE 4
 #define MEDIUM_BUF_SIZE 64
 #define LARGE_BUF_SIZE 255
+
+#define FMC_PROFILE_DEFAULT 0
+
+//timings of the SDRAM bank, the SDTR fields are in SDRAM clock cycles minus one
+typedef struct{
+	const char *name;
+	uint8_t tmrd;
+	uint8_t txsr;
+	uint8_t tras;
+	uint8_t trc;
+	uint8_t twr;
+	uint8_t trp;
+	uint8_t trcd;
+	uint8_t rpipe;		//read pipe delay in HCLK cycles
+	uint8_t rburst;		//1 to read in bursts, the FMC then fetches ahead into its read FIFO
+}fmc_profile_t;
+
+#define SDRAM_CAPTURE_ALIGN 1024
+#define SDRAM_CAPTURE_NAME "capture"
+#define SDRAM_SAVING_NAME "saving"		//a former capture kept until its background save ends
 /*
  *	Function to initialize the SDRAM.
  *	It first configures all the port pins required for functioning, after than it follows the
  *	initialization process provided in the reference manual.
- *	Once that is complete the memory range 0xD0000000 to 0xD08000000 is available for use
+ *	Once that is complete the memory range 0xD0000000 to 0xD08000000 is available for use, and its
+ *	clear to zero goes on in the background
  *
  * Parameters:
  *  none
@@ -102,4 +141,204 @@
  *  none
  */
 void init_sdram();
+
+/*
+ *	Function to start clearing the whole SDRAM in the background. The clear is done by DMA2 as a
+ *	memory to memory transfer of a word of zeros, in chunks of SDRAM_CLEAR_CHUNK bytes chained by the
+ *	transfer complete interrupt, so it takes no CPU time.
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void sdram_clear_start(void);
+
+/*
+ *	Function to wait until the background clear has passed an address. If the DMA stopped on an
+ *	error, the rest is cleared by the CPU.
+ *
+ * Parameters:
+ *  end address after the last byte that must be cleared
+ *
+ * Returns:
+ *  none
+ */
+void sdram_clear_wait(const uint8_t *end);
+
+/*
+ *	Function to choose where the next capture is stored. The region of the last capture is given
+ *	back and a new one is allocated in the first gap it fits, so while the last capture is locked by
+ *	a background save the next one goes beside it. The chosen address is returned by
+ *	get_capture_address from now on. Right after boot it waits for the background clear to pass the
+ *	end of the region.
+ *
+ * Parameters:
+ *  len number of bytes the capture will fill
+ *
+ * Returns:
+ *  start address of the capture
+ *  NULL if the capture does not fit, the last capture is then kept
+ */
+uint8_t *reserve_capture_region(uint32_t len);
+
+/*
+ *	Function to get the largest capture reserve_capture_region can place now, in the free SDRAM
+ *	and the region of the last capture, which it gives back first unless a save holds it
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  size in bytes
+ */
+uint32_t capture_room(void);
+
+/*
+ *	Function to allocate a named region of SDRAM for other users than captures, such as decoder
+ *	event stores or scratch buffers. Right after boot it waits for the background clear to pass the
+ *	end of the region.
+ *
+ * Parameters:
+ *  name name of the region, shown by the mem command
+ *  len size of the region in bytes
+ *  align alignment of the start, a power of two
+ *
+ * Returns:
+ *  start address of the region
+ *  NULL if it does not fit
+ */
+uint8_t *sdram_region_alloc(const char *name, uint32_t len, uint32_t align);
+
+/*
+ *	Function to free a region allocated with sdram_region_alloc
+ *
+ * Parameters:
+ *  addr start address of the region
+ *
+ * Returns:
+ *  none
+ */
+void sdram_region_free(uint8_t *addr);
+
+/*
+ *	Function to get how many bytes from an address on belong to the same region, so reads of a
+ *	capture stop at the end of its region. Before the first capture no region holds the bottom of
+ *	SDRAM, the room then runs to the end of SDRAM.
+ *
+ * Parameters:
+ *  addr address in SDRAM
+ *
+ * Returns:
+ *  bytes from addr to the end of its region, or of SDRAM if it is in no region
+ */
+uint32_t sdram_room_after(const uint8_t *addr);
+
+/*
+ *	Function to get the arena of the SDRAM, to print its map or check bounds
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  pointer to the arena
+ */
+sdram_arena_t *get_sdram_arena(void);
+
+/*
+ *	Function to get the start address of the last capture
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  start address of the last capture
+ */
+uint8_t *get_capture_address(void);
+
+/*
+ *	Function to lock a region of SDRAM so that no capture is placed over it, used while a capture is
+ *	being saved in the background. Only one region can be locked at a time. If the range is in no
+ *	region yet, a region is allocated over it.
+ *
+ * Parameters:
+ *  addr start of the region
+ *  len length of the region in bytes
+ *
+ * Returns:
+ *  none
+ */
+void lock_sdram_region(const uint8_t *addr, uint32_t len);
+
+/*
+ *	Function to release the locked region of SDRAM. If a capture has been taken since, the region is
+ *	no longer the capture and is freed.
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void unlock_sdram_region(void);
+
+/*
+ *	Function to compute the timings of every profile from the SDRAM datasheet times, for an AHB
+ *	clock. It is called by init_sdram with the clock init_clocks set.
+ *
+ * Parameters:
+ *  hclk AHB clock in Hz, the SDRAM runs at half of it
+ *
+ * Returns:
+ *  refresh count for SDRTR
+ */
+uint16_t fmc_compute_timings(uint32_t hclk);
+
+/*
+ *	Function to get the number of FMC timing profiles
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  number of profiles
+ */
+uint8_t fmc_profile_count(void);
+
+/*
+ *	Function to get an FMC timing profile
+ *
+ * Parameters:
+ *  index index of the profile
+ *
+ * Returns:
+ *  pointer to the profile
+ *  NULL if there is no such profile
+ */
+const fmc_profile_t *fmc_get_profile(uint8_t index);
+
+/*
+ *	Function to get the index of the FMC timing profile in use
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  index of the profile
+ */
+uint8_t fmc_get_active_profile(void);
+
+/*
+ *	Function to switch the SDRAM to another timing profile while it runs. Nothing may access the
+ *	SDRAM meanwhile, so no capture or DMA may be running.
+ *
+ * Parameters:
+ *  index index of the profile
+ *
+ * Returns:
+ *  true if the profile was applied
+ *  false if there is no such profile
+ */
+bool fmc_apply_profile(uint8_t index);
 #endif
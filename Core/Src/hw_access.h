@@ -0,0 +1,36 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    hw_access.h
+ * @brief   This file is included by the acquisition drivers (timers, DMA streams, button) and the
+ * 			console uart in place of the device header. On the board it is only the device header.
+ * 			The host build points the peripherals those drivers use at the simulated ones of
+ * 			Host/stubs/periph_sim.c, so the same drivers run there unchanged.
+ *
+ * 			HW_WAIT() goes in the loops that wait for the acquisition hardware. It does nothing on
+ * 			the board, on the host it lets the simulated time go on.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+#ifndef SRC_HW_ACCESS_H_
+#define SRC_HW_ACCESS_H_
+
+#include "stm32f429xx.h"
+
+#ifdef HOST_BUILD
+#include "periph_sim.h"
+#else
+#define HW_WAIT()
+#endif
+
+#endif /* SRC_HW_ACCESS_H_ */
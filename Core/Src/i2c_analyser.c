@@ -30,11 +30,13 @@
 #include "i2c_analyser.h"
 #include "stdint.h"
 #include "stdio.h"
+#include "perf.h"
 
 
 #ifdef TESTING
-static uint8_t buffer[] = {0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 1, 1, 1, 1, 1, 3, 3, 3, 3, 1, 3, 3, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 1, 3, 1, 1, 1, 1, 1, 1, 1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1, 3, 3, 1, 1, 1, 1, 1, 1, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1, 3, 1, 1, 1, 1, 1, 1, 1, 3, 3, 1, 1, 1, 1, 1, 1, 1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 3, 3, 1, 1, 1, 1, 1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1, 3, 3, 1, 1, 1, 1, 1, 1, 1, 0, 2, 0, 0, 0, 0, 0, 0, 1, 3, 3, 1, 1, 1, 1, 1, 1, 1, 0, 2, 2, 0, 0, 0, 0, 0, 0, 0, 1, 3, 1, 1, 1, 1, 1, 1, 0, 2, 2, 0, 0, 0, 0, 0, 1, 3, 3, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 0, 1, 1, 0, 0, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3};
-uint16_t buf_len = sizeof(buffer)/sizeof(buffer[0]);
+#include "wavegen.h"
+#define TEST_SAMPLES 4096
+static uint8_t buffer[TEST_SAMPLES];	//filled with generated transfers by test_analyser
 #endif
 
 /*
@@ -158,11 +160,6 @@ uint8_t is_positive_edge(uint8_t previous_sample, uint8_t current_sample, uint8_
 	}
 }
 
-typedef struct{
-	uint16_t accumulator;
-	uint8_t length;
-}accumulator_type_t;
-
 /*
  * Function to clear data present in the accumulator structure
  *
@@ -236,57 +233,86 @@ void print_processed_data(uint16_t data){
 }
 
 /*
- * Function to run i2c analyzer task, on a given buffer with given scl and sda bit positions
+ * Function to prepare an analyser context for decoding a capture block by block
  *
  * Parameters:
- *  buffer pointer to byte array containing samples
- *  buf_len length of byte array containing samples
+ *  ctx pointer to analyser context
  *  scl_pos position of scl signal in sample
  *  sda_pos position of sda signal in sample
  *
  * Returns:
  *  none
  */
-void run_analyser(uint8_t buffer[],uint32_t buf_len,uint8_t scl_pos,uint8_t sda_pos){
-	uint8_t previous_sample = 0;
+void i2c_analyser_init(i2c_analyser_t *ctx, uint8_t scl_pos, uint8_t sda_pos){
+	ctx->scl_pos = scl_pos;
+	ctx->sda_pos = sda_pos;
+	ctx->primed = 0;
+	ctx->previous_sample = 0;
+	ctx->event_has_start_occured = 0;
+	ctx->i2c_transaction_byte_number = 0;
+	clear_accumulator(&ctx->accumulator);
+	ctx->position = 0;
+}
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, transactions which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void i2c_analyser_process(i2c_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len){
+	uint8_t scl_pos = ctx->scl_pos;
+	uint8_t sda_pos = ctx->sda_pos;
+	uint8_t previous_sample = ctx->previous_sample;
 	uint8_t current_sample = 0;
+	uint8_t event_have_bits_accumulated = 0;
+	uint32_t i = 0;
 
-	uint8_t event_has_start_occured = 0, event_have_bits_accumulated = 0;
-	uint16_t i2c_transaction_byte_number = 0;
-	accumulator_type_t accumulator ={
-										.accumulator = 0,
-										.length = 0
-									};
+	if(buf_len == 0){
+		return;
+	}
+	if(!ctx->primed){//the very first sample of a capture has no previous sample to compare against
+		previous_sample = buffer[0];
+		ctx->primed = 1;
+		i = 1;
+	}
 
-	for(int i = 1; i < buf_len;i++){
-		previous_sample = buffer[i-1];
+	PERF_BEGIN(PERF_I2C_DECODE);
+	for(; i < buf_len;i++){
 		current_sample = buffer[i];
 		if(is_start_condition(previous_sample, current_sample, scl_pos, sda_pos)){
-			if(event_has_start_occured == 0){
-				printf("START DETECTED AT %d\r\n",i);//if start has occurred for the first time or
+			if(ctx->event_has_start_occured == 0){
+				printf("START DETECTED AT %lu\r\n",(unsigned long)(ctx->position + i));//if start has occurred for the first time or
 													 //for the first time after stop
-				event_has_start_occured = 1;
+				ctx->event_has_start_occured = 1;
 			}else{
-				printf("REPEATED START DETECTED AT %d\r\n",i);//if start has occurred again without a stop
+				printf("REPEATED START DETECTED AT %lu\r\n",(unsigned long)(ctx->position + i));//if start has occurred again without a stop
 															  //condition
-				i2c_transaction_byte_number = 0;//clear are variables so that they dont
+				ctx->i2c_transaction_byte_number = 0;//clear are variables so that they dont
 												//interfere with next calculation
-				clear_accumulator(&accumulator);
+				clear_accumulator(&ctx->accumulator);
+				previous_sample = current_sample;
 				continue;
 			}
 
 		}
 		if(is_stop_condition(previous_sample, current_sample, scl_pos, sda_pos)){
-			printf("STOP DETECTED AT %d\r\n",i);//if stop is detected, clear are variables so that they dont
+			printf("STOP DETECTED AT %lu\r\n",(unsigned long)(ctx->position + i));//if stop is detected, clear are variables so that they dont
 												//interfere with next calculation
-			event_has_start_occured = 0;
-			i2c_transaction_byte_number = 0;
-			clear_accumulator(&accumulator);
+			ctx->event_has_start_occured = 0;
+			ctx->i2c_transaction_byte_number = 0;
+			clear_accumulator(&ctx->accumulator);
 		}
 
-		if(event_has_start_occured){//if start has occured, sample SDA on every positive edge of the SCL line
+		if(ctx->event_has_start_occured){//if start has occured, sample SDA on every positive edge of the SCL line
 			if(is_positive_edge(previous_sample, current_sample, scl_pos)){
-				if(accumulate(&accumulator, 9, is_bit_set(current_sample, sda_pos)) == 1){
+				if(accumulate(&ctx->accumulator, 9, is_bit_set(current_sample, sda_pos)) == 1){
 					event_have_bits_accumulated = 1;//accumulate 9 bits before processing them
 													//in case of address: 7 bit address + 1 bit RW + 1 bit ACK/NACK
 													//in case of data: 8 bit data + 1 bit ACK/NACK
@@ -295,22 +321,46 @@ void run_analyser(uint8_t buffer[],uint32_t buf_len,uint8_t scl_pos,uint8_t sda_
 
 			if(event_have_bits_accumulated){//if bits have been accumulated, process them and print the result
 				event_have_bits_accumulated = 0;
-				if(i2c_transaction_byte_number == 0){//if it is the first byte after start or restart, process it as address,
+				if(ctx->i2c_transaction_byte_number == 0){//if it is the first byte after start or restart, process it as address,
 													 //else process it as data
-					print_processed_addr(accumulator.accumulator);
+					print_processed_addr(ctx->accumulator.accumulator);
 				}else{
-					print_processed_data(accumulator.accumulator);
+					print_processed_data(ctx->accumulator.accumulator);
 				}
-				clear_accumulator(&accumulator);
-				i2c_transaction_byte_number++;
+				clear_accumulator(&ctx->accumulator);
+				ctx->i2c_transaction_byte_number++;
 			}
 
 		}
+		previous_sample = current_sample;
 	}
+	PERF_END(PERF_I2C_DECODE);
+
+	ctx->previous_sample = previous_sample;
+	ctx->position += buf_len;
+}
+
+/*
+ * Function to run i2c analyzer task, on a given buffer with given scl and sda bit positions
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  scl_pos position of scl signal in sample
+ *  sda_pos position of sda signal in sample
+ *
+ * Returns:
+ *  none
+ */
+void run_analyser(uint8_t buffer[],uint32_t buf_len,uint8_t scl_pos,uint8_t sda_pos){
+	i2c_analyser_t ctx;
+
+	i2c_analyser_init(&ctx, scl_pos, sda_pos);
+	i2c_analyser_process(&ctx, buffer, buf_len);
 }
 
 /*
- *	Function to the run the analyzer on a sample array.
+ *	Function to run the analyzer on a few I2C transfers made by wavegen.c, SCL on P1 and SDA on P0.
  *	To run the function, uncomment:
  *	#define TESTING
  *
@@ -322,7 +372,14 @@ void run_analyser(uint8_t buffer[],uint32_t buf_len,uint8_t scl_pos,uint8_t sda_
  */
 #ifdef TESTING
 void test_analyser(){
-	run_analyser(buffer,buf_len,1,0);
+	wavegen_config_t config;
+	wavegen_stats_t stats;
+
+	wavegen_default_config(&config, WAVEGEN_I2C, 1000000);
+	config.pins[0] = 1;//SCL
+	config.pins[1] = 0;//SDA
+	wavegen_generate(&config, buffer, sizeof(buffer), NULL, 0, &stats);
+	run_analyser(buffer,sizeof(buffer),1,0);
 }
 #endif
 
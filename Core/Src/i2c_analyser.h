@@ -31,6 +31,49 @@
 #define __I2C_ANALYSER_H__
 #include "stdint.h"
 
+typedef struct{
+	uint16_t accumulator;
+	uint8_t length;
+}accumulator_type_t;
+
+typedef struct{
+	uint8_t scl_pos;
+	uint8_t sda_pos;
+	uint8_t primed;				//set once the first sample has been seen
+	uint8_t previous_sample;
+	uint8_t event_has_start_occured;
+	uint16_t i2c_transaction_byte_number;
+	accumulator_type_t accumulator;
+	uint32_t position;			//sample index of the start of the next block
+}i2c_analyser_t;
+
+/*
+ * Function to prepare an analyser context for decoding a capture block by block
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  scl_pos position of scl signal in sample
+ *  sda_pos position of sda signal in sample
+ *
+ * Returns:
+ *  none
+ */
+void i2c_analyser_init(i2c_analyser_t *ctx, uint8_t scl_pos, uint8_t sda_pos);
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, transactions which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void i2c_analyser_process(i2c_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len);
+
 /*
  * Function to run i2c analyzer task, on a given buffer with given scl and sda bit positions
  *
@@ -46,7 +89,7 @@
 void run_analyser(uint8_t buffer[],uint32_t buf_len,uint8_t scl_pos,uint8_t sda_pos);
 
 /*
- *	Function to the run the analyzer on a sample array.
+ *	Function to run the analyzer on a few I2C transfers made by wavegen.c, SCL on P1 and SDA on P0.
  *	To run the function, uncomment:
  *	#define TESTING
  *
@@ -20,12 +20,16 @@
  *
  *
  */
-#include "stm32f429xx.h"
+#include "hw_access.h"
 #include "input_capture_dma.h"
 #include "stdlib.h"
 #include "systick.h"
 #include "state_mode.h"
 #include "string.h"
+#include "fmc.h"
+#include "perf.h"
+#include "capture_health.h"
+#include "spi.h"
 
 static uint16_t _count = 0;
 static uint8_t _mode;
@@ -33,8 +37,8 @@ static uint8_t _mode;
 uint8_t array_1[SIZE_32KB] = { 0 };
 uint8_t array_2[SIZE_32KB] = { 0 };
 
-#define SDRAM_BANK_ADDR_TEST ((uint8_t*)0xD0000000)
-#define SDRAM_BANK_ADDR_TEST_DMA ((uint8_t*)0xD0008000)
+#define SDRAM_BANK_ADDR_TEST (get_capture_address())
+#define SDRAM_BANK_ADDR_TEST_DMA (get_capture_address() + 2 * SIZE_32KB)	// first 64kb take the pre trigger buffers
 #define SDRAM_SIZE_TEST 0x800000
 #define GPIOC_UPPER_8_BITS_ADDR 0x40020811
 #define BUTTON_MODE_COUNT_SDRAM 0
@@ -141,6 +145,8 @@ void dma_init_sdram(uint8_t mode, uint16_t count) {
 	DMA2_Stream2->CR |= DMA_SxCR_MINC;
 
 	DMA2_Stream2->CR |= DMA_SxCR_TCIE_Msk;    // TCIE bit enable
+	DMA2_Stream2->CR |= DMA_SxCR_TEIE | DMA_SxCR_DMEIE;	// errors, counted in capture_health.c
+	DMA2_Stream2->FCR |= DMA_SxFCR_FEIE;
 	NVIC_EnableIRQ(DMA2_Stream2_IRQn);
 
 }
@@ -162,6 +168,9 @@ void dma_init_sram(void) {
 	DMA2->LISR = 0;    //clear lisr hisr config
 	DMA2->HISR = 0;
 
+	trigger_flag = false;
+	process_flag = false;
+
 	DMA2_Stream3->PAR = (uint32_t) 0x40020811;       // gpioc->idr upper 8 lines
 	DMA2_Stream3->M0AR = (uint32_t) array_1;
 	DMA2_Stream3->M1AR = (uint32_t) array_2;
@@ -176,36 +185,57 @@ void dma_init_sram(void) {
 	DMA2_Stream3->CR |= DMA_SxCR_MINC;
 
 	DMA2_Stream3->CR |= DMA_SxCR_TCIE_Msk;    // TCIE bit enable
+	DMA2_Stream3->CR |= DMA_SxCR_TEIE | DMA_SxCR_DMEIE;	// errors, counted in capture_health.c
+	DMA2_Stream3->FCR |= DMA_SxFCR_FEIE;
 	NVIC_EnableIRQ(DMA2_Stream3_IRQn);
 
 }
 
 
 /*
- * Description: irq handler for SRAM
+ * Description: irq handler for SRAM. A half the trigger scan has not taken yet is counted as missed
+ * 				when the next one replaces it. A transfer error stops the stream, the trigger is then
+ * 				not found and the capture times out. Between captures the stream moves sd card
+ * 				blocks, its transfer errors are handled by spi.c
  * Parameters:
  * 		None
  * Returns:
  *   		None
  */
 void DMA2_Stream3_IRQHandler() {
+	uint32_t flags;
+
+	if (spi_dma_stream3_irq())
+		return;
+	flags = capture_health_dma_flags(3);
+
+	//the last request of the block was the capture of the clock edge in CCR2
+	PERF_LATENCY(PERF_LATENCY_DMA2_STREAM3, perf_timer_ticks_to_cycles((uint16_t) (TIM8->CNT - TIM8->CCR2), TIM8->PSC));
+	PERF_BEGIN(PERF_DMA2_STREAM3_IRQ);
 	DMA2->LIFCR |= DMA_LIFCR_CTCIF3_Msk;  // clearing the interrupt flags
 	DMA2->LIFCR |= DMA_LIFCR_CHTIF3;
 	NVIC_ClearPendingIRQ(DMA2_Stream3_IRQn); // clearing the PR bit in PR register
 
-	if (trigger_flag == true) {
+	if (!(flags & DMA_LISR_TCIF0)) {
+		//an error only, counted
+	} else if (trigger_flag == true) {
+		capture_health_block_end((uint16_t) (TIM8->CNT - TIM8->CCR2), TIM8->PSC, 0);
 		TIM8->DIER &= ~(TIM_DIER_CC2DE_Msk);
 		disable_dma2_stream_3();
 		enable_dma2_stream_2();
+		capture_health_stream_started((uint16_t) (TIM1->CNT - TIM1->CCR2), TIM1->PSC, 0);
 		process_flag = false;
 	} else {
+		capture_health_block_end((uint16_t) (TIM8->CNT - TIM8->CCR2), TIM8->PSC, 0);
+		if (process_flag == true)
+			capture_health_missed_half();
 		if (DMA2_Stream3->CR & DMA_SxCR_CT_Msk)
 			process_start_addr = array_1;
 		else
 			process_start_addr = array_2;
 		process_flag = true;
 	}
-
+	PERF_END(PERF_DMA2_STREAM3_IRQ);
 }
 
 
@@ -217,14 +247,15 @@ void DMA2_Stream3_IRQHandler() {
  *   		bool flag status
  */
 
-volatile bool get_done_flag() {
+bool get_done_flag() {
 	if (done_flag == true && _mode == TRIG_MODE) {
+		//the stream stopped with CT on the buffer it would have filled next, the older one
 		if (DMA2_Stream3->CR & DMA_SxCR_CT_Msk) {
-			memcpy(SDRAM_BANK_ADDR_TEST, array_1, SIZE_32KB);
-			memcpy(SDRAM_BANK_ADDR_TEST + SIZE_32KB, array_2, SIZE_32KB);
-		} else {
 			memcpy(SDRAM_BANK_ADDR_TEST, array_2, SIZE_32KB);
 			memcpy(SDRAM_BANK_ADDR_TEST + SIZE_32KB, array_1, SIZE_32KB);
+		} else {
+			memcpy(SDRAM_BANK_ADDR_TEST, array_1, SIZE_32KB);
+			memcpy(SDRAM_BANK_ADDR_TEST + SIZE_32KB, array_2, SIZE_32KB);
 		}
 
 	}
@@ -233,6 +264,24 @@ volatile bool get_done_flag() {
 }
 
 
+/*
+ * Description: gives where a sample of the pre trigger buffers ends up in the capture, once the
+ * 				capture is complete and get_done_flag has copied them in front of it
+ * Parameters:
+ * 		volatile uint8_t *sample address of the sample in array_1 or array_2
+ * Returns:
+ *   		uint32_t index of the sample in the capture
+ */
+uint32_t get_pre_trigger_offset(volatile uint8_t *sample) {
+	uint8_t *older = (DMA2_Stream3->CR & DMA_SxCR_CT_Msk) ? array_2 : array_1;
+	uint8_t *newer = (older == array_1) ? array_2 : array_1;
+
+	if (sample >= older && sample < older + SIZE_32KB)
+		return sample - older;
+	return SIZE_32KB + (sample - newer);
+}
+
+
 /*
  * Description: resets the flag
  * Parameters:
@@ -240,33 +289,44 @@ volatile bool get_done_flag() {
  * Returns:
  *   		None
  */
-volatile void reset_done_flag() {
+void reset_done_flag() {
 	done_flag = false;
 }
 
 
 /*
- * Description: irq handler for SDRAM
+ * Description: irq handler for SDRAM. A transfer error has stopped the stream, it ends the capture,
+ * 				which then fails
  * Parameters:
  * 		None
  * Returns:
  *   		None
  */
 void DMA2_Stream2_IRQHandler() {
+	uint32_t flags = capture_health_dma_flags(2);
+
+	PERF_LATENCY(PERF_LATENCY_DMA2_STREAM2, perf_timer_ticks_to_cycles((uint16_t) (TIM1->CNT - TIM1->CCR2), TIM1->PSC));
+	PERF_BEGIN(PERF_DMA2_STREAM2_IRQ);
 	DMA2->LIFCR |= DMA_LIFCR_CTCIF2;     // clearing the interrupt flags
 	DMA2->LIFCR |= DMA_LIFCR_CHTIF2;     // clearing the interrupt flags
 	NVIC_ClearPendingIRQ(DMA2_Stream2_IRQn); // clearing the PR bit in PR register
 
-	if (count_sdram_interrupts == _count) {
+	if (flags & DMA_LISR_TCIF0)
+		capture_health_block_end((uint16_t) (TIM1->CNT - TIM1->CCR2), TIM1->PSC, 0);
+
+	//a FIFO or direct mode error alone leaves the stream going
+	if ((flags & DMA_LISR_TEIF0) || ((flags & DMA_LISR_TCIF0) && count_sdram_interrupts == _count)) {
 		disable_dma2_stream_2();                   // SDRAM IS FULL
 		done_flag = true;
-	} else {
+	} else if (flags & DMA_LISR_TCIF0) {
 		DMA2_Stream2->CR &= ~DMA_SxCR_EN;
 		DMA2_Stream2->M0AR += SIZE_32KB;
 		DMA2_Stream2->NDTR = SIZE_32KB;
 		enable_dma2_stream_2();
+		capture_health_stream_started((uint16_t) (TIM1->CNT - TIM1->CCR2), TIM1->PSC, 0);
 		count_sdram_interrupts++;
 	}
+	PERF_END(PERF_DMA2_STREAM2_IRQ);
 }
 
 
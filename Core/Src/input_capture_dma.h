@@ -36,8 +36,9 @@ volatile uint8_t *get_start_address(void);
 void set_trigger_flag(void);
 void reset_process_flag(void);
 void tim_init_sync(void);
-volatile bool get_done_flag();
-volatile void reset_done_flag();
+bool get_done_flag();
+void reset_done_flag();
+uint32_t get_pre_trigger_offset(volatile uint8_t *sample);
 void reset_count_sdram_interrupts(uint8_t mode);
 void disable_all_timers();
 void enable_tim1();
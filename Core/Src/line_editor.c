@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    line_editor.c
+ * @brief   This file contains the function definitions for the console line editor. The echo goes
+ * 			through the transmit ring buffer of the uart, so feeding a character never waits for
+ * 			the line unless the ring buffer is full.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "line_editor.h"
+#include "stdio.h"
+#include "string.h"
+
+/* Function to empty the line, ready for the next one
+ *
+ * Parameters:
+ * 	editor(in/out) line editor
+ *
+ * Returns:
+ *  none
+ */
+void line_editor_reset(line_editor_t *editor){
+	memset(editor->line, 0, sizeof(editor->line));
+	editor->len = 0;
+}
+
+/* Function to add a received character to the line. Once the line is full only backspace and
+ * carriage return are taken, so the line always ends with the carriage return
+ *
+ * Parameters:
+ * 	editor(in/out) line editor
+ * 	byte(in) received character
+ *
+ * Returns:
+ *  true if the character was a carriage return and the line is complete, ending in '\r'
+ *  false otherwise
+ */
+bool line_editor_feed(line_editor_t *editor, uint8_t byte){
+	if (byte == '\b') {
+		if (editor->len == 0) {
+			return false; //to prevent backspace at the start of the line
+		}
+		printf("\b \b");
+		editor->len--;	//to move back 1 place to erase previous character in the line
+		editor->line[editor->len] = '\0';
+		return false;
+	}
+
+	if (byte == '\r') {//exit on carriage return
+		editor->line[editor->len++] = byte;
+		printf("\r\n");
+		return true;
+	}
+
+	if (editor->len >= LINE_EDITOR_SIZE - 1) {//keep room for the carriage return
+		editor->overflows++;
+		return false;
+	}
+	printf("%c", byte);	//echo user input and save it in the line buffer
+	editor->line[editor->len++] = byte;
+	return false;
+}
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    line_editor.h
+ * @brief   This file contains the function prototypes for the console line editor. It is fed one
+ * 			received character at a time and never waits, so the main loop can poll it between
+ * 			background jobs. Characters are echoed, backspace erases the last one and a carriage
+ * 			return ends the line.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __LINE_EDITOR_H__
+#define __LINE_EDITOR_H__
+
+#include "stdint.h"
+#include "stdbool.h"
+
+#define LINE_EDITOR_SIZE 256
+
+typedef struct{
+	uint8_t line[LINE_EDITOR_SIZE];
+	uint16_t len;
+	uint32_t overflows;		//characters dropped because the line was full
+}line_editor_t;
+
+/* Function to empty the line, ready for the next one
+ *
+ * Parameters:
+ * 	editor(in/out) line editor
+ *
+ * Returns:
+ *  none
+ */
+void line_editor_reset(line_editor_t *editor);
+
+/* Function to add a received character to the line. Once the line is full only backspace and
+ * carriage return are taken, so the line always ends with the carriage return
+ *
+ * Parameters:
+ * 	editor(in/out) line editor
+ * 	byte(in) received character
+ *
+ * Returns:
+ *  true if the character was a carriage return and the line is complete, ending in '\r'
+ *  false otherwise
+ */
+bool line_editor_feed(line_editor_t *editor, uint8_t byte);
+#endif
@@ -13,7 +13,9 @@
  * @brief   main file for LogiProbe Logic Analyzer Project. Completed for ECEN5613:
  * 			Embedded System Design final project.
  *
- * 			This file initializes all the peripherals and then runs the command processor.
+ * 			This file initializes all the peripherals and then runs the command processor. The SDRAM
+ * 			is cleared in the background and the SD card is only mounted by the first file operation,
+ * 			so the console is up right after reset. How long each step took is printed at boot.
  *
  * @author  Krish Shah and Pranjal Gupta
  * @date    December 17 2023
@@ -35,21 +37,80 @@
 #include "cmd_processor.h"
 #include "spi.h"
 
+#define BOOT_STEPS 6
+
+typedef struct{
+	const char *name;
+	uint32_t cycles;
+}boot_step_t;
+
+static boot_step_t boot_steps[BOOT_STEPS];
+static uint8_t boot_step_count = 0;
+static uint32_t boot_mark = 0;
+
+/*
+ * Description: records how many cycles a boot step took since the previous one
+ * Parameters:
+ * 		const char *name name of the step
+ * Returns:
+ *   		None
+ */
+static void boot_step(const char *name){
+	uint32_t cycles = get_cycles();
+
+	if(boot_step_count < BOOT_STEPS){
+		boot_steps[boot_step_count].name = name;
+		boot_steps[boot_step_count].cycles = cycles - boot_mark;
+		boot_step_count++;
+	}
+	boot_mark = cycles;
+}
+
+/*
+ * Description: prints the time each boot step took. The first step runs on the 16MHz HSI until
+ * 				init_clocks switches to the PLL, so it is converted at that frequency
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+static void print_boot_times(void){
+	uint32_t total_us = 0;
+
+	printf("\r\nBoot times:\r\n");
+	for(uint8_t i = 0; i < boot_step_count; i++){
+		uint32_t freq_mhz = (i == 0 ? PLL_HSI_FREQ : get_sysclk_freq()) / 1000000;
+		uint32_t us = boot_steps[i].cycles / freq_mhz;
+		printf("  %-8s %6lu us\r\n", boot_steps[i].name, us);
+		total_us += us;
+	}
+	printf("  %-8s %6lu us\r\n", "total", total_us);
+}
+
 int main(void)
 {
 
+  init_cycle_counter();
   init_clocks();
+  boot_step("clocks");
   init_uart();
   init_systick();
+  boot_step("uart");
+  init_sdram();//only starts the clear of the memory
+  boot_step("sdram");
   spi_init();
   spi_gpio_pin_init();
-  MX_FATFS_Init();
-  init_sdram();
+  spi_dma_init();
+  boot_step("spi");
+  MX_FATFS_Init();//links the driver, the card is mounted by the first save or load
+  boot_step("fatfs");
+  print_boot_times();
 
   /* Infinite loop */
   while (1)
   {
 	  run_command_processor();
+	  user_fatfs_save_poll();	//a background save goes on while the console waits for input
   }
 
 }
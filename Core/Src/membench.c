@@ -0,0 +1,288 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    membench.c
+ * @brief   Code for the SDRAM benchmark. It measures the bandwidth of sequential and random
+ * 			accesses by the CPU and of sequential transfers by DMA2, at 8, 16 and 32 bit widths, and
+ * 			checks that a pattern written to SDRAM reads back intact, so FMC timing profiles can be
+ * 			compared. The cycles are counted with the DWT cycle counter.
+ *
+ * 			The random tests draw each address from a linear congruential generator, which costs a
+ * 			few cycles per access that are counted too.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "membench.h"
+#include "stm32f429xx.h"
+#include "stdbool.h"
+#include "systick.h"
+#include "fmc.h"
+
+#define MEMBENCH_DMA_CHUNK 0x8000	//items per DMA transfer, NDTR is 16 bits
+#define MEMBENCH_LCG_MUL 1664525
+#define MEMBENCH_LCG_ADD 1013904223
+#define MEMBENCH_SEED 0x2545F491
+
+static const uint8_t widths[MEMBENCH_WIDTHS] = {1, 2, 4};
+static volatile uint32_t sink;		//reads are summed into it so they are not optimised away
+static volatile uint32_t dma_word;	//fixed end of the DMA transfers
+
+/*
+ *	Function to get the next value of a xorshift generator, for the check pattern
+ *
+ * Parameters:
+ *  state generator state, not zero
+ *
+ * Returns:
+ *  next value
+ */
+static uint32_t xorshift(uint32_t *state){
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+/*
+ *	Function to check that SDRAM holds what is written to it. A pseudo random pattern is written in
+ *	words and read back, then its inverse is written in bytes and read back in words, so the byte
+ *	lane selection is checked too.
+ *
+ * Parameters:
+ *  area start of the area to check, word aligned
+ *  len length of the area in bytes, a multiple of 4
+ *
+ * Returns:
+ *  number of words that did not read back as written
+ */
+uint32_t membench_check(uint8_t *area, uint32_t len){
+	volatile uint32_t *words = (volatile uint32_t*)area;
+	volatile uint8_t *bytes = area;
+	uint32_t count = len / sizeof(uint32_t);
+	uint32_t errors = 0, state;
+
+	state = MEMBENCH_SEED;
+	for(uint32_t i = 0; i < count; i++){
+		words[i] = xorshift(&state);
+	}
+	state = MEMBENCH_SEED;
+	for(uint32_t i = 0; i < count; i++){
+		if(words[i] != xorshift(&state)){
+			errors++;
+		}
+	}
+
+	state = MEMBENCH_SEED;
+	for(uint32_t i = 0; i < count; i++){
+		uint32_t value = ~xorshift(&state);
+		for(uint8_t b = 0; b < sizeof(uint32_t); b++){
+			bytes[i * sizeof(uint32_t) + b] = (uint8_t)(value >> (8 * b));
+		}
+	}
+	state = MEMBENCH_SEED;
+	for(uint32_t i = 0; i < count; i++){
+		if(words[i] != ~xorshift(&state)){
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+/*
+ *	Function to time sequential CPU writes or reads over the area
+ *
+ * Parameters:
+ *  area start of the area
+ *  len length of the area in bytes
+ *  width access width in bytes, 1, 2 or 4
+ *  write true to write, false to read
+ *
+ * Returns:
+ *  cycles taken
+ */
+static uint32_t cpu_sequential(uint8_t *area, uint32_t len, uint8_t width, bool write){
+	uint32_t count = len / width, sum = 0;
+	uint32_t start = get_cycles();
+
+	switch(width){
+	case 1:{
+		volatile uint8_t *p = area;
+		if(write){
+			for(uint32_t i = 0; i < count; i++) p[i] = i;
+		}else{
+			for(uint32_t i = 0; i < count; i++) sum += p[i];
+		}
+		break;
+	}
+	case 2:{
+		volatile uint16_t *p = (volatile uint16_t*)area;
+		if(write){
+			for(uint32_t i = 0; i < count; i++) p[i] = i;
+		}else{
+			for(uint32_t i = 0; i < count; i++) sum += p[i];
+		}
+		break;
+	}
+	default:{
+		volatile uint32_t *p = (volatile uint32_t*)area;
+		if(write){
+			for(uint32_t i = 0; i < count; i++) p[i] = i;
+		}else{
+			for(uint32_t i = 0; i < count; i++) sum += p[i];
+		}
+		break;
+	}
+	}
+
+	uint32_t cycles = get_cycles() - start;
+	sink = sum;
+	return cycles;
+}
+
+/*
+ *	Function to time CPU writes or reads at random places of the area, as many as the sequential
+ *	test makes
+ *
+ * Parameters:
+ *  area start of the area
+ *  len length of the area in bytes, a power of two
+ *  width access width in bytes, 1, 2 or 4
+ *  write true to write, false to read
+ *
+ * Returns:
+ *  cycles taken
+ */
+static uint32_t cpu_random(uint8_t *area, uint32_t len, uint8_t width, bool write){
+	uint32_t count = len / width, sum = 0, x = MEMBENCH_SEED;
+	uint8_t shift = 32;
+
+	for(uint32_t n = count; n > 1; n >>= 1){
+		shift--;//the top bits of the generator are the most random, take log2(count) of them
+	}
+
+	uint32_t start = get_cycles();
+	switch(width){
+	case 1:{
+		volatile uint8_t *p = area;
+		for(uint32_t i = 0; i < count; i++){
+			x = x * MEMBENCH_LCG_MUL + MEMBENCH_LCG_ADD;
+			if(write) p[x >> shift] = i; else sum += p[x >> shift];
+		}
+		break;
+	}
+	case 2:{
+		volatile uint16_t *p = (volatile uint16_t*)area;
+		for(uint32_t i = 0; i < count; i++){
+			x = x * MEMBENCH_LCG_MUL + MEMBENCH_LCG_ADD;
+			if(write) p[x >> shift] = i; else sum += p[x >> shift];
+		}
+		break;
+	}
+	default:{
+		volatile uint32_t *p = (volatile uint32_t*)area;
+		for(uint32_t i = 0; i < count; i++){
+			x = x * MEMBENCH_LCG_MUL + MEMBENCH_LCG_ADD;
+			if(write) p[x >> shift] = i; else sum += p[x >> shift];
+		}
+		break;
+	}
+	}
+
+	uint32_t cycles = get_cycles() - start;
+	sink = sum;
+	return cycles;
+}
+
+/*
+ *	Function to time a memory to memory DMA transfer between the area and a single word in SRAM.
+ *	The side in SDRAM is read or written in bursts of 4 items.
+ *
+ * Parameters:
+ *  area start of the area
+ *  len length of the area in bytes
+ *  width item width in bytes, 1, 2 or 4
+ *  write true to write the area, false to read it
+ *
+ * Returns:
+ *  cycles taken
+ *  0 if the transfer failed
+ */
+static uint32_t dma_sequential(uint8_t *area, uint32_t len, uint8_t width, bool write){
+	uint32_t size = (width >> 1);//00 byte, 01 half word, 10 word
+	uint32_t cr = DMA_SxCR_DIR_1 | (size << DMA_SxCR_PSIZE_Pos) | (size << DMA_SxCR_MSIZE_Pos);
+	uint32_t chunk = MEMBENCH_DMA_CHUNK * width;
+
+	if(write){
+		cr |= DMA_SxCR_MINC | DMA_SxCR_MBURST_0;
+	}else{
+		cr |= DMA_SxCR_PINC | DMA_SxCR_PBURST_0;
+	}
+
+	SDRAM_CLEAR_STREAM->CR = 0;
+	while(SDRAM_CLEAR_STREAM->CR & DMA_SxCR_EN);
+	SDRAM_CLEAR_STREAM->FCR = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_0 | DMA_SxFCR_FTH_1;
+
+	uint32_t start = get_cycles();
+	for(uint32_t done = 0; done < len; done += chunk){
+		DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+		//memory to memory copies from the peripheral port to the memory port
+		SDRAM_CLEAR_STREAM->PAR = write ? (uint32_t)&dma_word : (uint32_t)(area + done);
+		SDRAM_CLEAR_STREAM->M0AR = write ? (uint32_t)(area + done) : (uint32_t)&dma_word;
+		SDRAM_CLEAR_STREAM->NDTR = MEMBENCH_DMA_CHUNK;
+		SDRAM_CLEAR_STREAM->CR = cr | DMA_SxCR_EN;
+		while(!(DMA2->HISR & (DMA_HISR_TCIF7 | DMA_HISR_TEIF7)));
+		if(DMA2->HISR & DMA_HISR_TEIF7){
+			SDRAM_CLEAR_STREAM->CR = 0;
+			return 0;
+		}
+	}
+	uint32_t cycles = get_cycles() - start;
+
+	DMA2->HIFCR = DMA_HIFCR_CTCIF7;
+	return cycles;
+}
+
+/*
+ *	Function to run all the tests over an area of SDRAM, which is overwritten. The DMA tests use the
+ *	stream of the boot clear, so they wait for it to end.
+ *
+ * Parameters:
+ *  area start of the area, word aligned
+ *  len length of the area in bytes, a power of two of at least 128KB
+ *  results MEMBENCH_TESTS results to fill
+ *
+ * Returns:
+ *  none
+ */
+void membench_run(uint8_t *area, uint32_t len, membench_result_t results[MEMBENCH_TESTS]){
+	results[0].name = "cpu seq write";
+	results[1].name = "cpu seq read";
+	results[2].name = "cpu rand write";
+	results[3].name = "cpu rand read";
+	results[4].name = "dma seq write";
+	results[5].name = "dma seq read";
+
+	sdram_clear_wait(SDRAM_BANK_ADDR + SDRAM_SIZE);
+
+	for(uint8_t w = 0; w < MEMBENCH_WIDTHS; w++){
+		results[0].cycles[w] = cpu_sequential(area, len, widths[w], true);
+		results[1].cycles[w] = cpu_sequential(area, len, widths[w], false);
+		results[2].cycles[w] = cpu_random(area, len, widths[w], true);
+		results[3].cycles[w] = cpu_random(area, len, widths[w], false);
+		results[4].cycles[w] = dma_sequential(area, len, widths[w], true);
+		results[5].cycles[w] = dma_sequential(area, len, widths[w], false);
+	}
+}
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    membench.h
+ * @brief   Header file for the SDRAM benchmark. It measures the bandwidth of sequential and random
+ * 			accesses by the CPU and of sequential transfers by DMA2, at 8, 16 and 32 bit widths, and
+ * 			checks that a pattern written to SDRAM reads back intact, so FMC timing profiles can be
+ * 			compared. The cycles are counted with the DWT cycle counter.
+ *
+ * 			The random tests draw each address from a linear congruential generator, which costs a
+ * 			few cycles per access that are counted too.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __MEMBENCH_H__
+#define __MEMBENCH_H__
+#include "stdint.h"
+
+#define MEMBENCH_WIDTHS 3		//8, 16 and 32 bit accesses
+#define MEMBENCH_TESTS 6
+
+typedef struct{
+	const char *name;
+	uint32_t cycles[MEMBENCH_WIDTHS];	//cycles taken at each width, for the same number of bytes
+}membench_result_t;
+
+/*
+ *	Function to check that SDRAM holds what is written to it. A pseudo random pattern is written in
+ *	words and read back, then its inverse is written in bytes and read back in words, so the byte
+ *	lane selection is checked too.
+ *
+ * Parameters:
+ *  area start of the area to check, word aligned
+ *  len length of the area in bytes, a multiple of 4
+ *
+ * Returns:
+ *  number of words that did not read back as written
+ */
+uint32_t membench_check(uint8_t *area, uint32_t len);
+
+/*
+ *	Function to run all the tests over an area of SDRAM, which is overwritten. The DMA tests use the
+ *	stream of the boot clear, so they wait for it to end.
+ *
+ * Parameters:
+ *  area start of the area, word aligned
+ *  len length of the area in bytes, a power of two of at least 128KB
+ *  results MEMBENCH_TESTS results to fill
+ *
+ * Returns:
+ *  none
+ */
+void membench_run(uint8_t *area, uint32_t len, membench_result_t results[MEMBENCH_TESTS]);
+
+#endif
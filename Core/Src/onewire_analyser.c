@@ -0,0 +1,432 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    onewire_analyser.c
+ * @brief   1-Wire (Dallas/Maxim) interpreter. It goes over a given buffer, where data is 8bit format
+ * 			and one pin is selected as the 1-Wire bus by calling code.
+ *
+ * 			The bus only carries low pulses driven by the master or a slave, so the decoder works on
+ * 			the width of each low pulse:
+ * 			>= 480us 		RESET
+ * 			60us..240us		PRESENCE, if it starts within 60us of the end of a reset
+ * 			< 15us			1 bit (write 1 slot, or read slot where the slave released the bus)
+ * 			15us..120us		0 bit (write 0 slot, or read slot where the slave held the bus low)
+ *
+ * 			Read and write slots look the same on the wire, so the bits are assembled according to the
+ * 			ROM command which was sent after the reset.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "onewire_analyser.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "string.h"
+#include "perf.h"
+
+//standard speed timings in us, with margin for slow slaves and sampling error
+#define ONEWIRE_BIT_ONE_MAX_US 		15
+#define ONEWIRE_SLOT_MAX_US 		150
+#define ONEWIRE_RESET_MIN_US 		400
+#define ONEWIRE_PRESENCE_WAIT_MAX_US 80
+#define ONEWIRE_PRESENCE_MAX_US 	300
+#define ONEWIRE_MIN_BIT_ONE_SAMPLES 3	//a 1 bit must span a few samples to be told apart from a 0 bit
+
+#define ONEWIRE_ROM_BITS 			64
+#define ONEWIRE_SEARCH_SLOTS 		(3*ONEWIRE_ROM_BITS)
+
+/*
+ * Function to convert a time in us into a number of samples at the given sample rate
+ *
+ * Parameters:
+ *  us time in microseconds
+ *  sample_rate sampling frequency in Hz
+ *
+ * Returns:
+ *  number of samples, rounded to the nearest sample
+ */
+static uint32_t us_to_samples(uint32_t us, uint32_t sample_rate){
+	return (uint32_t)(((uint64_t)us * sample_rate + 500000) / 1000000);
+}
+
+/*
+ * Function to compute the Dallas/Maxim CRC8 (polynomial x^8 + x^5 + x^4 + 1) of a byte array
+ *
+ * Parameters:
+ *  data pointer to byte array
+ *  len number of bytes
+ *
+ * Returns:
+ *  crc of the array, 0 if the array ends with its own valid crc
+ */
+uint8_t onewire_crc8(const uint8_t data[], uint32_t len){
+	uint8_t crc = 0;
+	for(uint32_t i = 0; i < len; i++){
+		uint8_t byte = data[i];
+		for(int bit = 0; bit < 8; bit++){
+			uint8_t mix = (crc ^ byte) & 0x01;
+			crc >>= 1;
+			if(mix){
+				crc ^= 0x8C;//reflected form of the polynomial
+			}
+			byte >>= 1;
+		}
+	}
+	return crc;
+}
+
+/*
+ * Function to print the name of a ROM command
+ *
+ * Parameters:
+ *  command the rom command byte
+ *
+ * Returns:
+ *  pointer to the name of the command
+ */
+static const char *rom_command_name(uint8_t command){
+	switch(command){
+	case ONEWIRE_CMD_READ_ROM:
+		return "READ ROM";
+	case ONEWIRE_CMD_MATCH_ROM:
+		return "MATCH ROM";
+	case ONEWIRE_CMD_SKIP_ROM:
+		return "SKIP ROM";
+	case ONEWIRE_CMD_SEARCH_ROM:
+		return "SEARCH ROM";
+	case ONEWIRE_CMD_ALARM_SEARCH:
+		return "ALARM SEARCH";
+	case ONEWIRE_CMD_RESUME:
+		return "RESUME";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+/*
+ * Function to print a decoded event in a clear format. It is used when the calling code
+ * does not provide its own event handler.
+ *
+ * Parameters:
+ *  event pointer to the decoded event
+ *  arg unused
+ *
+ * Returns:
+ *  none
+ */
+static void print_onewire_event(const onewire_event_t *event, void *arg){
+	(void)arg;
+	unsigned long position = (unsigned long)event->position;
+
+	switch(event->type){
+	case ONEWIRE_EVENT_RESET:
+		printf("RESET DETECTED AT %lu\r\n", position);
+		break;
+	case ONEWIRE_EVENT_PRESENCE:
+		printf("PRESENCE DETECTED AT %lu\r\n", position);
+		break;
+	case ONEWIRE_EVENT_NO_PRESENCE:
+		printf("NO PRESENCE AFTER RESET AT %lu\r\n", position);
+		break;
+	case ONEWIRE_EVENT_ROM_COMMAND:
+		printf("ROM COMMAND: %x (%s)\r\n", (unsigned int)event->value, rom_command_name(event->value));
+		break;
+	case ONEWIRE_EVENT_ROM_ID:
+		printf("ROM ID:   FAMILY %x SERIAL %04lx%08lx CRC %x %s\r\n",
+				(unsigned int)(event->value & 0xFF),
+				(unsigned long)((event->value >> 40) & 0xFFFF),
+				(unsigned long)((event->value >> 8) & 0xFFFFFFFF),
+				(unsigned int)(event->value >> 56),
+				event->crc_ok ? "OK" : "ERROR");
+		break;
+	case ONEWIRE_EVENT_FUNCTION_COMMAND:
+		printf("FUNCTION: %x\r\n", (unsigned int)event->value);
+		break;
+	case ONEWIRE_EVENT_DATA:
+		printf("DATA:     %x\r\n", (unsigned int)event->value);
+		break;
+	case ONEWIRE_EVENT_INVALID_SLOT:
+		printf("INVALID SLOT AT %lu\r\n", position);
+		break;
+	}
+}
+
+/*
+ * Function to hand an event over to the event handler
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  type type of the event
+ *  position sample index of the event
+ *  value value carried by the event
+ *  crc_ok result of the crc check for rom ids
+ *
+ * Returns:
+ *  none
+ */
+static void emit_event(onewire_analyser_t *ctx, onewire_event_type_t type, uint64_t position,
+		uint64_t value, bool crc_ok){
+	onewire_event_t event = {
+			.type = type,
+			.position = position,
+			.value = value,
+			.crc_ok = crc_ok
+	};
+	ctx->on_event(&event, ctx->arg);
+}
+
+/*
+ * Function to hand over a complete ROM ID, after checking its CRC
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *
+ * Returns:
+ *  none
+ */
+static void emit_rom_id(onewire_analyser_t *ctx){
+	uint8_t rom[8];
+	for(int i = 0; i < 8; i++){//rom id is sent LSB first, family code first and crc last
+		rom[i] = (uint8_t)(ctx->shift >> (8 * i));
+	}
+	bool crc_ok = (onewire_crc8(rom, sizeof(rom)) == 0);
+	ctx->rom_ids++;
+	if(!crc_ok){
+		ctx->crc_errors++;
+	}
+	emit_event(ctx, ONEWIRE_EVENT_ROM_ID, ctx->event_start, ctx->shift, crc_ok);
+}
+
+/*
+ * Function to assemble a decoded bit according to the state of the transaction
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  bit value of the slot
+ *
+ * Returns:
+ *  none
+ */
+static void accumulate_bit(onewire_analyser_t *ctx, uint8_t bit){
+	switch(ctx->state){
+	case ONEWIRE_STATE_ROM_COMMAND:
+	case ONEWIRE_STATE_FUNCTION_COMMAND:
+	case ONEWIRE_STATE_DATA:
+		ctx->shift |= (uint64_t)bit << ctx->bit_count;
+		if(++ctx->bit_count < 8){
+			return;
+		}
+		if(ctx->state == ONEWIRE_STATE_ROM_COMMAND){
+			uint8_t command = ctx->shift;
+			emit_event(ctx, ONEWIRE_EVENT_ROM_COMMAND, ctx->event_start, command, true);
+			if(command == ONEWIRE_CMD_READ_ROM || command == ONEWIRE_CMD_MATCH_ROM){
+				ctx->state = ONEWIRE_STATE_ROM_ID;
+			}else if(command == ONEWIRE_CMD_SEARCH_ROM || command == ONEWIRE_CMD_ALARM_SEARCH){
+				ctx->state = ONEWIRE_STATE_SEARCH;
+			}else if(command == ONEWIRE_CMD_SKIP_ROM || command == ONEWIRE_CMD_RESUME){
+				ctx->state = ONEWIRE_STATE_FUNCTION_COMMAND;
+			}else{
+				ctx->state = ONEWIRE_STATE_IDLE;//overdrive or unknown, wait for the next reset
+			}
+		}else if(ctx->state == ONEWIRE_STATE_FUNCTION_COMMAND){
+			emit_event(ctx, ONEWIRE_EVENT_FUNCTION_COMMAND, ctx->event_start, ctx->shift, true);
+			ctx->state = ONEWIRE_STATE_DATA;
+		}else{
+			emit_event(ctx, ONEWIRE_EVENT_DATA, ctx->event_start, ctx->shift, true);
+		}
+		break;
+
+	case ONEWIRE_STATE_ROM_ID:
+		ctx->shift |= (uint64_t)bit << ctx->bit_count;
+		if(++ctx->bit_count < ONEWIRE_ROM_BITS){
+			return;
+		}
+		emit_rom_id(ctx);
+		ctx->state = ONEWIRE_STATE_FUNCTION_COMMAND;
+		break;
+
+	case ONEWIRE_STATE_SEARCH:
+		//each rom bit takes 3 slots, the bit, its complement and the direction chosen by the master
+		if(ctx->bit_count % 3 == 2){
+			ctx->shift |= (uint64_t)bit << (ctx->bit_count / 3);
+		}
+		if(++ctx->bit_count < ONEWIRE_SEARCH_SLOTS){
+			return;
+		}
+		emit_rom_id(ctx);
+		ctx->state = ONEWIRE_STATE_FUNCTION_COMMAND;
+		break;
+
+	default:
+		return;
+	}
+	ctx->shift = 0;
+	ctx->bit_count = 0;
+}
+
+/*
+ * Function to classify a low pulse by its width
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  width width of the low pulse in samples
+ *
+ * Returns:
+ *  none
+ */
+static void classify_pulse(onewire_analyser_t *ctx, uint32_t width){
+	if(width >= ctx->reset_min){
+		ctx->resets++;
+		ctx->state = ONEWIRE_STATE_PRESENCE;
+		emit_event(ctx, ONEWIRE_EVENT_RESET, ctx->low_start, 0, true);
+		return;
+	}
+
+	if(ctx->state == ONEWIRE_STATE_PRESENCE){
+		if(width <= ctx->presence_max && width > ctx->bit_one_max){
+			emit_event(ctx, ONEWIRE_EVENT_PRESENCE, ctx->low_start, 0, true);
+		}else{
+			emit_event(ctx, ONEWIRE_EVENT_INVALID_SLOT, ctx->low_start, width, true);
+		}
+		ctx->state = ONEWIRE_STATE_ROM_COMMAND;
+		ctx->shift = 0;
+		ctx->bit_count = 0;
+		return;
+	}
+
+	if(width > ctx->slot_max){
+		emit_event(ctx, ONEWIRE_EVENT_INVALID_SLOT, ctx->low_start, width, true);
+		ctx->state = ONEWIRE_STATE_IDLE;//lost track of the transaction, wait for the next reset
+		return;
+	}
+
+	accumulate_bit(ctx, (width < ctx->bit_one_max) ? 1 : 0);
+}
+
+/*
+ * Function to prepare an analyser context for decoding a capture block by block
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  pin position of the 1-Wire bus in the sample
+ *  sample_rate sampling frequency in Hz
+ *  on_event function called for each decoded event, NULL prints it
+ *  arg passed to on_event
+ *
+ * Returns:
+ *  true if the sample rate is high enough to tell the slots apart
+ *  false otherwise
+ */
+bool onewire_analyser_init(onewire_analyser_t *ctx, uint8_t pin, uint32_t sample_rate,
+		onewire_event_handler_t on_event, void *arg){
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->pin = pin;
+	ctx->on_event = (on_event != NULL) ? on_event : print_onewire_event;
+	ctx->arg = arg;
+
+	ctx->bit_one_max = us_to_samples(ONEWIRE_BIT_ONE_MAX_US, sample_rate);
+	ctx->slot_max = us_to_samples(ONEWIRE_SLOT_MAX_US, sample_rate);
+	ctx->reset_min = us_to_samples(ONEWIRE_RESET_MIN_US, sample_rate);
+	ctx->presence_wait_max = us_to_samples(ONEWIRE_PRESENCE_WAIT_MAX_US, sample_rate);
+	ctx->presence_max = us_to_samples(ONEWIRE_PRESENCE_MAX_US, sample_rate);
+	ctx->state = ONEWIRE_STATE_IDLE;
+	ctx->last_level = 1;//bus idles high through the pull up
+
+	return (pin <= 7 && ctx->bit_one_max >= ONEWIRE_MIN_BIT_ONE_SAMPLES);
+}
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, pulses which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void onewire_analyser_process(onewire_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len){
+	uint8_t pin = ctx->pin;
+	uint8_t last_level = ctx->last_level;
+	uint32_t i = 0;
+
+	if(buf_len == 0){
+		return;
+	}
+	if(!ctx->primed){//a capture starting in the middle of a low pulse can not be measured
+		last_level = (buffer[0] >> pin) & 1;
+		ctx->low_start = ctx->high_start = 0;
+		ctx->primed = 1;
+	}
+
+	PERF_BEGIN(PERF_ONEWIRE_DECODE);
+	while(i < buf_len){
+		while(i < buf_len && ((buffer[i] >> pin) & 1) == last_level){
+			i++;
+		}
+		if(i == buf_len){
+			break;
+		}
+
+		uint64_t position = ctx->position + i;
+		last_level ^= 1;
+		if(last_level == 0){//falling edge, start of a pulse
+			ctx->low_start = position;
+			if(ctx->state == ONEWIRE_STATE_PRESENCE && position - ctx->high_start > ctx->presence_wait_max){
+				emit_event(ctx, ONEWIRE_EVENT_NO_PRESENCE, ctx->high_start, 0, true);
+				ctx->state = ONEWIRE_STATE_ROM_COMMAND;
+				ctx->shift = 0;
+				ctx->bit_count = 0;
+			}
+			if(ctx->bit_count == 0){
+				ctx->event_start = position;
+			}
+		}else{//rising edge, end of a pulse
+			ctx->high_start = position;
+			classify_pulse(ctx, (uint32_t)(position - ctx->low_start));
+		}
+		i++;
+	}
+	PERF_END(PERF_ONEWIRE_DECODE);
+
+	ctx->last_level = last_level;
+	ctx->position += buf_len;
+}
+
+/*
+ * Function to run 1-Wire analyzer task, on a given buffer with a given bus position
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  pin position of the 1-Wire bus in the sample
+ *  sample_rate sampling frequency in Hz
+ *
+ * Returns:
+ *  true if the analyser ran
+ *  false if the sample rate is unknown or too low
+ */
+bool run_onewire_analyser(const uint8_t buffer[], uint32_t buf_len, uint8_t pin, uint32_t sample_rate){
+	onewire_analyser_t ctx;
+
+	if(!onewire_analyser_init(&ctx, pin, sample_rate, NULL, NULL)){
+		printf("Sample rate too low or unknown, 1-Wire needs at least 200kHz timing mode capture\r\n");
+		return false;
+	}
+	onewire_analyser_process(&ctx, buffer, buf_len);
+	printf("Resets: %lu, ROM IDs: %lu, CRC Errors: %lu\r\n", (unsigned long)ctx.resets,
+			(unsigned long)ctx.rom_ids, (unsigned long)ctx.crc_errors);
+
+	return true;
+}
@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    onewire_analyser.h
+ * @brief   Header file for the 1-Wire (Dallas/Maxim) interpreter. It goes over a given buffer, where data
+ * 			is 8bit format and one pin is selected as the 1-Wire bus by calling code.
+ *
+ * 			Every low pulse on the bus is classified by its width, which is converted from samples to
+ * 			microseconds using the sampling frequency of the capture. Standard speed timings are used.
+ *
+ * 			It can detect:
+ * 			RESET
+ * 			PRESENCE
+ * 			Write/Read slots, as 0 or 1 bits
+ * 			ROM commands (Read, Match, Skip, Search, Alarm Search, Resume)
+ * 			ROM IDs, with family code, serial number and CRC8 check
+ * 			Function command and data bytes that follow the ROM command
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __ONEWIRE_ANALYSER_H__
+#define __ONEWIRE_ANALYSER_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define ONEWIRE_CMD_READ_ROM 		0x33
+#define ONEWIRE_CMD_MATCH_ROM 		0x55
+#define ONEWIRE_CMD_SKIP_ROM 		0xCC
+#define ONEWIRE_CMD_SEARCH_ROM 		0xF0
+#define ONEWIRE_CMD_ALARM_SEARCH 	0xEC
+#define ONEWIRE_CMD_RESUME 			0xA5
+
+typedef enum{
+	ONEWIRE_EVENT_RESET = 0,
+	ONEWIRE_EVENT_PRESENCE,
+	ONEWIRE_EVENT_NO_PRESENCE,
+	ONEWIRE_EVENT_ROM_COMMAND,
+	ONEWIRE_EVENT_ROM_ID,
+	ONEWIRE_EVENT_FUNCTION_COMMAND,
+	ONEWIRE_EVENT_DATA,
+	ONEWIRE_EVENT_INVALID_SLOT
+}onewire_event_type_t;
+
+typedef struct{
+	onewire_event_type_t type;
+	uint64_t position;	//sample index of the falling edge which started the event
+	uint64_t value;		//command, data byte or ROM ID
+	bool crc_ok;		//only used by ONEWIRE_EVENT_ROM_ID
+}onewire_event_t;
+
+typedef void (*onewire_event_handler_t)(const onewire_event_t *event, void *arg);
+
+typedef enum{
+	ONEWIRE_STATE_IDLE = 0,		//waiting for a reset
+	ONEWIRE_STATE_PRESENCE,		//reset seen, waiting for a presence pulse
+	ONEWIRE_STATE_ROM_COMMAND,
+	ONEWIRE_STATE_ROM_ID,		//read or match rom, 64 bits
+	ONEWIRE_STATE_SEARCH,		//search rom, 64 triplets of read, read complement, write
+	ONEWIRE_STATE_FUNCTION_COMMAND,
+	ONEWIRE_STATE_DATA
+}onewire_state_t;
+
+typedef struct{
+	uint8_t pin;
+	onewire_event_handler_t on_event;	//NULL prints each event
+	void *arg;
+
+	//pulse width thresholds in samples, computed from the sample rate
+	uint32_t bit_one_max;
+	uint32_t slot_max;
+	uint32_t reset_min;
+	uint32_t presence_wait_max;
+	uint32_t presence_max;
+
+	onewire_state_t state;
+	uint8_t last_level;
+	uint8_t primed;
+	uint64_t low_start;		//sample index of the last falling edge
+	uint64_t high_start;	//sample index of the last rising edge
+	uint64_t event_start;
+	uint64_t shift;
+	uint16_t bit_count;
+	uint64_t position;
+	uint32_t resets;
+	uint32_t rom_ids;
+	uint32_t crc_errors;
+}onewire_analyser_t;
+
+/*
+ * Function to compute the Dallas/Maxim CRC8 (polynomial x^8 + x^5 + x^4 + 1) of a byte array
+ *
+ * Parameters:
+ *  data pointer to byte array
+ *  len number of bytes
+ *
+ * Returns:
+ *  crc of the array, 0 if the array ends with its own valid crc
+ */
+uint8_t onewire_crc8(const uint8_t data[], uint32_t len);
+
+/*
+ * Function to prepare an analyser context for decoding a capture block by block
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  pin position of the 1-Wire bus in the sample
+ *  sample_rate sampling frequency in Hz
+ *  on_event function called for each decoded event, NULL prints it
+ *  arg passed to on_event
+ *
+ * Returns:
+ *  true if the sample rate is high enough to tell the slots apart
+ *  false otherwise
+ */
+bool onewire_analyser_init(onewire_analyser_t *ctx, uint8_t pin, uint32_t sample_rate,
+		onewire_event_handler_t on_event, void *arg);
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, pulses which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void onewire_analyser_process(onewire_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len);
+
+/*
+ * Function to run 1-Wire analyzer task, on a given buffer with a given bus position
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  pin position of the 1-Wire bus in the sample
+ *  sample_rate sampling frequency in Hz
+ *
+ * Returns:
+ *  true if the analyser ran
+ *  false if the sample rate is unknown or too low
+ */
+bool run_onewire_analyser(const uint8_t buffer[], uint32_t buf_len, uint8_t pin, uint32_t sample_rate);
+
+#endif
@@ -0,0 +1,184 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    perf.c
+ * @brief   Code for the cycle profiling of the hot paths, see perf.h. The counters are updated by
+ * 			handlers and by the main loop without masking interrupts, each section and each
+ * 			histogram is only written from one of them, so they do not race. A section running
+ * 			while perf clears the table may keep part of its old values.
+ *
+ * 			Sections are timed inclusive of everything they call, a decoder printing a frame
+ * 			counts the printf too, and a handler interrupting a section counts in both.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "perf.h"
+#include "pll_clock.h"
+#include "stdio.h"
+#include "string.h"
+
+#ifdef PERF_ENABLED
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+} perf_counter_t;
+
+typedef struct {
+	uint32_t bins[PERF_LATENCY_BINS];
+	uint32_t max;
+} perf_histogram_t;
+
+static const char *section_names[PERF_SECTIONS] = { "dma2 s2 irq", "dma2 s3 irq", "dma2 s5 irq",
+		"trigger scan", "i2c decode", "uart decode", "1wire decode", "can decode", "sd block write",
+		"printf" };
+static const char *latency_names[PERF_LATENCIES] = { "dma2 s2", "dma2 s3", "dma2 s5", "systick" };
+
+static volatile perf_counter_t counters[PERF_SECTIONS];
+static volatile perf_histogram_t histograms[PERF_LATENCIES];
+#endif
+
+/*
+ * Function to add a run of a section to its counters, use PERF_BEGIN and PERF_END instead
+ *
+ * Parameters:
+ *  section section that ran
+ *  cycles cycles it took
+ *
+ * Returns:
+ *  none
+ */
+void perf_record(perf_section_t section, uint32_t cycles){
+#ifdef PERF_ENABLED
+	volatile perf_counter_t *counter = &counters[section];
+
+	if(counter->count == 0 || cycles < counter->min)
+		counter->min = cycles;
+	if(cycles > counter->max)
+		counter->max = cycles;
+	counter->total += cycles;
+	counter->count++;
+#endif
+}
+
+/*
+ * Function to add the entry latency of an interrupt to its histogram, use PERF_LATENCY instead
+ *
+ * Parameters:
+ *  irq interrupt that was taken
+ *  cycles cycles from the event raising it to the first line of its handler
+ *
+ * Returns:
+ *  none
+ */
+void perf_record_latency(perf_latency_t irq, uint32_t cycles){
+#ifdef PERF_ENABLED
+	volatile perf_histogram_t *histogram = &histograms[irq];
+	uint32_t bin = 0;
+
+	if(cycles >= 32)
+		bin = 31 - __builtin_clz(cycles) - 4;//16<<n <= cycles < 32<<n
+	if(bin >= PERF_LATENCY_BINS)
+		bin = PERF_LATENCY_BINS - 1;
+	histogram->bins[bin]++;
+	if(cycles > histogram->max)
+		histogram->max = cycles;
+#endif
+}
+
+/*
+ * Function to turn ticks of an APB2 timer, TIM1 or TIM8, into core cycles. A DMA handler of the
+ * acquisition knows how long ago its event was from the counter of the timer that requested it
+ *
+ * Parameters:
+ *  ticks ticks of the counter since the event
+ *  psc value of the prescaler of the timer
+ *
+ * Returns:
+ *  uint32_t core cycles
+ */
+uint32_t perf_timer_ticks_to_cycles(uint32_t ticks, uint32_t psc){
+	uint32_t sysclk = get_sysclk_freq();
+	uint32_t apb2 = get_apb2_clk_freq();
+	uint32_t timer_clk = (apb2 == sysclk) ? apb2 : 2 * apb2;//timers run at twice a divided APB clock
+
+	return (uint32_t)((uint64_t)ticks * (psc + 1) * sysclk / timer_clk);
+}
+
+/*
+ * Function to print the counters of every section that ran and the latency histograms, then
+ * clear them. Without DEBUG it only prints that the profiling is not built
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void perf_report(void){
+#ifdef PERF_ENABLED
+	uint32_t mhz = get_sysclk_freq() / 1000000;
+	perf_counter_t copy[PERF_SECTIONS];
+
+	//the printf of the table would count in it, so it is taken first
+	for(int i = 0; i < PERF_SECTIONS; i++)
+		copy[i] = counters[i];
+
+	printf("\r\n%-15s %10s %10s %10s %10s %12s\r\n", "Section", "Count", "Min", "Avg", "Max", "Total us");
+	for(int i = 0; i < PERF_SECTIONS; i++){
+		if(copy[i].count == 0)
+			continue;
+		printf("%-15s %10lu %10lu %10lu %10lu %12llu\r\n", section_names[i], (unsigned long) copy[i].count,
+				(unsigned long) copy[i].min, (unsigned long) (copy[i].total / copy[i].count),
+				(unsigned long) copy[i].max, (unsigned long long) (copy[i].total / mhz));
+	}
+	printf("cycles at %lu MHz\r\n", (unsigned long) mhz);
+
+	printf("\r\nInterrupt entry latency, cycles from the event to the handler\r\n%-8s", "");
+	for(int bin = 0; bin < PERF_LATENCY_BINS; bin++){
+		char label[8];
+		if(bin == PERF_LATENCY_BINS - 1)
+			snprintf(label, sizeof(label), ">=%u", 16u << bin);
+		else
+			snprintf(label, sizeof(label), "<%u", 32u << bin);
+		printf(" %7s", label);
+	}
+	printf(" %8s\r\n", "Max");
+	for(int i = 0; i < PERF_LATENCIES; i++){
+		printf("%-8s", latency_names[i]);
+		for(int bin = 0; bin < PERF_LATENCY_BINS; bin++)
+			printf(" %7lu", (unsigned long) histograms[i].bins[bin]);
+		printf(" %8lu\r\n", (unsigned long) histograms[i].max);
+	}
+	perf_reset();
+#else
+	printf("Profiling is not built in, it needs the Debug configuration (DEBUG defined)\r\n");
+#endif
+}
+
+/*
+ * Function to clear the counters and the histograms
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void perf_reset(void){
+#ifdef PERF_ENABLED
+	memset((void *) counters, 0, sizeof(counters));
+	memset((void *) histograms, 0, sizeof(histograms));
+#endif
+}
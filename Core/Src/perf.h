@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    perf.h
+ * @brief   Header file for the cycle profiling of the hot paths. A section between PERF_BEGIN and
+ * 			PERF_END adds its length in DWT cycles to the count, min, max and total of that section,
+ * 			and PERF_LATENCY adds how long an interrupt waited for its handler to a histogram.
+ * 			The perf command prints both tables and clears them.
+ *
+ * 			The profiling is only built in the Debug configuration, which defines DEBUG. Without it
+ * 			the macros are empty, their arguments are not evaluated, and perf only says so.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __PERF_H__
+#define __PERF_H__
+#include "stdint.h"
+#include "systick.h"
+
+#ifdef DEBUG
+#define PERF_ENABLED
+#endif
+
+#define PERF_LATENCY_BINS 12		//bin 0 is below 32 cycles, bin n from 16<<n, the last has the rest
+
+typedef enum {
+	PERF_DMA2_STREAM2_IRQ,			//state mode, SDRAM fill
+	PERF_DMA2_STREAM3_IRQ,			//state mode, pre trigger buffer
+	PERF_DMA2_STREAM5_IRQ,			//timing mode
+	PERF_TRIGGER_SCAN,				//one half of the pre trigger buffer
+	PERF_I2C_DECODE,				//one call of the process function of a decoder
+	PERF_UART_DECODE,
+	PERF_ONEWIRE_DECODE,
+	PERF_CAN_DECODE,
+	PERF_SD_WRITE_BLOCK,			//one 512 byte block to the card
+	PERF_PRINTF,					//one _write, to the ring buffer of the console
+	PERF_SECTIONS
+} perf_section_t;
+
+typedef enum {
+	PERF_LATENCY_DMA2_STREAM2,
+	PERF_LATENCY_DMA2_STREAM3,
+	PERF_LATENCY_DMA2_STREAM5,
+	PERF_LATENCY_SYSTICK,
+	PERF_LATENCIES
+} perf_latency_t;
+
+#ifdef PERF_ENABLED
+#define PERF_BEGIN(section) uint32_t perf_start_##section = get_cycles()
+#define PERF_END(section) perf_record(section, get_cycles() - perf_start_##section)
+#define PERF_LATENCY(irq, cycles) perf_record_latency(irq, cycles)
+#else
+#define PERF_BEGIN(section)
+#define PERF_END(section)
+#define PERF_LATENCY(irq, cycles)
+#endif
+
+/*
+ * Function to add a run of a section to its counters, use PERF_BEGIN and PERF_END instead
+ *
+ * Parameters:
+ *  section section that ran
+ *  cycles cycles it took
+ *
+ * Returns:
+ *  none
+ */
+void perf_record(perf_section_t section, uint32_t cycles);
+
+/*
+ * Function to add the entry latency of an interrupt to its histogram, use PERF_LATENCY instead
+ *
+ * Parameters:
+ *  irq interrupt that was taken
+ *  cycles cycles from the event raising it to the first line of its handler
+ *
+ * Returns:
+ *  none
+ */
+void perf_record_latency(perf_latency_t irq, uint32_t cycles);
+
+/*
+ * Function to turn ticks of an APB2 timer, TIM1 or TIM8, into core cycles. A DMA handler of the
+ * acquisition knows how long ago its event was from the counter of the timer that requested it
+ *
+ * Parameters:
+ *  ticks ticks of the counter since the event
+ *  psc value of the prescaler of the timer
+ *
+ * Returns:
+ *  uint32_t core cycles
+ */
+uint32_t perf_timer_ticks_to_cycles(uint32_t ticks, uint32_t psc);
+
+/*
+ * Function to print the counters of every section that ran and the latency histograms, then
+ * clear them. Without DEBUG it only prints that the profiling is not built
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void perf_report(void);
+
+/*
+ * Function to clear the counters and the histograms
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void perf_reset(void);
+
+#endif
@@ -15,9 +15,10 @@
  * 			and to get the bus freq
  * 			* APB1  = System Clock/ PPRE1 precalar
  * 			* APB2  = System Clock/ PPRE2 precalar
- * 			so system clock freq = 160 Mhz
- * 			APB1 = 40 MHZ
- * 			APB2 = 80 MHZ
+ * 			The values come from the entry of clock_config.h the firmware is built for, by default
+ * 			system clock freq = 180 Mhz from HSE with over-drive
+ * 			APB1 = 45 MHZ
+ * 			APB2 = 90 MHZ
  *
  * @author  Pranjal Gupta
  * @date    12/17/2023
@@ -29,35 +30,157 @@
 
 
 #include "stm32f429xx.h"
+#include "pll_clock.h"
 
+static const uint8_t hpre_shift[8] = {1, 2, 3, 4, 6, 7, 8, 9};	// /2 /4 /8 /16 /64 /128 /256 /512 of HPRE 1000 to 1111
 
+/*
+ * gives the HPRE field of CFGR for an AHB divider, 0xxx is /1 and 1000 to 1111 are /2 to /512
+ * without /32
+ */
+static uint32_t ahb_prescaler_bits(uint16_t div){
+	uint32_t i = 0;
 
+	if(div <= 1){
+		return 0;
+	}
+	while(i < 7 && (1u << hpre_shift[i]) < div){
+		i++;
+	}
+	return 0b1000 + i;
+}
 
 /*
- * Description: Configures the PLL clock to run at 160MHz
+ * gives the PPRE field of CFGR for an APB divider, 0xx is /1 and 100 to 111 are /2 to /16
+ */
+static uint32_t apb_prescaler_bits(uint8_t div){
+	uint32_t bits = 0b100;
+
+	if(div <= 1){
+		return 0;
+	}
+	while(bits < 0b111 && (2u << (bits - 0b100)) < div){
+		bits++;
+	}
+	return bits;
+}
+
+/*
+ * Description: Configures the PLL clock from clock_config_get(). The wait states are set before
+ * 				the clock goes up, and above 168MHz the over-drive is switched on after the PLL locks
+ * 				and before the system clock is switched to it, as the reference manual asks
  * Parameters:
  * 		None
  * Returns:
  *   		None
  */
 void init_clocks(){
-
+			const clock_config_t *config = clock_config_get();
 
 			RCC->CR	&= ~(RCC_CR_PLLON);
 			RCC->CFGR |= (0b11<< RCC_CFGR_MCO1_Pos);
 			RCC->CFGR |= (7<<24);
 			RCC->APB1ENR |= RCC_APB1ENR_PWREN_Msk;
 			PWR->CR |= PWR_CR_VOS_0 | PWR_CR_VOS_1;        // scale 1 mode(voltage scaling output)
-			FLASH->ACR = FLASH_ACR_LATENCY_5WS | FLASH_ACR_DCEN | FLASH_ACR_ICEN | FLASH_ACR_PRFTEN;
-			RCC->PLLCFGR = 0;
-			RCC->PLLCFGR |= (RCC_PLLCFGR_PLLQ_3)|(0b001000<<RCC_PLLCFGR_PLLM_Pos)|(0b10100000<<RCC_PLLCFGR_PLLN_Pos)|(0b00<<RCC_PLLCFGR_PLLP_Pos);
-			RCC->CR |= RCC_CR_HSION;
-			while(!( RCC->CR & RCC_CR_HSIRDY));
-			RCC->CFGR |= (0b101<<RCC_CFGR_PPRE1_Pos)|(0b100<<RCC_CFGR_PPRE2_Pos)|(0b0000<<RCC_CFGR_HPRE_Pos);
+			FLASH->ACR = (clock_config_flash_latency(config) << FLASH_ACR_LATENCY_Pos) | FLASH_ACR_DCEN |
+					FLASH_ACR_ICEN | FLASH_ACR_PRFTEN;
+			if(config->hse){
+				RCC->CR |= RCC_CR_HSEON;
+				while(!( RCC->CR & RCC_CR_HSERDY));
+			}else{
+				RCC->CR |= RCC_CR_HSION;
+				while(!( RCC->CR & RCC_CR_HSIRDY));
+			}
+			RCC->PLLCFGR = (config->hse ? RCC_PLLCFGR_PLLSRC_HSE : RCC_PLLCFGR_PLLSRC_HSI) |
+					((uint32_t)config->pllq << RCC_PLLCFGR_PLLQ_Pos) | ((uint32_t)config->pllm << RCC_PLLCFGR_PLLM_Pos) |
+					((uint32_t)config->plln << RCC_PLLCFGR_PLLN_Pos) | ((uint32_t)(config->pllp / 2 - 1) << RCC_PLLCFGR_PLLP_Pos);
+			RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2 | RCC_CFGR_HPRE)) |
+					(apb_prescaler_bits(config->apb1_div) << RCC_CFGR_PPRE1_Pos) |
+					(apb_prescaler_bits(config->apb2_div) << RCC_CFGR_PPRE2_Pos) |
+					(ahb_prescaler_bits(config->ahb_div) << RCC_CFGR_HPRE_Pos);
 			RCC->CR |= RCC_CR_PLLON;
 			while(!( RCC->CR & RCC_CR_PLLRDY));
+			if(clock_config_overdrive(config)){
+				PWR->CR |= PWR_CR_ODEN;
+				while(!(PWR->CSR & PWR_CSR_ODRDY));
+				PWR->CR |= PWR_CR_ODSWEN;
+				while(!(PWR->CSR & PWR_CSR_ODSWRDY));
+			}
 			RCC->CFGR |= (0b10<<RCC_CFGR_SW_Pos);
 			while(!(RCC->CFGR & RCC_CFGR_SWS_PLL));
 }
 
+/*
+ * Description: computes the system clock from the RCC registers, so it is right whatever
+ * 				configuration init_clocks left
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t system clock frequency in Hz
+ */
+uint32_t get_sysclk_freq(void){
+	uint32_t cfgr = RCC->CFGR;
+	uint32_t pllcfgr = RCC->PLLCFGR;
+	uint32_t source, m, n, p;
+
+	switch(cfgr & RCC_CFGR_SWS){
+	case RCC_CFGR_SWS_HSE:
+		return PLL_HSE_FREQ;
+	case RCC_CFGR_SWS_PLL:
+		source = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? PLL_HSE_FREQ : PLL_HSI_FREQ;
+		m = (pllcfgr & RCC_PLLCFGR_PLLM) >> RCC_PLLCFGR_PLLM_Pos;
+		n = (pllcfgr & RCC_PLLCFGR_PLLN) >> RCC_PLLCFGR_PLLN_Pos;
+		p = ((((pllcfgr & RCC_PLLCFGR_PLLP) >> RCC_PLLCFGR_PLLP_Pos) + 1) * 2);
+		return (uint32_t)(((uint64_t)source * n) / (m * p));
+	default:
+		return PLL_HSI_FREQ;
+	}
+}
 
+/*
+ * divides a clock by the APB prescaler field of CFGR, 0xx is /1 and 1xx is /2 to /16
+ */
+static uint32_t apb_divide(uint32_t hclk, uint32_t ppre){
+	if(ppre < 4){
+		return hclk;
+	}
+	return hclk >> (ppre - 3);
+}
+
+/*
+ * Description: computes the AHB clock (core, DMA, FMC, SysTick) from the RCC registers
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t AHB clock frequency in Hz
+ */
+uint32_t get_ahb_clk_freq(void){
+	uint32_t hpre = (RCC->CFGR & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos;
+
+	if(hpre < 8){
+		return get_sysclk_freq();
+	}
+	return get_sysclk_freq() >> hpre_shift[hpre - 8];
+}
+
+/*
+ * Description: computes the APB1 clock (USART2, TIM2-5) from the RCC registers
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t APB1 clock frequency in Hz
+ */
+uint32_t get_apb1_clk_freq(void){
+	return apb_divide(get_ahb_clk_freq(), (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos);
+}
+
+/*
+ * Description: computes the APB2 clock (SPI1, TIM1) from the RCC registers
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t APB2 clock frequency in Hz
+ */
+uint32_t get_apb2_clk_freq(void){
+	return apb_divide(get_ahb_clk_freq(), (RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos);
+}
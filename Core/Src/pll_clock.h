@@ -10,8 +10,9 @@
 
 /**
  * @file    pll_clock.h
- * @brief   This file contains the function prototype for PLL initialisation and also the MACROs which represent
- * 			the buses frequency after initialisation
+ * @brief   This file contains the function prototype for PLL initialisation, which sets the entry of
+ * 			clock_config.h the firmware is built for, and the functions which give the bus frequencies
+ * 			it left
  * @author  Pranjal Gupta
  * @date    12/17/2023
  *
@@ -22,10 +23,54 @@
 #ifndef SRC_PLL_CLOCK_H_
 #define SRC_PLL_CLOCK_H_
 
+#include "stdint.h"
+#include "clock_config.h"
+
+/*
+ * Description: configures the PLL, the bus prescalers, the flash wait states and the over-drive
+ * 				from clock_config_get()
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
 void init_clocks();
 
-#define AHB1_CLK_FREQ 160000000
-#define APB1_CLK_FREQ 40000000
-#define APB2_CLK_FREQ 80000000
+/*
+ * Description: computes the system clock from the RCC registers, so it is right whatever
+ * 				configuration init_clocks left
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t system clock frequency in Hz
+ */
+uint32_t get_sysclk_freq(void);
+
+/*
+ * Description: computes the AHB clock (core, DMA, FMC, SysTick) from the RCC registers
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t AHB clock frequency in Hz
+ */
+uint32_t get_ahb_clk_freq(void);
+
+/*
+ * Description: computes the APB1 clock (USART2, TIM2-5) from the RCC registers
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t APB1 clock frequency in Hz
+ */
+uint32_t get_apb1_clk_freq(void);
+
+/*
+ * Description: computes the APB2 clock (SPI1, TIM1, TIM8) from the RCC registers
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t APB2 clock frequency in Hz
+ */
+uint32_t get_apb2_clk_freq(void);
 
 #endif /* SRC_PLL_CLOCK_H_ */
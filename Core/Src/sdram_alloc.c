@@ -0,0 +1,281 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sdram_alloc.c
+ * @brief   Region allocator of the SDRAM. An arena hands out named, aligned regions from a table of
+ * 			at most SDRAM_MAX_REGIONS entries kept in address order, placing each in the first gap it
+ * 			fits. The table is small and fixed, so allocating and freeing take a bounded time.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "sdram_alloc.h"
+#include "stddef.h"
+#include "string.h"
+
+/*
+ *	Function to put a region into the table at a given index, moving the ones after it up
+ *
+ * Parameters:
+ *  arena arena to change, its table is not full
+ *  index index of the new region
+ *  name name of the region
+ *  offset offset of the region
+ *  size size of the region
+ *
+ * Returns:
+ *  none
+ */
+static void insert_region(sdram_arena_t *arena, uint8_t index, const char *name, uint32_t offset, uint32_t size){
+	memmove(&arena->regions[index + 1], &arena->regions[index], (arena->count - index) * sizeof(sdram_region_t));
+	arena->regions[index].name = name;
+	arena->regions[index].offset = offset;
+	arena->regions[index].size = size;
+	arena->regions[index].flags = 0;
+	arena->count++;
+	if(offset + size > arena->peak){
+		arena->peak = offset + size;
+	}
+}
+
+/*
+ *	Function to set up an empty arena over a buffer
+ *
+ * Parameters:
+ *  arena arena to set up
+ *  base start of the buffer
+ *  size size of the buffer in bytes
+ *
+ * Returns:
+ *  none
+ */
+void sdram_arena_init(sdram_arena_t *arena, uint8_t *base, uint32_t size){
+	memset(arena, 0, sizeof(*arena));
+	arena->base = base;
+	arena->size = size;
+}
+
+/*
+ *	Function to allocate a region in the first gap it fits
+ *
+ * Parameters:
+ *  arena arena to allocate from
+ *  name name of the region, shown by the mem command, the string must outlive the region
+ *  size size of the region in bytes, not 0
+ *  align alignment of the start from the base of the arena, a power of two
+ *
+ * Returns:
+ *  start of the region
+ *  NULL if no gap is large enough or the table is full
+ */
+uint8_t *sdram_alloc(sdram_arena_t *arena, const char *name, uint32_t size, uint32_t align){
+	uint32_t gap_start = 0;
+
+	if(size == 0 || size > arena->size || align == 0 || (align & (align - 1)) || arena->count == SDRAM_MAX_REGIONS){
+		arena->failures++;
+		return NULL;
+	}
+
+	for(uint8_t i = 0; i <= arena->count; i++){
+		uint32_t gap_end = (i < arena->count) ? arena->regions[i].offset : arena->size;
+		uint32_t start = (gap_start + align - 1) & ~(align - 1);
+		if(start >= gap_start && start <= gap_end && gap_end - start >= size){
+			insert_region(arena, i, name, start, size);
+			return arena->base + start;
+		}
+		if(i < arena->count){
+			gap_start = arena->regions[i].offset + arena->regions[i].size;
+		}
+	}
+
+	arena->failures++;
+	return NULL;
+}
+
+/*
+ *	Function to allocate a region at a given address, used to keep memory whose content must not
+ *	move, such as a capture that is still being saved
+ *
+ * Parameters:
+ *  arena arena to allocate from
+ *  name name of the region
+ *  addr start of the region
+ *  size size of the region in bytes, not 0
+ *
+ * Returns:
+ *  true if the region was allocated
+ *  false if it leaves the arena, overlaps another region or the table is full
+ */
+bool sdram_alloc_at(sdram_arena_t *arena, const char *name, uint8_t *addr, uint32_t size){
+	uint32_t offset = addr - arena->base;
+	uint8_t i = 0;
+
+	if(size == 0 || addr < arena->base || offset > arena->size || arena->size - offset < size ||
+			arena->count == SDRAM_MAX_REGIONS){
+		arena->failures++;
+		return false;
+	}
+
+	while(i < arena->count && arena->regions[i].offset < offset){
+		i++;
+	}
+	if((i > 0 && arena->regions[i - 1].offset + arena->regions[i - 1].size > offset) ||
+			(i < arena->count && offset + size > arena->regions[i].offset)){
+		arena->failures++;
+		return false;
+	}
+
+	insert_region(arena, i, name, offset, size);
+	return true;
+}
+
+/*
+ *	Function to free a region
+ *
+ * Parameters:
+ *  arena arena the region belongs to
+ *  addr start of the region
+ *
+ * Returns:
+ *  true if the region was freed
+ *  false if no region starts at addr
+ */
+bool sdram_free(sdram_arena_t *arena, const uint8_t *addr){
+	for(uint8_t i = 0; i < arena->count; i++){
+		if(arena->base + arena->regions[i].offset == addr){
+			memmove(&arena->regions[i], &arena->regions[i + 1], (arena->count - i - 1) * sizeof(sdram_region_t));
+			arena->count--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ *	Function to find the region holding an address
+ *
+ * Parameters:
+ *  arena arena to look in
+ *  addr address to look for
+ *
+ * Returns:
+ *  pointer to the region
+ *  NULL if the address is in no region
+ */
+sdram_region_t *sdram_find(sdram_arena_t *arena, const uint8_t *addr){
+	if(addr < arena->base){
+		return NULL;
+	}
+	uint32_t offset = addr - arena->base;
+
+	for(uint8_t i = 0; i < arena->count; i++){
+		if(offset >= arena->regions[i].offset && offset - arena->regions[i].offset < arena->regions[i].size){
+			return &arena->regions[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ *	Function to check that a range lies inside a single region, before a DMA or a decoder is let
+ *	loose on it
+ *
+ * Parameters:
+ *  arena arena to look in
+ *  addr start of the range
+ *  len length of the range in bytes
+ *
+ * Returns:
+ *  true if the range lies inside one region
+ *  false otherwise
+ */
+bool sdram_check(sdram_arena_t *arena, const uint8_t *addr, uint32_t len){
+	sdram_region_t *region = sdram_find(arena, addr);
+
+	if(region == NULL){
+		return false;
+	}
+	return len <= region->size - (uint32_t)(addr - arena->base - region->offset);
+}
+
+/*
+ *	Function to get the number of bytes not in any region
+ *
+ * Parameters:
+ *  arena arena to look in
+ *
+ * Returns:
+ *  free bytes
+ */
+uint32_t sdram_free_bytes(const sdram_arena_t *arena){
+	uint32_t used = 0;
+
+	for(uint8_t i = 0; i < arena->count; i++){
+		used += arena->regions[i].size;
+	}
+	return arena->size - used;
+}
+
+/*
+ *	Function to get the size of the largest gap, the largest region that can still be allocated
+ *	with an alignment of 1
+ *
+ * Parameters:
+ *  arena arena to look in
+ *
+ * Returns:
+ *  size of the largest gap in bytes
+ */
+uint32_t sdram_largest_free(const sdram_arena_t *arena){
+	return sdram_largest_aligned(arena, 1, NULL);
+}
+
+/*
+ *	Function to get the largest region that can still be allocated with an alignment, what is left
+ *	of each gap from its first aligned address. A region can be counted as free, to know what
+ *	allocating after freeing it would give without changing the table
+ *
+ * Parameters:
+ *  arena arena to look in
+ *  align alignment of the start, a power of two
+ *  skip start of a region counted as free, NULL for none
+ *
+ * Returns:
+ *  size in bytes, 0 if nothing fits or the alignment is not a power of two
+ */
+uint32_t sdram_largest_aligned(const sdram_arena_t *arena, uint32_t align, const uint8_t *skip){
+	uint32_t gap_start = 0, largest = 0;
+	uint8_t count = arena->count;
+
+	for(uint8_t i = 0; i < arena->count; i++){
+		if(arena->base + arena->regions[i].offset == skip){
+			count--;//its slot is given back with it
+		}
+	}
+	if(count == SDRAM_MAX_REGIONS || align == 0 || (align & (align - 1))){
+		return 0;
+	}
+	for(uint8_t i = 0; i <= arena->count; i++){
+		if(i < arena->count && arena->base + arena->regions[i].offset == skip){
+			continue;//its space joins the gaps around it
+		}
+		uint32_t gap_end = (i < arena->count) ? arena->regions[i].offset : arena->size;
+		uint32_t start = (gap_start + align - 1) & ~(align - 1);
+		if(start >= gap_start && start <= gap_end && gap_end - start > largest){
+			largest = gap_end - start;
+		}
+		if(i < arena->count){
+			gap_start = arena->regions[i].offset + arena->regions[i].size;
+		}
+	}
+	return largest;
+}
@@ -0,0 +1,170 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sdram_alloc.h
+ * @brief   Header file for the region allocator of the SDRAM. An arena hands out named, aligned
+ * 			regions from a table of at most SDRAM_MAX_REGIONS entries kept in address order, placing
+ * 			each in the first gap it fits. The table is small and fixed, so allocating and freeing
+ * 			take a bounded time. Nothing here touches the hardware, the arena works over any buffer.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __SDRAM_ALLOC_H__
+#define __SDRAM_ALLOC_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define SDRAM_MAX_REGIONS 8
+
+#define SDRAM_REGION_LOCKED 0x01	//in use by a background job, see lock_sdram_region
+
+typedef struct{
+	const char *name;
+	uint32_t offset;		//from the base of the arena
+	uint32_t size;
+	uint8_t flags;
+}sdram_region_t;
+
+typedef struct{
+	uint8_t *base;
+	uint32_t size;
+	uint8_t count;
+	sdram_region_t regions[SDRAM_MAX_REGIONS];	//sorted by offset
+	uint32_t peak;			//highest end of a region so far
+	uint32_t failures;		//allocations refused
+}sdram_arena_t;
+
+/*
+ *	Function to set up an empty arena over a buffer
+ *
+ * Parameters:
+ *  arena arena to set up
+ *  base start of the buffer
+ *  size size of the buffer in bytes
+ *
+ * Returns:
+ *  none
+ */
+void sdram_arena_init(sdram_arena_t *arena, uint8_t *base, uint32_t size);
+
+/*
+ *	Function to allocate a region in the first gap it fits
+ *
+ * Parameters:
+ *  arena arena to allocate from
+ *  name name of the region, shown by the mem command, the string must outlive the region
+ *  size size of the region in bytes, not 0
+ *  align alignment of the start from the base of the arena, a power of two
+ *
+ * Returns:
+ *  start of the region
+ *  NULL if no gap is large enough or the table is full
+ */
+uint8_t *sdram_alloc(sdram_arena_t *arena, const char *name, uint32_t size, uint32_t align);
+
+/*
+ *	Function to allocate a region at a given address, used to keep memory whose content must not
+ *	move, such as a capture that is still being saved
+ *
+ * Parameters:
+ *  arena arena to allocate from
+ *  name name of the region
+ *  addr start of the region
+ *  size size of the region in bytes, not 0
+ *
+ * Returns:
+ *  true if the region was allocated
+ *  false if it leaves the arena, overlaps another region or the table is full
+ */
+bool sdram_alloc_at(sdram_arena_t *arena, const char *name, uint8_t *addr, uint32_t size);
+
+/*
+ *	Function to free a region
+ *
+ * Parameters:
+ *  arena arena the region belongs to
+ *  addr start of the region
+ *
+ * Returns:
+ *  true if the region was freed
+ *  false if no region starts at addr
+ */
+bool sdram_free(sdram_arena_t *arena, const uint8_t *addr);
+
+/*
+ *	Function to find the region holding an address
+ *
+ * Parameters:
+ *  arena arena to look in
+ *  addr address to look for
+ *
+ * Returns:
+ *  pointer to the region
+ *  NULL if the address is in no region
+ */
+sdram_region_t *sdram_find(sdram_arena_t *arena, const uint8_t *addr);
+
+/*
+ *	Function to check that a range lies inside a single region, before a DMA or a decoder is let
+ *	loose on it
+ *
+ * Parameters:
+ *  arena arena to look in
+ *  addr start of the range
+ *  len length of the range in bytes
+ *
+ * Returns:
+ *  true if the range lies inside one region
+ *  false otherwise
+ */
+bool sdram_check(sdram_arena_t *arena, const uint8_t *addr, uint32_t len);
+
+/*
+ *	Function to get the number of bytes not in any region
+ *
+ * Parameters:
+ *  arena arena to look in
+ *
+ * Returns:
+ *  free bytes
+ */
+uint32_t sdram_free_bytes(const sdram_arena_t *arena);
+
+/*
+ *	Function to get the size of the largest gap, the largest region that can still be allocated
+ *	with an alignment of 1
+ *
+ * Parameters:
+ *  arena arena to look in
+ *
+ * Returns:
+ *  size of the largest gap in bytes
+ */
+uint32_t sdram_largest_free(const sdram_arena_t *arena);
+
+/*
+ *	Function to get the largest region that can still be allocated with an alignment, what is left
+ *	of each gap from its first aligned address. A region can be counted as free, to know what
+ *	allocating after freeing it would give without changing the table
+ *
+ * Parameters:
+ *  arena arena to look in
+ *  align alignment of the start, a power of two
+ *  skip start of a region counted as free, NULL for none
+ *
+ * Returns:
+ *  size in bytes, 0 if nothing fits or the alignment is not a power of two
+ */
+uint32_t sdram_largest_aligned(const sdram_arena_t *arena, uint32_t align, const uint8_t *skip);
+
+#endif
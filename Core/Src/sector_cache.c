@@ -0,0 +1,257 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sector_cache.c
+ * @brief   This file contains the function definitions for the write-back sector cache. During a save
+ * 			fatfs rewrites the same FAT sector and directory entry after every cluster it allocates, and
+ * 			writes both FAT copies; with the cache those end up as one write of each sector on sync.
+ *
+ * 			The cache is small, so the least recently used line is found by scanning the use stamps
+ * 			instead of keeping a list.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "sector_cache.h"
+#include "stdbool.h"
+#include "string.h"
+
+typedef struct{
+	DWORD sector;
+	uint32_t last_use;
+	uint8_t valid;
+	uint8_t dirty;
+}cache_line_t;
+
+static cache_line_t lines[SECTOR_CACHE_LINES];
+static BYTE line_data[SECTOR_CACHE_LINES][SECTOR_CACHE_SECTOR_SIZE] SECTOR_CACHE_SECTION __attribute__((aligned(4)));
+static uint32_t use_counter;
+static sector_read_t disk_read_fn;
+static sector_write_t disk_write_fn;
+static sector_cache_stats_t stats;
+
+static cache_line_t *find_line(DWORD sector){
+	for(int i = 0; i < SECTOR_CACHE_LINES; i++){
+		if(lines[i].valid && lines[i].sector == sector)
+			return &lines[i];
+	}
+	return NULL;
+}
+
+static BYTE *data_of(const cache_line_t *line){
+	return line_data[line - lines];
+}
+
+static DRESULT write_back(BYTE pdrv, cache_line_t *line){
+	DRESULT res = disk_write_fn(pdrv, data_of(line), line->sector, 1);
+	if(res == RES_OK){
+		line->dirty = 0;
+		stats.write_backs++;
+	}
+	return res;
+}
+
+/*
+ * gives a free line, or empties the least recently used one. A dirty line is written back
+ * first, and kept if that fails
+ */
+static cache_line_t *alloc_line(BYTE pdrv, DRESULT *res){
+	cache_line_t *victim = &lines[0];
+
+	for(int i = 0; i < SECTOR_CACHE_LINES; i++){
+		if(!lines[i].valid){
+			victim = &lines[i];
+			break;
+		}
+		if(lines[i].last_use < victim->last_use)
+			victim = &lines[i];
+	}
+
+	*res = RES_OK;
+	if(victim->valid && victim->dirty){
+		*res = write_back(pdrv, victim);
+		if(*res != RES_OK)
+			return NULL;
+	}
+	victim->valid = 0;
+	return victim;
+}
+
+/*
+ * Description: sets the functions used to reach the card and empties the cache, without writing
+ * 				back dirty sectors. Called when the card is initialised, since it may have been swapped
+ * Parameters:
+ * 		sector_read_t read function reading sectors from the card
+ * 		sector_write_t write function writing sectors to the card
+ * Returns:
+ *   		None
+ */
+void sector_cache_init(sector_read_t read, sector_write_t write){
+	disk_read_fn = read;
+	disk_write_fn = write;
+	memset(lines, 0, sizeof(lines));
+	memset(&stats, 0, sizeof(stats));
+	use_counter = 0;
+}
+
+/*
+ * Description: reads sectors through the cache
+ * Parameters:
+ * 		BYTE pdrv physical drive number
+ * 		BYTE *buff buffer to read to
+ * 		DWORD sector first sector
+ * 		UINT count number of sectors
+ * Returns:
+ *   		DRESULT RES_OK on success, the error of the card otherwise
+ */
+DRESULT sector_cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count){
+	cache_line_t *line;
+	DRESULT res;
+
+	if(count > 1){
+		stats.bypasses++;
+		res = disk_read_fn(pdrv, buff, sector, count);
+		if(res != RES_OK)
+			return res;
+		//cached copies may be newer than the card
+		for(int i = 0; i < SECTOR_CACHE_LINES; i++){
+			if(lines[i].valid && lines[i].dirty && lines[i].sector >= sector && lines[i].sector - sector < count)
+				memcpy(buff + (lines[i].sector - sector) * SECTOR_CACHE_SECTOR_SIZE, line_data[i], SECTOR_CACHE_SECTOR_SIZE);
+		}
+		return RES_OK;
+	}
+
+	line = find_line(sector);
+	if(line){
+		stats.hits++;
+	}else{
+		stats.misses++;
+		line = alloc_line(pdrv, &res);
+		if(!line)
+			return res;
+		res = disk_read_fn(pdrv, data_of(line), sector, 1);
+		if(res != RES_OK)
+			return res;
+		line->sector = sector;
+		line->dirty = 0;
+		line->valid = 1;
+	}
+	line->last_use = ++use_counter;
+	memcpy(buff, data_of(line), SECTOR_CACHE_SECTOR_SIZE);
+	return RES_OK;
+}
+
+/*
+ * Description: writes sectors through the cache. A single sector is only written to the cache
+ * Parameters:
+ * 		BYTE pdrv physical drive number
+ * 		const BYTE *buff data to write
+ * 		DWORD sector first sector
+ * 		UINT count number of sectors
+ * Returns:
+ *   		DRESULT RES_OK on success, the error of the card otherwise
+ */
+DRESULT sector_cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count){
+	cache_line_t *line;
+	DRESULT res;
+
+	if(count > 1){
+		stats.bypasses++;
+		res = disk_write_fn(pdrv, buff, sector, count);
+		if(res != RES_OK)
+			return res;
+		//the card now holds the newest data of any cached sector in the range
+		for(int i = 0; i < SECTOR_CACHE_LINES; i++){
+			if(lines[i].valid && lines[i].sector >= sector && lines[i].sector - sector < count){
+				memcpy(line_data[i], buff + (lines[i].sector - sector) * SECTOR_CACHE_SECTOR_SIZE, SECTOR_CACHE_SECTOR_SIZE);
+				lines[i].dirty = 0;
+			}
+		}
+		return RES_OK;
+	}
+
+	line = find_line(sector);
+	if(line){
+		stats.hits++;
+	}else{
+		line = alloc_line(pdrv, &res);
+		if(!line)
+			return res;
+		line->sector = sector;
+		line->valid = 1;
+	}
+	memcpy(data_of(line), buff, SECTOR_CACHE_SECTOR_SIZE);
+	line->dirty = 1;
+	line->last_use = ++use_counter;
+	return RES_OK;
+}
+
+/*
+ * Description: writes all dirty sectors to the card in ascending order. A sector that fails to be
+ * 				written stays dirty, so a later flush tries it again
+ * Parameters:
+ * 		BYTE pdrv physical drive number
+ * Returns:
+ *   		DRESULT RES_OK if every dirty sector was written, the error of the card otherwise
+ */
+DRESULT sector_cache_flush(BYTE pdrv){
+	DRESULT result = RES_OK;
+	DWORD done = 0;
+	bool first = true;
+
+	//cards write faster in ascending order, and a failed line must not be picked again
+	while(1){
+		cache_line_t *next = NULL;
+		for(int i = 0; i < SECTOR_CACHE_LINES; i++){
+			if(lines[i].valid && lines[i].dirty && (first || lines[i].sector > done)
+					&& (!next || lines[i].sector < next->sector))
+				next = &lines[i];
+		}
+		if(!next)
+			break;
+
+		DRESULT res = write_back(pdrv, next);
+		if(res != RES_OK)
+			result = res;
+		done = next->sector;
+		first = false;
+	}
+	return result;
+}
+
+/*
+ * Description: counts the dirty sectors waiting to be written
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t number of dirty sectors
+ */
+uint32_t sector_cache_dirty_count(void){
+	uint32_t count = 0;
+	for(int i = 0; i < SECTOR_CACHE_LINES; i++){
+		if(lines[i].valid && lines[i].dirty)
+			count++;
+	}
+	return count;
+}
+
+/*
+ * Description: gives the hit and miss counters of the cache, they are cleared by sector_cache_init
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const sector_cache_stats_t * pointer to the counters
+ */
+const sector_cache_stats_t *sector_cache_get_stats(void){
+	return &stats;
+}
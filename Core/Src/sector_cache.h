@@ -0,0 +1,118 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sector_cache.h
+ * @brief   This file contains the function prototypes for the write-back sector cache that sits between
+ * 			fatfs and the sd card driver. Single sector accesses, which is how fatfs reads and writes FAT,
+ * 			directory and FSINFO sectors, are kept in a small LRU cache and only written to the card on
+ * 			CTRL_SYNC or when evicted. Multi sector accesses are file data and go straight to the card.
+ *
+ * 			The cache does not know about the card, it calls the read and write functions it is given,
+ * 			so it can be run on the host against a ram disk.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __SECTOR_CACHE_H__
+#define __SECTOR_CACHE_H__
+#include "stdint.h"
+#include "integer.h"
+#include "diskio.h"
+
+//number of cached sectors, each one takes 512 bytes of ram
+#ifndef SECTOR_CACHE_LINES
+#define SECTOR_CACHE_LINES 16
+#endif
+
+/* placement of the cached sectors. They are handed to the SPI DMA, so they must be in memory DMA2 can
+ * reach: SRAM1/2 (the default) or SDRAM, but not CCMRAM, which is only connected to the core */
+#ifndef SECTOR_CACHE_SECTION
+#define SECTOR_CACHE_SECTION
+#endif
+
+#define SECTOR_CACHE_SECTOR_SIZE 512
+
+typedef DRESULT (*sector_read_t)(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+typedef DRESULT (*sector_write_t)(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+typedef struct{
+	uint32_t hits;			//single sector reads and writes served by the cache
+	uint32_t misses;		//single sector reads that had to go to the card
+	uint32_t write_backs;	//dirty sectors written to the card on sync or eviction
+	uint32_t bypasses;		//multi sector accesses sent straight to the card
+}sector_cache_stats_t;
+
+/*
+ * Description: sets the functions used to reach the card and empties the cache, without writing
+ * 				back dirty sectors. Called when the card is initialised, since it may have been swapped
+ * Parameters:
+ * 		sector_read_t read function reading sectors from the card
+ * 		sector_write_t write function writing sectors to the card
+ * Returns:
+ *   		None
+ */
+void sector_cache_init(sector_read_t read, sector_write_t write);
+
+/*
+ * Description: reads sectors through the cache
+ * Parameters:
+ * 		BYTE pdrv physical drive number
+ * 		BYTE *buff buffer to read to
+ * 		DWORD sector first sector
+ * 		UINT count number of sectors
+ * Returns:
+ *   		DRESULT RES_OK on success, the error of the card otherwise
+ */
+DRESULT sector_cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+
+/*
+ * Description: writes sectors through the cache. A single sector is only written to the cache
+ * Parameters:
+ * 		BYTE pdrv physical drive number
+ * 		const BYTE *buff data to write
+ * 		DWORD sector first sector
+ * 		UINT count number of sectors
+ * Returns:
+ *   		DRESULT RES_OK on success, the error of the card otherwise
+ */
+DRESULT sector_cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+
+/*
+ * Description: writes all dirty sectors to the card in ascending order. A sector that fails to be
+ * 				written stays dirty, so a later flush tries it again
+ * Parameters:
+ * 		BYTE pdrv physical drive number
+ * Returns:
+ *   		DRESULT RES_OK if every dirty sector was written, the error of the card otherwise
+ */
+DRESULT sector_cache_flush(BYTE pdrv);
+
+/*
+ * Description: counts the dirty sectors waiting to be written
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t number of dirty sectors
+ */
+uint32_t sector_cache_dirty_count(void);
+
+/*
+ * Description: gives the hit and miss counters of the cache, they are cleared by sector_cache_init
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const sector_cache_stats_t * pointer to the counters
+ */
+const sector_cache_stats_t *sector_cache_get_stats(void);
+
+#endif
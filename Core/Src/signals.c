@@ -0,0 +1,247 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    signals.c
+ * @brief   This file contains the waveform builders of the host tests and of wavegen.c, see
+ * 			signals.h.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "signals.h"
+#include "can_analyser.h"
+
+#define ONEWIRE_RESET_US 		480
+#define ONEWIRE_PRESENCE_WAIT_US 30
+#define ONEWIRE_PRESENCE_US 	120
+#define ONEWIRE_RECOVERY_US 	330
+#define ONEWIRE_ONE_LOW_US 		6
+#define ONEWIRE_ZERO_LOW_US 	60
+#define ONEWIRE_SLOT_US 		70
+#define CAN_INTERMISSION_BITS 	3
+
+//appends samples at the current level, the exact number
+static void hold(signal_t *sig, uint32_t samples){
+	while(samples-- && sig->len < sig->size)
+		sig->buf[sig->len++] = sig->level;
+}
+
+//holds up to a sample index, nothing if the signal is already past it
+static void hold_until(signal_t *sig, uint32_t end){
+	if(end > sig->len)
+		hold(sig, end - sig->len);
+}
+
+//a displacement of an edge, uniform in -jitter..jitter
+static int32_t jitter_offset(signal_t *sig){
+	if(sig->jitter == 0)
+		return 0;
+	return (int32_t)(signal_random(&sig->seed) % (2 * sig->jitter + 1)) - (int32_t)sig->jitter;
+}
+
+uint32_t signal_random(uint32_t *state){
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+void signal_init(signal_t *sig, uint8_t *buf, uint32_t size, uint8_t idle){
+	sig->buf = buf;
+	sig->size = size;
+	sig->len = 0;
+	sig->level = idle;
+	sig->jitter = 0;
+	sig->seed = 1;
+}
+
+void signal_set_jitter(signal_t *sig, uint32_t jitter, uint32_t seed){
+	sig->jitter = jitter;
+	sig->seed = seed ? seed : 1;
+}
+
+void signal_hold(signal_t *sig, uint32_t samples){
+	int32_t offset = jitter_offset(sig);
+
+	if(samples == 0)
+		return;
+	if(offset < 0 && (uint32_t)-offset >= samples)
+		samples = 1;
+	else
+		samples += offset;
+	hold(sig, samples);
+}
+
+void signal_set(signal_t *sig, uint8_t pin, uint8_t level){
+	if(level)
+		sig->level |= (1 << pin);
+	else
+		sig->level &= ~(1 << pin);
+}
+
+uint32_t signal_uart(signal_t *sig, uint8_t pin, uint16_t data, uint8_t data_bits, uart_parity_t parity,
+		uint8_t stop_bits, uint32_t bit_q8){
+	uint8_t bits[UART_ANALYSER_MAX_BITS];
+	uint8_t count = 0, ones = 0;
+	uint32_t start = sig->len;
+	uint64_t start_q8 = (uint64_t)start << 8;
+
+	bits[count++] = 0;
+	for(uint8_t i = 0; i < data_bits; i++){
+		bits[count++] = (data >> i) & 1;
+		ones += (data >> i) & 1;
+	}
+	if(parity != UART_PARITY_NONE)
+		bits[count++] = (parity == UART_PARITY_EVEN) ? (ones & 1) : !(ones & 1);
+	for(uint8_t i = 0; i < stop_bits; i++)
+		bits[count++] = 1;
+
+	//each bit ends on the sample nearest to its exact end, so fractional rates do not drift, and
+	//jitter moves each edge around that end without adding up
+	for(uint8_t i = 0; i < count; i++){
+		uint32_t end = (uint32_t)((start_q8 + (uint64_t)(i + 1) * bit_q8 + 128) >> 8);
+		signal_set(sig, pin, bits[i]);
+		hold_until(sig, end + jitter_offset(sig));
+	}
+	return start;
+}
+
+uint32_t signal_i2c_start(signal_t *sig, uint8_t scl, uint8_t sda, uint32_t half){
+	uint32_t position;
+
+	signal_set(sig, sda, 1);
+	signal_hold(sig, half);
+	signal_set(sig, scl, 1);
+	signal_hold(sig, half);
+	signal_set(sig, sda, 0);
+	position = sig->len;
+	signal_hold(sig, half);
+	signal_set(sig, scl, 0);
+	signal_hold(sig, half);
+	return position;
+}
+
+//one clock pulse with SDA set while SCL is low
+static void i2c_bit(signal_t *sig, uint8_t scl, uint8_t sda, uint8_t bit, uint32_t half){
+	signal_set(sig, sda, bit);
+	signal_hold(sig, half);
+	signal_set(sig, scl, 1);
+	signal_hold(sig, half);
+	signal_set(sig, scl, 0);
+}
+
+void signal_i2c_byte(signal_t *sig, uint8_t scl, uint8_t sda, uint8_t byte, bool ack, uint32_t half){
+	for(int i = 7; i >= 0; i--)
+		i2c_bit(sig, scl, sda, (byte >> i) & 1, half);
+	i2c_bit(sig, scl, sda, !ack, half);
+}
+
+uint32_t signal_i2c_stop(signal_t *sig, uint8_t scl, uint8_t sda, uint32_t half){
+	uint32_t position;
+
+	signal_set(sig, sda, 0);
+	signal_hold(sig, half);
+	signal_set(sig, scl, 1);
+	signal_hold(sig, half);
+	signal_set(sig, sda, 1);
+	position = sig->len;
+	signal_hold(sig, 2 * half);
+	return position;
+}
+
+void signal_spi_byte(signal_t *sig, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t out, uint8_t in,
+		uint32_t half){
+	for(int i = 7; i >= 0; i--){
+		signal_set(sig, mosi, (out >> i) & 1);
+		signal_set(sig, miso, (in >> i) & 1);
+		signal_hold(sig, half);
+		signal_set(sig, sck, 1);
+		signal_hold(sig, half);
+		signal_set(sig, sck, 0);
+	}
+}
+
+uint32_t signal_onewire_reset(signal_t *sig, uint8_t pin, uint32_t samples_per_us, bool presence){
+	uint32_t position;
+
+	signal_set(sig, pin, 0);
+	signal_hold(sig, ONEWIRE_RESET_US * samples_per_us);
+	signal_set(sig, pin, 1);
+	position = sig->len;
+	if(presence){
+		signal_hold(sig, ONEWIRE_PRESENCE_WAIT_US * samples_per_us);
+		signal_set(sig, pin, 0);
+		position = sig->len;
+		signal_hold(sig, ONEWIRE_PRESENCE_US * samples_per_us);
+		signal_set(sig, pin, 1);
+	}
+	signal_hold(sig, ONEWIRE_RECOVERY_US * samples_per_us);
+	return position;
+}
+
+void signal_onewire_byte(signal_t *sig, uint8_t pin, uint32_t samples_per_us, uint8_t byte){
+	for(int i = 0; i < 8; i++){
+		uint32_t low = ((byte >> i) & 1) ? ONEWIRE_ONE_LOW_US : ONEWIRE_ZERO_LOW_US;
+		signal_set(sig, pin, 0);
+		signal_hold(sig, low * samples_per_us);
+		signal_set(sig, pin, 1);
+		signal_hold(sig, (ONEWIRE_SLOT_US - low) * samples_per_us);
+	}
+}
+
+static uint32_t put_bits(uint8_t *bits, uint32_t len, uint32_t value, uint8_t count){
+	for(int i = count - 1; i >= 0; i--)
+		bits[len++] = (value >> i) & 1;
+	return len;
+}
+
+uint32_t signal_can(signal_t *sig, uint8_t pin, uint32_t samples_per_bit, uint16_t id, const uint8_t *data,
+		uint8_t dlc, bool corrupt_crc){
+	uint8_t bits[CAN_MAX_STUFFED_BITS];
+	uint32_t len = 0, sent = 0;
+	uint32_t start = sig->len;
+	uint8_t same = 0, last = 2;
+
+	bits[len++] = 0;						//SOF
+	len = put_bits(bits, len, id, 11);
+	len = put_bits(bits, len, 0, 3);		//RTR, IDE, r0
+	len = put_bits(bits, len, dlc, 4);
+	for(uint8_t i = 0; i < dlc; i++)
+		len = put_bits(bits, len, data[i], 8);
+	len = put_bits(bits, len, can_crc15(bits, len) ^ (corrupt_crc ? 1 : 0), 15);
+
+	//bits end on a grid from the start of frame, jitter moves each edge around it
+	for(uint32_t i = 0; i < len; i++){
+		signal_set(sig, pin, bits[i]);
+		hold_until(sig, start + ++sent * samples_per_bit + jitter_offset(sig));
+		same = (bits[i] == last) ? same + 1 : 1;
+		last = bits[i];
+		if(same == 5){
+			last = !last;
+			same = 1;
+			signal_set(sig, pin, last);
+			hold_until(sig, start + ++sent * samples_per_bit + jitter_offset(sig));
+		}
+	}
+
+	signal_set(sig, pin, 1);				//CRC delimiter
+	hold_until(sig, start + ++sent * samples_per_bit + jitter_offset(sig));
+	signal_set(sig, pin, 0);				//ACK slot
+	hold_until(sig, start + ++sent * samples_per_bit + jitter_offset(sig));
+	signal_set(sig, pin, 1);				//ACK delimiter, EOF and intermission
+	hold_until(sig, start + (sent + 1 + 7 + CAN_INTERMISSION_BITS) * samples_per_bit);
+	return start;
+}
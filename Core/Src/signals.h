@@ -0,0 +1,208 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    signals.h
+ * @brief   This file contains the waveform builders of the host tests and of the traffic generator
+ * 			wavegen.c. A signal is a buffer of samples in the capture layout, one byte per sample
+ * 			and one bit per pin, appended to with the bus traffic the decoders are tested on.
+ *
+ * 			With jitter set, every hold and every bit of a UART or CAN frame is longer or shorter
+ * 			by up to that many samples. The bits of those frames stay on the grid of their rate, so
+ * 			the jitter does not add up over a frame.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __SIGNALS_H__
+#define __SIGNALS_H__
+#include "stdint.h"
+#include "stdbool.h"
+#include "uart_analyser.h"
+
+typedef struct{
+	uint8_t *buf;
+	uint32_t size;
+	uint32_t len;		//samples appended so far
+	uint8_t level;		//current level of all pins
+	uint32_t jitter;	//largest displacement of an edge in samples, 0 by default
+	uint32_t seed;		//state of the generator of the jitter
+}signal_t;
+
+/*
+ * Description: gives the next value of a xorshift generator, the one of the jitter
+ * Parameters:
+ * 		uint32_t *state state of the generator, not 0
+ * Returns:
+ *   		uint32_t next value
+ */
+uint32_t signal_random(uint32_t *state);
+
+/*
+ * Description: starts a signal in a buffer
+ * Parameters:
+ * 		signal_t *sig signal to start
+ * 		uint8_t *buf buffer of samples
+ * 		uint32_t size size of the buffer
+ * 		uint8_t idle level of all pins before the first change
+ * Returns:
+ *   		None
+ */
+void signal_init(signal_t *sig, uint8_t *buf, uint32_t size, uint8_t idle);
+
+/*
+ * Description: sets the jitter of the edges appended from now on
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint32_t jitter largest displacement of an edge in samples, less than a quarter of the
+ * 						shortest pulse or bit so the traffic still decodes, 0 for none
+ * 		uint32_t seed seed of the jitter, the same seed gives the same edges
+ * Returns:
+ *   		None
+ */
+void signal_set_jitter(signal_t *sig, uint32_t jitter, uint32_t seed);
+
+/*
+ * Description: appends samples at the current level, nothing past the end of the buffer
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint32_t samples number of samples
+ * Returns:
+ *   		None
+ */
+void signal_hold(signal_t *sig, uint32_t samples);
+
+/*
+ * Description: changes the level of one pin from the next sample on
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t pin pin to change
+ * 		uint8_t level 0 or 1
+ * Returns:
+ *   		None
+ */
+void signal_set(signal_t *sig, uint8_t pin, uint8_t level);
+
+/*
+ * Description: appends a uart frame, start bit, data LSB first, parity and stop bits
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t pin pin of the line
+ * 		uint16_t data data bits
+ * 		uint8_t data_bits 5..9
+ * 		uart_parity_t parity parity of the frame
+ * 		uint8_t stop_bits 1 or 2
+ * 		uint32_t bit_q8 samples per bit in 1/256th of a sample
+ * Returns:
+ *   		uint32_t sample of the falling edge of the start bit
+ */
+uint32_t signal_uart(signal_t *sig, uint8_t pin, uint16_t data, uint8_t data_bits, uart_parity_t parity,
+		uint8_t stop_bits, uint32_t bit_q8);
+
+/*
+ * Description: appends an I2C start or repeated start
+ * Parameters:
+ * 		signal_t *sig signal, SCL and SDA high for a start, SCL low for a repeated start
+ * 		uint8_t scl pin of SCL
+ * 		uint8_t sda pin of SDA
+ * 		uint32_t half samples in half a clock period
+ * Returns:
+ *   		uint32_t sample where SDA falls while SCL is high
+ */
+uint32_t signal_i2c_start(signal_t *sig, uint8_t scl, uint8_t sda, uint32_t half);
+
+/*
+ * Description: appends an I2C byte and its acknowledge bit, MSB first
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t scl pin of SCL
+ * 		uint8_t sda pin of SDA
+ * 		uint8_t byte byte to send
+ * 		bool ack true if the receiver acknowledges it
+ * 		uint32_t half samples in half a clock period
+ * Returns:
+ *   		None
+ */
+void signal_i2c_byte(signal_t *sig, uint8_t scl, uint8_t sda, uint8_t byte, bool ack, uint32_t half);
+
+/*
+ * Description: appends an I2C stop, the bus is left idle
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t scl pin of SCL
+ * 		uint8_t sda pin of SDA
+ * 		uint32_t half samples in half a clock period
+ * Returns:
+ *   		uint32_t sample where SDA rises while SCL is high
+ */
+uint32_t signal_i2c_stop(signal_t *sig, uint8_t scl, uint8_t sda, uint32_t half);
+
+/*
+ * Description: appends an SPI byte in mode 0, MSB first: MOSI and MISO change while SCK is low
+ * 				and are sampled on its rising edge. Chip select is left to the caller
+ * Parameters:
+ * 		signal_t *sig signal, SCK low
+ * 		uint8_t sck pin of SCK
+ * 		uint8_t mosi pin of MOSI
+ * 		uint8_t miso pin of MISO
+ * 		uint8_t out byte sent by the master
+ * 		uint8_t in byte sent by the slave
+ * 		uint32_t half samples in half a clock period
+ * Returns:
+ *   		None
+ */
+void signal_spi_byte(signal_t *sig, uint8_t sck, uint8_t mosi, uint8_t miso, uint8_t out, uint8_t in,
+		uint32_t half);
+
+/*
+ * Description: appends a 1-Wire reset pulse, followed by a presence pulse or not
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t pin pin of the bus
+ * 		uint32_t samples_per_us samples in a microsecond
+ * 		bool presence true if a device answers
+ * Returns:
+ *   		uint32_t sample of the falling edge of the presence pulse, or of the rising edge ending
+ *   				 the reset if there is none
+ */
+uint32_t signal_onewire_reset(signal_t *sig, uint8_t pin, uint32_t samples_per_us, bool presence);
+
+/*
+ * Description: appends 1-Wire write slots for the bits of a byte, LSB first
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t pin pin of the bus
+ * 		uint32_t samples_per_us samples in a microsecond
+ * 		uint8_t byte byte to send
+ * Returns:
+ *   		None
+ */
+void signal_onewire_byte(signal_t *sig, uint8_t pin, uint32_t samples_per_us, uint8_t byte);
+
+/*
+ * Description: appends a standard CAN data frame with its stuff bits, acknowledged, then 3 bits of
+ * 				intermission
+ * Parameters:
+ * 		signal_t *sig signal
+ * 		uint8_t pin pin of the bus
+ * 		uint32_t samples_per_bit samples in a bit
+ * 		uint16_t id 11 bit identifier
+ * 		const uint8_t *data data bytes
+ * 		uint8_t dlc number of data bytes, up to 8
+ * 		bool corrupt_crc true to send a wrong CRC
+ * Returns:
+ *   		uint32_t sample of the start of frame
+ */
+uint32_t signal_can(signal_t *sig, uint8_t pin, uint32_t samples_per_bit, uint16_t id, const uint8_t *data,
+		uint8_t dlc, bool corrupt_crc);
+
+#endif
@@ -13,6 +13,10 @@
  * @brief   This file contains the GPIO initailisation, SPI initialisation, write and read functionality and
  * 			also functions related to chip select GPIO pin
  *
+ * 			Blocks of data are moved by DMA2, stream 0 channel 3 for SPI1_RX and stream 3 channel 3 for
+ * 			SPI1_TX. Stream 3 is also used by the state mode trigger capture, so both streams are left
+ * 			with a cleared configuration after every transfer.
+ *
  * @author  Pranjal Gupta
  * @date    12/17/2023
  *
@@ -20,7 +24,17 @@
  *
  */
 #include "stm32f429xx.h"
+#include "stddef.h"
 #include "spi.h"
+#include "pll_clock.h"
+
+#define SPI_DMA_CHANNEL 	(DMA_SxCR_CHSEL_0 | DMA_SxCR_CHSEL_1)	// channel 3 is SPI1 on stream 0 and 3
+
+static volatile bool spi_dma_done = true;
+static volatile bool spi_dma_failed = false;	// the last transfer ended on a transfer error
+static volatile uint32_t spi_dma_errors = 0;
+static uint8_t spi_dma_dummy_tx = 0xFF;	// clocked out while receiving
+static uint8_t spi_dma_dummy_rx;		// sink for data received while transmitting
 
 /*
  * Description: initialises the spi to transfer and receive data from SD Card using FatFS
@@ -35,7 +49,7 @@ void spi_init(void){
 	SPI1->CR1 = 0;
 	SPI1->CR1 |= SPI_CR1_MSTR;
 	SPI1->CR1 |= SPI_CR1_SSM | SPI_CR1_SSI;
-	SPI1->CR1 |= SPI_CR1_BR_1 | SPI_CR1_BR_2;   // PRESCALCING BY 128
+	SPI1->CR1 |= SPI_CR1_BR_0 | SPI_CR1_BR_1 | SPI_CR1_BR_2;   // PRESCALCING BY 256, the slowest until fatfs_sd sets the clock
 	SPI1->CR1 &= ~(SPI_CR1_CPHA | SPI_CR1_CPOL);
 	SPI1->CRCPR = 10;
 
@@ -52,6 +66,7 @@ void spi_gpio_pin_init(void){
 
 	GPIOA->MODER |= GPIO_MODER_MODE5_1 | GPIO_MODER_MODE6_1 | GPIO_MODER_MODE7_1;
 	GPIOA->AFR[0] |= GPIO_AFRL_AFRL5_0 | GPIO_AFRL_AFRL5_2 | GPIO_AFRL_AFRL6_0 | GPIO_AFRL_AFRL6_1 | GPIO_AFRL_AFRL7_0 | GPIO_AFRL_AFRL7_2;
+	GPIOA->OSPEEDR |= GPIO_OSPEEDR_OSPEED5 | GPIO_OSPEEDR_OSPEED6 | GPIO_OSPEEDR_OSPEED7;	// clean edges at 20MHz
 
 	GPIOB->MODER |= GPIO_MODER_MODE12_0;
 }
@@ -60,12 +75,12 @@ void spi_gpio_pin_init(void){
  * Description: transfer a complete buffer through SPI
  * Parameters:
  * 		uint8_t *buffer an array which contains the data to be transferred
- * 		uint8_t len which tells the length of the data to be transferred
+ * 		uint16_t len which tells the length of the data to be transferred
  * Returns:
  *   		None
  */
 
-void spi_transmit_buffer(uint8_t *buffer, uint8_t len){
+void spi_transmit_buffer(uint8_t *buffer, uint16_t len){
 
 	while(len > 0){
 		spi_transmit_data(*buffer);
@@ -152,3 +167,207 @@ void gpio_set_cs_low(){
 
 
 }
+
+/*
+ * Description: sets the spi clock to the fastest one which does not exceed the given frequency.
+ * 				The sd card is initialised slowly and switched to its full speed afterwards
+ * Parameters:
+ * 		uint32_t max_hz highest clock frequency accepted by the device
+ * Returns:
+ *   		uint32_t the spi clock frequency which was set
+ */
+uint32_t spi_set_max_clock(uint32_t max_hz){
+	uint32_t pclk = get_apb2_clk_freq();	// SPI1 runs from APB2
+	uint32_t br = 0;
+
+	while(br < 7 && (pclk >> (br + 1)) > max_hz){
+		br++;
+	}
+
+	while(SPI1->SR & SPI_SR_BSY);
+	SPI1->CR1 &= ~SPI_CR1_SPE;
+	SPI1->CR1 = (SPI1->CR1 & ~SPI_CR1_BR) | (br << SPI_CR1_BR_Pos);
+	SPI1->CR1 |= SPI_CR1_SPE;
+
+	return pclk >> (br + 1);
+}
+
+/*
+ * Description: enables the dma controller and the interrupts which signal the end of a
+ * 				spi transfer, or a transfer error on either stream
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void spi_dma_init(void){
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+	NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+	NVIC_EnableIRQ(DMA2_Stream3_IRQn);	// the handler is the one of state mode, it calls spi_dma_stream3_irq
+}
+
+/*
+ * Description: starts a dma transfer of a block over spi and returns without waiting for it.
+ * 				Every byte sent is also received, so the receive stream always runs and ends the
+ * 				transfer
+ * Parameters:
+ * 		const uint8_t *tx data to transmit, NULL to clock out 0xFF
+ * 		uint8_t *rx buffer for the received data, NULL to discard it
+ * 		uint16_t len number of bytes, 1..65535
+ * Returns:
+ *   		None
+ */
+void spi_dma_start(const uint8_t *tx, uint8_t *rx, uint16_t len){
+	while(SPI1->SR & SPI_SR_BSY);
+	(void)SPI1->DR;	// drop stale data and overrun left by the byte functions
+	(void)SPI1->SR;
+
+	DMA2_Stream0->CR = 0;
+	DMA2_Stream3->CR = 0;
+	while((DMA2_Stream0->CR | DMA2_Stream3->CR) & DMA_SxCR_EN);
+	DMA2->LIFCR = DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0 |
+			DMA_LIFCR_CTCIF3 | DMA_LIFCR_CHTIF3 | DMA_LIFCR_CTEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3;
+
+	DMA2_Stream0->PAR = (uint32_t)&SPI1->DR;
+	DMA2_Stream0->M0AR = (uint32_t)((rx != NULL) ? rx : &spi_dma_dummy_rx);
+	DMA2_Stream0->NDTR = len;
+	DMA2_Stream0->CR = SPI_DMA_CHANNEL | DMA_SxCR_PL_1 | DMA_SxCR_TCIE | DMA_SxCR_TEIE |
+			((rx != NULL) ? DMA_SxCR_MINC : 0);
+
+	DMA2_Stream3->PAR = (uint32_t)&SPI1->DR;
+	DMA2_Stream3->M0AR = (uint32_t)((tx != NULL) ? tx : &spi_dma_dummy_tx);
+	DMA2_Stream3->NDTR = len;
+	DMA2_Stream3->CR = SPI_DMA_CHANNEL | DMA_SxCR_PL_1 | DMA_SxCR_DIR_0 | DMA_SxCR_TEIE |
+			((tx != NULL) ? DMA_SxCR_MINC : 0);
+
+	spi_dma_failed = false;
+	spi_dma_done = false;
+	DMA2_Stream0->CR |= DMA_SxCR_EN;	// receive first so no byte is missed
+	DMA2_Stream3->CR |= DMA_SxCR_EN;
+	SPI1->CR2 |= SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+}
+
+/*
+ * Description: tells if the last dma transfer started with spi_dma_start has ended
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if the transfer has ended
+ */
+bool spi_dma_is_done(void){
+	return spi_dma_done;
+}
+
+/*
+ * Description: tells if the last dma transfer ended on a transfer error of either stream
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if it did, the received data is then incomplete
+ */
+bool spi_dma_error(void){
+	return spi_dma_failed;
+}
+
+/*
+ * Description: gives the number of transfers that ended on a transfer error since boot
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t number of errors
+ */
+uint32_t spi_dma_error_count(void){
+	return spi_dma_errors;
+}
+
+/*
+ * Description: waits for the last dma transfer started with spi_dma_start to end. The core
+ * 				sleeps until an interrupt instead of polling the spi. A transfer error ends it too
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if the transfer completed, false on a transfer error
+ */
+bool spi_dma_wait(void){
+	// interrupts are masked around the check so the end of transfer cannot slip in just before
+	// the sleep, a pending interrupt still wakes the core and runs once they are unmasked
+	__disable_irq();
+	while(!spi_dma_done){
+		__WFI();
+		__enable_irq();
+		__disable_irq();
+	}
+	__enable_irq();
+	return !spi_dma_failed;
+}
+
+/*
+ * Description: transfers a block over spi with dma and waits for it to end
+ * Parameters:
+ * 		const uint8_t *tx data to transmit, NULL to clock out 0xFF
+ * 		uint8_t *rx buffer for the received data, NULL to discard it
+ * 		uint16_t len number of bytes, 1..65535
+ * Returns:
+ *   		bool true if the transfer completed, false on a transfer error
+ */
+bool spi_dma_transfer(const uint8_t *tx, uint8_t *rx, uint16_t len){
+	spi_dma_start(tx, rx, len);
+	return spi_dma_wait();
+}
+
+/*
+ * Description: ends the transfer, both streams and the spi dma requests are released
+ * Parameters:
+ * 		bool failed true if it ended on a transfer error
+ * Returns:
+ *   		None
+ */
+static void spi_dma_end(bool failed){
+	SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+	DMA2_Stream0->CR = 0;
+	DMA2_Stream3->CR = 0;
+	if(failed){
+		spi_dma_errors++;
+		spi_dma_failed = true;
+	}
+	spi_dma_done = true;
+}
+
+/*
+ * Description: irq handler for the spi receive stream, the last byte of a transfer has been
+ * 				received so the spi is idle and both streams are released. A transfer error of the
+ * 				stream ends the transfer as failed
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void DMA2_Stream0_IRQHandler(void){
+	bool failed = (DMA2->LISR & DMA_LISR_TEIF0) != 0;
+
+	DMA2->LIFCR = DMA_LIFCR_CTCIF0 | DMA_LIFCR_CTEIF0;
+	NVIC_ClearPendingIRQ(DMA2_Stream0_IRQn);
+
+	spi_dma_end(failed);
+}
+
+/*
+ * Description: handles a transfer error of the spi transmit stream. Stream 3 is shared with the
+ * 				state mode trigger capture, which owns DMA2_Stream3_IRQHandler, so the handler calls
+ * 				this first. A stopped transmit stream stops the clock, the receive stream would
+ * 				never complete, so the transfer is ended here as failed
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if stream 3 is set up for the spi and the interrupt was handled
+ */
+bool spi_dma_stream3_irq(void){
+	if((DMA2_Stream3->CR & DMA_SxCR_CHSEL) != SPI_DMA_CHANNEL || spi_dma_done){
+		return false;
+	}
+	DMA2->LIFCR = DMA_LIFCR_CTEIF3 | DMA_LIFCR_CDMEIF3 | DMA_LIFCR_CFEIF3;
+	NVIC_ClearPendingIRQ(DMA2_Stream3_IRQn);
+
+	spi_dma_end(true);
+	return true;
+}
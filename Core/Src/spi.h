@@ -24,8 +24,9 @@
 #define SRC_SPI_H_
 
 #include "stdint.h"
+#include "stdbool.h"
 
-void spi_transmit_buffer(uint8_t *buffer, uint8_t len);
+void spi_transmit_buffer(uint8_t *buffer, uint16_t len);
 void spi_transmit_data(uint8_t data);
 uint8_t spi_read_data();
 void spi_write_read_data(uint8_t *write_data, uint8_t *read_data, uint8_t len);
@@ -33,5 +34,14 @@ void spi_init(void);
 void spi_gpio_pin_init(void);
 void gpio_set_cs_low();
 void gpio_set_cs_high();
+uint32_t spi_set_max_clock(uint32_t max_hz);
+void spi_dma_init(void);
+void spi_dma_start(const uint8_t *tx, uint8_t *rx, uint16_t len);
+bool spi_dma_is_done(void);
+bool spi_dma_error(void);
+uint32_t spi_dma_error_count(void);
+bool spi_dma_wait(void);
+bool spi_dma_transfer(const uint8_t *tx, uint8_t *rx, uint16_t len);
+bool spi_dma_stream3_irq(void);
 
 #endif /* SRC_SPI_H_ */
@@ -25,6 +25,11 @@
 #include "stdbool.h"
 #include "systick.h"
 #include "timer.h"
+#include "timing_mode_init.h"
+#include "user_fatfs.h"
+#include "hw_access.h"
+#include "perf.h"
+#include "capture_health.h"
 volatile uint8_t *addr = NULL;
 uint8_t pattern = 0x3F;
 uint8_t bit = 0;
@@ -77,6 +82,7 @@ bool state_timing_init(input_capture_edge_t edge, uint8_t mode, uint8_t pattern,
 	disable_dma2_stream_3();
 	disable_dma_2_stream5();
 	reset_count_sdram_interrupts(mode);
+	capture_health_reset(true);
 	tim_gpio_init_state_mode();
 	tim_init_input_capture(edge);
 	if (mode == BUTTON_MODE) {
@@ -86,18 +92,22 @@ bool state_timing_init(input_capture_edge_t edge, uint8_t mode, uint8_t pattern,
 	} else if (mode == TRIG_MODE) {
 		dma_init_sdram(mode, count);
 		dma_init_sram();
-		enable_dma2_stream_2();
-		enable_dma2_stream_3();
+		enable_dma2_stream_3();//stream 2 is enabled by the stream 3 interrupt after the trigger
 		init_timers_sync();
 	}
 
 	trigger_found = false;
+	p_accumulator = 0;
 	if (mode == TRIG_MODE) {
 		ticktime_t current_tick = now();
 		uint32_t i = 0;
 		while (current_tick + time_count > now()) {
+			HW_WAIT();
 			if (get_process_flag() == 1) {
+				reset_process_flag();//every half of the pre trigger buffer is scanned once
 				addr = get_start_address();
+				i = 0;
+				PERF_BEGIN(PERF_TRIGGER_SCAN);
 				while (i < BUF_SIZE) {
 					bit = get_bit(*addr, pin_num);
 					p_accumulator = p_accumulator << 1 | (bit);//accumulate bits in byte
@@ -106,23 +116,40 @@ bool state_timing_init(input_capture_edge_t edge, uint8_t mode, uint8_t pattern,
 						trigger_found = true;
 						addr_test = addr;
 						i = 0;
+						PERF_END(PERF_TRIGGER_SCAN);
 						goto outside;
 						break;
 					}
 					addr++;
 					i++;
 				}
+				PERF_END(PERF_TRIGGER_SCAN);
 			}
 		}
-		if (trigger_found == true)
+		if (trigger_found == false) {
+			//timed out, stop the pre trigger buffer and the sdram fill waiting for the trigger
+			disable_all_timers();
+			disable_dma2_stream_3();
+			disable_dma2_stream_2();
 			return false;
+		}
 	} else
 		goto outside;
 
-	outside: while (get_done_flag() == false);
+	//a background save goes on while waiting for the capture, except in trigger mode where dma2
+	//stream 3 which the sd card shares is still filling the pre trigger buffer
+	outside: while (get_done_flag() == false) {
+		HW_WAIT();
+		if (mode == BUTTON_MODE)
+			user_fatfs_save_poll();
+	}
 	reset_done_flag();
+	set_sample_rate(0);//sampled on an external clock, rate is unknown
+	//the capture starts with the pre trigger buffer, the trigger sample is in there
+	set_trigger_position((mode == TRIG_MODE) ? get_pre_trigger_offset(addr_test) : NO_TRIGGER_POSITION);
+	set_capture_length((uint32_t)count * 32768);
 
-	return true;
+	return capture_health_get()->transfer_errors == 0;
 
 }
 
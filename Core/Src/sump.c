@@ -0,0 +1,411 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sump.c
+ * @brief   This file contains the function definitions for the SUMP binary protocol. A run command
+ * 			starts a timing mode capture straight away; with a trigger the blocks are searched while
+ * 			the next ones are filled, and the capture is stopped once the samples after the trigger
+ * 			are in. If the whole capture goes by without a match it is taken again, until the host
+ * 			sends a reset.
+ *
+ * 			The samples are sent back last first, as the protocol wants, through the transmit ring
+ * 			buffer of the uart. A reply has no line feed to end it, so stdout is flushed after each
+ * 			one rather than left to its buffering.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "sump.h"
+#include "stdio.h"
+#include "string.h"
+#include "uart.h"
+#include "fmc.h"
+#include "timing_mode_init.h"
+#include "timer_update_event.h"
+#include "user_fatfs.h"
+#include "hw_access.h"
+
+#define SUMP_ID_REPLY "1ALS"
+#define SUMP_DEVICE_NAME "LogiProbe"
+#define SUMP_FIRMWARE_VERSION "1.0"
+#define SUMP_BLOCK_SIZE 32768						//timing mode captures in blocks of 32KB
+#define SUMP_SEND_CHUNK 256
+
+#define SUMP_META_END 			0x00
+#define SUMP_META_NAME 			0x01
+#define SUMP_META_FIRMWARE 		0x02
+#define SUMP_META_PROBES 		0x20
+#define SUMP_META_MEMORY 		0x21
+#define SUMP_META_MAX_RATE 		0x23
+#define SUMP_META_PROTOCOL 		0x24
+
+static sump_stats_t stats;
+
+static uint32_t put_string(uint8_t *buf, uint8_t key, const char *str){
+	uint32_t len = strlen(str) + 1;
+	buf[0] = key;
+	memcpy(buf + 1, str, len);
+	return len + 1;
+}
+
+static uint32_t put_u32(uint8_t *buf, uint8_t key, uint32_t value){
+	buf[0] = key;
+	buf[1] = (uint8_t)(value >> 24);	//metadata values are big endian
+	buf[2] = (uint8_t)(value >> 16);
+	buf[3] = (uint8_t)(value >> 8);
+	buf[4] = (uint8_t)value;
+	return 5;
+}
+
+/*
+ * Description: sets a configuration to the state after a reset, 1MHz, 4096 samples without
+ * 				trigger and only the first group of channels
+ * Parameters:
+ * 		sump_config_t *config configuration to reset
+ * Returns:
+ *   		None
+ */
+void sump_config_reset(sump_config_t *config){
+	memset(config, 0, sizeof(*config));
+	config->divider = SUMP_CLOCK / SUMP_MAX_SAMPLE_RATE - 1;
+	config->read_count = 4096;
+	config->delay_count = 4096;
+	config->flags = 0xE << SUMP_FLAG_GROUPS_Pos;
+}
+
+/*
+ * Description: feeds one received byte to the command parser
+ * Parameters:
+ * 		sump_parser_t *parser parser state, zeroed before the first byte
+ * 		uint8_t byte received byte
+ * 		uint8_t *cmd set to the command when one is complete
+ * 		uint32_t *arg set to the argument of a long command, 0 for a short one
+ * Returns:
+ *   		bool true if a command is complete
+ */
+bool sump_parse(sump_parser_t *parser, uint8_t byte, uint8_t *cmd, uint32_t *arg){
+	if(parser->len == 0){
+		if(!(byte & 0x80)){
+			*cmd = byte;
+			*arg = 0;
+			return true;
+		}
+		parser->cmd = byte;
+		parser->arg = 0;
+		parser->len = 1;
+		return false;
+	}
+
+	parser->arg |= (uint32_t)byte << (8 * (parser->len - 1));
+	parser->len++;
+	if(parser->len < 5)
+		return false;
+
+	parser->len = 0;
+	*cmd = parser->cmd;
+	*arg = parser->arg;
+	return true;
+}
+
+/*
+ * Description: applies a configuration command, other commands are ignored
+ * Parameters:
+ * 		sump_config_t *config configuration to change
+ * 		uint8_t cmd command
+ * 		uint32_t arg argument of the command
+ * Returns:
+ *   		None
+ */
+void sump_apply(sump_config_t *config, uint8_t cmd, uint32_t arg){
+	switch(cmd){
+	case SUMP_SET_DIVIDER:
+		config->divider = arg & 0xFFFFFF;
+		break;
+	case SUMP_SET_READ_DELAY:
+		config->read_count = ((arg & 0xFFFF) + 1) * 4;
+		config->delay_count = ((arg >> 16) + 1) * 4;
+		break;
+	case SUMP_SET_READ_COUNT:
+		config->read_count = (arg + 1) * 4;
+		break;
+	case SUMP_SET_DELAY_COUNT:
+		config->delay_count = (arg + 1) * 4;
+		break;
+	case SUMP_SET_FLAGS:
+		config->flags = arg;
+		break;
+	case SUMP_SET_TRIGGER_MASK:
+		config->trigger_mask = (uint8_t)arg;
+		break;
+	case SUMP_SET_TRIGGER_VALUE:
+		config->trigger_value = (uint8_t)arg;
+		break;
+	default:
+		break;		//the other trigger stages and settings are not supported
+	}
+}
+
+/*
+ * Description: gives the sampling rate asked by the divider, limited to SUMP_MAX_SAMPLE_RATE
+ * Parameters:
+ * 		const sump_config_t *config configuration
+ * Returns:
+ *   		uint32_t sampling frequency in Hz
+ */
+uint32_t sump_sample_rate(const sump_config_t *config){
+	uint32_t rate = SUMP_CLOCK / (config->divider + 1);
+	return (rate > SUMP_MAX_SAMPLE_RATE) ? SUMP_MAX_SAMPLE_RATE : rate;
+}
+
+/*
+ * Description: gives the number of bytes sent for each sample, one per enabled group of channels
+ * Parameters:
+ * 		const sump_config_t *config configuration
+ * Returns:
+ *   		uint8_t bytes per sample
+ */
+uint8_t sump_bytes_per_sample(const sump_config_t *config){
+	uint8_t bytes = 0;
+	for(int group = 0; group < 4; group++){
+		if(!(config->flags & (1 << (SUMP_FLAG_GROUPS_Pos + group))))
+			bytes++;
+	}
+	return bytes;
+}
+
+/*
+ * Description: gives the most samples a capture can take now, the room capture_room finds
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t number of samples, in whole blocks
+ */
+static uint32_t sump_room(void){
+	return capture_room() / SUMP_BLOCK_SIZE * SUMP_BLOCK_SIZE;
+}
+
+/*
+ * Description: builds the reply to the metadata command
+ * Parameters:
+ * 		uint8_t *buf buffer to fill
+ * 		uint32_t size size of the buffer, 64 bytes are enough
+ * Returns:
+ *   		uint32_t length of the reply, 0 if the buffer is too small
+ */
+uint32_t sump_metadata(uint8_t *buf, uint32_t size){
+	uint32_t len = 0;
+
+	if(size < 64)
+		return 0;
+	len += put_string(buf + len, SUMP_META_NAME, SUMP_DEVICE_NAME);
+	len += put_string(buf + len, SUMP_META_FIRMWARE, SUMP_FIRMWARE_VERSION);
+	len += put_u32(buf + len, SUMP_META_PROBES, SUMP_PROBES);
+	len += put_u32(buf + len, SUMP_META_MEMORY, sump_room());
+	len += put_u32(buf + len, SUMP_META_MAX_RATE, SUMP_MAX_SAMPLE_RATE);
+	len += put_u32(buf + len, SUMP_META_PROTOCOL, 2);
+	buf[len++] = SUMP_META_END;
+	return len;
+}
+
+/*
+ * Description: looks for the first sample matching the trigger
+ * Parameters:
+ * 		const uint8_t *samples captured samples
+ * 		uint32_t from index of the first sample to look at
+ * 		uint32_t to index after the last sample to look at
+ * 		uint8_t mask channels the trigger looks at
+ * 		uint8_t value level these channels must have
+ * Returns:
+ *   		uint32_t index of the sample, SUMP_NO_TRIGGER if none matches
+ */
+uint32_t sump_find_trigger(const uint8_t *samples, uint32_t from, uint32_t to, uint8_t mask, uint8_t value){
+	value &= mask;
+	for(uint32_t i = from; i < to; i++){
+		if((samples[i] & mask) == value)
+			return i;
+	}
+	return SUMP_NO_TRIGGER;
+}
+
+/*
+ * Description: tells if a byte received at the start of a line is a host opening a SUMP session
+ * Parameters:
+ * 		uint8_t byte received byte
+ * Returns:
+ *   		bool true for reset, ID and metadata
+ */
+bool sump_is_start(uint8_t byte){
+	return (byte == SUMP_RESET || byte == SUMP_ID || byte == SUMP_METADATA);
+}
+
+/*
+ * sends the samples last first, with a zero byte for every enabled group above the first
+ */
+static void send_samples(const uint8_t *samples, uint32_t count, const sump_config_t *config){
+	uint8_t chunk[SUMP_SEND_CHUNK];
+	uint8_t bytes = sump_bytes_per_sample(config);
+	bool first_group = !(config->flags & (1 << SUMP_FLAG_GROUPS_Pos));
+	uint32_t fill = 0;
+
+	for(uint32_t i = count; i > 0; i--){
+		for(uint8_t b = 0; b < bytes; b++){
+			chunk[fill++] = (b == 0 && first_group) ? samples[i - 1] : 0;
+		}
+		if(fill > SUMP_SEND_CHUNK - 4){
+			fwrite(chunk, 1, fill, stdout);
+			fill = 0;
+		}
+	}
+	if(fill)
+		fwrite(chunk, 1, fill, stdout);
+	fflush(stdout);
+}
+
+/*
+ * takes a capture as configured and sends it. Returns false if the host sent a reset meanwhile
+ */
+static bool capture(const sump_config_t *config){
+	uint32_t read = config->read_count;
+	uint32_t delay = config->delay_count;
+	bool triggered = (config->trigger_mask != 0);
+	uint32_t room = sump_room();
+	uint32_t total, pre, trigger = SUMP_NO_TRIGGER;
+	uint8_t *samples = NULL;
+
+	if(read > room)
+		read = room;
+	if(delay > read)
+		delay = read;
+	pre = read - delay;
+
+	//with a trigger all the room is used, so it has room to come
+	total = triggered ? room : read;
+	total = ((total + SUMP_BLOCK_SIZE - 1) / SUMP_BLOCK_SIZE) * SUMP_BLOCK_SIZE;
+	if(room != 0)
+		samples = reserve_capture_region(total);
+	else
+		total = ((config->read_count + SUMP_BLOCK_SIZE - 1) / SUMP_BLOCK_SIZE) * SUMP_BLOCK_SIZE;
+	if(samples == NULL){
+		//the protocol has no way to report it, the host times out and mem tells why
+		stats.refused++;
+		stats.refused_len = total;
+		return true;
+	}
+	stats.captures++;
+
+	while(trigger == SUMP_NO_TRIGGER){
+		uint32_t scanned = pre;
+		timing_mode_start(sump_sample_rate(config), total / SUMP_BLOCK_SIZE - 1);
+
+		while(1){
+			bool done = get_done();
+			uint32_t avail = done ? total : (uint32_t)get_timing_blocks_done() * SUMP_BLOCK_SIZE;
+
+			HW_WAIT();
+			if(char_available() && get_char() == SUMP_RESET){
+				abort_timing_capture();
+				return false;
+			}
+			user_fatfs_save_poll();
+
+			if(!triggered){
+				if(done)
+					break;
+				continue;
+			}
+			if(trigger == SUMP_NO_TRIGGER){
+				//a trigger too close to the end has no room for the samples after it
+				uint32_t limit = (avail < total - delay) ? avail : total - delay;
+				if(limit > scanned){
+					trigger = sump_find_trigger(samples, scanned, limit, config->trigger_mask, config->trigger_value);
+					scanned = limit;
+				}
+			}
+			if(trigger != SUMP_NO_TRIGGER && avail >= trigger + delay){
+				if(!done)
+					abort_timing_capture();
+				break;
+			}
+			if(done)
+				break;
+		}
+		reset_done();
+		if(!triggered)
+			break;
+	}
+
+	if(triggered){
+		set_trigger_position(trigger);
+		set_capture_length(trigger + delay);
+		send_samples(samples + trigger - pre, read, config);
+	}else{
+		set_capture_length(read);
+		send_samples(samples, read, config);
+	}
+	return true;
+}
+
+const sump_stats_t *sump_get_stats(void){
+	return &stats;
+}
+
+/*
+ * Description: runs a SUMP session on the console uart until the host sends a carriage return or
+ * 				line feed in place of a command
+ * Parameters:
+ * 		uint8_t first byte that started the session
+ * Returns:
+ *   		None
+ */
+void sump_run(uint8_t first){
+	sump_parser_t parser = { 0 };
+	sump_config_t config;
+	uint8_t byte = first;
+	uint8_t cmd;
+	uint32_t arg;
+
+	sump_config_reset(&config);
+	while(1){
+		if(parser.len == 0 && (byte == '\r' || byte == '\n'))
+			return;
+
+		if(sump_parse(&parser, byte, &cmd, &arg)){
+			switch(cmd){
+			case SUMP_RESET:
+				sump_config_reset(&config);
+				break;
+			case SUMP_ID:
+				fwrite(SUMP_ID_REPLY, 1, strlen(SUMP_ID_REPLY), stdout);
+				fflush(stdout);
+				break;
+			case SUMP_METADATA:{
+				uint8_t meta[64];
+				fwrite(meta, 1, sump_metadata(meta, sizeof(meta)), stdout);
+				fflush(stdout);
+				break;
+			}
+			case SUMP_RUN:
+				if(!capture(&config))
+					sump_config_reset(&config);
+				break;
+			default:
+				sump_apply(&config, cmd, arg);
+				break;
+			}
+		}
+
+		while(!char_available())
+			user_fatfs_save_poll();
+		byte = get_char();
+	}
+}
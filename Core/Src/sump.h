@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    sump.h
+ * @brief   This file contains the function prototypes for the SUMP (Openbench Logic Sniffer) binary
+ * 			protocol, so PulseView and sigrok can drive the analyzer over the console uart. A host
+ * 			starts a session by sending reset or ID where the command processor expects the first
+ * 			character of a line, and a carriage return sent in place of a command ends it.
+ *
+ * 			Commands are one byte, or five when bit 7 is set: the command followed by a 32 bit little
+ * 			endian argument. The captures are taken with the timing mode engine at the rate set by
+ * 			the divider, and only the first trigger stage (mask and value over P0..P7) is used.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __SUMP_H__
+#define __SUMP_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define SUMP_RESET 				0x00
+#define SUMP_RUN 				0x01
+#define SUMP_ID 				0x02
+#define SUMP_METADATA 			0x04
+#define SUMP_XON 				0x11
+#define SUMP_XOFF 				0x13
+#define SUMP_SET_DIVIDER 		0x80
+#define SUMP_SET_READ_DELAY 	0x81	//read and delay count in units of 4 samples, 16 bits each
+#define SUMP_SET_FLAGS 			0x82
+#define SUMP_SET_DELAY_COUNT 	0x83	//32 bit delay count, used by hosts when the memory is above 256K samples
+#define SUMP_SET_READ_COUNT 	0x84	//32 bit read count
+#define SUMP_SET_TRIGGER_MASK 	0xC0	//stage 0, the other stages are 0xC4, 0xC8 and 0xCC
+#define SUMP_SET_TRIGGER_VALUE 	0xC1
+#define SUMP_SET_TRIGGER_CONFIG 0xC2
+
+#define SUMP_CLOCK 100000000				//the divider counts in periods of this clock
+#define SUMP_MAX_SAMPLE_RATE 1000000
+#define SUMP_PROBES 8
+#define SUMP_FLAG_GROUPS_Pos 2				//bits 2..5 of the flags disable the 4 groups of 8 channels
+#define SUMP_FLAG_GROUPS_Msk (0xF << SUMP_FLAG_GROUPS_Pos)
+#define SUMP_NO_TRIGGER 0xFFFFFFFF
+
+typedef struct{
+	uint8_t cmd;
+	uint8_t len;		//bytes of the long command received so far, 0 between commands
+	uint32_t arg;
+}sump_parser_t;
+
+typedef struct{
+	uint32_t captures;			//run commands a capture was taken for
+	uint32_t refused;			//run commands with no room in SDRAM, the host only times out
+	uint32_t refused_len;		//bytes the last refused capture wanted
+}sump_stats_t;
+
+typedef struct{
+	uint32_t divider;
+	uint32_t read_count;		//samples sent back
+	uint32_t delay_count;		//samples sent back after the trigger
+	uint32_t flags;
+	uint8_t trigger_mask;
+	uint8_t trigger_value;
+}sump_config_t;
+
+/*
+ * Description: sets a configuration to the state after a reset, 1MHz, 4096 samples without
+ * 				trigger and only the first group of channels
+ * Parameters:
+ * 		sump_config_t *config configuration to reset
+ * Returns:
+ *   		None
+ */
+void sump_config_reset(sump_config_t *config);
+
+/*
+ * Description: feeds one received byte to the command parser
+ * Parameters:
+ * 		sump_parser_t *parser parser state, zeroed before the first byte
+ * 		uint8_t byte received byte
+ * 		uint8_t *cmd set to the command when one is complete
+ * 		uint32_t *arg set to the argument of a long command, 0 for a short one
+ * Returns:
+ *   		bool true if a command is complete
+ */
+bool sump_parse(sump_parser_t *parser, uint8_t byte, uint8_t *cmd, uint32_t *arg);
+
+/*
+ * Description: applies a configuration command, other commands are ignored
+ * Parameters:
+ * 		sump_config_t *config configuration to change
+ * 		uint8_t cmd command
+ * 		uint32_t arg argument of the command
+ * Returns:
+ *   		None
+ */
+void sump_apply(sump_config_t *config, uint8_t cmd, uint32_t arg);
+
+/*
+ * Description: gives the sampling rate asked by the divider, limited to SUMP_MAX_SAMPLE_RATE
+ * Parameters:
+ * 		const sump_config_t *config configuration
+ * Returns:
+ *   		uint32_t sampling frequency in Hz
+ */
+uint32_t sump_sample_rate(const sump_config_t *config);
+
+/*
+ * Description: gives the number of bytes sent for each sample, one per enabled group of channels
+ * Parameters:
+ * 		const sump_config_t *config configuration
+ * Returns:
+ *   		uint8_t bytes per sample
+ */
+uint8_t sump_bytes_per_sample(const sump_config_t *config);
+
+/*
+ * Description: builds the reply to the metadata command
+ * Parameters:
+ * 		uint8_t *buf buffer to fill
+ * 		uint32_t size size of the buffer, 64 bytes are enough
+ * Returns:
+ *   		uint32_t length of the reply, 0 if the buffer is too small
+ */
+uint32_t sump_metadata(uint8_t *buf, uint32_t size);
+
+/*
+ * Description: looks for the first sample matching the trigger
+ * Parameters:
+ * 		const uint8_t *samples captured samples
+ * 		uint32_t from index of the first sample to look at
+ * 		uint32_t to index after the last sample to look at
+ * 		uint8_t mask channels the trigger looks at
+ * 		uint8_t value level these channels must have
+ * Returns:
+ *   		uint32_t index of the sample, SUMP_NO_TRIGGER if none matches
+ */
+uint32_t sump_find_trigger(const uint8_t *samples, uint32_t from, uint32_t to, uint8_t mask, uint8_t value);
+
+/*
+ * Description: tells if a byte received at the start of a line is a host opening a SUMP session
+ * Parameters:
+ * 		uint8_t byte received byte
+ * Returns:
+ *   		bool true for reset, ID and metadata
+ */
+bool sump_is_start(uint8_t byte);
+
+/*
+ * Description: gives the counters of the run commands since boot, for the mem command
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const sump_stats_t * counters
+ */
+const sump_stats_t *sump_get_stats(void);
+
+/*
+ * Description: runs a SUMP session on the console uart until the host sends a carriage return or
+ * 				line feed in place of a command
+ * Parameters:
+ * 		uint8_t first byte that started the session
+ * Returns:
+ *   		None
+ */
+void sump_run(uint8_t first);
+
+#endif
@@ -19,13 +19,16 @@
  */
 #include "systick.h"
 #include "stm32f429xx.h"
+#include "pll_clock.h"
+#include "perf.h"
 
 extern uint16_t Timer1, Timer2;
 
-#define SYSTICK_LOAD_VALUE 20000//for tick every 1ms
+#define SYSTICK_HZ 1000			//for tick every 1ms
+#define SYSTICK_CLK_DIV 8		//CLKSOURCE is left clear, the SysTick counts the AHB clock / 8
 
-ticktime_t tick = 0;
-ticktime_t clock_tick = 0;
+volatile ticktime_t tick = 0;
+volatile ticktime_t clock_tick = 0;
 /*
  * Initializes the Systick timer. It is configured to generate an interrupt every 1ms which is used to
  * increment the tick variable.
@@ -38,7 +41,7 @@ ticktime_t clock_tick = 0;
  */
 void init_systick()
 {
-	SysTick->LOAD = SYSTICK_LOAD_VALUE;
+	SysTick->LOAD = get_ahb_clk_freq() / SYSTICK_CLK_DIV / SYSTICK_HZ - 1;
 	SysTick->VAL = 0;//to clear SYST_CVR, since startup value is unknown
 	NVIC_EnableIRQ(SysTick_IRQn);
 	SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
@@ -99,6 +102,52 @@ void b_delay(int ms){
 	while(get_clock() < ms);
 }
 
+/*
+ * Enables the DWT cycle counter, which counts core clock cycles from then on. It is used to time
+ * stages shorter than a tick, such as the steps of the boot.
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void init_cycle_counter(){
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*
+ * A function to get the number of core clock cycles counted by the DWT cycle counter. It wraps
+ * after 2^32 cycles, about 24s at 180MHz, so only differences of close readings are meaningful
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  uint32_t current value of the cycle counter
+ */
+uint32_t get_cycles(){
+	return DWT->CYCCNT;
+}
+
+/*
+ * Function to create a blocking delay of a given number of us with the cycle counter, for waits
+ * where a whole tick of b_delay is too coarse
+ *
+ * Parameters:
+ *  us number of us to delay for
+ *
+ * Returns:
+ *  none
+ */
+void b_delay_us(uint32_t us){
+	uint32_t start = get_cycles();
+	uint32_t wait = us * (get_sysclk_freq() / 1000000);
+	while(get_cycles() - start < wait);
+}
+
 
 
 /*
@@ -112,6 +161,9 @@ void b_delay(int ms){
  */
 void SysTick_Handler()
 {
+	//the counter runs down from LOAD on the core clock divided by 8
+	PERF_LATENCY(PERF_LATENCY_SYSTICK, (SysTick->LOAD - SysTick->VAL) * 8);
+
 	if(Timer1 > 0)//fatfs state variables handling
 		Timer1--;
 
@@ -21,7 +21,7 @@
 #define __SYSTICK_H__
 #include "stm32f429xx.h"
 
-typedef volatile uint32_t ticktime_t;
+typedef uint32_t ticktime_t;
 
 /*
  * Initializes the Systick timer. It is configured to generate an interrupt every 1ms which is used to
@@ -80,4 +80,40 @@ ticktime_t get_clock();
  */
 void b_delay(int ms);
 
+/*
+ * Enables the DWT cycle counter, which counts core clock cycles from then on. It is used to time
+ * stages shorter than a tick, such as the steps of the boot.
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  none
+ */
+void init_cycle_counter();
+
+/*
+ * A function to get the number of core clock cycles counted by the DWT cycle counter. It wraps
+ * after 2^32 cycles, about 24s at 180MHz, so only differences of close readings are meaningful
+ *
+ * Parameters:
+ *  none
+ *
+ * Returns:
+ *  uint32_t current value of the cycle counter
+ */
+uint32_t get_cycles();
+
+/*
+ * Function to create a blocking delay of a given number of us with the cycle counter, for waits
+ * where a whole tick of b_delay is too coarse
+ *
+ * Parameters:
+ *  us number of us to delay for
+ *
+ * Returns:
+ *  none
+ */
+void b_delay_us(uint32_t us);
+
 #endif
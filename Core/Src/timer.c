@@ -18,7 +18,7 @@
  *
  */
 #include "timer.h"
-#include "stm32f429xx.h"
+#include "hw_access.h"
 
 #define ITR0_MASK 0b000
 #define ITR3_MASK 0b011
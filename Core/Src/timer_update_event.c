@@ -24,9 +24,12 @@
 #include "stdbool.h"
 #include "timer_update_event.h"
 #include "timing_mode_init.h"
-#include "stm32f429xx.h"
+#include "hw_access.h"
+#include "fmc.h"
+#include "pll_clock.h"
+#include "perf.h"
+#include "capture_health.h"
 
-#define TIMING_MODE_SDRAM_ADDR ((uint8_t*)0xD0000000)
 #define SDRAM_SIZE_TEST 0x800000
 
 static uint16_t _count = 0;
@@ -58,6 +61,45 @@ void timer_update_event_init(timing_mode_freq_t freq ,bool is_i2c_asked){
 }
 
 
+/*
+ * Description: initialises the timer for the timer update event at any sampling rate, for hosts
+ * 				that choose the rate themselves. The prescaler is used below the timer clock/65536
+ * Parameters:
+ * 		uint32_t rate sampling frequency in Hz
+ * 		bool is_i2c_asked which tells that does the user wants to sample i2c data or not
+ * Returns:
+ *   		uint32_t sampling frequency the timer really gives, 0 if the rate is 0
+ */
+uint32_t timer_update_event_init_rate(uint32_t rate, bool is_i2c_asked){
+	uint32_t timer_clk = get_apb2_clk_freq() * 2;	//timers on a divided APB2 run at twice its clock
+	uint32_t ticks, psc;
+
+	if(rate == 0)
+		return 0;
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_GPIOCEN_Msk;
+	RCC->APB2ENR |= RCC_APB2ENR_TIM1EN_Msk;
+
+	if(is_i2c_asked == true)
+		GPIOC->PUPDR = 0xAAA0 << 16;              // making all the pins pull down
+	else
+		GPIOC->PUPDR = 0xAAAA << 16;
+
+	ticks = (timer_clk + rate / 2) / rate;
+	if(ticks < 2)
+		ticks = 2;
+	psc = (ticks - 1) / 65536;
+	ticks /= (psc + 1);
+	TIM1->PSC = psc;
+	TIM1->ARR = ticks - 1;
+	TIM1->EGR = TIM_EGR_UG;		// load the prescaler now, before the dma requests are enabled
+	TIM1->SR &= ~TIM_SR_UIF;
+	TIM1->DIER |= TIM_DIER_UDE_Msk;  // enable dma on timer update
+
+	return timer_clk / ((psc + 1) * ticks);
+}
+
+
 /*
  * Description: It disables the button timer and also disable the dma request from the timer
  * Parameters:
@@ -105,19 +147,22 @@ void button_dma_init_timing_mode(uint16_t count){
 
 	NVIC_EnableIRQ(DMA2_Stream5_IRQn);
 	DMA2_Stream5->PAR = (uint32_t)0x40020811;
-	DMA2_Stream5->M0AR = (uint32_t)TIMING_MODE_SDRAM_ADDR;
+	DMA2_Stream5->M0AR = (uint32_t)get_capture_address();
 	DMA2_Stream5->NDTR = 32768;
 	DMA2_Stream5->CR |= DMA_SxCR_CHSEL_2 | DMA_SxCR_CHSEL_1 /*| DMA_SxCR_HTIE_Msk*/;
 	DMA2_Stream5->CR |= DMA_SxCR_PL_1 | DMA_SxCR_PL_0;
 	//PSIZE , MSIZE to be 8bit by default
 	DMA2_Stream5->CR |= DMA_SxCR_MINC;
 	DMA2_Stream5->CR |= DMA_SxCR_TCIE_Msk;
+	DMA2_Stream5->CR |= DMA_SxCR_TEIE | DMA_SxCR_DMEIE;	//counted in capture_health.c
+	DMA2_Stream5->FCR |= DMA_SxFCR_FEIE;
 
 }
 
 
 /*
- * Description: It sets the ARR value corresponfing what we frquency of sampling the user wants
+ * Description: It sets the ARR value corresponfing what we frquency of sampling the user wants, from
+ * 				the timer clock, so 1799 for 100kHz at 180MHz
  * Parameters:
  * 		timing_mode_freq_t freq which the user wants
  *
@@ -125,34 +170,20 @@ void button_dma_init_timing_mode(uint16_t count){
  *   		None
  */
 static void set_arr(timing_mode_freq_t freq){
-	switch(freq){
-	case FREQ_100KHz:
-			TIM1->ARR = 1599;
-			break;
-	case FREQ_200KHz:
-			TIM1->ARR = 799;
-			break;
-
-	case FREQ_400KHz:
-			TIM1->ARR = 399;
-			break;
-
-	case FREQ_800KHz:
-			TIM1->ARR = 199;
-			break;
-
-	case FREQ_1000KHz:
-			TIM1->ARR = 159;
-			break;
-
-	default:
-		break;
-	}
+	uint32_t timer_clk = get_apb2_clk_freq() * 2;	//timers on a divided APB2 run at twice its clock
+	uint32_t hz = timing_freq_hz(freq);
+
+	TIM1->PSC = 0;	// may have been changed by timer_update_event_init_rate
+	TIM1->EGR = TIM_EGR_UG;
+	TIM1->SR &= ~TIM_SR_UIF;
+	if(hz != 0)
+		TIM1->ARR = timer_clk / hz - 1;
 }
 
 
 /*
- * Description: IRQ handler for the dma2 stream 5 which occurs till the commplete asked data is not captured
+ * Description: IRQ handler for the dma2 stream 5 which occurs till the commplete asked data is not captured.
+ * 				A transfer error has stopped the stream, it ends the capture, which then fails
  * Parameters:
  * 		None
  *
@@ -160,11 +191,20 @@ static void set_arr(timing_mode_freq_t freq){
  *   		None
  */
 void DMA2_Stream5_IRQHandler(){
+	uint32_t flags = capture_health_dma_flags(5);
+
+	//the last request of the block came at the update event, the counter has counted since
+	PERF_LATENCY(PERF_LATENCY_DMA2_STREAM5, perf_timer_ticks_to_cycles(TIM1->CNT, TIM1->PSC));
+	PERF_BEGIN(PERF_DMA2_STREAM5_IRQ);
 	DMA2->HIFCR |= DMA_HIFCR_CTCIF5;
 	DMA2->HIFCR |= DMA_HIFCR_CHTIF5;
 	NVIC_ClearPendingIRQ(DMA2_Stream5_IRQn);
 
-	if(count == _count){
+	if(flags & DMA_LISR_TCIF0)
+		capture_health_block_end(TIM1->CNT, TIM1->PSC, TIM1->ARR + 1);
+
+	//a FIFO or direct mode error alone leaves the stream going
+	if((flags & DMA_LISR_TEIF0) || ((flags & DMA_LISR_TCIF0) && count == _count)){
 		TIM1->DIER &= ~(TIM_DIER_UDE_Msk);
 		disable_dma_2_stream5();
 		reset_pull_states();
@@ -172,14 +212,49 @@ void DMA2_Stream5_IRQHandler(){
 		count = 0;
 		_count = 0;
 	}
-	else{
+	else if(flags & DMA_LISR_TCIF0){
 		count++;
 
 	disable_dma_2_stream5();
 	DMA2_Stream5->M0AR += 32768;
 	DMA2_Stream5->NDTR = 32768;
 	enable_dma_2_stream5();
+	capture_health_stream_started(TIM1->CNT, TIM1->PSC, TIM1->ARR + 1);
 	}
+	PERF_END(PERF_DMA2_STREAM5_IRQ);
+}
+
+
+/*
+ * Description: returns how many blocks of 32KB of the running capture are complete, so they can
+ * 				be looked at while the next ones are filled. Once get_done is true all are complete
+ * Parameters:
+ * 		None
+ *
+ * Returns:
+ *   		uint16_t number of complete blocks
+ */
+uint16_t get_timing_blocks_done(void){
+	return count;
+}
+
+
+/*
+ * Description: stops the capture before all the blocks are filled
+ * Parameters:
+ * 		None
+ *
+ * Returns:
+ *   		None
+ */
+void abort_timing_capture(void){
+	TIM1->DIER &= ~(TIM_DIER_UDE_Msk);
+	disable_dma_2_stream5();
+	TIM1->CR1 &= ~TIM_CR1_CEN;
+	reset_pull_states();
+	count = 0;
+	_count = 0;
+	done = false;
 }
 
 
@@ -191,7 +266,7 @@ void DMA2_Stream5_IRQHandler(){
  * Returns:
  *   		returns the status of the done flag
  */
-volatile bool get_done(){
+bool get_done(){
 
 	return done;
 }
@@ -204,7 +279,7 @@ volatile bool get_done(){
  * Returns:
  *   		void
  */
-volatile void reset_done(){
+void reset_done(){
 	done = false;
 }
 
@@ -23,15 +23,19 @@
 #define SRC_TIMER_UPDATE_EVENT_H_
 #include "timing_mode_init.h"
 #include "stdbool.h"
+#include "stdint.h"
 
 
 void timer_update_event_init(timing_mode_freq_t freq ,bool is_i2c_asked);
 void button_dma_init_timing_mode(uint16_t count);
-volatile bool get_done();
-volatile void reset_done();
+bool get_done();
+void reset_done();
 void enable_dma_2_stream5(void);
 void reset_pull_states();
 void disable_dma_2_stream5(void);
 void enable_button_timer(void);
 void disable_button_timer(void);
+uint32_t timer_update_event_init_rate(uint32_t rate, bool is_i2c_asked);
+uint16_t get_timing_blocks_done(void);
+void abort_timing_capture(void);
 #endif /* SRC_TIMER_UPDATE_EVENT_H_ */
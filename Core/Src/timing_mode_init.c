@@ -26,9 +26,15 @@
 #include "state_mode.h"
 #include "button_init.h"
 #include "input_capture_dma.h"
-#include "stm32f429xx.h"
+#include "hw_access.h"
+#include "user_fatfs.h"
+#include "capture_health.h"
 char* freq_table[] ={"100","200","400","800","1000"};//order of this arr must match timing enum
 int freq_table_len = sizeof(freq_table)/sizeof(freq_table[0]);
+static const uint32_t freq_table_hz[] = {100000, 200000, 400000, 800000, 1000000};//order must match timing enum
+static uint32_t sample_rate = 0;
+static uint32_t trigger_position = NO_TRIGGER_POSITION;
+static uint32_t capture_length = 0;
 
 
 bool timing_mode_init(uint8_t mode, timing_mode_freq_t freq, bool is_i2c_asked, uint16_t count){
@@ -40,17 +46,142 @@ bool timing_mode_init(uint8_t mode, timing_mode_freq_t freq, bool is_i2c_asked,
 	disable_dma2_stream_3();
 	disable_dma_2_stream5();
 	disable_button_timer();
+	capture_health_reset(false);
 	button_init(TIMING_MODE);
 	button_dma_init_timing_mode(count);
 	timer_update_event_init(freq, is_i2c_asked);
 	enable_button_timer();
 
-	while(get_done() == false);
+	while(get_done() == false){
+		HW_WAIT();
+		user_fatfs_save_poll();//a background save goes on while waiting for the capture
+	}
 	reset_done();
+	set_sample_rate(timing_freq_hz(freq));
+	set_trigger_position(NO_TRIGGER_POSITION);
+	set_capture_length((uint32_t)count * 32768);
 
-	return true;
+	return capture_health_get()->transfer_errors == 0;
 
 }
 
+/*
+ * Description: gives the sampling frequency of a timing mode setting, the timer period is
+ * 				computed from it and the timer clock
+ * Parameters:
+ * 		timing_mode_freq_t freq setting
+ * Returns:
+ *   		uint32_t sampling frequency in Hz, 0 if the setting is unknown
+ */
+uint32_t timing_freq_hz(timing_mode_freq_t freq){
+	if((uint32_t)freq >= sizeof(freq_table_hz)/sizeof(freq_table_hz[0]))
+		return 0;
+	return freq_table_hz[freq];
+}
+
+/*
+ * Description: starts a timing mode capture straight away at any sampling rate, instead of waiting
+ * 				for the button, for hosts that choose the rate and start the capture themselves. Like
+ * 				timing_mode_init it fills count+1 blocks of 32KB from get_capture_address; the caller
+ * 				polls get_done or get_timing_blocks_done, and may stop it with abort_timing_capture
+ * Parameters:
+ * 		uint32_t rate sampling frequency in Hz
+ * 		uint16_t count size of the capture in blocks of 32KB, minus one
+ * Returns:
+ *   		uint32_t sampling frequency really used, 0 if the rate is 0 and nothing was started
+ */
+uint32_t timing_mode_start(uint32_t rate, uint16_t count){
+	uint32_t actual;
+
+	if(rate == 0)
+		return 0;
+
+	disable_all_timers();
+	disable_dma2_stream_2();
+	disable_dma2_stream_3();
+	disable_dma_2_stream5();
+	disable_button_timer();
+	reset_done();
+	capture_health_reset(false);
+	button_dma_init_timing_mode(count);
+	actual = timer_update_event_init_rate(rate, false);
+	enable_dma_2_stream5();
+	capture_health_stream_started(TIM1->CNT, TIM1->PSC, TIM1->ARR + 1);
+	enable_button_timer();
+
+	set_sample_rate(actual);
+	set_trigger_position(NO_TRIGGER_POSITION);
+	set_capture_length(0);
+	return actual;
+}
+
+/*
+ * Description: returns the sampling frequency of the last capture, used by the analysers to
+ * 				convert between time and samples
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t sampling frequency in Hz, 0 if unknown (state mode or nothing captured yet)
+ */
+uint32_t get_sample_rate(void){
+	return sample_rate;
+}
+
+/*
+ * Description: sets the sampling frequency of the last capture
+ * Parameters:
+ * 		uint32_t rate sampling frequency in Hz, 0 if unknown
+ * Returns:
+ *   		None
+ */
+void set_sample_rate(uint32_t rate){
+	sample_rate = rate;
+}
+
+/*
+ * Description: returns the sample index of the trigger in the last capture, saved in the
+ * 				header of the capture file
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t sample index of the trigger, NO_TRIGGER_POSITION if the capture was not triggered
+ */
+uint32_t get_trigger_position(void){
+	return trigger_position;
+}
+
+/*
+ * Description: sets the sample index of the trigger in the last capture
+ * Parameters:
+ * 		uint32_t position sample index of the trigger, NO_TRIGGER_POSITION if none
+ * Returns:
+ *   		None
+ */
+void set_trigger_position(uint32_t position){
+	trigger_position = position;
+}
+
+/*
+ * Description: returns the length of the last capture, or of the capture loaded from the sd card
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t length in bytes, 0 if nothing was captured yet
+ */
+uint32_t get_capture_length(void){
+	return capture_length;
+}
+
+/*
+ * Description: sets the length of the last capture
+ * Parameters:
+ * 		uint32_t len length in bytes
+ * Returns:
+ *   		None
+ */
+void set_capture_length(uint32_t len){
+	capture_length = len;
+}
+
 
 
@@ -25,6 +25,7 @@
 
 #define TIMING_MODE 1
 #define STATE_MODE 2
+#define NO_TRIGGER_POSITION 0xFFFFFFFF
 
 #include "stdbool.h"
 #include "stdint.h"
@@ -42,4 +43,83 @@ extern char* freq_table[5];
 
 bool timing_mode_init(uint8_t mode, timing_mode_freq_t freq, bool is_i2c_asked, uint16_t count);
 
+/*
+ * Description: gives the sampling frequency of a timing mode setting, the timer period is
+ * 				computed from it and the timer clock
+ * Parameters:
+ * 		timing_mode_freq_t freq setting
+ * Returns:
+ *   		uint32_t sampling frequency in Hz, 0 if the setting is unknown
+ */
+uint32_t timing_freq_hz(timing_mode_freq_t freq);
+
+/*
+ * Description: starts a timing mode capture straight away at any sampling rate, instead of waiting
+ * 				for the button, for hosts that choose the rate and start the capture themselves. Like
+ * 				timing_mode_init it fills count+1 blocks of 32KB from get_capture_address; the caller
+ * 				polls get_done or get_timing_blocks_done, and may stop it with abort_timing_capture
+ * Parameters:
+ * 		uint32_t rate sampling frequency in Hz
+ * 		uint16_t count size of the capture in blocks of 32KB, minus one
+ * Returns:
+ *   		uint32_t sampling frequency really used, 0 if the rate is 0 and nothing was started
+ */
+uint32_t timing_mode_start(uint32_t rate, uint16_t count);
+
+/*
+ * Description: returns the sampling frequency of the last capture, used by the analysers to
+ * 				convert between time and samples
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t sampling frequency in Hz, 0 if unknown (state mode or nothing captured yet)
+ */
+uint32_t get_sample_rate(void);
+
+/*
+ * Description: sets the sampling frequency of the last capture
+ * Parameters:
+ * 		uint32_t rate sampling frequency in Hz, 0 if unknown
+ * Returns:
+ *   		None
+ */
+void set_sample_rate(uint32_t rate);
+
+/*
+ * Description: returns the sample index of the trigger in the last capture, saved in the
+ * 				header of the capture file
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t sample index of the trigger, NO_TRIGGER_POSITION if the capture was not triggered
+ */
+uint32_t get_trigger_position(void);
+
+/*
+ * Description: sets the sample index of the trigger in the last capture
+ * Parameters:
+ * 		uint32_t position sample index of the trigger, NO_TRIGGER_POSITION if none
+ * Returns:
+ *   		None
+ */
+void set_trigger_position(uint32_t position);
+
+/*
+ * Description: returns the length of the last capture, or of the capture loaded from the sd card
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t length in bytes, 0 if nothing was captured yet
+ */
+uint32_t get_capture_length(void);
+
+/*
+ * Description: sets the length of the last capture
+ * Parameters:
+ * 		uint32_t len length in bytes
+ * Returns:
+ *   		None
+ */
+void set_capture_length(uint32_t len);
+
 #endif /* SRC_TIMING_MODE_INIT_H_ */
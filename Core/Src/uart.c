@@ -11,7 +11,10 @@
 /**
  * @file    uart.c
  * @brief   UART Drive Coder. Provides functions to initialize the UART,
- * 			and remap printf to uart
+ * 			and remap printf to uart. Output goes to a ring buffer which is sent by
+ * 			DMA1 stream 6, so printf only waits for the serial line when the buffer
+ * 			is full. There is one writer (the main loop), and the dma interrupt is
+ * 			the only reader, so the indices need no lock.
  *
  *
  * @author  Krish Shah
@@ -19,23 +22,59 @@
  *
  */
 #include "uart.h"
-#include "stm32f429xx.h"
+#include "hw_access.h"
+#include "pll_clock.h"
+#include "systick.h"
+#include "perf.h"
 #include <stdio.h>
+#include <string.h>
 
-#define UART_BRR_MANTISSA_115200_BAUD 21
-#define UART_BRR_FRACTION_115200_BAUD 11
+#define UART_TX_MASK (UART_TX_BUFFER_SIZE - 1)
+#define UART_TX_DMA_CHANNEL (4 << DMA_SxCR_CHSEL_Pos)	//USART2_TX is DMA1 stream 6 channel 4
+#define UART_TX_DMA_FLAGS (DMA_HISR_TCIF6 | DMA_HISR_TEIF6)
+#define UART_TX_DROP_NOTE_LEN 40						//room needed to print the dropped byte count
+#define UART_RX_MASK (UART_RX_BUFFER_SIZE - 1)
+#define UART_RX_ERROR_FLAGS (USART_SR_FE | USART_SR_NE)
 
+static uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head;		//free running index of the next free byte, moved by the writer
+static volatile uint32_t tx_tail;		//free running index of the first unsent byte, moved by the dma interrupt
+static volatile uint32_t tx_dma_len;	//bytes in the running dma transfer, 0 when idle
+static uart_tx_overflow_t tx_overflow = UART_TX_OVERFLOW_BLOCK;
+static uint32_t tx_unreported_drops;
+static uart_tx_stats_t tx_stats;
+static uint32_t current_baud;
+static uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head;		//free running index of the next free byte, moved by the usart interrupt
+static volatile uint32_t rx_tail;		//free running index of the first unread byte, moved by get_char
+static volatile uart_rx_stats_t rx_stats;
+
+
+/*
+ * Writes the baud rate registers. The usart is disabled while they change and enabled again
+ * with the transmitter and receiver on.
+ */
+static void uart_write_brr(uint32_t brr, bool over8){
+	USART2->CR1 &= ~USART_CR1_UE;
+	USART2->BRR = brr;
+	if(over8){
+		USART2->CR1 |= USART_CR1_OVER8;
+	}else{
+		USART2->CR1 &= ~USART_CR1_OVER8;
+	}
+	USART2->CR1 |= USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+}
 
 /*
- * Initializes USART to 1152000 Baud. It uses USART2 on PD5(TX) and PD6(RX).
+ * Initializes USART to UART_DEFAULT_BAUD. It uses USART2 on PD5(TX) and PD6(RX).
  *
  * Baud = Fck/((8 x (2 - OVER8) x USARTDIV)
  *
- * Fck = 40MHz
+ * Fck = APB1 clock, 45MHz at the default clock configuration, see clock_config.h
  * Over8 = 0
- * USARTDIV = (40MHz)/(8 x 2 x 115200) = 21.7
+ * USARTDIV = (45MHz)/(8 x 2 x 115200) = 24.41
  *
- * Therefore, Mantissa = 21 and Fraction = 11 in BRR
+ * Therefore, Mantissa = 24 and Fraction = 7 in BRR, computed by uart_compute_brr from the clock
  *
  * Parameters:
  *  none
@@ -61,19 +100,369 @@ void init_uart(){
 	GPIOD->AFR[0] |= 0b111<<GPIO_AFRL_AFSEL6_Pos;
 
 	//set baudrate to 115200
-	USART2->BRR &= ~(USART_BRR_DIV_Mantissa_Msk | USART_BRR_DIV_Fraction_Msk);
-	USART2->BRR |= ((UART_BRR_MANTISSA_115200_BAUD << USART_BRR_DIV_Mantissa_Pos)
-				   |(UART_BRR_FRACTION_115200_BAUD << USART_BRR_DIV_Fraction_Pos));
-	//enable usart
-	USART2->CR1 |= USART_CR1_UE_Msk;//keep m=0 for 8 bit communication
+	uint32_t brr;
+	bool over8;
+	current_baud = uart_compute_brr(UART_DEFAULT_BAUD, &brr, &over8);
+	//enables the usart with te and re set, keep m=0 for 8 bit communication
 	//keep STOP in cr2 to 00 for 1 stop bit
+	uart_write_brr(brr, over8);
+
+	//transmit through dma1 stream 6, memory to peripheral
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+	DMA1_Stream6->CR = 0;
+	while(DMA1_Stream6->CR & DMA_SxCR_EN);
+	DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+	DMA1_Stream6->PAR = (uint32_t)&USART2->DR;
+	DMA1_Stream6->CR = UART_TX_DMA_CHANNEL | DMA_SxCR_DIR_0 | DMA_SxCR_MINC | DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+	USART2->CR3 |= USART_CR3_DMAT;
+	NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+	//receive through the rxne interrupt into the ring buffer
+	rx_head = rx_tail = 0;
+	USART2->CR1 |= USART_CR1_RXNEIE;
+	NVIC_EnableIRQ(USART2_IRQn);
+}
+
+/*
+ * Moves the received byte into the ring buffer. Reading SR then DR clears RXNE and the error
+ * flags; a byte with a framing or noise error is dropped rather than passed on as garbage.
+ */
+void USART2_IRQHandler(void){
+	uint32_t sr = USART2->SR;
+	uint8_t c;
+
+	if(!(sr & (USART_SR_RXNE | USART_SR_ORE | UART_RX_ERROR_FLAGS))){
+		return;
+	}
+	c = USART2->DR;
+	if(sr & USART_SR_ORE){
+		rx_stats.overruns++;
+	}
+	if(sr & UART_RX_ERROR_FLAGS){
+		rx_stats.errors++;
+		return;
+	}
+	if(!(sr & USART_SR_RXNE)){
+		return;
+	}
+	if(rx_head - rx_tail >= UART_RX_BUFFER_SIZE){
+		rx_stats.dropped++;
+		return;
+	}
+	rx_buffer[rx_head & UART_RX_MASK] = c;
+	rx_head++;
+	rx_stats.received++;
+	if(rx_head - rx_tail > rx_stats.peak){
+		rx_stats.peak = rx_head - rx_tail;
+	}
+}
+
+/*
+ * Starts sending the bytes from the tail of the ring buffer up to its head or to the end of
+ * the buffer, whichever comes first. Must be called with the dma idle and the dma interrupt
+ * unable to run.
+ */
+static void uart_tx_start_dma(void){
+	uint32_t used = tx_head - tx_tail;
+	uint32_t start = tx_tail & UART_TX_MASK;
+	uint32_t len = UART_TX_BUFFER_SIZE - start;
+
+	if(used == 0){
+		tx_dma_len = 0;
+		return;
+	}
+	if(len > used){
+		len = used;
+	}
+	tx_dma_len = len;
+	DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+	DMA1_Stream6->M0AR = (uint32_t)&tx_buffer[start];
+	DMA1_Stream6->NDTR = len;
+	DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+/*
+ * Frees the bytes of the finished dma transfer and chains the next one. Does nothing if the
+ * transfer has not ended, so it is safe to call from both the interrupt and a polling loop.
+ */
+static void uart_tx_dma_done(void){
+	if(!(DMA1->HISR & UART_TX_DMA_FLAGS)){
+		return;
+	}
+	DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+	tx_tail += tx_dma_len;
+	uart_tx_start_dma();
+}
+
+void DMA1_Stream6_IRQHandler(void){
+	uart_tx_dma_done();
+}
+
+/*
+ * Starts the dma if it is idle and there is something to send
+ */
+static void uart_tx_kick(void){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(tx_dma_len == 0){
+		uart_tx_start_dma();
+	}
+	__set_PRIMASK(primask);
+}
+
+/*
+ * Waits for the running dma transfer to free some room. When interrupts are masked or the
+ * caller is itself an interrupt, the end of the transfer is polled instead.
+ */
+static void uart_tx_wait(void){
+	uint32_t primask = __get_PRIMASK();
+
+	if(primask || __get_IPSR()){
+		uart_tx_dma_done();
+		return;
+	}
+	__disable_irq();
+	if(tx_dma_len != 0 && !(DMA1->HISR & UART_TX_DMA_FLAGS)){
+		__WFI();
+	}
+	__enable_irq();
+}
+
+/*
+ * Copies as much as fits into the ring buffer, without waiting
+ */
+static uint32_t uart_tx_put(const char *ptr, uint32_t len){
+	uint32_t head = tx_head;
+	uint32_t space = UART_TX_BUFFER_SIZE - (head - tx_tail);
+	uint32_t done = 0;
+
+	if(len > space){
+		len = space;
+	}
+	while(done < len){
+		uint32_t chunk = UART_TX_BUFFER_SIZE - ((head + done) & UART_TX_MASK);
+		if(chunk > len - done){
+			chunk = len - done;
+		}
+		memcpy(&tx_buffer[(head + done) & UART_TX_MASK], ptr + done, chunk);
+		done += chunk;
+	}
+	tx_head = head + len;
+
+	tx_stats.queued += len;
+	if(tx_head - tx_tail > tx_stats.peak){
+		tx_stats.peak = tx_head - tx_tail;
+	}
+	return len;
+}
+
+/*
+ * Queues bytes for sending, applying the overflow policy when the ring buffer is full
+ */
+static void uart_tx_write(const char *ptr, uint32_t len){
+	if(tx_unreported_drops && UART_TX_BUFFER_SIZE - (tx_head - tx_tail) >= UART_TX_DROP_NOTE_LEN){
+		char note[UART_TX_DROP_NOTE_LEN];
+		int note_len = snprintf(note, sizeof(note), "\r\n[%lu bytes dropped]\r\n",
+				(unsigned long)tx_unreported_drops);
+		tx_unreported_drops = 0;
+		uart_tx_put(note, note_len);
+	}
+
+	while(len){
+		uint32_t done = uart_tx_put(ptr, len);
+		ptr += done;
+		len -= done;
+		uart_tx_kick();
+		if(len == 0){
+			break;
+		}
+
+		if(tx_overflow == UART_TX_OVERFLOW_BLOCK){
+			uart_tx_wait();
+		}else{
+			tx_stats.dropped += len;
+			if(tx_overflow == UART_TX_OVERFLOW_COUNT){
+				tx_unreported_drops += len;
+			}
+			break;
+		}
+	}
+}
+
+/* Function to choose what happens to output when the transmit ring buffer is full
+ *
+ * Parameters:
+ * 	policy one of uart_tx_overflow_t, UART_TX_OVERFLOW_BLOCK after reset
+ *
+ * Returns:
+ *  none
+ */
+void uart_set_tx_overflow(uart_tx_overflow_t policy){
+	tx_overflow = policy;
+}
+
+/* Function to wait until all queued output has been sent, for example before the baud rate
+ * is changed
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  none
+ */
+void uart_tx_flush(){
+	while(tx_head != tx_tail){
+		uart_tx_wait();
+	}
+	while(!(USART2->SR & USART_SR_TC));
+}
+
+/* Function to get the counters of the transmit ring buffer
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  pointer to the counters
+ */
+const uart_tx_stats_t *uart_get_tx_stats(){
+	return &tx_stats;
+}
+
+/* Function to compute the BRR value for a baud rate from the APB1 clock. Oversampling by 16 is
+ * used while USARTDIV is at least 1 with it, above that oversampling by 8 doubles the highest
+ * rate to APB1/8 (5.6 Mbaud at 45MHz)
+ *
+ * Parameters:
+ * 	baud wanted baud rate
+ * 	brr filled with the value for the BRR register
+ * 	over8 filled with true if the rate needs oversampling by 8
+ *
+ * Returns:
+ *  the baud rate the BRR value really gives, 0 if it is out of range or more than
+ *  UART_BAUD_MAX_ERROR_PERMILLE away from the wanted rate
+ */
+uint32_t uart_compute_brr(uint32_t baud, uint32_t *brr, bool *over8){
+	uint32_t fck = get_apb1_clk_freq();
+	uint32_t div, actual, error;
+
+	if(baud == 0){
+		return 0;
+	}
+
+	//with OVER8=0 BRR is USARTDIV in 12.4 fixed point, that is fck/baud rounded
+	div = (fck + baud / 2) / baud;
+	if(div >= 16){
+		*over8 = false;
+		*brr = div;
+		actual = fck / div;
+	}else{
+		//with OVER8=1 USARTDIV is fck/(8 x baud) in 12.3 fixed point and BRR[3] must stay clear
+		if(div < 8){
+			return 0;
+		}
+		*over8 = true;
+		*brr = ((div >> 3) << USART_BRR_DIV_Mantissa_Pos) | (div & 0x7);
+		actual = fck / div;
+	}
+
+	error = (actual > baud) ? actual - baud : baud - actual;
+	if((uint64_t)error * 1000 > (uint64_t)baud * UART_BAUD_MAX_ERROR_PERMILLE){
+		return 0;
+	}
+	return actual;
+}
+
+/* Function to change the baud rate straight away, after the queued output has been sent
+ *
+ * Parameters:
+ * 	baud wanted baud rate
+ *
+ * Returns:
+ *  the baud rate set, 0 if it cannot be reached and nothing was changed
+ */
+uint32_t uart_set_baud(uint32_t baud){
+	uint32_t brr, actual;
+	bool over8;
+
+	actual = uart_compute_brr(baud, &brr, &over8);
+	if(actual == 0){
+		return 0;
+	}
+	uart_tx_flush();
+	uart_write_brr(brr, over8);
+	current_baud = actual;
+	return actual;
+}
+
+/* Function to get the baud rate in use
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  the baud rate in use
+ */
+uint32_t uart_get_baud(){
+	return current_baud;
+}
+
+/* Function to move the link to a new baud rate and keep it only if the host confirms. After the
+ * switch the host must send a carriage return or line feed at the new rate; if none arrives
+ * without framing or noise errors within the timeout, the old rate is put back
+ *
+ * Parameters:
+ * 	baud wanted baud rate
+ * 	confirm_ms time given to the host to confirm, in ms
+ *
+ * Returns:
+ *  true if the host confirmed the new rate
+ *  false if the rate cannot be reached or the host did not confirm, the old rate is in use
+ */
+bool uart_switch_baud(uint32_t baud, uint32_t confirm_ms){
+	uint32_t old_brr = USART2->BRR;
+	bool old_over8 = (USART2->CR1 & USART_CR1_OVER8) != 0;
+	uint32_t old_baud = current_baud;
+
+	if(uart_set_baud(baud) == 0){
+		return false;
+	}
+
+	//drop whatever arrived while the host was switching, bytes with framing errors never get in
+	rx_tail = rx_head;
+
+	ticktime_t start = now();
+	while(now() - start < confirm_ms){
+		if(!char_available()){
+			continue;
+		}
+		uint8_t c = get_char();
+		if(c == '\r' || c == '\n'){
+			return true;
+		}
+	}
 
+	uart_write_brr(old_brr, old_over8);
+	current_baud = old_baud;
+	return false;
+}
 
-	//set te and re bit
-	USART2->CR1 |= USART_CR1_TE_Msk | USART_CR1_RE_Msk ;
+/* Function to check if a character is waiting in the receive ring buffer, so that the caller
+ * can do other work instead of blocking in get_char
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  1 if a character is waiting
+ *  0 otherwise
+ */
+int char_available(){
+	return (rx_head != rx_tail) ? 1 : 0;
 }
 
-/* Serial Input function. Receives 1 character at a time
+/* Serial Input function. Takes 1 character from the receive ring buffer, waiting for one
+ * if it is empty
  *
  * Parameters:
  * 	none
@@ -82,13 +471,28 @@ void init_uart(){
  *  unsigned char value of the character input
  */
 unsigned char get_char(){
-	char result = 0;
-	while(!(USART2->SR & USART_SR_RXNE));
-	result = USART2->DR;
+	unsigned char result = 0;
+	while(rx_head == rx_tail){
+		__WFI();	//the usart interrupt wakes it up, at worst the next systick does
+	}
+	result = rx_buffer[rx_tail & UART_RX_MASK];
+	rx_tail++;
 	return result;
 }
 
-/* Serial Output function. Transmits 1 character at a time
+/* Function to get the counters of the receive ring buffer
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  pointer to the counters
+ */
+const volatile uart_rx_stats_t *uart_get_rx_stats(){
+	return &rx_stats;
+}
+
+/* Serial Output function. Queues 1 character for transmission
  *
  * Parameters:
  * 	unsigned char value of character to be transmitted
@@ -97,8 +501,7 @@ unsigned char get_char(){
  *  unsigned char value of character transmitted
  */
 unsigned char put_char(unsigned char c_out){
-	while(!(USART2->SR & USART_SR_TXE));
-	USART2->DR = c_out;
+	uart_tx_write((const char *)&c_out, 1);
 	return c_out;
 }
 
@@ -116,10 +519,10 @@ unsigned char put_char(unsigned char c_out){
  */
 int _write(int file, char *ptr, int len)
 {
-  for (int i = 0; i < len; i++)
-  {
-    put_char(*ptr++);
-  }
+  (void)file;
+  PERF_BEGIN(PERF_PRINTF);
+  uart_tx_write(ptr, len);
+  PERF_END(PERF_PRINTF);
   return len;
 }
 
@@ -21,19 +21,56 @@
 #ifndef __UART_H__
 #define __UART_H__
 
+#include "stdint.h"
+#include "stdbool.h"
+
 #define LF 0xA
 #define RE 0xD
 
+#define UART_DEFAULT_BAUD 115200
+#define UART_BAUD_MAX_ERROR_PERMILLE 25		//highest baud rate error accepted, 2.5%
+
+//size of the transmit ring buffer, must be a power of 2
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 2048
+#endif
+
+//size of the receive ring buffer filled by the usart interrupt, must be a power of 2
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 512
+#endif
+
+//what _write does with output that does not fit in the ring buffer
+typedef enum{
+	UART_TX_OVERFLOW_BLOCK,		//wait for the dma to make room, nothing is lost
+	UART_TX_OVERFLOW_DROP,		//drop what does not fit
+	UART_TX_OVERFLOW_COUNT		//drop what does not fit, and print how much once there is room again
+}uart_tx_overflow_t;
+
+typedef struct{
+	uint32_t queued;		//bytes put in the ring buffer
+	uint32_t dropped;		//bytes dropped because the ring buffer was full
+	uint32_t peak;			//highest number of bytes waiting in the ring buffer
+}uart_tx_stats_t;
+
+typedef struct{
+	uint32_t received;		//bytes put in the receive ring buffer
+	uint32_t dropped;		//bytes lost because the ring buffer was full
+	uint32_t overruns;		//bytes lost in the usart before the interrupt could read them
+	uint32_t errors;		//bytes dropped for a framing or noise error
+	uint32_t peak;			//highest number of bytes waiting in the ring buffer
+}uart_rx_stats_t;
+
 /*
- * Initializes USART to 1152000 Baud. It uses USART2 on PD5(TX) and PD6(RX).
+ * Initializes USART to UART_DEFAULT_BAUD. It uses USART2 on PD5(TX) and PD6(RX).
  *
  * Baud = Fck/((8 x (2 - OVER8) x USARTDIV)
  *
- * Fck = 40MHz
+ * Fck = APB1 clock, 45MHz at the default clock configuration, see clock_config.h
  * Over8 = 0
- * USARTDIV = (40MHz)/(8 x 2 x 115200) = 21.7
+ * USARTDIV = (45MHz)/(8 x 2 x 115200) = 24.41
  *
- * Therefore, Mantissa = 21 and Fraction = 11 in BRR
+ * Therefore, Mantissa = 24 and Fraction = 7 in BRR, computed by uart_compute_brr from the clock
  *
  * Parameters:
  *  none
@@ -43,8 +80,8 @@
  */
 void init_uart();
 
-/* Serial Input function. Receives 1 character at a time
- *
+/* Serial Input function. Takes 1 character from the receive ring buffer, waiting for one
+ * if it is empty
  *
  * Parameters:
  * 	none
@@ -54,6 +91,18 @@ void init_uart();
  */
 unsigned char get_char();
 
+/* Function to check if a character is waiting in the receive ring buffer, so that the caller
+ * can do other work instead of blocking in get_char
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  1 if a character is waiting
+ *  0 otherwise
+ */
+int char_available();
+
 /* Serial Output function. Transmits 1 character at a time
  *
  * Parameters:
@@ -63,4 +112,94 @@ unsigned char get_char();
  *  unsigned char value of character transmitted
  */
 unsigned char put_char(unsigned char c_out);
+
+/* Function to choose what happens to output when the transmit ring buffer is full
+ *
+ * Parameters:
+ * 	policy one of uart_tx_overflow_t, UART_TX_OVERFLOW_BLOCK after reset
+ *
+ * Returns:
+ *  none
+ */
+void uart_set_tx_overflow(uart_tx_overflow_t policy);
+
+/* Function to wait until all queued output has been sent, for example before the baud rate
+ * is changed
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  none
+ */
+void uart_tx_flush();
+
+/* Function to get the counters of the transmit ring buffer
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  pointer to the counters
+ */
+const uart_tx_stats_t *uart_get_tx_stats();
+
+/* Function to get the counters of the receive ring buffer
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  pointer to the counters
+ */
+const volatile uart_rx_stats_t *uart_get_rx_stats();
+
+/* Function to compute the BRR value for a baud rate from the APB1 clock. Oversampling by 16 is
+ * used while USARTDIV is at least 1 with it, above that oversampling by 8 doubles the highest
+ * rate to APB1/8 (5.6 Mbaud at 45MHz)
+ *
+ * Parameters:
+ * 	baud wanted baud rate
+ * 	brr filled with the value for the BRR register
+ * 	over8 filled with true if the rate needs oversampling by 8
+ *
+ * Returns:
+ *  the baud rate the BRR value really gives, 0 if it is out of range or more than
+ *  UART_BAUD_MAX_ERROR_PERMILLE away from the wanted rate
+ */
+uint32_t uart_compute_brr(uint32_t baud, uint32_t *brr, bool *over8);
+
+/* Function to change the baud rate straight away, after the queued output has been sent
+ *
+ * Parameters:
+ * 	baud wanted baud rate
+ *
+ * Returns:
+ *  the baud rate set, 0 if it cannot be reached and nothing was changed
+ */
+uint32_t uart_set_baud(uint32_t baud);
+
+/* Function to get the baud rate in use
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  the baud rate in use
+ */
+uint32_t uart_get_baud();
+
+/* Function to move the link to a new baud rate and keep it only if the host confirms. After the
+ * switch the host must send a carriage return or line feed at the new rate; if none arrives
+ * without framing or noise errors within the timeout, the old rate is put back
+ *
+ * Parameters:
+ * 	baud wanted baud rate
+ * 	confirm_ms time given to the host to confirm, in ms
+ *
+ * Returns:
+ *  true if the host confirmed the new rate
+ *  false if the rate cannot be reached or the host did not confirm, the old rate is in use
+ */
+bool uart_switch_baud(uint32_t baud, uint32_t confirm_ms);
 #endif
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    uart_analyser.c
+ * @brief   Asynchronous serial (UART) interpreter. It goes over a given buffer, where data is 8bit format
+ * 			and one or two pins are selected as the TX and RX lines of a link.
+ *
+ * 			Every frame is sampled at the centre of each bit, counted from the falling edge of the start
+ * 			bit. The distance between bit centres is precomputed once from the fractional bit period,
+ * 			so the inner loop only has to count samples down, which keeps the decoder linear in the
+ * 			buffer length and independent of the baud rate.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#include "uart_analyser.h"
+#include "bit_timing.h"
+#include "stdint.h"
+#include "stdio.h"
+#include "string.h"
+#include "perf.h"
+
+#define UART_MIN_BIT_PERIOD_Q8 	(3*256)	//a bit must be at least 3 samples to find its centre
+
+static const uint32_t standard_baud_table[] = {300, 600, 1200, 2400, 4800, 9600, 14400, 19200, 28800,
+		38400, 57600, 76800, 115200, 230400, 250000, 460800, 500000, 921600, 1000000};
+static const int standard_baud_table_len = sizeof(standard_baud_table)/sizeof(standard_baud_table[0]);
+
+/*
+ * Function to print a decoded frame in a clear format. It is used when the calling code
+ * does not provide its own frame handler.
+ *
+ * Parameters:
+ *  frame pointer to the decoded frame
+ *  arg unused
+ *
+ * Returns:
+ *  none
+ */
+static void print_uart_frame(const uart_frame_t *frame, void *arg){
+	(void)arg;
+	printf("%s AT %lu: DATA %x", (frame->channel == 0) ? "TX" : "RX",
+			(unsigned long)frame->position, frame->data);
+	if(frame->data >= ' ' && frame->data <= '~'){
+		printf(" '%c'", frame->data);
+	}
+	if(frame->flags & UART_FRAME_ERR_FRAMING){
+		printf(" FRAMING ERROR");
+	}
+	if(frame->flags & UART_FRAME_ERR_PARITY){
+		printf(" PARITY ERROR");
+	}
+	printf("\r\n");
+}
+
+/*
+ * Function to prepare an analyser context for decoding. The config is copied in.
+ *
+ * The sample offset of every bit centre from the start edge is computed in 1/256th of a sample
+ * and rounded once here, the decoder then stores only the distance to the next centre.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  config pointer to link configuration
+ *
+ * Returns:
+ *  true if the configuration is valid
+ *  false otherwise
+ */
+bool uart_analyser_init(uart_analyser_t *ctx, const uart_config_t *config){
+	if(config->data_bits < 5 || config->data_bits > 9 ||
+	   config->stop_bits < 1 || config->stop_bits > 2 ||
+	   config->parity > UART_PARITY_ODD ||
+	   config->bit_period_q8 < UART_MIN_BIT_PERIOD_Q8){
+		return false;
+	}
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->config = *config;
+	if(ctx->config.on_frame == NULL){
+		ctx->config.on_frame = print_uart_frame;
+	}
+	ctx->frame_bits = 1 + config->data_bits + ((config->parity != UART_PARITY_NONE) ? 1 : 0) + config->stop_bits;
+
+	uint32_t previous_offset = 0;
+	for(int bit = 0; bit < ctx->frame_bits; bit++){
+		//the edge is seen on the first low sample, so the centre of bit n is (n + 0.5) bits later
+		uint32_t offset = ((2 * bit + 1) * config->bit_period_q8) >> 9;
+		ctx->bit_offsets[bit] = offset - previous_offset;
+		previous_offset = offset;
+	}
+
+	for(int ch = 0; ch < UART_ANALYSER_MAX_CHANNELS; ch++){
+		uint8_t pin = config->pins[ch];
+		ctx->channels[ch].pin = pin;
+		if(pin != UART_ANALYSER_NO_PIN){
+			if(pin > 7){
+				return false;
+			}
+			ctx->pin_mask |= (1<<pin);
+		}
+		ctx->channels[ch].last_level = 1;//line idles high
+	}
+	ctx->previous_sample = 0xFF;
+
+	return (ctx->pin_mask != 0);
+}
+
+/*
+ * Function to sample one bit of a frame in progress and hand the frame over once its
+ * last stop bit has been sampled.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  ch index of the channel
+ *  level the value of the line at the bit centre
+ *
+ * Returns:
+ *  none
+ */
+static void sample_uart_bit(uart_analyser_t *ctx, uint8_t ch, uint8_t level){
+	uart_channel_state_t *state = &ctx->channels[ch];
+	const uart_config_t *config = &ctx->config;
+	uint8_t bit = state->bit_index;
+
+	if(bit == 0){
+		if(level){//start bit not low at its centre, it was a glitch
+			state->in_frame = 0;
+			return;
+		}
+	}else if(bit <= config->data_bits){
+		state->shift |= (uint16_t)level << (bit - 1);//LSB first
+		state->ones += level;
+	}else if(bit == config->data_bits + 1 && config->parity != UART_PARITY_NONE){
+		uint8_t odd = (state->ones + level) & 1;
+		if((config->parity == UART_PARITY_EVEN && odd) || (config->parity == UART_PARITY_ODD && !odd)){
+			state->flags |= UART_FRAME_ERR_PARITY;
+		}
+	}else if(!level){
+		state->flags |= UART_FRAME_ERR_FRAMING;
+	}
+
+	state->bit_index++;
+	if(state->bit_index == ctx->frame_bits){
+		uart_frame_t frame = {
+				.position = state->start_position,
+				.data = state->shift,
+				.channel = ch,
+				.flags = state->flags
+		};
+		ctx->frames++;
+		if(state->flags){
+			ctx->errors++;
+		}
+		config->on_frame(&frame, config->arg);
+		state->in_frame = 0;
+	}else{
+		state->countdown = ctx->bit_offsets[state->bit_index];
+	}
+}
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, frames which span two blocks are decoded correctly.
+ *
+ * While no channel is inside a frame, samples are skipped until one of the selected pins
+ * changes, since only a falling edge can start a frame.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void uart_analyser_process(uart_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len){
+	uint8_t mask = ctx->pin_mask;
+	uint8_t previous_sample = ctx->previous_sample;
+	uint32_t i = 0;
+
+	PERF_BEGIN(PERF_UART_DECODE);
+	while(i < buf_len){
+		uint8_t busy = 0;
+		for(int ch = 0; ch < UART_ANALYSER_MAX_CHANNELS; ch++){
+			busy |= ctx->channels[ch].in_frame;
+		}
+		if(!busy){
+			while(i < buf_len && ((buffer[i] ^ previous_sample) & mask) == 0){
+				i++;
+			}
+			if(i == buf_len){
+				break;
+			}
+		}
+
+		uint8_t sample = buffer[i];
+		for(int ch = 0; ch < UART_ANALYSER_MAX_CHANNELS; ch++){
+			uart_channel_state_t *state = &ctx->channels[ch];
+			if(state->pin == UART_ANALYSER_NO_PIN){
+				continue;
+			}
+			uint8_t level = (sample >> state->pin) & 1;
+			if(state->in_frame){
+				if(--state->countdown == 0){
+					sample_uart_bit(ctx, ch, level);
+				}
+			}else if(state->last_level && !level){//falling edge of a start bit
+				state->in_frame = 1;
+				state->bit_index = 0;
+				state->shift = 0;
+				state->ones = 0;
+				state->flags = 0;
+				state->countdown = ctx->bit_offsets[0];
+				state->start_position = ctx->position + i;
+			}
+			state->last_level = level;
+		}
+		previous_sample = sample;
+		i++;
+	}
+	PERF_END(PERF_UART_DECODE);
+
+	ctx->previous_sample = previous_sample;
+	ctx->position += buf_len;
+}
+
+/*
+ * Function to prepare an analyser context for a capture, detecting the baud rate from the
+ * samples first if the bit period in the config is 0. Used when the capture is decoded in
+ * several blocks, the detection only looks at the given one.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing the first samples of the capture
+ *  buf_len length of byte array containing samples
+ *  config pointer to link configuration, the detected bit period is written back
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser is ready
+ *  false if the configuration was invalid or the baud rate could not be detected
+ */
+bool uart_analyser_start(uart_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len,
+		uart_config_t *config, uint32_t sample_rate){
+	if(config->bit_period_q8 == 0){
+		uint8_t pin_mask = 0;
+		for(int ch = 0; ch < UART_ANALYSER_MAX_CHANNELS; ch++){
+			if(config->pins[ch] <= 7){
+				pin_mask |= (1<<config->pins[ch]);
+			}
+		}
+		config->bit_period_q8 = detect_bit_period(buffer, buf_len, pin_mask);
+		if(config->bit_period_q8 == 0){
+			printf("Could not detect baud rate, no stable pulse width found\r\n");
+			return false;
+		}
+		if(sample_rate){
+			uint32_t baud = bit_period_to_rate(config->bit_period_q8, sample_rate,
+					standard_baud_table, standard_baud_table_len);
+			config->bit_period_q8 = rate_to_bit_period(baud, sample_rate);
+			printf("Detected baud rate: %lu\r\n", (unsigned long)baud);
+		}
+		printf("Samples per bit: %lu.%02lu\r\n", (unsigned long)(config->bit_period_q8 >> 8),
+				(unsigned long)(((config->bit_period_q8 & 0xFF) * 100) >> 8));
+	}
+
+	if(!uart_analyser_init(ctx, config)){
+		printf("Invalid UART configuration or bit period too short for the sample rate\r\n");
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Function to run the uart analyzer task on a complete buffer, detecting the baud rate first
+ * if the bit period in the config is 0.
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  config pointer to link configuration
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser ran
+ *  false if the configuration was invalid or the baud rate could not be detected
+ */
+bool run_uart_analyser(const uint8_t buffer[], uint32_t buf_len, uart_config_t *config, uint32_t sample_rate){
+	static uart_analyser_t ctx;
+
+	if(!uart_analyser_start(&ctx, buffer, buf_len, config, sample_rate)){
+		return false;
+	}
+	uart_analyser_process(&ctx, buffer, buf_len);
+	printf("Frames: %lu, Errors: %lu\r\n", (unsigned long)ctx.frames, (unsigned long)ctx.errors);
+
+	return true;
+}
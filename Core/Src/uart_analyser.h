@@ -0,0 +1,156 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by Krish Shah
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. Krish Shah and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    uart_analyser.h
+ * @brief   Header file for the asynchronous serial (UART) interpreter. It goes over a given buffer, where
+ * 			data is 8bit format and one or two pins are selected as the TX and RX lines of a link.
+ *
+ * 			The bit period can be given by the calling code or estimated from the capture itself, using
+ * 			a histogram of the pulse widths seen on the selected pins (see bit_timing.h).
+ *
+ * 			It can decode:
+ * 			5 to 9 data bits, LSB first
+ * 			No, Even or Odd parity
+ * 			1 or 2 stop bits
+ *
+ * 			and flags framing errors (stop bit low) and parity errors on each frame.
+ *
+ * 			Both the baud detection and the decoding are a single pass over the buffer, and TX and RX
+ * 			are decoded in the same pass.
+ *
+ * @author  Krish Shah
+ * @date    December 17 2023
+ *
+ */
+#ifndef __UART_ANALYSER_H__
+#define __UART_ANALYSER_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define UART_ANALYSER_MAX_CHANNELS 	2 	//TX and RX of one link
+#define UART_ANALYSER_NO_PIN 		0xFF
+#define UART_ANALYSER_MAX_BITS 		13 	//start + 9 data + parity + 2 stop
+
+#define UART_FRAME_ERR_FRAMING		(1<<0)
+#define UART_FRAME_ERR_PARITY		(1<<1)
+
+typedef enum{
+	UART_PARITY_NONE = 0,
+	UART_PARITY_EVEN,
+	UART_PARITY_ODD
+}uart_parity_t;
+
+typedef struct{
+	uint64_t position;	//sample index of the start bit edge
+	uint16_t data;
+	uint8_t channel;	//index of the channel in the config, 0 for TX and 1 for RX
+	uint8_t flags;		//UART_FRAME_ERR_x
+}uart_frame_t;
+
+typedef void (*uart_frame_handler_t)(const uart_frame_t *frame, void *arg);
+
+typedef struct{
+	uint8_t pins[UART_ANALYSER_MAX_CHANNELS];	//UART_ANALYSER_NO_PIN if channel is unused
+	uint8_t data_bits;							//5..9
+	uart_parity_t parity;
+	uint8_t stop_bits;							//1 or 2
+	uint32_t bit_period_q8;						//samples per bit, in 1/256th of a sample
+	uart_frame_handler_t on_frame;				//NULL prints each frame
+	void *arg;
+}uart_config_t;
+
+typedef struct{
+	uint8_t pin;
+	uint8_t in_frame;
+	uint8_t bit_index;
+	uint8_t last_level;
+	uint32_t countdown;
+	uint16_t shift;
+	uint8_t ones;
+	uint8_t flags;
+	uint64_t start_position;
+}uart_channel_state_t;
+
+typedef struct{
+	uart_config_t config;
+	uint8_t frame_bits;
+	uint8_t pin_mask;
+	uint8_t previous_sample;
+	uint32_t bit_offsets[UART_ANALYSER_MAX_BITS];	//samples between consecutive bit centres
+	uart_channel_state_t channels[UART_ANALYSER_MAX_CHANNELS];
+	uint64_t position;
+	uint32_t frames;
+	uint32_t errors;
+}uart_analyser_t;
+
+/*
+ * Function to prepare an analyser context for decoding. The config is copied in.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  config pointer to link configuration
+ *
+ * Returns:
+ *  true if the configuration is valid
+ *  false otherwise
+ */
+bool uart_analyser_init(uart_analyser_t *ctx, const uart_config_t *config);
+
+/*
+ * Function to decode a block of samples. It can be called repeatedly with consecutive blocks
+ * of one capture, frames which span two blocks are decoded correctly.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *
+ * Returns:
+ *  none
+ */
+void uart_analyser_process(uart_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len);
+
+/*
+ * Function to prepare an analyser context for a capture, detecting the baud rate from the
+ * samples first if the bit period in the config is 0. Used when the capture is decoded in
+ * several blocks, the detection only looks at the given one.
+ *
+ * Parameters:
+ *  ctx pointer to analyser context
+ *  buffer pointer to byte array containing the first samples of the capture
+ *  buf_len length of byte array containing samples
+ *  config pointer to link configuration, the detected bit period is written back
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser is ready
+ *  false if the configuration was invalid or the baud rate could not be detected
+ */
+bool uart_analyser_start(uart_analyser_t *ctx, const uint8_t buffer[], uint32_t buf_len,
+		uart_config_t *config, uint32_t sample_rate);
+
+/*
+ * Function to run the uart analyzer task on a complete buffer, detecting the baud rate first
+ * if the bit period in the config is 0.
+ *
+ * Parameters:
+ *  buffer pointer to byte array containing samples
+ *  buf_len length of byte array containing samples
+ *  config pointer to link configuration
+ *  sample_rate sampling frequency in Hz, 0 if unknown
+ *
+ * Returns:
+ *  true if the analyser ran
+ *  false if the configuration was invalid or the baud rate could not be detected
+ */
+bool run_uart_analyser(const uint8_t buffer[], uint32_t buf_len, uart_config_t *config, uint32_t sample_rate);
+
+#endif
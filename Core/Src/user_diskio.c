@@ -36,6 +36,7 @@
 #include <string.h>
 #include "ff_gen_drv.h"
 #include "fatfs_sd.h"
+#include "sector_cache.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -82,6 +83,8 @@ DSTATUS USER_initialize (
 )
 {
   /* USER CODE BEGIN INIT */
+  /* the card may have been swapped since the last mount */
+  sector_cache_init(SD_disk_read, SD_disk_write);
 return SD_disk_initialize(pdrv);
   /* USER CODE END INIT */
 }
@@ -116,7 +119,7 @@ DRESULT USER_read (
 )
 {
   /* USER CODE BEGIN READ */
-    return SD_disk_read(pdrv, buff, sector, count);
+    return sector_cache_read(pdrv, buff, sector, count);
   /* USER CODE END READ */
 }
 
@@ -138,7 +141,7 @@ DRESULT USER_write (
 {
   /* USER CODE BEGIN WRITE */
   /* USER CODE HERE */
-    return SD_disk_write(pdrv, buff, sector, count);
+    return sector_cache_write(pdrv, buff, sector, count);
   /* USER CODE END WRITE */
 }
 #endif /* _USE_WRITE == 1 */
@@ -158,6 +161,8 @@ DRESULT USER_ioctl (
 )
 {
   /* USER CODE BEGIN IOCTL */
+ if (cmd == CTRL_SYNC && sector_cache_flush(pdrv) != RES_OK)
+   return RES_ERROR;
  return SD_disk_ioctl(pdrv, cmd, buff);
   /* USER CODE END IOCTL */
 }
@@ -11,8 +11,8 @@
 /**
  * @file    user_fatfs.c
  * @brief   This file contains the function definitions and algorithms for the file writing using fatfs driver.
- * 			This file uses STM32CUBEIDE HAL generated middleware related to file systems. The algorithm in which how we wanted
- * 			our file should be and in which arrangement is writte by me.
+ * 			This file uses STM32CUBEIDE HAL generated middleware related to file systems. Captures are saved
+ * 			in the binary format described in capture_format.h, one byte in the file per byte captured.
  * @author  Pranjal Gupta
  * @date    12/17/2023
  *
@@ -20,10 +20,14 @@
 
 
 #include "fatfs.h"
+#include "diskio.h"
 #include "stdint.h"
 #include "user_fatfs.h"
 #include "fatfs_sd.h"
 #include "fmc.h"
+#include "capture_format.h"
+#include "timing_mode_init.h"
+#include "systick.h"
 #include"stdio.h"
 #include "string.h"
 
@@ -35,71 +39,558 @@ FIL fil1;
 FRESULT fres;
 DWORD fre_clust;
 uint32_t totalSpace, freeSpace;
-uint8_t *fill_address = SDRAM_BANK_ADDR;
 uint8_t file_num = 1;
 
-bool user_fatfs_init(uint16_t count){
+#define SECTOR_SIZE 		512		//SD_disk_ioctl always reports 512 byte sectors
+#define WRITE_SPAN_SECTORS 	128		//sectors handed to one CMD25 multi-block write, one poll step
+#define LINKMAP_SIZE 		64		//fast seek map entries, room for 31 fragments of a capture file
+#define STREAM_LINKMAP_SIZE 	128		//room for 63 fragments of a streamed capture file
+#define STREAM_BUFFER_SIZE 	8192	//bytes in each of the two read-ahead buffers
+
+static save_job_t save_job;
+static DWORD next_sector;			//next disk sector of a contiguous file, 0 when writing through fatfs
+
+static uint8_t stream_buffers[2][STREAM_BUFFER_SIZE] __attribute__((aligned(4)));
+static DWORD stream_linkmap[STREAM_LINKMAP_SIZE];
+static struct{
+	bool open;
+	bool error;
+	bool direct;			//samples are read with background multi-block reads, not through fatfs
+	bool card_open;			//a multi-block read is open on the card
+	bool filling;			//the read into stream_buffers[fill] has not ended yet
+	uint8_t fill;			//buffer being read into, the other one is with the decoder
+	uint32_t fill_len;
+	uint64_t left;			//bytes of samples not read yet
+	DWORD *frag;			//fragment of the link map being read
+	DWORD frag_left;		//sectors left in it
+	DWORD sector;			//next sector to read
+	ticktime_t start_ms;
+	capture_stream_stats_t stats;
+}stream;
+
+/*
+ * Description: writes back the sectors the disk layer still caches and unmounts the card, so that
+ * 				it can be removed
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		FRESULT FR_OK if everything reached the card
+ */
+static FRESULT unmount(void){
+		FRESULT res = FR_OK;
+
+		//fs_type is only set once the volume has been accessed
+		if(fs.fs_type && disk_ioctl(fs.drv, CTRL_SYNC, NULL) != RES_OK)
+			res = FR_DISK_ERR;
+		if(f_mount(NULL, "", 0) != FR_OK)
+			res = FR_INVALID_DRIVE;
+		return res;
+}
+
+/*
+ * Description: closes the file of the save job, unmounts the card and releases the sdram region
+ * Parameters:
+ * 		bool ok true if all data was written
+ * Returns:
+ *   		None
+ */
+static void save_job_finish(bool ok){
+		if(f_close(&fil) != FR_OK)
+			ok = false;
+
+		/* Unmount SDCARD */
+		if(unmount() != FR_OK)
+			ok = false;
+
+		unlock_sdram_region();
+		save_job.elapsed_ms = now() - save_job.start_ms;
+		save_job.state = ok ? SAVE_JOB_DONE : SAVE_JOB_FAILED;
+}
+
+/*
+ * Description: starts saving a capture to a new capture file on the sd card. The file is named
+ * 				fileN.bin with the first free N, and holds a header (see capture_format.h) followed by
+ * 				the raw samples. Only the file is created and its header written here, the samples are
+ * 				written span by span by user_fatfs_save_poll, and their sdram region stays locked
+ * 				until the save ends so that new captures are placed next to it
+ *
+ * 				The whole file is pre-allocated as contiguous clusters, so that the samples go from
+ * 				sdram to the card in long multi-block writes without being copied or split at cluster
+ * 				ends. If the card is too fragmented, the samples are written through fatfs instead
+ * Parameters:
+ * 		const uint8_t *samples pointer to the samples
+ * 		uint32_t len length of the samples
+ * Returns:
+ *   		bool true if the save was started
+ *   			 false if a save is running or the file could not be created
+ */
+bool user_fatfs_save_start(const uint8_t *samples, uint32_t len){
+		uint32_t trigger = get_trigger_position();
+		capture_info_t info;
+		uint8_t header[CAPTURE_HEADER_SIZE];
+		UINT written = 0;
+		char filename[15];
+
+		if(save_job.state == SAVE_JOB_RUNNING)
+			return false;
 
 		if(f_mount(&fs, "", 0) != FR_OK){
 			return false;
 		}
-		char filename[15];
 
 		do{
-			sprintf(filename, "file%d.txt", file_num);
+			sprintf(filename, "file%d.bin", file_num);
 			file_num++;
 		}while(f_stat(filename, NULL) == FR_OK);
 
-		if(f_open(&fil, filename, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) != FR_OK){
-			return false;
-		}
-
 		/* Check freeSpace space */
-		if(f_getfree("", &fre_clust, &pfs) != FR_OK)
+		if(f_getfree("", &fre_clust, &pfs) != FR_OK){
+			unmount();
 			return false;
+		}
 
 		totalSpace = (uint32_t)((pfs->n_fatent - 2) * pfs->csize * 0.5);
 		freeSpace = (uint32_t)(fre_clust * pfs->csize * 0.5);
 
-		/* free space is less than 1kb */
-		if(freeSpace < 4)
+		/* free space in kb must hold the header and all samples */
+		if(freeSpace < (len + CAPTURE_HEADER_SIZE) / 1024 + 1){
+			unmount();
 			return false;
+		}
 
-		char buffer[512] = {0};
+		if(f_open(&fil, filename, FA_CREATE_NEW | FA_WRITE) != FR_OK){
+			unmount();
+			return false;
+		}
+
+		capture_info_init(&info, get_sample_rate(), len,
+				(trigger == NO_TRIGGER_POSITION) ? CAPTURE_NO_TRIGGER : trigger);
+		info.health = *capture_health_get();
+		capture_header_encode(&info, header);
 
-		for(uint16_t i = 0; i<((count * 32768) / 256); i++){
+		bool header_ok;
+		if(len % SECTOR_SIZE == 0 && f_expand(&fil, CAPTURE_HEADER_SIZE + len, 1) == FR_OK){
+			next_sector = fs.database + (DWORD)fs.csize * (fil.obj.sclust - 2);
+			header_ok = (disk_write(fs.drv, header, next_sector, CAPTURE_HEADER_SIZE / SECTOR_SIZE) == RES_OK);
+			next_sector += CAPTURE_HEADER_SIZE / SECTOR_SIZE;
+		}else{
+			/* samples are still sector aligned behind the header, so fatfs writes them straight
+			 * from sdram without going through its own buffer */
+			next_sector = 0;
+			header_ok = (f_write(&fil, header, CAPTURE_HEADER_SIZE, &written) == FR_OK && written == CAPTURE_HEADER_SIZE);
+		}
 
-			for(int k = 0; k<8; k++){
-			for(uint16_t j = 0; j<32; j++){
-				if(i == 0 && j == 0 && k == 0){
-					sprintf(buffer, " ");
-				}
+		strcpy(save_job.filename, filename);
+		save_job.samples = samples;
+		save_job.len = len;
+		save_job.written = 0;
+		save_job.start_ms = now();
+		save_job.elapsed_ms = 0;
+		save_job.state = SAVE_JOB_RUNNING;
+		lock_sdram_region(samples, len);
 
-			if(j == 31){
-				sprintf(buffer+(j*2 + k*64), "%d\n", (fill_address + (512*i))[j + k*32]);
-				j++;
-			}
-			else
-				sprintf(buffer+(j*2 + k*64), "%d ", (fill_address + (512*i))[j + k*32]);
+		if(!header_ok){
+			save_job_finish(false);
+			return false;
 		}
+
+		return true;
+}
+
+/*
+ * Description: writes the next span of samples of a running save, and ends the save after the
+ * 				last one. It is called whenever the command processor or a capture is waiting
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if the save is still running
+ *   			 false if it has ended or none was running
+ */
+bool user_fatfs_save_poll(void){
+		uint32_t span;
+		bool ok;
+
+		if(save_job.state != SAVE_JOB_RUNNING)
+			return false;
+
+		span = save_job.len - save_job.written;
+		if(span > WRITE_SPAN_SECTORS * SECTOR_SIZE)
+			span = WRITE_SPAN_SECTORS * SECTOR_SIZE;
+
+		if(next_sector){
+			ok = (disk_write(fs.drv, save_job.samples + save_job.written, next_sector, span / SECTOR_SIZE) == RES_OK);
+			next_sector += span / SECTOR_SIZE;
+		}else{
+			UINT written = 0;
+			ok = (f_write(&fil, save_job.samples + save_job.written, span, &written) == FR_OK && written == span);
+		}
+		if(!ok){
+			save_job_finish(false);
+			return false;
+		}
+
+		save_job.written += span;
+		if(save_job.written == save_job.len){
+			save_job_finish(true);
+			return false;
+		}
+
+		return true;
+}
+
+/*
+ * Description: gives the state and progress of the last save
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const save_job_t * pointer to the last save job
+ */
+const save_job_t *user_fatfs_get_save_job(void){
+		return &save_job;
+}
+
+/*
+ * Description: reads the samples of the open capture file. The clusters of the file are looked up
+ * 				once into a fast seek link map, then each contiguous fragment is read straight from the
+ * 				card into the buffer with multi-block reads, instead of cluster by cluster through
+ * 				f_read. If the file has too many fragments for the map, it is read through fatfs
+ * Parameters:
+ * 		uint8_t *dest buffer to copy the samples to
+ * 		uint32_t len number of bytes to read
+ * Returns:
+ *   		bool true if all samples were read
+ *   			 false otherwise
+ */
+static bool read_samples(uint8_t *dest, uint32_t len){
+		DWORD linkmap[LINKMAP_SIZE];
+		DWORD first = CAPTURE_HEADER_SIZE / SECTOR_SIZE;	//the samples start after the header sector
+		DWORD last = first + len / SECTOR_SIZE;				//whole sectors are read straight from the card
+		DWORD file_sector = 0;
+		UINT read = 0;
+		UINT tail = len % SECTOR_SIZE;
+
+		fil1.cltbl = linkmap;
+		linkmap[0] = LINKMAP_SIZE;
+		if(f_lseek(&fil1, CREATE_LINKMAP) != FR_OK){
+			fil1.cltbl = NULL;
+			return (f_lseek(&fil1, CAPTURE_HEADER_SIZE) == FR_OK
+					&& f_read(&fil1, dest, len, &read) == FR_OK && read == len);
+		}
+
+		/* the map holds pairs of fragment length and first cluster, ended by a 0 */
+		for(DWORD *frag = &linkmap[1]; frag[0] && file_sector < last; frag += 2){
+			DWORD sectors = frag[0] * fs.csize;
+			DWORD start = (file_sector > first) ? file_sector : first;
+			DWORD end = (file_sector + sectors < last) ? file_sector + sectors : last;
+
+			if(end > start){
+				DWORD lba = fs.database + (frag[1] - 2) * fs.csize + (start - file_sector);
+				if(disk_read(fs.drv, dest + (start - first) * SECTOR_SIZE, lba, end - start) != RES_OK)
+					return false;
 			}
+			file_sector += sectors;
+		}
+		if(file_sector < last)
+			return false;
+
+		if(tail == 0)
+			return true;
+		return (f_lseek(&fil1, CAPTURE_HEADER_SIZE + (FSIZE_t)(last - first) * SECTOR_SIZE) == FR_OK
+				&& f_read(&fil1, dest + (last - first) * SECTOR_SIZE, tail, &read) == FR_OK && read == tail);
+}
+
+/*
+ * Description: reads a capture file back from the sd card, checking its header and copying
+ * 				its samples to a buffer
+ * Parameters:
+ * 		const char *filename name of the capture file
+ * 		uint8_t *dest buffer to copy the samples to
+ * 		uint32_t max_len size of the buffer, longer captures are cut to it, 0 to only read the header
+ * 		capture_info_t *info filled with the description of the capture
+ * Returns:
+ *   		bool true if the header is valid and the samples were read
+ *   			 false otherwise
+ */
+bool user_fatfs_read_capture(const char *filename, uint8_t *dest, uint32_t max_len, capture_info_t *info){
+		uint8_t header[CAPTURE_HEADER_SIZE];
+		UINT read = 0;
+		bool ok = false;
+
+		/* the card is mounted by the save until it ends */
+		if(save_job.state == SAVE_JOB_RUNNING)
+			return false;
+
+		if(f_mount(&fs, "", 0) != FR_OK){
+			return false;
+		}
+		if(f_open(&fil1, filename, FA_READ) != FR_OK){
+			unmount();
+			return false;
+		}
+
+		if(f_read(&fil1, header, CAPTURE_HEADER_SIZE, &read) == FR_OK && read == CAPTURE_HEADER_SIZE
+				&& capture_header_decode(header, info)){
+			uint64_t len = info->sample_count * info->sample_width;
+			if(len > max_len)
+				len = max_len;
+			ok = (len == 0) || read_samples(dest, (uint32_t)len);
+		}
+
+		f_close(&fil1);
+		unmount();
+
+		return ok;
+}
 
-		if(f_write(&fil, buffer , 512, NULL) != FR_OK)
+/*
+ * Description: reads a whole small file, such as a command script, from the sd card
+ * Parameters:
+ * 		const char *filename name of the file
+ * 		char *dest buffer to copy the file to, it is NUL terminated
+ * 		uint32_t size size of the buffer
+ * 		uint32_t *len set to the length of the file
+ * Returns:
+ *   		bool true if the file was read and fits in the buffer with its terminator
+ *   			 false otherwise, or while a save is running
+ */
+bool user_fatfs_read_file(const char *filename, char *dest, uint32_t size, uint32_t *len){
+		UINT read = 0;
+		bool ok = false;
+
+		/* the card is mounted by the save until it ends */
+		if(save_job.state == SAVE_JOB_RUNNING || size == 0)
 			return false;
 
-		if(f_lseek(&fil, (i +1)*512) != FR_OK)
+		if(f_mount(&fs, "", 0) != FR_OK){
+			return false;
+		}
+		if(f_open(&fil1, filename, FA_READ) != FR_OK){
+			unmount();
 			return false;
+		}
+
+		if(f_size(&fil1) < size && f_read(&fil1, dest, size - 1, &read) == FR_OK){
+			dest[read] = '\0';
+			*len = read;
+			ok = true;
+		}
+
+		f_close(&fil1);
+		unmount();
+
+		return ok;
 }
-		if(f_close(&fil) != FR_OK)
+
+/*
+ * Description: moves the stream to the first sector of the next fragment of the link map
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool false if the map has no more fragments
+ */
+static bool stream_next_fragment(void){
+		if(stream.frag[0] == 0)
 			return false;
+		stream.sector = fs.database + (stream.frag[1] - 2) * fs.csize;
+		stream.frag_left = stream.frag[0] * fs.csize;
+		stream.frag += 2;
+		return true;
+}
 
-		/* Unmount SDCARD */
-		if(f_mount(NULL, "", 0) != FR_OK)
+/*
+ * Description: starts reading the next buffer of samples into stream_buffers[stream.fill]. A
+ * 				buffer ends early at the end of a fragment, so that one multi-block read covers a
+ * 				whole fragment. Without read-ahead the buffer is read right away through fatfs
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+static void stream_start_fill(void){
+		uint8_t *dest = stream_buffers[stream.fill];
+		uint32_t len = (stream.left < STREAM_BUFFER_SIZE) ? (uint32_t)stream.left : STREAM_BUFFER_SIZE;
+		UINT read = 0;
+
+		stream.fill_len = len;
+		if(len == 0 || stream.error)
+			return;
+
+		if(!stream.direct){
+			if(f_read(&fil1, dest, len, &read) != FR_OK || read != len)
+				stream.error = true;
+			stream.left -= len;
+			return;
+		}
+
+		if(stream.frag_left == 0 && !stream_next_fragment()){
+			stream.error = true;
+			return;
+		}
+		DWORD sectors = (len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+		if(sectors > stream.frag_left){
+			sectors = stream.frag_left;
+			len = sectors * SECTOR_SIZE;
+			stream.fill_len = len;
+		}
+
+		if(!stream.card_open){
+			if(SD_stream_open(stream.sector) != RES_OK){
+				stream.error = true;
+				return;
+			}
+			stream.card_open = true;
+		}
+		SD_stream_read(dest, sectors);
+		stream.sector += sectors;
+		stream.frag_left -= sectors;
+		stream.left -= len;
+		stream.filling = true;
+}
+
+/*
+ * Description: opens a capture file to be decoded straight from the sd card, for captures that
+ * 				do not fit in sdram. The samples are handed out in buffers by user_fatfs_stream_next
+ * 				while the following buffer is read in the background
+ * Parameters:
+ * 		const char *filename name of the capture file
+ * 		capture_info_t *info filled with the description of the capture
+ * Returns:
+ *   		bool true if the header is valid and the first read was started
+ *   			 false otherwise
+ */
+bool user_fatfs_stream_open(const char *filename, capture_info_t *info){
+		uint8_t header[CAPTURE_HEADER_SIZE];
+		UINT read = 0;
+
+		if(save_job.state == SAVE_JOB_RUNNING || stream.open)
 			return false;
 
+		if(f_mount(&fs, "", 0) != FR_OK){
+			return false;
+		}
+		if(f_open(&fil1, filename, FA_READ) != FR_OK){
+			unmount();
+			return false;
+		}
+		if(f_read(&fil1, header, CAPTURE_HEADER_SIZE, &read) != FR_OK || read != CAPTURE_HEADER_SIZE
+				|| !capture_header_decode(header, info)){
+			f_close(&fil1);
+			unmount();
+			return false;
+		}
+
+		memset(&stream, 0, sizeof(stream));
+		stream.left = info->sample_count * info->sample_width;
+		if(stream.left > f_size(&fil1) - CAPTURE_HEADER_SIZE)
+			stream.left = f_size(&fil1) - CAPTURE_HEADER_SIZE;
+
+		fil1.cltbl = stream_linkmap;
+		stream_linkmap[0] = STREAM_LINKMAP_SIZE;
+		stream.direct = (f_lseek(&fil1, CREATE_LINKMAP) == FR_OK);
+		if(stream.direct){
+			//skip the header sector
+			stream.frag = &stream_linkmap[1];
+			stream_next_fragment();
+			stream.sector += CAPTURE_HEADER_SIZE / SECTOR_SIZE;
+			stream.frag_left -= CAPTURE_HEADER_SIZE / SECTOR_SIZE;
+		}else{
+			fil1.cltbl = NULL;
+		}
+
+		stream.open = true;
+		stream.stats.read_ahead = stream.direct;
+		stream.start_ms = now();
+		stream_start_fill();
 		return true;
+}
 
+/*
+ * Description: moves the background read along, it is called by the decoder between slices of
+ * 				the buffer it is working on
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void user_fatfs_stream_poll(void){
+		int res;
+
+		if(!stream.filling)
+			return;
+		res = SD_stream_poll();
+		if(res > 0)
+			return;
 
+		stream.filling = false;
+		if(res < 0)
+			stream.error = true;
+		//the multi-block read ends with its fragment or the capture
+		if(res < 0 || stream.frag_left == 0 || stream.left == 0){
+			if(SD_stream_close() != RES_OK)
+				stream.error = true;
+			stream.card_open = false;
+		}
 }
 
+/*
+ * Description: gives the next buffer of samples of the open capture file, and starts reading the
+ * 				one after it. The buffer stays valid until the next call
+ * Parameters:
+ * 		uint32_t *len filled with the number of bytes in the buffer
+ * Returns:
+ *   		const uint8_t * pointer to the samples
+ *   			 NULL at the end of the capture or on a read error
+ */
+const uint8_t *user_fatfs_stream_next(uint32_t *len){
+		ticktime_t start = now();
+		const uint8_t *ready;
+
+		if(!stream.open)
+			return NULL;
 
+		while(stream.filling)
+			user_fatfs_stream_poll();
+		if(stream.error || stream.fill_len == 0){
+			stream.stats.wait_ms += now() - start;
+			return NULL;
+		}
+
+		ready = stream_buffers[stream.fill];
+		*len = stream.fill_len;
+		stream.stats.bytes += *len;
+		stream.fill ^= 1;
+		stream_start_fill();
+
+		stream.stats.wait_ms += now() - start;
+		return ready;
+}
+
+/*
+ * Description: closes the capture file opened by user_fatfs_stream_open
+ * Parameters:
+ * 		capture_stream_stats_t *stats filled with the throughput of the read, can be NULL
+ * Returns:
+ *   		bool true if every read succeeded
+ *   			 false otherwise
+ */
+bool user_fatfs_stream_close(capture_stream_stats_t *stats){
+		bool ok;
+
+		if(!stream.open)
+			return false;
+
+		while(stream.filling)
+			user_fatfs_stream_poll();
+		if(stream.card_open)
+			SD_stream_close();
+
+		stream.stats.elapsed_ms = now() - stream.start_ms;
+		if(stats)
+			*stats = stream.stats;
+		ok = !stream.error;
+
+		f_close(&fil1);
+		unmount();
+		stream.open = false;
+		return ok;
+}
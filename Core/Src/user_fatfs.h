@@ -11,7 +11,7 @@
 /**
  * @file    user_fatfs.h
  * @brief   This file contains the function prototype which carries out the operation related to writing
- * 			of the data on the SD Card using Fatfs drivers.
+ * 			and reading back of the data on the SD Card using Fatfs drivers.
  * @author  Pranjal Gupta
  * @date    12/17/2023
  *
@@ -25,5 +25,135 @@
 #define __USER_FATFS_H__
 #include "stdint.h"
 #include "stdbool.h"
-bool user_fatfs_init(uint16_t count);
+#include "capture_format.h"
+
+typedef enum{
+	SAVE_JOB_IDLE = 0,	//no save since reset
+	SAVE_JOB_RUNNING,
+	SAVE_JOB_DONE,
+	SAVE_JOB_FAILED
+}save_job_state_t;
+
+typedef struct{
+	uint64_t bytes;			//samples handed out by user_fatfs_stream_next
+	uint32_t elapsed_ms;	//from open to close
+	uint32_t wait_ms;		//time spent in user_fatfs_stream_next waiting for the card
+	bool read_ahead;		//false if the file was too fragmented and was read without read-ahead
+}capture_stream_stats_t;
+
+typedef struct{
+	save_job_state_t state;
+	char filename[15];
+	const uint8_t *samples;
+	uint32_t len;			//bytes of samples to write
+	uint32_t written;		//bytes of samples written so far
+	uint32_t start_ms;
+	uint32_t elapsed_ms;	//duration of the save once it has ended
+}save_job_t;
+
+/*
+ * Description: starts saving a capture to a new capture file on the sd card. The file is named
+ * 				fileN.bin with the first free N, and holds a header (see capture_format.h) followed by
+ * 				the raw samples. Only the file is created and its header written here, the samples are
+ * 				written span by span by user_fatfs_save_poll, and their sdram region stays locked
+ * 				until the save ends so that new captures are placed next to it
+ * Parameters:
+ * 		const uint8_t *samples pointer to the samples
+ * 		uint32_t len length of the samples
+ * Returns:
+ *   		bool true if the save was started
+ *   			 false if a save is running or the file could not be created
+ */
+bool user_fatfs_save_start(const uint8_t *samples, uint32_t len);
+
+/*
+ * Description: writes the next span of samples of a running save, and ends the save after the
+ * 				last one. It is called whenever the command processor or a capture is waiting
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if the save is still running
+ *   			 false if it has ended or none was running
+ */
+bool user_fatfs_save_poll(void);
+
+/*
+ * Description: gives the state and progress of the last save
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const save_job_t * pointer to the last save job
+ */
+const save_job_t *user_fatfs_get_save_job(void);
+
+/*
+ * Description: reads a capture file back from the sd card, checking its header and copying
+ * 				its samples to a buffer
+ * Parameters:
+ * 		const char *filename name of the capture file
+ * 		uint8_t *dest buffer to copy the samples to
+ * 		uint32_t max_len size of the buffer, longer captures are cut to it, 0 to only read the header
+ * 		capture_info_t *info filled with the description of the capture
+ * Returns:
+ *   		bool true if the header is valid and the samples were read
+ *   			 false otherwise
+ */
+bool user_fatfs_read_capture(const char *filename, uint8_t *dest, uint32_t max_len, capture_info_t *info);
+
+/*
+ * Description: reads a whole small file, such as a command script, from the sd card
+ * Parameters:
+ * 		const char *filename name of the file
+ * 		char *dest buffer to copy the file to, it is NUL terminated
+ * 		uint32_t size size of the buffer
+ * 		uint32_t *len set to the length of the file
+ * Returns:
+ *   		bool true if the file was read and fits in the buffer with its terminator
+ *   			 false otherwise, or while a save is running
+ */
+bool user_fatfs_read_file(const char *filename, char *dest, uint32_t size, uint32_t *len);
+
+/*
+ * Description: opens a capture file to be decoded straight from the sd card, for captures that
+ * 				do not fit in sdram. The samples are handed out in buffers by user_fatfs_stream_next
+ * 				while the following buffer is read in the background
+ * Parameters:
+ * 		const char *filename name of the capture file
+ * 		capture_info_t *info filled with the description of the capture
+ * Returns:
+ *   		bool true if the header is valid and the first read was started
+ *   			 false otherwise
+ */
+bool user_fatfs_stream_open(const char *filename, capture_info_t *info);
+
+/*
+ * Description: gives the next buffer of samples of the open capture file, and starts reading the
+ * 				one after it. The buffer stays valid until the next call
+ * Parameters:
+ * 		uint32_t *len filled with the number of bytes in the buffer
+ * Returns:
+ *   		const uint8_t * pointer to the samples
+ *   			 NULL at the end of the capture or on a read error
+ */
+const uint8_t *user_fatfs_stream_next(uint32_t *len);
+
+/*
+ * Description: moves the background read along, it is called by the decoder between slices of
+ * 				the buffer it is working on
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void user_fatfs_stream_poll(void);
+
+/*
+ * Description: closes the capture file opened by user_fatfs_stream_open
+ * Parameters:
+ * 		capture_stream_stats_t *stats filled with the throughput of the read, can be NULL
+ * Returns:
+ *   		bool true if every read succeeded
+ *   			 false otherwise
+ */
+bool user_fatfs_stream_close(capture_stream_stats_t *stats);
 #endif
@@ -0,0 +1,615 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    wavegen.c
+ * @brief   This file contains the generator of synthetic bus traffic, see wavegen.h. Each
+ * 			transaction is built at the end of the traffic so far; one that does not fit in the
+ * 			buffer any more is taken back, with its events, and the rest is left idle.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "wavegen.h"
+#include "signals.h"
+#include "bit_timing.h"
+#include "onewire_analyser.h"
+#include "ctype.h"
+#include "string.h"
+
+#define UART_BURST_MAX 16			//frames
+#define UART_GAP_BITS_MAX 20		//idle bits after a burst
+#define I2C_BYTES_MAX 8				//data bytes after an address
+#define I2C_STRETCH_HALVES_MAX 4	//clock stretching after a byte, in half clock periods
+#define I2C_IDLE_HALVES_MAX 20
+#define SPI_BYTES_MAX 8
+#define SPI_IDLE_HALVES_MAX 20
+#define ONEWIRE_DATA_MAX 4
+#define ONEWIRE_IDLE_US_MAX 200
+#define ONEWIRE_ONE_LOW_US 6		//shortest pulse, the one of a 1 bit
+#define CAN_IDLE_BITS_MAX 10		//after the intermission, at least 1 so jitter can not shorten it
+#define GLITCH_TRIES 8				//random places looked at for a glitch before giving up
+
+typedef struct{
+	const wavegen_config_t *config;
+	signal_t sig;
+	uint32_t seed;
+	wavegen_event_t *events;
+	uint32_t max_events;
+	wavegen_stats_t *stats;
+	uint32_t period;		//samples in a UART or CAN bit, in half an I2C or SPI clock, in a us of 1-Wire
+	uint32_t bit_q8;		//samples in a UART bit, in 1/256th of a sample
+	uint32_t jitter;		//samples
+}wavegen_t;
+
+static const char *protocol_names[WAVEGEN_PROTOCOLS] = {"uart", "i2c", "spi", "1wire", "can"};
+static const uint32_t uart_rates[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+static const uint32_t can_rates[] = {10000, 20000, 50000, 100000, 125000, 250000, 500000, 1000000};
+static const uint8_t onewire_functions[] = {0x44, 0xBE, 0x4E, 0x48, 0xB8};
+
+/*
+ * Description: gives a random number below a bound
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		uint32_t bound bound, not 0
+ * Returns:
+ *   		uint32_t number in 0..bound-1
+ */
+static uint32_t random_below(wavegen_t *gen, uint32_t bound){
+	return signal_random(&gen->seed) % bound;
+}
+
+/*
+ * Description: draws whether something happens, given its chance in percent
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		uint8_t percent chance
+ * Returns:
+ *   		bool true if it happens
+ */
+static bool chance(wavegen_t *gen, uint8_t percent){
+	return random_below(gen, 100) < percent;
+}
+
+/*
+ * Description: adds an event to the list, or only counts it once the list is full
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		wavegen_event_type_t type type of the event
+ * 		uint32_t position sample of the event
+ * 		uint64_t value value of the event
+ * 		uint8_t flags WAVEGEN_FLAG_x
+ * Returns:
+ *   		wavegen_event_t * the event in the list to add to, NULL if it was only counted
+ */
+static wavegen_event_t *emit(wavegen_t *gen, wavegen_event_type_t type, uint32_t position, uint64_t value,
+		uint8_t flags){
+	wavegen_event_t *event = NULL;
+
+	if(gen->events != NULL && gen->stats->events < gen->max_events){
+		event = &gen->events[gen->stats->events];
+		memset(event, 0, sizeof(*event));
+		event->type = type;
+		event->position = position;
+		event->value = value;
+		event->flags = flags;
+	}
+	gen->stats->events++;
+	if(flags & WAVEGEN_FLAG_ERROR)
+		gen->stats->errors++;
+	return event;
+}
+
+/*
+ * Description: flips a pin for one sample
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		uint32_t position sample to change, before the end of the traffic
+ * 		uint8_t pin pin to change
+ * Returns:
+ *   		None
+ */
+static void glitch(wavegen_t *gen, uint32_t position, uint8_t pin){
+	gen->sig.buf[position] ^= (1 << pin);
+	gen->stats->glitches++;
+}
+
+/*
+ * Description: tells if a pin is at a level on a sample and both its neighbours
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		uint32_t position middle sample, not the first or last of the traffic
+ * 		uint8_t pin pin to look at
+ * 		uint8_t level 0 or 1
+ * Returns:
+ *   		bool true if the three samples have the pin at the level
+ */
+static bool steady(wavegen_t *gen, uint32_t position, uint8_t pin, uint8_t level){
+	for(uint32_t i = position - 1; i <= position + 1; i++){
+		if(((gen->sig.buf[i] >> pin) & 1) != level)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Description: puts a glitch on a data line somewhere between two samples where its clock stays
+ * 				low around it, so no clock edge samples it and no I2C start or stop is made
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		uint32_t from first sample of the range
+ * 		uint32_t to sample after the range
+ * 		uint8_t clock pin of the clock
+ * 		uint8_t data pin to glitch
+ * Returns:
+ *   		None
+ */
+static void glitch_while_clock_low(wavegen_t *gen, uint32_t from, uint32_t to, uint8_t clock, uint8_t data){
+	if(from == 0 || to > gen->sig.len || to < from + 3)
+		return;
+	for(int i = 0; i < GLITCH_TRIES; i++){
+		uint32_t position = from + 1 + random_below(gen, to - from - 2);
+		if(steady(gen, position, clock, 0)){
+			glitch(gen, position, data);
+			return;
+		}
+	}
+}
+
+/*
+ * Description: appends a burst of UART frames and the idle line after it
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * Returns:
+ *   		None
+ */
+static void uart_transaction(wavegen_t *gen){
+	const wavegen_config_t *config = gen->config;
+	uint8_t pin = config->pins[0];
+	uint32_t frames = 1 + random_below(gen, UART_BURST_MAX);
+	uint32_t bit = gen->bit_q8 >> 8;
+
+	for(uint32_t i = 0; i < frames; i++){
+		uint8_t data = random_below(gen, 256);
+		bool framing = chance(gen, config->errors);
+		uint32_t start;
+
+		//a ninth data bit at 0 is where the decoder expects the stop bit
+		start = signal_uart(&gen->sig, pin, data, framing ? 9 : 8, UART_PARITY_NONE, 1, gen->bit_q8);
+		emit(gen, WAVEGEN_EVENT_UART_FRAME, start, data, framing ? WAVEGEN_FLAG_ERROR : 0);
+
+		//early in a bit, after its edge however it was moved, and well before its middle
+		if(chance(gen, config->glitches) && bit / 4 > gen->jitter + 1){
+			uint32_t k = random_below(gen, framing ? 11 : 10);
+			uint32_t position = start + (uint32_t)(((uint64_t)k * gen->bit_q8) >> 8) + gen->jitter + 1
+					+ random_below(gen, bit / 4 - gen->jitter - 1);
+			if(position < gen->sig.len)
+				glitch(gen, position, pin);
+		}
+		if(random_below(gen, 4) == 0)
+			signal_hold(&gen->sig, random_below(gen, 3) * bit);
+	}
+	signal_hold(&gen->sig, (1 + random_below(gen, UART_GAP_BITS_MAX)) * bit);
+}
+
+/*
+ * Description: appends an I2C byte, with its event, glitch and clock stretching
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		wavegen_event_type_t type address or data
+ * 		uint8_t byte byte on the bus
+ * 		uint64_t value value of the event
+ * 		uint8_t flags flags of the event, the byte is not acknowledged if it has WAVEGEN_FLAG_NACK
+ * Returns:
+ *   		None
+ */
+static void i2c_byte(wavegen_t *gen, wavegen_event_type_t type, uint8_t byte, uint64_t value, uint8_t flags){
+	const wavegen_config_t *config = gen->config;
+	uint32_t start = gen->sig.len;
+
+	signal_i2c_byte(&gen->sig, config->pins[0], config->pins[1], byte, !(flags & WAVEGEN_FLAG_NACK), gen->period);
+	emit(gen, type, start, value, flags);
+	if(chance(gen, config->glitches))
+		glitch_while_clock_low(gen, start, gen->sig.len, config->pins[0], config->pins[1]);
+	if(random_below(gen, 4) == 0)//the slave holds SCL low
+		signal_hold(&gen->sig, (1 + random_below(gen, I2C_STRETCH_HALVES_MAX)) * gen->period);
+}
+
+/*
+ * Description: appends an I2C transfer: start, one or two address phases with their data
+ * 				bytes, stop and idle bus
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * Returns:
+ *   		None
+ */
+static void i2c_transaction(wavegen_t *gen){
+	const wavegen_config_t *config = gen->config;
+	uint8_t scl = config->pins[0], sda = config->pins[1];
+	uint32_t phases = (random_below(gen, 5) == 0) ? 2 : 1;
+	uint32_t position;
+
+	position = signal_i2c_start(&gen->sig, scl, sda, gen->period);
+	emit(gen, WAVEGEN_EVENT_I2C_START, position, 0, 0);
+	for(uint32_t phase = 0; phase < phases; phase++){
+		uint8_t address = 0x08 + random_below(gen, 0x70);
+		bool read = random_below(gen, 2);
+		uint32_t bytes = 1 + random_below(gen, I2C_BYTES_MAX);
+		bool stop = false;
+
+		if(phase > 0){
+			position = signal_i2c_start(&gen->sig, scl, sda, gen->period);
+			emit(gen, WAVEGEN_EVENT_I2C_REPEATED_START, position, 0, 0);
+		}
+		if(chance(gen, config->errors)){//nobody at that address
+			i2c_byte(gen, WAVEGEN_EVENT_I2C_ADDRESS, (address << 1) | read, address,
+					WAVEGEN_FLAG_NACK | WAVEGEN_FLAG_ERROR | (read ? WAVEGEN_FLAG_READ : 0));
+			break;
+		}
+		i2c_byte(gen, WAVEGEN_EVENT_I2C_ADDRESS, (address << 1) | read, address, read ? WAVEGEN_FLAG_READ : 0);
+		for(uint32_t i = 0; i < bytes && !stop; i++){
+			uint8_t data = random_below(gen, 256);
+			uint8_t flags = 0;
+
+			if(read && i == bytes - 1){
+				flags = WAVEGEN_FLAG_NACK;//the master ends a read so
+			}else if(!read && chance(gen, config->errors)){
+				flags = WAVEGEN_FLAG_NACK | WAVEGEN_FLAG_ERROR;
+				stop = true;
+			}
+			i2c_byte(gen, WAVEGEN_EVENT_I2C_DATA, data, data, flags);
+		}
+		if(stop)
+			break;
+	}
+	position = signal_i2c_stop(&gen->sig, scl, sda, gen->period);
+	emit(gen, WAVEGEN_EVENT_I2C_STOP, position, 0, 0);
+	signal_hold(&gen->sig, random_below(gen, I2C_IDLE_HALVES_MAX) * gen->period);
+}
+
+/*
+ * Description: appends an SPI transfer of a few bytes under chip select and idle bus
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * Returns:
+ *   		None
+ */
+static void spi_transaction(wavegen_t *gen){
+	const wavegen_config_t *config = gen->config;
+	uint8_t sck = config->pins[0], mosi = config->pins[1], miso = config->pins[2], cs = config->pins[3];
+	uint32_t bytes = 1 + random_below(gen, SPI_BYTES_MAX);
+
+	signal_set(&gen->sig, cs, 0);
+	signal_hold(&gen->sig, gen->period);
+	for(uint32_t i = 0; i < bytes; i++){
+		uint8_t out = random_below(gen, 256), in = random_below(gen, 256);
+		uint32_t start = gen->sig.len;
+		wavegen_event_t *event;
+
+		signal_spi_byte(&gen->sig, sck, mosi, miso, out, in, gen->period);
+		event = emit(gen, WAVEGEN_EVENT_SPI_BYTE, start, out, 0);
+		if(event != NULL)
+			event->id = in;
+		if(chance(gen, config->glitches))
+			glitch_while_clock_low(gen, start, gen->sig.len, sck, random_below(gen, 2) ? mosi : miso);
+	}
+	signal_hold(&gen->sig, gen->period);
+	signal_set(&gen->sig, cs, 1);
+	signal_hold(&gen->sig, (1 + random_below(gen, SPI_IDLE_HALVES_MAX)) * gen->period);
+}
+
+/*
+ * Description: appends a 1-Wire byte and its event
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * 		wavegen_event_type_t type type of the event
+ * 		uint8_t byte byte on the bus
+ * Returns:
+ *   		None
+ */
+static void onewire_byte(wavegen_t *gen, wavegen_event_type_t type, uint8_t byte){
+	uint32_t start = gen->sig.len;
+
+	signal_onewire_byte(&gen->sig, gen->config->pins[0], gen->period, byte);
+	emit(gen, type, start, byte, 0);
+}
+
+/*
+ * Description: appends a 1-Wire transaction: a reset, a ROM command with its ROM ID if it has
+ * 				one, a function command and its data. A reset nobody answers is followed by another
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * Returns:
+ *   		None
+ */
+static void onewire_transaction(wavegen_t *gen){
+	const wavegen_config_t *config = gen->config;
+	static const uint8_t rom_commands[] = {ONEWIRE_CMD_READ_ROM, ONEWIRE_CMD_MATCH_ROM, ONEWIRE_CMD_SKIP_ROM};
+	uint8_t pin = config->pins[0];
+	uint8_t command = rom_commands[random_below(gen, sizeof(rom_commands))];
+	uint32_t start, position, data;
+
+	if(chance(gen, config->errors)){
+		start = gen->sig.len;
+		position = signal_onewire_reset(&gen->sig, pin, gen->period, false);
+		emit(gen, WAVEGEN_EVENT_ONEWIRE_RESET, start, 0, 0);
+		emit(gen, WAVEGEN_EVENT_ONEWIRE_NO_PRESENCE, position, 0, WAVEGEN_FLAG_ERROR);
+	}
+	start = gen->sig.len;
+	position = signal_onewire_reset(&gen->sig, pin, gen->period, true);
+	emit(gen, WAVEGEN_EVENT_ONEWIRE_RESET, start, 0, 0);
+	emit(gen, WAVEGEN_EVENT_ONEWIRE_PRESENCE, position, 0, 0);
+
+	onewire_byte(gen, WAVEGEN_EVENT_ONEWIRE_ROM_COMMAND, command);
+	if(command != ONEWIRE_CMD_SKIP_ROM){
+		uint8_t rom[8];
+		uint64_t id = 0;
+		bool bad_crc = chance(gen, config->errors);
+
+		rom[0] = 0x28;
+		for(int i = 1; i < 7; i++)
+			rom[i] = random_below(gen, 256);
+		rom[7] = onewire_crc8(rom, 7) ^ (bad_crc ? 0x01 : 0);
+		start = gen->sig.len;
+		for(int i = 0; i < 8; i++){
+			signal_onewire_byte(&gen->sig, pin, gen->period, rom[i]);
+			id |= (uint64_t)rom[i] << (8 * i);
+		}
+		emit(gen, WAVEGEN_EVENT_ONEWIRE_ROM_ID, start, id, bad_crc ? WAVEGEN_FLAG_ERROR : 0);
+	}
+	onewire_byte(gen, WAVEGEN_EVENT_ONEWIRE_FUNCTION_COMMAND,
+			onewire_functions[random_below(gen, sizeof(onewire_functions))]);
+	data = random_below(gen, ONEWIRE_DATA_MAX + 1);
+	for(uint32_t i = 0; i < data; i++)
+		onewire_byte(gen, WAVEGEN_EVENT_ONEWIRE_DATA, random_below(gen, 256));
+	signal_hold(&gen->sig, random_below(gen, ONEWIRE_IDLE_US_MAX) * gen->period);
+}
+
+/*
+ * Description: appends a CAN data frame and idle bus
+ * Parameters:
+ * 		wavegen_t *gen generator
+ * Returns:
+ *   		None
+ */
+static void can_transaction(wavegen_t *gen){
+	const wavegen_config_t *config = gen->config;
+	uint8_t pin = config->pins[0];
+	uint16_t id = random_below(gen, 0x800);
+	uint8_t dlc = random_below(gen, 9);
+	bool bad_crc = chance(gen, config->errors);
+	uint8_t data[8];
+	uint64_t value = 0;
+	uint32_t start, end;
+	wavegen_event_t *event;
+
+	for(uint8_t i = 0; i < dlc; i++){
+		data[i] = random_below(gen, 256);
+		value |= (uint64_t)data[i] << (8 * i);
+	}
+	start = signal_can(&gen->sig, pin, gen->period, id, data, dlc, bad_crc);
+	event = emit(gen, WAVEGEN_EVENT_CAN_FRAME, start, value, bad_crc ? WAVEGEN_FLAG_ERROR : 0);
+	if(event != NULL){
+		event->id = id;
+		event->len = dlc;
+	}
+
+	//just after the start of a recessive bit between the start of frame and the CRC delimiter, the
+	//decoder synchronises on it a little late and still samples every bit inside it
+	end = gen->sig.len - 13 * gen->period;
+	if(chance(gen, config->glitches) && 2 * gen->jitter + 2 < gen->period / 2 && end < gen->sig.len){
+		uint32_t bits = (end - start) / gen->period;
+		for(int i = 0; i < GLITCH_TRIES && bits > 1; i++){
+			uint32_t position = start + (1 + random_below(gen, bits - 1)) * gen->period + gen->jitter + 1;
+			if(steady(gen, position, pin, 1)){
+				glitch(gen, position, pin);
+				break;
+			}
+		}
+	}
+	signal_hold(&gen->sig, (1 + random_below(gen, CAN_IDLE_BITS_MAX)) * gen->period);
+}
+
+/*
+ * Description: works out the timing of the protocol at the sample rate
+ * Parameters:
+ * 		wavegen_t *gen generator, with its configuration
+ * Returns:
+ *   		bool true if the rates and pins fit the protocol
+ */
+static bool prepare(wavegen_t *gen){
+	const wavegen_config_t *config = gen->config;
+	uint32_t rate = config->sample_rate, bus = config->bus_rate;
+	uint32_t shortest = 0;
+	int pins = 1;
+
+	if(rate == 0 || config->jitter > WAVEGEN_JITTER_MAX || config->glitches > 100 || config->errors > 100)
+		return false;
+	switch(config->protocol){
+	case WAVEGEN_UART:
+		if(bus == 0 || rate / bus < 4)
+			return false;
+		gen->bit_q8 = rate_to_bit_period(bus, rate);
+		gen->period = shortest = gen->bit_q8 >> 8;
+		break;
+	case WAVEGEN_I2C:
+	case WAVEGEN_SPI:
+		if(bus == 0 || rate / bus < 4)
+			return false;
+		gen->period = shortest = rate / (2 * bus);
+		pins = (config->protocol == WAVEGEN_I2C) ? 2 : 4;
+		break;
+	case WAVEGEN_ONEWIRE:
+		if(rate < 1000000)
+			return false;
+		gen->period = rate / 1000000;
+		shortest = ONEWIRE_ONE_LOW_US * gen->period;
+		break;
+	case WAVEGEN_CAN:
+		if(bus == 0 || rate / bus < 4)
+			return false;
+		gen->period = shortest = rate / bus;
+		break;
+	default:
+		return false;
+	}
+	for(int i = 0; i < pins; i++){
+		if(config->pins[i] > 7)
+			return false;
+		for(int j = 0; j < i; j++){
+			if(config->pins[i] == config->pins[j])
+				return false;
+		}
+	}
+	gen->jitter = shortest * config->jitter / 100;
+	return true;
+}
+
+/*
+ * Description: fills a buffer with random traffic of one protocol, whole transactions followed
+ * 				by idle bus up to its end
+ * Parameters:
+ * 		const wavegen_config_t *config protocol, rates, pins, jitter, glitches, errors and seed
+ * 		uint8_t *buf buffer of samples
+ * 		uint32_t len length of the buffer
+ * 		wavegen_event_t *events list of the events in the traffic, in order, NULL for none
+ * 		uint32_t max_events size of the list, the events past it are only counted
+ * 		wavegen_stats_t *stats counters of what was generated
+ * Returns:
+ *   		bool true if the buffer was filled, false if the rates or pins do not fit the protocol
+ */
+bool wavegen_generate(const wavegen_config_t *config, uint8_t *buf, uint32_t len, wavegen_event_t *events,
+		uint32_t max_events, wavegen_stats_t *stats){
+	wavegen_t gen = {
+			.config = config,
+			.seed = config->seed ? config->seed : 1,
+			.events = events,
+			.max_events = max_events,
+			.stats = stats
+	};
+	uint8_t idle = 0xFF;
+
+	memset(stats, 0, sizeof(*stats));
+	if(!prepare(&gen))
+		return false;
+	if(config->protocol == WAVEGEN_SPI)
+		idle &= ~(1 << config->pins[0]);//mode 0, SCK idles low
+
+	signal_init(&gen.sig, buf, len, idle);
+	signal_set_jitter(&gen.sig, gen.jitter, gen.seed ^ 0x5A5A5A5A);
+	signal_hold(&gen.sig, 16 * gen.period);
+	while(true){
+		wavegen_stats_t before = *stats;
+		uint32_t start = gen.sig.len;
+
+		switch(config->protocol){
+		case WAVEGEN_UART:
+			uart_transaction(&gen);
+			break;
+		case WAVEGEN_I2C:
+			i2c_transaction(&gen);
+			break;
+		case WAVEGEN_SPI:
+			spi_transaction(&gen);
+			break;
+		case WAVEGEN_ONEWIRE:
+			onewire_transaction(&gen);
+			break;
+		default:
+			can_transaction(&gen);
+			break;
+		}
+		if(gen.sig.len >= len){//cut off by the end of the buffer, taken back
+			*stats = before;
+			gen.sig.len = start;
+			gen.sig.level = idle;
+			break;
+		}
+		stats->transactions++;
+	}
+	stats->samples = gen.sig.len;
+	signal_set_jitter(&gen.sig, 0, 1);
+	signal_hold(&gen.sig, len - gen.sig.len);
+	return true;
+}
+
+/*
+ * Description: gives the protocol of a name
+ * Parameters:
+ * 		const char *name uart, i2c, spi, 1wire or can, in any case
+ * Returns:
+ *   		wavegen_protocol_t the protocol, WAVEGEN_PROTOCOLS if the name is unknown
+ */
+wavegen_protocol_t wavegen_protocol_by_name(const char *name){
+	for(int i = 0; i < WAVEGEN_PROTOCOLS; i++){
+		if(!strcasecmp(name, protocol_names[i]))
+			return (wavegen_protocol_t)i;
+	}
+	return WAVEGEN_PROTOCOLS;
+}
+
+/*
+ * Description: gives the largest rate of a table with at least a number of samples per bit
+ * Parameters:
+ * 		const uint32_t *rates table in increasing order
+ * 		int count entries in the table
+ * 		uint32_t sample_rate sample rate in Hz
+ * 		bool whole true if the samples per bit must be a whole number
+ * Returns:
+ *   		uint32_t the rate, the first of the table if none fits
+ */
+static uint32_t fitting_rate(const uint32_t *rates, int count, uint32_t sample_rate, bool whole){
+	uint32_t best = rates[0];
+
+	for(int i = 0; i < count; i++){
+		if(sample_rate / rates[i] >= 8 && (!whole || sample_rate % rates[i] == 0))
+			best = rates[i];
+	}
+	return best;
+}
+
+/*
+ * Description: fills a configuration with the defaults of a protocol: the pins the analyse
+ * 				command uses by default, a bus rate of a few samples per bit at the sample rate,
+ * 				no jitter, glitches or errors
+ * Parameters:
+ * 		wavegen_config_t *config configuration to fill
+ * 		wavegen_protocol_t protocol protocol
+ * 		uint32_t sample_rate sample rate in Hz
+ * Returns:
+ *   		None
+ */
+void wavegen_default_config(wavegen_config_t *config, wavegen_protocol_t protocol, uint32_t sample_rate){
+	memset(config, 0, sizeof(*config));
+	config->protocol = protocol;
+	config->sample_rate = sample_rate;
+	config->seed = 1;
+	for(int i = 0; i < WAVEGEN_PINS; i++)
+		config->pins[i] = i;
+
+	switch(protocol){
+	case WAVEGEN_UART:
+		config->bus_rate = fitting_rate(uart_rates, sizeof(uart_rates) / sizeof(uart_rates[0]), sample_rate, false);
+		break;
+	case WAVEGEN_I2C:
+		config->bus_rate = (sample_rate / 10 < 400000) ? sample_rate / 10 : 400000;
+		break;
+	case WAVEGEN_SPI:
+		config->bus_rate = sample_rate / 8;
+		break;
+	case WAVEGEN_CAN:
+		config->bus_rate = fitting_rate(can_rates, sizeof(can_rates) / sizeof(can_rates[0]), sample_rate, true);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    wavegen.h
+ * @brief   This file contains the generator of synthetic bus traffic, to test and benchmark the
+ * 			decoders on captures of any size, on the host and on the board (the gen command fills
+ * 			SDRAM with it). It fills a sample buffer with random transactions of one protocol,
+ * 			built with signals.c, and lists the events a decoder should find in it:
+ *
+ * 			UART		bursts of 8N1 frames, a framing error as an error
+ * 			I2C			writes and reads to random addresses, with clock stretching, repeated
+ * 						starts, the NACK of the master on the last byte read, and a NACK of the
+ * 						slave as an error
+ * 			SPI			mode 0 transfers of a few bytes under chip select
+ * 			1-Wire		reset, presence, read, match or skip ROM, a function command and data,
+ * 						a missing presence or a ROM ID with a bad CRC as an error
+ * 			CAN			standard data frames, a bad CRC as an error
+ *
+ * 			Jitter moves every edge by up to a percentage of the shortest pulse. Glitches are
+ * 			single sample pulses placed where a correct decoder does not look: on SDA or MOSI and
+ * 			MISO while the clock stays low, early in a UART bit, just after the start of a
+ * 			recessive CAN bit. 1-Wire gets no glitches, every pulse width is meaningful there.
+ * 			The same configuration and seed always give the same samples.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __WAVEGEN_H__
+#define __WAVEGEN_H__
+#include "stdint.h"
+#include "stdbool.h"
+
+#define WAVEGEN_JITTER_MAX 20		//percent, more would move UART and CAN edges past the sample points
+#define WAVEGEN_PINS 4
+
+#define WAVEGEN_FLAG_NACK	(1<<0)	//byte of I2C not acknowledged
+#define WAVEGEN_FLAG_READ	(1<<1)	//I2C address of a read
+#define WAVEGEN_FLAG_ERROR	(1<<2)	//UART framing error, bad CRC, missing presence, NACK of a slave
+
+typedef enum{
+	WAVEGEN_UART = 0,
+	WAVEGEN_I2C,
+	WAVEGEN_SPI,
+	WAVEGEN_ONEWIRE,
+	WAVEGEN_CAN,
+	WAVEGEN_PROTOCOLS
+}wavegen_protocol_t;
+
+typedef struct{
+	wavegen_protocol_t protocol;
+	uint32_t sample_rate;			//Hz
+	uint32_t bus_rate;				//baud, SCL or SCK frequency, CAN bit rate, 1-Wire is at standard speed
+	uint8_t pins[WAVEGEN_PINS];		//UART TX; I2C SCL, SDA; SPI SCK, MOSI, MISO, CS; 1-Wire bus; CAN RX
+	uint8_t jitter;					//largest displacement of an edge, percent of the shortest pulse
+	uint8_t glitches;				//percent of frames or bytes given a glitch
+	uint8_t errors;					//percent of frames given a protocol error
+	uint32_t seed;
+}wavegen_config_t;
+
+typedef enum{
+	WAVEGEN_EVENT_UART_FRAME = 0,			//value data byte
+	WAVEGEN_EVENT_I2C_START,
+	WAVEGEN_EVENT_I2C_REPEATED_START,
+	WAVEGEN_EVENT_I2C_ADDRESS,				//value 7 bit address
+	WAVEGEN_EVENT_I2C_DATA,					//value byte
+	WAVEGEN_EVENT_I2C_STOP,
+	WAVEGEN_EVENT_SPI_BYTE,					//value MOSI byte, id MISO byte
+	WAVEGEN_EVENT_ONEWIRE_RESET,
+	WAVEGEN_EVENT_ONEWIRE_PRESENCE,
+	WAVEGEN_EVENT_ONEWIRE_NO_PRESENCE,		//at the end of the reset pulse
+	WAVEGEN_EVENT_ONEWIRE_ROM_COMMAND,		//value command
+	WAVEGEN_EVENT_ONEWIRE_ROM_ID,			//value ROM ID, family code in the low byte
+	WAVEGEN_EVENT_ONEWIRE_FUNCTION_COMMAND,	//value command
+	WAVEGEN_EVENT_ONEWIRE_DATA,				//value byte
+	WAVEGEN_EVENT_CAN_FRAME					//id identifier, len data bytes in value, the first in the low byte
+}wavegen_event_type_t;
+
+typedef struct{
+	wavegen_event_type_t type;
+	uint32_t position;		//sample where the decoder places it: the falling edge of a UART start
+							//bit, 1-Wire pulse or CAN start of frame, the SDA edge of an I2C start or
+							//stop, the first sample of an I2C or SPI byte
+	uint64_t value;
+	uint16_t id;
+	uint8_t len;
+	uint8_t flags;			//WAVEGEN_FLAG_x
+}wavegen_event_t;
+
+typedef struct{
+	uint32_t events;		//events of the traffic, including those past the end of the list
+	uint32_t transactions;	//UART bursts, I2C and SPI transfers, 1-Wire resets and what follows, CAN frames
+	uint32_t glitches;
+	uint32_t errors;
+	uint32_t samples;		//samples of traffic, the rest of the buffer is idle
+}wavegen_stats_t;
+
+/*
+ * Description: fills a buffer with random traffic of one protocol, whole transactions followed
+ * 				by idle bus up to its end
+ * Parameters:
+ * 		const wavegen_config_t *config protocol, rates, pins, jitter, glitches, errors and seed
+ * 		uint8_t *buf buffer of samples
+ * 		uint32_t len length of the buffer
+ * 		wavegen_event_t *events list of the events in the traffic, in order, NULL for none
+ * 		uint32_t max_events size of the list, the events past it are only counted
+ * 		wavegen_stats_t *stats counters of what was generated
+ * Returns:
+ *   		bool true if the buffer was filled, false if the rates or pins do not fit the protocol
+ */
+bool wavegen_generate(const wavegen_config_t *config, uint8_t *buf, uint32_t len, wavegen_event_t *events,
+		uint32_t max_events, wavegen_stats_t *stats);
+
+/*
+ * Description: gives the protocol of a name
+ * Parameters:
+ * 		const char *name uart, i2c, spi, 1wire or can, in any case
+ * Returns:
+ *   		wavegen_protocol_t the protocol, WAVEGEN_PROTOCOLS if the name is unknown
+ */
+wavegen_protocol_t wavegen_protocol_by_name(const char *name);
+
+/*
+ * Description: fills a configuration with the defaults of a protocol: the pins the analyse
+ * 				command uses by default, a bus rate of a few samples per bit at the sample rate,
+ * 				no jitter, glitches or errors
+ * Parameters:
+ * 		wavegen_config_t *config configuration to fill
+ * 		wavegen_protocol_t protocol protocol
+ * 		uint32_t sample_rate sample rate in Hz
+ * Returns:
+ *   		None
+ */
+void wavegen_default_config(wavegen_config_t *config, wavegen_protocol_t protocol, uint32_t sample_rate);
+
+#endif
@@ -0,0 +1,294 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    bench.c
+ * @brief   This file contains the host benchmark of the hardware independent kernels: the decoders,
+ * 			bit rate detection, the dump frame builder, the capture CRC and a save through FatFs to
+ * 			the RAM disk, then the generator of wavegen.c and each decoder on a whole SDRAM of its
+ * 			own generated traffic, with jitter, glitches and errors. The numbers are host numbers,
+ * 			they compare versions of the code with each other, not with the board.
+ *
+ * 			logiprobe_bench [--quick]
+ *
+ * 			--quick runs every kernel on a small capture, so the benchmark also serves as a test.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "host_stubs.h"
+#include "signals.h"
+#include "uart_analyser.h"
+#include "i2c_analyser.h"
+#include "onewire_analyser.h"
+#include "can_analyser.h"
+#include "bit_timing.h"
+#include "dump.h"
+#include "capture_format.h"
+#include "user_fatfs.h"
+#include "timing_mode_init.h"
+#include "timer_update_event.h"
+#include "fmc.h"
+#include "wavegen.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#define BENCH_LEN (4 * 1024 * 1024)		//samples, as large as a capture region
+#define QUICK_LEN (256 * 1024)
+#define DISK_SECTORS 65536				//32 MB
+#define SAMPLE_RATE 1000000
+#define GEN_JITTER 10					//percent, as gen -j
+#define GEN_GLITCHES 5
+#define GEN_ERRORS 2
+
+typedef void (*bench_kernel_t)(const uint8_t *samples, uint32_t len);
+
+static uint32_t events = 0;
+static wavegen_config_t generated;		//traffic the gen_x kernels decode
+
+static double seconds(void){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void count_uart(const uart_frame_t *frame, void *arg){
+	(void)frame;
+	(void)arg;
+	events++;
+}
+
+static void count_onewire(const onewire_event_t *event, void *arg){
+	(void)event;
+	(void)arg;
+	events++;
+}
+
+static void count_can(const can_frame_t *frame, void *arg){
+	(void)frame;
+	(void)arg;
+	events++;
+}
+
+//a busy bus on every decoder: uart on P0 and P1, I2C on P2 and P3, 1-Wire on P4, CAN on P5
+static void build_traffic(uint8_t *samples, uint32_t len){
+	uint32_t uart_q8 = rate_to_bit_period(115200, SAMPLE_RATE);
+	const uint8_t can_data[] = {0x11, 0x22, 0x33, 0x44};
+	signal_t sig;
+	uint32_t n = 0;
+
+	//each protocol gets its own stretch, in turn, so they do not disturb each other
+	signal_init(&sig, samples, len, 0xFF);
+	while(sig.len < len){
+		signal_hold(&sig, 200);
+		for(int i = 0; i < 16; i++)
+			signal_uart(&sig, i & 1, (uint8_t)(n + i), 8, UART_PARITY_NONE, 1, uart_q8);
+		signal_i2c_start(&sig, 2, 3, 5);
+		signal_i2c_byte(&sig, 2, 3, 0xA0, true, 5);
+		for(int i = 0; i < 8; i++)
+			signal_i2c_byte(&sig, 2, 3, (uint8_t)(n + i), i != 7, 5);
+		signal_i2c_stop(&sig, 2, 3, 5);
+		signal_onewire_reset(&sig, 4, SAMPLE_RATE / 1000000, true);
+		signal_onewire_byte(&sig, 4, SAMPLE_RATE / 1000000, 0xCC);
+		signal_onewire_byte(&sig, 4, SAMPLE_RATE / 1000000, 0x44);
+		signal_hold(&sig, 12 * 4);
+		signal_can(&sig, 5, 4, (uint16_t)(n & 0x7FF), can_data, sizeof(can_data), false);
+		n++;
+	}
+}
+
+static void run_uart(const uint8_t *samples, uint32_t len){
+	uart_config_t config = {{0, 1}, 8, UART_PARITY_NONE, 1, rate_to_bit_period(115200, SAMPLE_RATE),
+			count_uart, NULL};
+	uart_analyser_t ctx;
+
+	uart_analyser_init(&ctx, &config);
+	uart_analyser_process(&ctx, samples, len);
+}
+
+static void run_i2c(const uint8_t *samples, uint32_t len){
+	i2c_analyser_t ctx;
+	char *out;
+
+	host_capture_begin();	//it only prints, each line is an event
+	i2c_analyser_init(&ctx, 2, 3);
+	i2c_analyser_process(&ctx, samples, len);
+	out = host_capture_end(NULL);
+	for(char *c = out; *c; c++)
+		events += (*c == '\n');
+	free(out);
+}
+
+static void run_onewire(const uint8_t *samples, uint32_t len){
+	onewire_analyser_t ctx;
+
+	onewire_analyser_init(&ctx, 4, SAMPLE_RATE, count_onewire, NULL);
+	onewire_analyser_process(&ctx, samples, len);
+}
+
+static void run_can(const uint8_t *samples, uint32_t len){
+	can_analyser_t ctx;
+
+	can_analyser_init(&ctx, 5, 4 << 8, count_can, NULL);
+	can_analyser_process(&ctx, samples, len);
+}
+
+static void run_bit_period(const uint8_t *samples, uint32_t len){
+	events += (detect_bit_period(samples, len, 0x03) != 0);
+}
+
+static void run_dump_frames(const uint8_t *samples, uint32_t len){
+	uint8_t frame[DUMP_FRAME_MAX];
+	uint32_t pos = 0, count;
+	uint16_t seq = 0;
+
+	while(pos < len){
+		dump_build_frame(samples, pos, len, seq++, true, frame, &count);
+		pos += count;
+		events++;
+	}
+}
+
+static void run_crc(const uint8_t *samples, uint32_t len){
+	events += capture_crc32(0, samples, len) & 1;
+}
+
+//the decoders on generated traffic, at the pins and rates of wavegen_default_config
+static void gen_uart(const uint8_t *samples, uint32_t len){
+	uart_config_t config = {{generated.pins[0], UART_ANALYSER_NO_PIN}, 8, UART_PARITY_NONE, 1,
+			rate_to_bit_period(generated.bus_rate, SAMPLE_RATE), count_uart, NULL};
+	uart_analyser_t ctx;
+
+	uart_analyser_init(&ctx, &config);
+	uart_analyser_process(&ctx, samples, len);
+}
+
+static void gen_i2c(const uint8_t *samples, uint32_t len){
+	i2c_analyser_t ctx;
+	char *out;
+
+	host_capture_begin();
+	i2c_analyser_init(&ctx, generated.pins[0], generated.pins[1]);
+	i2c_analyser_process(&ctx, samples, len);
+	out = host_capture_end(NULL);
+	for(char *c = out; *c; c++)
+		events += (*c == '\n');
+	free(out);
+}
+
+static void gen_onewire(const uint8_t *samples, uint32_t len){
+	onewire_analyser_t ctx;
+
+	onewire_analyser_init(&ctx, generated.pins[0], SAMPLE_RATE, count_onewire, NULL);
+	onewire_analyser_process(&ctx, samples, len);
+}
+
+static void gen_can(const uint8_t *samples, uint32_t len){
+	can_analyser_t ctx;
+
+	can_analyser_init(&ctx, generated.pins[0], (SAMPLE_RATE / generated.bus_rate) << 8, count_can, NULL);
+	can_analyser_process(&ctx, samples, len);
+}
+
+static void bench(const char *name, bench_kernel_t kernel, const uint8_t *samples, uint32_t len){
+	double start, elapsed;
+
+	events = 0;
+	start = seconds();
+	kernel(samples, len);
+	elapsed = seconds() - start;
+	printf("%-14s %10.1f Msamples/s %10lu events\n", name, len / elapsed / 1e6, (unsigned long)events);
+}
+
+//fills the buffer with one protocol and decodes it, SPI has no decoder and is only generated
+static bool bench_generated(wavegen_protocol_t protocol, const char *name, bench_kernel_t kernel,
+		uint8_t *samples, uint32_t len){
+	wavegen_stats_t stats;
+	double start, elapsed;
+	char label[24];
+
+	wavegen_default_config(&generated, protocol, SAMPLE_RATE);
+	generated.jitter = GEN_JITTER;
+	generated.glitches = GEN_GLITCHES;
+	generated.errors = GEN_ERRORS;
+	start = seconds();
+	if(!wavegen_generate(&generated, samples, len, NULL, 0, &stats)){
+		printf("%s traffic could not be generated\n", name);
+		return false;
+	}
+	elapsed = seconds() - start;
+	snprintf(label, sizeof(label), "gen %s", name);
+	printf("%-14s %10.1f Msamples/s %10lu events\n", label, len / elapsed / 1e6, (unsigned long)stats.events);
+	if(kernel != NULL){
+		snprintf(label, sizeof(label), "%s on gen", name);
+		bench(label, kernel, samples, len);
+	}
+	return true;
+}
+
+//a background save to the RAM disk, polled to its end as the command processor does
+static bool bench_save(const uint8_t *samples, uint32_t len){
+	double start, elapsed;
+	uint32_t polls = 0;
+
+	set_sample_rate(SAMPLE_RATE);
+	set_trigger_position(NO_TRIGGER_POSITION);
+	start = seconds();
+	if(!user_fatfs_save_start(samples, len)){
+		printf("save could not start\n");
+		return false;
+	}
+	while(user_fatfs_save_poll())
+		polls++;
+	elapsed = seconds() - start;
+	printf("%-14s %10.1f MB/s       %10lu polls\n", "save", len / elapsed / 1e6, (unsigned long)polls);
+	return user_fatfs_get_save_job()->state == SAVE_JOB_DONE;
+}
+
+int main(int argc, char *argv[]){
+	bool quick = (argc > 1 && !strcmp(argv[1], "--quick"));
+	uint32_t len = quick ? QUICK_LEN : BENCH_LEN;
+	uint8_t *samples;
+	bool ok;
+
+	samples = reserve_capture_region(len);
+	if(samples == NULL)
+		return 1;
+	build_traffic(samples, len);
+
+	printf("%u samples%s\n", (unsigned)len, quick ? " (quick)" : "");
+	bench("uart", run_uart, samples, len);
+	bench("i2c", run_i2c, samples, len);
+	bench("1-wire", run_onewire, samples, len);
+	bench("can", run_can, samples, len);
+	bench("bit period", run_bit_period, samples, len);
+	bench("dump rle", run_dump_frames, samples, len);
+	bench("capture crc", run_crc, samples, len);
+
+	host_ramdisk_init(DISK_SECTORS);
+	ok = host_ramdisk_format() && bench_save(samples, len);
+
+	//a whole SDRAM of each protocol, as gen fills it on the board
+	len = quick ? QUICK_LEN : SDRAM_SIZE;
+	samples = reserve_capture_region(len);
+	if(samples == NULL)
+		return 1;
+	ok = bench_generated(WAVEGEN_UART, "uart", gen_uart, samples, len) && ok;
+	ok = bench_generated(WAVEGEN_I2C, "i2c", gen_i2c, samples, len) && ok;
+	ok = bench_generated(WAVEGEN_SPI, "spi", NULL, samples, len) && ok;
+	ok = bench_generated(WAVEGEN_ONEWIRE, "1-wire", gen_onewire, samples, len) && ok;
+	ok = bench_generated(WAVEGEN_CAN, "can", gen_can, samples, len) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    board_stubs.c
+ * @brief   This file contains the host stand ins for the clock, systick, spi dma and memory test drivers. The
+ * 			acquisition drivers themselves are built for the host and run on periph_sim.c, whose
+ * 			simulated time is the one now() and the delays give.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "host_stubs.h"
+#include "pll_clock.h"
+#include "systick.h"
+#include "periph_sim.h"
+#include "membench.h"
+#include "fmc.h"
+#include "spi.h"
+#include "string.h"
+#include "time.h"
+
+uint8_t host_sdram[SDRAM_SIZE] __attribute__((aligned(4096)));
+
+void init_clocks(){
+}
+
+//the clocks init_clocks would set, from the same table
+uint32_t get_sysclk_freq(void){
+	return clock_config_sysclk(clock_config_get());
+}
+
+uint32_t get_ahb_clk_freq(void){
+	return clock_config_hclk(clock_config_get());
+}
+
+uint32_t get_apb1_clk_freq(void){
+	return clock_config_apb1(clock_config_get());
+}
+
+uint32_t get_apb2_clk_freq(void){
+	return clock_config_apb2(clock_config_get());
+}
+
+void init_systick(){
+}
+
+//the time is the one of the peripheral simulation, so waiting lets a capture go on
+ticktime_t now(){
+	ticktime_t t = host_time();
+
+	periph_sim_advance_us(1000);
+	return t;
+}
+
+uint32_t host_time(void){
+	return (uint32_t)(periph_sim_time_ns() / 1000000);
+}
+
+void b_delay(int ms){
+	periph_sim_advance_us((uint64_t)ms * 1000);
+}
+
+void init_cycle_counter(){
+}
+
+uint32_t get_cycles(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec) * (get_sysclk_freq() / 1000000) / 1000);
+}
+
+void b_delay_us(uint32_t us){
+	periph_sim_advance_us(us);
+}
+
+//the RAM disk moves no block by SPI DMA, so stream 3 is always the one of state mode
+bool spi_dma_stream3_irq(void){
+	return false;
+}
+
+uint32_t spi_dma_error_count(void){
+	return 0;
+}
+
+//there is no SDRAM controller to measure, every test reports a failure
+uint32_t membench_check(uint8_t *area, uint32_t len){
+	(void)area;
+	(void)len;
+	return 0;
+}
+
+void membench_run(uint8_t *area, uint32_t len, membench_result_t results[MEMBENCH_TESTS]){
+	(void)area;
+	(void)len;
+	memset(results, 0, sizeof(membench_result_t) * MEMBENCH_TESTS);
+	for(uint8_t t = 0; t < MEMBENCH_TESTS; t++)
+		results[t].name = "host";
+}
@@ -0,0 +1,44 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    cmsis_nvic_virtual.h
+ * @brief   This file is included by core_cm4.h in place of its NVIC functions, since the host build
+ * 			defines CMSIS_NVIC_VIRTUAL. Enabling, disabling and clearing interrupts goes to the
+ * 			simulated NVIC of periph_sim.c, which calls the handlers. Priorities are not simulated.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __CMSIS_NVIC_VIRTUAL_H__
+#define __CMSIS_NVIC_VIRTUAL_H__
+
+void periph_sim_nvic_enable(IRQn_Type irq);
+void periph_sim_nvic_disable(IRQn_Type irq);
+uint32_t periph_sim_nvic_get_enable(IRQn_Type irq);
+void periph_sim_nvic_set_pending(IRQn_Type irq);
+void periph_sim_nvic_clear_pending(IRQn_Type irq);
+uint32_t periph_sim_nvic_get_pending(IRQn_Type irq);
+
+#define NVIC_EnableIRQ					periph_sim_nvic_enable
+#define NVIC_DisableIRQ					periph_sim_nvic_disable
+#define NVIC_GetEnableIRQ				periph_sim_nvic_get_enable
+#define NVIC_SetPendingIRQ				periph_sim_nvic_set_pending
+#define NVIC_ClearPendingIRQ			periph_sim_nvic_clear_pending
+#define NVIC_GetPendingIRQ				periph_sim_nvic_get_pending
+#define NVIC_GetActive(irq)				(0U)
+#define NVIC_SetPriority(irq, priority)	((void)(irq), (void)(priority))
+#define NVIC_GetPriority(irq)			(0U)
+#define NVIC_SetPriorityGrouping(group)	((void)(group))
+#define NVIC_GetPriorityGrouping()		(0U)
+
+#endif
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    console_stub.c
+ * @brief   This file contains the host stand in for uart.c. Received bytes come from a queue the
+ * 			test fills, sent bytes go to stdout. Reading past the end of the queue ends the test
+ * 			program, since on the board it would wait for a key forever.
+ *
+ * 			A test can attach a file descriptor instead, the slave of a pseudo terminal, so that a
+ * 			real client talks to the firmware. stdout then writes to it fully buffered, so a reply
+ * 			the firmware does not flush never reaches the client.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "host_stubs.h"
+#include "uart.h"
+#include "pll_clock.h"
+#include "systick.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "poll.h"
+#include "unistd.h"
+
+static uint8_t *rx_queue = NULL;
+static uint32_t rx_size = 0, rx_head = 0, rx_tail = 0;
+static uint32_t rx_visible = 0;		//bytes up to here have arrived, the rest are scheduled for later
+static struct{
+	uint32_t end;					//queue index after the last byte of the chunk
+	uint32_t at_ms;
+}rx_later[HOST_CONSOLE_LATER_MAX];
+static uint8_t rx_later_count = 0;
+static uint32_t current_baud = UART_DEFAULT_BAUD;
+static uart_tx_stats_t tx_stats;
+static uart_rx_stats_t rx_stats;
+
+static int attached_fd = -1;
+static FILE *attached_stdout = NULL, *detached_stdout = NULL;
+static FILE *saved_stdout = NULL;
+static char *capture_buf = NULL;
+static size_t capture_len = 0;
+
+static void append(const void *data, uint32_t len){
+	if(rx_tail + len > rx_size){
+		//the bytes already read are dropped, the rest moves to the front
+		memmove(rx_queue, rx_queue + rx_head, rx_tail - rx_head);
+		rx_tail -= rx_head;
+		rx_visible -= rx_head;
+		for(uint8_t i = 0; i < rx_later_count; i++)
+			rx_later[i].end -= rx_head;
+		rx_head = 0;
+		if(rx_tail + len > rx_size){
+			rx_size = (rx_tail + len) * 2;
+			rx_queue = realloc(rx_queue, rx_size);
+		}
+	}
+	memcpy(rx_queue + rx_tail, data, len);
+	rx_tail += len;
+	rx_stats.received += len;
+}
+
+//makes the scheduled chunks whose time has come readable, in order
+static void release(void){
+	while(rx_later_count && rx_later[0].at_ms <= host_time()){
+		rx_visible = rx_later[0].end;
+		memmove(&rx_later[0], &rx_later[1], --rx_later_count * sizeof(rx_later[0]));
+	}
+	if(rx_later_count == 0)
+		rx_visible = rx_tail;
+}
+
+void host_console_push(const void *data, uint32_t len){
+	append(data, len);
+	if(rx_later_count == 0)
+		rx_visible = rx_tail;
+}
+
+bool host_console_push_at(uint32_t at_ms, const void *data, uint32_t len){
+	if(rx_later_count == HOST_CONSOLE_LATER_MAX)
+		return false;
+	append(data, len);
+	rx_later[rx_later_count].end = rx_tail;
+	rx_later[rx_later_count].at_ms = at_ms;
+	rx_later_count++;
+	return true;
+}
+
+void host_console_type(const char *text){
+	host_console_push(text, strlen(text));
+}
+
+uint32_t host_console_pending(void){
+	return rx_tail - rx_head;
+}
+
+void host_capture_begin(void){
+	fflush(stdout);
+	saved_stdout = stdout;
+	stdout = open_memstream(&capture_buf, &capture_len);
+}
+
+char *host_capture_end(size_t *len){
+	char *buf;
+
+	fclose(stdout);
+	stdout = saved_stdout;
+	buf = capture_buf;
+	if(len != NULL)
+		*len = capture_len;
+	capture_buf = NULL;
+	capture_len = 0;
+	return buf;
+}
+
+void host_console_attach(int fd){
+	if(attached_fd >= 0){
+		fclose(attached_stdout);
+		stdout = detached_stdout;
+	}
+	attached_fd = fd;
+	if(fd >= 0){
+		fflush(stdout);
+		detached_stdout = stdout;
+		attached_stdout = fdopen(dup(fd), "w");
+		setvbuf(attached_stdout, NULL, _IOFBF, BUFSIZ);
+		stdout = attached_stdout;
+	}
+}
+
+void init_uart(){
+	rx_head = rx_tail = rx_visible = 0;
+	rx_later_count = 0;
+}
+
+unsigned char get_char(){
+	if(attached_fd >= 0){
+		uint8_t byte;
+		if(read(attached_fd, &byte, 1) != 1){
+			fprintf(stderr, "console closed by the client\n");
+			exit(2);
+		}
+		return byte;
+	}
+	release();
+	if(rx_head == rx_visible){
+		fflush(stdout);
+		fprintf(stderr, "console read with no input queued\n");
+		exit(2);
+	}
+	return rx_queue[rx_head++];
+}
+
+int char_available(){
+	if(attached_fd >= 0){
+		struct pollfd p = { attached_fd, POLLIN, 0 };
+		return poll(&p, 1, 0) > 0;
+	}
+	release();
+	if(rx_head == rx_visible && rx_later_count){
+		b_delay(1);		//waiting for scheduled input takes time, or it would never come
+		release();
+	}
+	return rx_head != rx_visible;
+}
+
+unsigned char put_char(unsigned char c_out){
+	tx_stats.queued++;
+	return fputc(c_out, stdout);
+}
+
+void uart_set_tx_overflow(uart_tx_overflow_t policy){
+	(void)policy;
+}
+
+void uart_tx_flush(){
+	fflush(stdout);
+}
+
+const uart_tx_stats_t *uart_get_tx_stats(){
+	return &tx_stats;
+}
+
+const volatile uart_rx_stats_t *uart_get_rx_stats(){
+	return &rx_stats;
+}
+
+//oversampling by 16 only, the exact BRR rules are in uart.c and only matter on the board
+uint32_t uart_compute_brr(uint32_t baud, uint32_t *brr, bool *over8){
+	uint32_t fck = get_apb1_clk_freq();
+	uint32_t div;
+
+	if(baud == 0)
+		return 0;
+	div = (fck + baud / 2) / baud;
+	if(div < 16)
+		return 0;
+	*brr = div;
+	*over8 = false;
+	return fck / div;
+}
+
+uint32_t uart_set_baud(uint32_t baud){
+	uint32_t brr;
+	bool over8;
+	uint32_t actual = uart_compute_brr(baud, &brr, &over8);
+
+	if(actual != 0)
+		current_baud = baud;
+	return actual;
+}
+
+uint32_t uart_get_baud(){
+	return current_baud;
+}
+
+bool uart_switch_baud(uint32_t baud, uint32_t confirm_ms){
+	(void)confirm_ms;
+	return uart_set_baud(baud) != 0;
+}
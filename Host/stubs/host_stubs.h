@@ -0,0 +1,201 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    host_stubs.h
+ * @brief   This file contains the controls of the board stubs of the host build. They stand in for
+ * 			the drivers that touch registers, so the hardware independent modules link unchanged:
+ *
+ * 			console_stub.c	uart.h, received bytes come from a queue filled by the test and sent
+ * 							bytes go to stdout, which a test can capture
+ * 			board_stubs.c	pll_clock.h, systick.h and membench.h
+ * 			periph_sim.c	the timers, DMA streams and button under the acquisition drivers, which
+ * 							are built unchanged; the port samples come from a sample source
+ * 			ramdisk.c		fatfs_sd.h over a RAM disk that can be told to fail
+ *
+ * 			SDRAM is the array host_sdram, fmc.c is built with HOST_BUILD to use it.
+ *
+ * 			Time is simulated: every call to now() is one millisecond later than the previous one,
+ * 			so timeouts end after as many polls and the tests never wait. The peripherals run on the
+ * 			same time, see periph_sim.h.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __HOST_STUBS_H__
+#define __HOST_STUBS_H__
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+
+extern uint8_t host_sdram[];
+
+#define HOST_CONSOLE_LATER_MAX 8	//chunks of console input scheduled at once
+
+typedef void (*host_sample_source_t)(uint8_t *dest, uint32_t len, void *arg);
+
+typedef struct{
+	uint32_t reads;			//read calls
+	uint32_t writes;		//write calls
+	uint64_t sectors_read;
+	uint64_t sectors_written;
+	uint32_t failed;		//calls failed by fault injection
+}host_ramdisk_stats_t;
+
+/*
+ * Description: queues bytes as if the host had sent them to the console uart
+ * Parameters:
+ * 		const void *data bytes to queue
+ * 		uint32_t len number of bytes
+ * Returns:
+ *   		None
+ */
+void host_console_push(const void *data, uint32_t len);
+
+/*
+ * Description: queues bytes that arrive on the console once the simulated time reaches a given
+ * 				millisecond, bytes queued after them wait as well. Meanwhile every poll of the empty
+ * 				console moves the time on by a millisecond
+ * Parameters:
+ * 		uint32_t at_ms time of arrival, see host_time
+ * 		const void *data bytes to queue
+ * 		uint32_t len number of bytes
+ * Returns:
+ *   		bool false if HOST_CONSOLE_LATER_MAX chunks are already waiting
+ */
+bool host_console_push_at(uint32_t at_ms, const void *data, uint32_t len);
+
+/*
+ * Description: queues a string as if it had been typed on the console
+ * Parameters:
+ * 		const char *text string to queue, without its terminator
+ * Returns:
+ *   		None
+ */
+void host_console_type(const char *text);
+
+/*
+ * Description: takes the console bytes from a file descriptor instead of the queue, and sends
+ * 				stdout to it fully buffered, until it is detached
+ * Parameters:
+ * 		int fd descriptor to read and write, -1 to go back to the queue and the previous stdout
+ * Returns:
+ *   		None
+ */
+void host_console_attach(int fd);
+
+/*
+ * Description: gives the number of queued bytes not read yet
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t number of bytes
+ */
+uint32_t host_console_pending(void);
+
+/*
+ * Description: gives the simulated time without moving it on, unlike now()
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t milliseconds since the start
+ */
+uint32_t host_time(void);
+
+/*
+ * Description: starts collecting everything written to stdout, so a test can look at the console
+ * 				output. Captures do not nest
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void host_capture_begin(void);
+
+/*
+ * Description: stops collecting stdout
+ * Parameters:
+ * 		size_t *len set to the number of bytes collected, may be NULL
+ * Returns:
+ *   		char * the bytes collected with a terminator, to be freed by the caller
+ */
+char *host_capture_end(size_t *len);
+
+/*
+ * Description: sets what the port shows to the next captures, by default all zeros. The source is
+ * 				asked for the samples from the first sampling event of a capture on, as many as
+ * 				the capture may need, and again from the start for more
+ * Parameters:
+ * 		host_sample_source_t source function filling a buffer from sample 0, NULL for zeros
+ * 		void *arg passed to the function
+ * Returns:
+ *   		None
+ */
+void host_set_sample_source(host_sample_source_t source, void *arg);
+
+/*
+ * Description: gives the number of captures started since the start
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t number of captures
+ */
+uint32_t host_capture_count(void);
+
+/*
+ * Description: creates an empty RAM disk, freeing the previous one
+ * Parameters:
+ * 		uint32_t sectors size of the disk in 512 byte sectors
+ * Returns:
+ *   		None
+ */
+void host_ramdisk_init(uint32_t sectors);
+
+/*
+ * Description: makes the RAM disk fail calls after a number of sectors, to test error paths
+ * Parameters:
+ * 		int64_t write_after sectors written before writes fail, -1 never
+ * 		int64_t read_after sectors read before reads fail, -1 never
+ * Returns:
+ *   		None
+ */
+void host_ramdisk_fail_after(int64_t write_after, int64_t read_after);
+
+/*
+ * Description: gives the counters of the RAM disk
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const host_ramdisk_stats_t * counters since host_ramdisk_init
+ */
+const host_ramdisk_stats_t *host_ramdisk_get_stats(void);
+
+/*
+ * Description: gives the contents of the RAM disk
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint8_t * first byte of sector 0
+ */
+uint8_t *host_ramdisk_data(void);
+
+/*
+ * Description: formats the RAM disk with FatFs and links the FatFs driver, as MX_FATFS_Init does
+ * 				at boot
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		bool true if the disk was formatted
+ */
+bool host_ramdisk_format(void);
+
+#endif
@@ -0,0 +1,746 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    periph_sim.c
+ * @brief   This file contains the simulation of the acquisition peripherals for the host build, see
+ * 			periph_sim.h. The drivers write the register blocks below as they would the ones of the
+ * 			board; at every step the simulation looks at them (sync), moves to the next event and
+ * 			acts on it as the hardware would, then looks again.
+ *
+ * 			The addresses the drivers give the DMA are 32 bits, so the host build is linked without
+ * 			PIE, which keeps host_sdram and the pre trigger buffers below 4GB.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "host_stubs.h"
+#include "periph_sim.h"
+#include "pll_clock.h"
+#include "fmc.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define PS_PER_S 1000000000000ULL
+#define PS_PER_US 1000000ULL
+#define SIM_SCRIPT_MIN (1 << 20)			//samples of the source made at once, doubled as needed
+#define SIM_SRAM_BUF_SIZE 32768				//array_1 and array_2 of input_capture_dma.c
+#define SIM_GPIOC_IDR_HIGH (GPIOC_BASE + 0x11)	//upper byte of GPIOC IDR, the only source simulated
+#define SIM_SMS_TRIGGER 0b110
+#define SIM_MMS_UPDATE 0b010
+#define SIM_MODER_AF 0b10
+
+DMA_TypeDef sim_dma2;
+DMA_Stream_TypeDef sim_dma2_stream[8];
+TIM_TypeDef sim_tim1, sim_tim5, sim_tim8;
+GPIO_TypeDef sim_gpioa, sim_gpioc;
+EXTI_TypeDef sim_exti;
+SYSCFG_TypeDef sim_syscfg;
+RCC_TypeDef sim_rcc;
+DBGMCU_TypeDef sim_dbgmcu;
+DWT_Type sim_dwt;
+USART_TypeDef sim_usart2;
+GPIO_TypeDef sim_gpiod;
+DMA_TypeDef sim_dma1;
+DMA_Stream_TypeDef sim_dma1_stream[8];
+uint32_t sim_primask;
+
+extern uint8_t array_1[], array_2[];
+
+void DMA2_Stream2_IRQHandler(void);
+void DMA2_Stream3_IRQHandler(void);
+void DMA2_Stream5_IRQHandler(void);
+void EXTI0_IRQHandler(void);
+void USART2_IRQHandler(void);
+
+typedef enum{
+	REQ_NONE = 0,
+	REQ_TIM1_UP,
+	REQ_TIM1_CH2,
+	REQ_TIM8_CH2
+}sim_request_t;
+
+typedef enum{
+	SAMPLER_NONE = 0,
+	SAMPLER_TIMING,		//TIM1 update events
+	SAMPLER_STATE		//edges of the external clock on the input captures
+}sim_sampler_t;
+
+typedef struct{
+	DMA_Stream_TypeDef *regs;
+	uint8_t number;
+	IRQn_Type irq;
+	bool active;			//enabled, and NDTR taken as the length of the transfer
+	uint32_t ndtr_start;
+}sim_stream_t;
+
+typedef struct{
+	TIM_TypeDef *regs;
+	volatile uint32_t *enr;
+	uint32_t en_bit;
+	bool apb2;
+	bool running;
+	uint64_t start_ps;
+	uint64_t next_update_ps;
+}sim_timer_t;
+
+typedef struct{
+	IRQn_Type irq;
+	void (*handler)(void);
+	bool pending;
+	uint64_t raised_ps;
+	uint64_t due_ps;
+}sim_irq_t;
+
+//DMA2 request mapping of RM0090 for the streams the drivers use
+static const struct{
+	uint8_t stream;
+	uint8_t channel;
+	sim_request_t request;
+}routes[] = {
+	{2, 6, REQ_TIM1_CH2},
+	{3, 7, REQ_TIM8_CH2},
+	{5, 6, REQ_TIM1_UP},
+};
+
+static const uint8_t flag_shift[4] = {0, 6, 16, 22};
+
+static sim_stream_t streams[] = {
+	{.regs = &sim_dma2_stream[2], .number = 2, .irq = DMA2_Stream2_IRQn},
+	{.regs = &sim_dma2_stream[3], .number = 3, .irq = DMA2_Stream3_IRQn},
+	{.regs = &sim_dma2_stream[5], .number = 5, .irq = DMA2_Stream5_IRQn},
+};
+#define SIM_STREAMS (sizeof(streams) / sizeof(streams[0]))
+
+static sim_timer_t tim1 = {.regs = &sim_tim1, .enr = &sim_rcc.APB2ENR, .en_bit = RCC_APB2ENR_TIM1EN, .apb2 = true};
+static sim_timer_t tim8 = {.regs = &sim_tim8, .enr = &sim_rcc.APB2ENR, .en_bit = RCC_APB2ENR_TIM8EN, .apb2 = true};
+static sim_timer_t tim5 = {.regs = &sim_tim5, .enr = &sim_rcc.APB1ENR, .en_bit = RCC_APB1ENR_TIM5EN, .apb2 = false};
+
+static sim_irq_t irqs[] = {
+	{.irq = DMA2_Stream2_IRQn, .handler = DMA2_Stream2_IRQHandler},
+	{.irq = DMA2_Stream3_IRQn, .handler = DMA2_Stream3_IRQHandler},
+	{.irq = DMA2_Stream5_IRQn, .handler = DMA2_Stream5_IRQHandler},
+	{.irq = EXTI0_IRQn, .handler = EXTI0_IRQHandler},
+	{.irq = USART2_IRQn, .handler = USART2_IRQHandler},
+};
+#define SIM_IRQS (sizeof(irqs) / sizeof(irqs[0]))
+static uint32_t nvic_enabled[3];
+
+static uint64_t now_ps = 0;
+static bool stepping = false;
+static uint32_t state_clock = PERIPH_SIM_STATE_CLOCK_DEFAULT;
+static uint64_t irq_latency_ps = 0;
+static uint64_t button_delay_ps = PERIPH_SIM_BUTTON_DELAY_DEFAULT * PS_PER_US;
+static uint64_t press_ps = PERIPH_SIM_NONE;
+static bool pressed = false;
+
+static sim_sampler_t sampler = SAMPLER_NONE;
+static uint64_t sample_index = 0;
+static bool stream3_stored = false;
+static periph_sim_stats_t stats = {.first_sample = PERIPH_SIM_NONE, .handover_sample = PERIPH_SIM_NONE};
+static uint32_t total_captures = 0;
+
+static sim_irq_t *active_irq = NULL;
+static uint8_t *usart_queue = NULL;
+static uint32_t usart_size = 0, usart_len = 0, usart_pos = 0;
+static uint64_t usart_next_ps = PERIPH_SIM_NONE;
+
+static host_sample_source_t sample_source = NULL;
+static void *sample_source_arg = NULL;
+static uint8_t *script = NULL;
+static uint64_t script_len = 0;
+
+void host_set_sample_source(host_sample_source_t source, void *arg){
+	sample_source = source;
+	sample_source_arg = arg;
+	script_len = 0;
+}
+
+uint32_t host_capture_count(void){
+	return total_captures;
+}
+
+//the console stub has no usart, test_uart links uart.c and its handler in place of this one
+__attribute__((weak)) void USART2_IRQHandler(void){
+}
+
+//sample k of the source, made in one go from the start as the sources expect
+static uint8_t script_sample(uint64_t k){
+	if(k >= script_len){
+		uint64_t len = script_len ? script_len : SIM_SCRIPT_MIN;
+
+		while(len <= k)
+			len *= 2;
+		script = realloc(script, len);
+		if(sample_source != NULL)
+			sample_source(script, (uint32_t)len, sample_source_arg);
+		else
+			memset(script, 0, len);
+		script_len = len;
+	}
+	return script[k];
+}
+
+static sim_irq_t *find_irq(IRQn_Type irq){
+	for(uint8_t i = 0; i < SIM_IRQS; i++)
+		if(irqs[i].irq == irq)
+			return &irqs[i];
+	return NULL;
+}
+
+static bool irq_enabled(IRQn_Type irq){
+	return (nvic_enabled[irq >> 5] >> (irq & 31)) & 1;
+}
+
+static void raise_irq(IRQn_Type irq, uint64_t delay_ps){
+	sim_irq_t *s = find_irq(irq);
+
+	if(s == NULL)
+		return;
+	if(s->pending){
+		stats.irqs_lost++;
+		return;
+	}
+	s->pending = true;
+	s->raised_ps = now_ps;
+	s->due_ps = now_ps + delay_ps;
+}
+
+void periph_sim_nvic_enable(IRQn_Type irq){
+	nvic_enabled[irq >> 5] |= 1UL << (irq & 31);
+}
+
+void periph_sim_nvic_disable(IRQn_Type irq){
+	nvic_enabled[irq >> 5] &= ~(1UL << (irq & 31));
+}
+
+uint32_t periph_sim_nvic_get_enable(IRQn_Type irq){
+	return irq_enabled(irq);
+}
+
+void periph_sim_nvic_set_pending(IRQn_Type irq){
+	raise_irq(irq, 0);
+}
+
+void periph_sim_nvic_clear_pending(IRQn_Type irq){
+	sim_irq_t *s = find_irq(irq);
+
+	if(s != NULL)
+		s->pending = false;
+}
+
+uint32_t periph_sim_nvic_get_pending(IRQn_Type irq){
+	sim_irq_t *s = find_irq(irq);
+
+	return (s != NULL) && s->pending;
+}
+
+static sim_request_t stream_request(const sim_stream_t *s){
+	uint8_t channel = (s->regs->CR & DMA_SxCR_CHSEL_Msk) >> DMA_SxCR_CHSEL_Pos;
+
+	for(uint8_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
+		if(routes[i].stream == s->number && routes[i].channel == channel)
+			return routes[i].request;
+	return REQ_NONE;
+}
+
+static void stream_flag(sim_stream_t *s, uint32_t flag, uint32_t enable){
+	volatile uint32_t *isr = (s->number < 4) ? &sim_dma2.LISR : &sim_dma2.HISR;
+
+	*isr |= flag << flag_shift[s->number & 3];
+	if(s->regs->CR & enable)
+		raise_irq(s->irq, irq_latency_ps);
+}
+
+static bool sim_memory(const uint8_t *p){
+	return (p >= host_sdram && p < host_sdram + SDRAM_SIZE) ||
+			(p >= array_1 && p < array_1 + SIM_SRAM_BUF_SIZE) ||
+			(p >= array_2 && p < array_2 + SIM_SRAM_BUF_SIZE);
+}
+
+//one byte from the port to memory, false if the stream has nowhere valid to put it
+static bool transfer(sim_stream_t *s, uint8_t value){
+	DMA_Stream_TypeDef *r = s->regs;
+	uint32_t ndtr = r->NDTR & 0xFFFF;
+	bool second = (r->CR & DMA_SxCR_DBM) && (r->CR & DMA_SxCR_CT);
+	uint32_t base = second ? r->M1AR : r->M0AR;
+	uint32_t offset = (r->CR & DMA_SxCR_MINC) ? s->ndtr_start - ndtr : 0;
+	uint8_t *dest = (uint8_t*)(uintptr_t)(base + offset);
+
+	if(r->PAR != SIM_GPIOC_IDR_HIGH || ndtr == 0 || !sim_memory(dest)){
+		r->CR &= ~DMA_SxCR_EN;
+		s->active = false;
+		stats.transfer_errors++;
+		stream_flag(s, DMA_LISR_TEIF0, DMA_SxCR_TEIE);
+		return false;
+	}
+	*dest = value;
+	r->NDTR = --ndtr;
+	if(ndtr == s->ndtr_start / 2)
+		stream_flag(s, DMA_LISR_HTIF0, DMA_SxCR_HTIE);
+	if(ndtr == 0){
+		if(r->CR & DMA_SxCR_DBM){
+			r->CR ^= DMA_SxCR_CT;
+			r->NDTR = s->ndtr_start;
+		}else if(r->CR & DMA_SxCR_CIRC){
+			r->NDTR = s->ndtr_start;
+		}else{
+			r->CR &= ~DMA_SxCR_EN;	//the end of a normal transfer disables the stream
+			s->active = false;
+		}
+		stream_flag(s, DMA_LISR_TCIF0, DMA_SxCR_TCIE);
+	}
+	return true;
+}
+
+static uint64_t timer_period_ps(const sim_timer_t *t){
+	uint64_t clk = (uint64_t)(t->apb2 ? get_apb2_clk_freq() : get_apb1_clk_freq()) * 2;
+	uint64_t arr = (t == &tim5) ? t->regs->ARR : (t->regs->ARR & 0xFFFF);	//TIM5 is 32 bits
+
+	//a tick is not a whole number of ps at every clock, so multiply first
+	return (uint64_t)((unsigned __int128)((uint64_t)t->regs->PSC + 1) * (arr + 1) * PS_PER_S / clk);
+}
+
+//the channel 2 input capture of a timer with its pin, making a DMA request at every edge
+static bool capture_requests(const sim_timer_t *t){
+	TIM_TypeDef *r = t->regs;
+
+	if(!t->running || !(r->DIER & TIM_DIER_CC2DE) || !(r->CCER & TIM_CCER_CC2E) ||
+			(r->CCMR1 & TIM_CCMR1_CC2S) != TIM_CCMR1_CC2S_0)
+		return false;
+	if(t == &tim1)		//PA9 in AF1
+		return (sim_rcc.AHB1ENR & RCC_AHB1ENR_GPIOAEN) && ((sim_gpioa.MODER >> 18) & 3) == SIM_MODER_AF &&
+				((sim_gpioa.AFR[1] >> 4) & 0xF) == 1;
+	return (sim_rcc.AHB1ENR & RCC_AHB1ENR_GPIOCEN) && ((sim_gpioc.MODER >> 14) & 3) == SIM_MODER_AF &&
+			((sim_gpioc.AFR[0] >> 28) & 0xF) == 3;		//PC7 in AF3
+}
+
+static sim_sampler_t sampler_mode(void){
+	if(tim1.running && (sim_tim1.DIER & TIM_DIER_UDE))
+		return SAMPLER_TIMING;
+	if(capture_requests(&tim1) || capture_requests(&tim8))
+		return SAMPLER_STATE;
+	return SAMPLER_NONE;
+}
+
+static bool requested(sim_sampler_t mode, sim_request_t request){
+	switch(request){
+	case REQ_TIM1_UP:
+		return mode == SAMPLER_TIMING;
+	case REQ_TIM1_CH2:
+		return mode == SAMPLER_STATE && capture_requests(&tim1);
+	case REQ_TIM8_CH2:
+		return mode == SAMPLER_STATE && capture_requests(&tim8);
+	default:
+		return false;
+	}
+}
+
+//true if a sampling event of the mode would be taken by a stream
+static bool consumed(sim_sampler_t mode){
+	for(uint8_t i = 0; i < SIM_STREAMS; i++)
+		if(streams[i].active && requested(mode, stream_request(&streams[i])))
+			return true;
+	return false;
+}
+
+static uint64_t state_period_ps(void){
+	return PS_PER_S / state_clock;
+}
+
+static uint64_t next_sample_ps(sim_sampler_t mode){
+	if(mode == SAMPLER_TIMING)
+		return tim1.next_update_ps;
+	return (now_ps / state_period_ps() + 1) * state_period_ps();
+}
+
+//counts the sampling events up to a time without looking at them, as no stream takes them
+static void skip_samples(sim_sampler_t mode, uint64_t to_ps){
+	uint64_t n = 0;
+
+	if(mode == SAMPLER_TIMING){
+		uint64_t period = timer_period_ps(&tim1);
+
+		if(to_ps >= tim1.next_update_ps){
+			n = (to_ps - tim1.next_update_ps) / period + 1;
+			tim1.next_update_ps += n * period;
+		}
+	}else if(mode == SAMPLER_STATE){
+		n = to_ps / state_period_ps() - now_ps / state_period_ps();
+	}
+	sample_index += n;
+	stats.samples += n;
+}
+
+static void sample_event(sim_sampler_t mode){
+	bool stored = false, have = false;
+	uint8_t value = 0;
+
+	for(uint8_t i = 0; i < SIM_STREAMS; i++){
+		sim_stream_t *s = &streams[i];
+
+		if(!s->active || !requested(mode, stream_request(s)))
+			continue;
+		if(!have){
+			value = script_sample(sample_index);
+			sim_gpioc.IDR = (uint32_t)value << 8;
+			have = true;
+		}
+		if(transfer(s, value)){
+			stored = true;
+			if(s->number == 3)
+				stream3_stored = true;
+			else if(s->number == 2 && stream3_stored && stats.handover_sample == PERIPH_SIM_NONE)
+				stats.handover_sample = sample_index;
+		}
+	}
+	if(stored){
+		if(stats.first_sample == PERIPH_SIM_NONE)
+			stats.first_sample = sample_index;
+		else
+			stats.dropped += sample_index - stats.last_sample - 1;
+		stats.last_sample = sample_index;
+		stats.stored++;
+	}
+	stats.samples++;
+	sample_index++;
+	if(mode == SAMPLER_TIMING)
+		tim1.next_update_ps += timer_period_ps(&tim1);
+}
+
+static void start_capture(void){
+	uint32_t captures = stats.captures + 1;
+	uint32_t usart_received = stats.usart_received, usart_overruns = stats.usart_overruns;
+
+	memset(&stats, 0, sizeof(stats));
+	stats.captures = captures;
+	stats.usart_received = usart_received;
+	stats.usart_overruns = usart_overruns;
+	stats.first_sample = PERIPH_SIM_NONE;
+	stats.handover_sample = PERIPH_SIM_NONE;
+	sample_index = 0;
+	stream3_stored = false;
+	script_len = 0;
+	total_captures++;
+}
+
+//a slave in trigger mode waiting for the TRGO of TIM5 on its trigger input
+static bool slave_waiting(const sim_timer_t *t, uint8_t itr){
+	TIM_TypeDef *r = t->regs;
+
+	return !(r->CR1 & TIM_CR1_CEN) && (*t->enr & t->en_bit) &&
+			((r->SMCR & TIM_SMCR_SMS_Msk) >> TIM_SMCR_SMS_Pos) == SIM_SMS_TRIGGER &&
+			((r->SMCR & TIM_SMCR_TS_Msk) >> TIM_SMCR_TS_Pos) == itr;
+}
+
+static uint64_t next_tim5_ps(void){
+	if(!tim5.running || ((sim_tim5.CR2 & TIM_CR2_MMS_Msk) >> TIM_CR2_MMS_Pos) != SIM_MMS_UPDATE ||
+			!(slave_waiting(&tim1, 0) || slave_waiting(&tim8, 3)))
+		return PERIPH_SIM_NONE;
+	if(tim5.next_update_ps < now_ps){
+		uint64_t period = timer_period_ps(&tim5);
+
+		tim5.next_update_ps += ((now_ps - tim5.next_update_ps) / period + 1) * period;
+	}
+	return tim5.next_update_ps;
+}
+
+static void tim5_update(void){
+	if(slave_waiting(&tim1, 0))		//ITR0 of TIM1 is TIM5
+		sim_tim1.CR1 |= TIM_CR1_CEN;
+	if(slave_waiting(&tim8, 3))		//ITR3 of TIM8 is TIM5
+		sim_tim8.CR1 |= TIM_CR1_CEN;
+	tim5.next_update_ps += timer_period_ps(&tim5);
+}
+
+static bool button_armed(void){
+	return (sim_rcc.APB2ENR & RCC_APB2ENR_SYSCFGEN) && (sim_rcc.AHB1ENR & RCC_AHB1ENR_GPIOAEN) &&
+			(sim_exti.IMR & EXTI_IMR_IM0) && (sim_exti.RTSR & EXTI_RTSR_TR0) &&
+			(sim_syscfg.EXTICR[0] & SYSCFG_EXTICR1_EXTI0) == SYSCFG_EXTICR1_EXTI0_PA && irq_enabled(EXTI0_IRQn);
+}
+
+static void press_button(void){
+	press_ps = PERIPH_SIM_NONE;
+	pressed = true;
+	sim_exti.PR |= EXTI_PR_PR0;
+	raise_irq(EXTI0_IRQn, irq_latency_ps);
+}
+
+static uint64_t next_irq_ps(sim_irq_t **next){
+	uint64_t t = PERIPH_SIM_NONE;
+
+	*next = NULL;
+	for(uint8_t i = 0; i < SIM_IRQS; i++){
+		uint64_t due;
+
+		if(!irqs[i].pending || !irq_enabled(irqs[i].irq))
+			continue;
+		due = (irqs[i].due_ps > now_ps) ? irqs[i].due_ps : now_ps;
+		if(due < t){
+			t = due;
+			*next = &irqs[i];
+		}
+	}
+	return t;
+}
+
+//CNT counts from the start of the timer, CCR2 holds it at the last edge of the external clock
+static void update_timer_counter(sim_timer_t *t){
+	uint64_t clk = (uint64_t)(t->apb2 ? get_apb2_clk_freq() : get_apb1_clk_freq()) * 2;
+	uint64_t tick_div = ((uint64_t)t->regs->PSC + 1) * PS_PER_S;	//ticks are (ps x clk) / tick_div
+	uint64_t top = (t == &tim5) ? (uint64_t)t->regs->ARR + 1 : (t->regs->ARR & 0xFFFF) + 1;
+	uint64_t edge = now_ps / state_period_ps() * state_period_ps();
+
+	if(!t->running)
+		return;
+	t->regs->CNT = (uint32_t)(((unsigned __int128)(now_ps - t->start_ps) * clk / tick_div) % top);
+	if(sampler == SAMPLER_STATE && edge >= t->start_ps)
+		t->regs->CCR2 = (uint32_t)(((unsigned __int128)(edge - t->start_ps) * clk / tick_div) % top);
+}
+
+static void dispatch(sim_irq_t *s){
+	uint64_t latency_ns = (now_ps - s->raised_ps) / 1000;
+
+	sim_dwt.CYCCNT = (uint32_t)((unsigned __int128)now_ps * get_sysclk_freq() / PS_PER_S);
+	update_timer_counter(&tim1);
+	update_timer_counter(&tim8);
+	s->pending = false;
+	stats.irqs++;
+	if(latency_ns > stats.irq_latency_max_ns)
+		stats.irq_latency_max_ns = (uint32_t)latency_ns;
+	active_irq = s;
+	s->handler();
+	active_irq = NULL;
+	if(s->irq == USART2_IRQn)
+		sim_usart2.SR &= ~(USART_SR_RXNE | USART_SR_ORE | USART_SR_FE | USART_SR_NE);	//SR then DR read
+}
+
+//start, data and stop bits at the rate of BRR from the APB1 clock
+static uint64_t usart_frame_ps(void){
+	uint32_t brr = sim_usart2.BRR & 0xFFFF;
+	uint32_t div = (sim_usart2.CR1 & USART_CR1_OVER8) ? (brr >> 4) * 8 + (brr & 7) : brr;
+	uint32_t bits = 1 + ((sim_usart2.CR1 & USART_CR1_M) ? 9 : 8) + ((sim_usart2.CR2 & USART_CR2_STOP_1) ? 2 : 1);
+
+	if(div == 0)
+		div = 1;
+	return (uint64_t)bits * div * PS_PER_S / get_apb1_clk_freq();
+}
+
+//the stop bit of the next queued byte, lost if the receiver is off
+static void usart_rx_event(void){
+	uint8_t byte = usart_queue[usart_pos++];
+	bool on = (sim_rcc.APB1ENR & RCC_APB1ENR_USART2EN) && (sim_usart2.CR1 & USART_CR1_UE) &&
+			(sim_usart2.CR1 & USART_CR1_RE);
+
+	usart_next_ps = (usart_pos < usart_len) ? now_ps + usart_frame_ps() : PERIPH_SIM_NONE;
+	if(!on)
+		return;
+	stats.usart_received++;
+	if(sim_usart2.SR & USART_SR_RXNE){
+		sim_usart2.SR |= USART_SR_ORE;		//DR keeps the byte not read yet
+		stats.usart_overruns++;
+	}else{
+		sim_usart2.DR = byte;
+		sim_usart2.SR |= USART_SR_RXNE;
+	}
+	if(sim_usart2.CR1 & USART_CR1_RXNEIE)
+		raise_irq(USART2_IRQn, irq_latency_ps);
+}
+
+static void sync_timer(sim_timer_t *t){
+	bool run = (t->regs->CR1 & TIM_CR1_CEN) && (*t->enr & t->en_bit);
+
+	if(run && !t->running){
+		t->running = true;
+		t->start_ps = now_ps;
+		t->next_update_ps = now_ps + timer_period_ps(t);
+	}else if(!run){
+		t->running = false;
+	}
+}
+
+//takes in what the drivers wrote since the last step
+static void sync(void){
+	sim_sampler_t mode;
+
+	sim_dma2.LISR &= ~sim_dma2.LIFCR;
+	sim_dma2.HISR &= ~sim_dma2.HIFCR;
+	sim_dma2.LIFCR = 0;
+	sim_dma2.HIFCR = 0;
+
+	for(uint8_t i = 0; i < SIM_STREAMS; i++){
+		sim_stream_t *s = &streams[i];
+		bool en = (s->regs->CR & DMA_SxCR_EN) && (sim_rcc.AHB1ENR & RCC_AHB1ENR_DMA2EN);
+
+		if(en && !s->active){
+			s->active = true;
+			s->ndtr_start = s->regs->NDTR & 0xFFFF;
+		}else if(!en){
+			s->active = false;
+		}
+	}
+
+	sync_timer(&tim1);
+	sync_timer(&tim8);
+	sync_timer(&tim5);
+	mode = sampler_mode();
+	if(mode != SAMPLER_NONE && sampler == SAMPLER_NONE)
+		start_capture();
+	sampler = mode;
+
+	if(!button_armed()){
+		pressed = false;
+		press_ps = PERIPH_SIM_NONE;
+	}else if(!pressed && press_ps == PERIPH_SIM_NONE){
+		press_ps = now_ps + button_delay_ps;
+	}
+}
+
+static void run_until(uint64_t to_ps){
+	static bool checked = false;
+
+	if(stepping)
+		return;		//a handler waiting on the time, which only goes on between them
+	if(!checked){
+		if((uintptr_t)host_sdram > UINT32_MAX || (uintptr_t)array_1 > UINT32_MAX){
+			fprintf(stderr, "periph_sim: memory above 4GB, the DMA cannot reach it, link without PIE\n");
+			exit(2);
+		}
+		checked = true;
+	}
+	stepping = true;
+	sync();
+	while(1){
+		sim_irq_t *irq;
+		sim_sampler_t mode = sampler;
+		bool taken = (mode != SAMPLER_NONE) && consumed(mode);
+		uint64_t t_irq = next_irq_ps(&irq);
+		uint64_t t_tim5 = next_tim5_ps();
+		uint64_t t_sample = taken ? next_sample_ps(mode) : PERIPH_SIM_NONE;
+		uint64_t t_usart = usart_next_ps;
+		uint64_t t = t_irq;
+
+		if(press_ps < t)
+			t = press_ps;
+		if(t_tim5 < t)
+			t = t_tim5;
+		if(t_sample < t)
+			t = t_sample;
+		if(t_usart < t)
+			t = t_usart;
+		if(t > to_ps)
+			break;
+		if(!taken)
+			skip_samples(mode, t);
+		now_ps = t;
+		if(t == t_irq)
+			dispatch(irq);		//at the same time the handler goes first, it may re-enable a stream
+		else if(t == press_ps)
+			press_button();
+		else if(t == t_tim5)
+			tim5_update();
+		else if(t == t_usart)
+			usart_rx_event();
+		else
+			sample_event(mode);
+		sync();
+	}
+	if(sampler != SAMPLER_NONE && !consumed(sampler))
+		skip_samples(sampler, to_ps);
+	now_ps = to_ps;
+	stepping = false;
+}
+
+void periph_sim_reset(void){
+	memset(&sim_dma2, 0, sizeof(sim_dma2));
+	memset(sim_dma2_stream, 0, sizeof(sim_dma2_stream));
+	memset(&sim_tim1, 0, sizeof(sim_tim1));
+	memset(&sim_tim5, 0, sizeof(sim_tim5));
+	memset(&sim_tim8, 0, sizeof(sim_tim8));
+	memset(&sim_gpioa, 0, sizeof(sim_gpioa));
+	memset(&sim_gpioc, 0, sizeof(sim_gpioc));
+	memset(&sim_exti, 0, sizeof(sim_exti));
+	memset(&sim_syscfg, 0, sizeof(sim_syscfg));
+	memset(&sim_rcc, 0, sizeof(sim_rcc));
+	memset(&sim_dbgmcu, 0, sizeof(sim_dbgmcu));
+	memset(&sim_dwt, 0, sizeof(sim_dwt));
+	memset(&sim_usart2, 0, sizeof(sim_usart2));
+	sim_usart2.SR = USART_SR_TXE | USART_SR_TC;
+	memset(&sim_gpiod, 0, sizeof(sim_gpiod));
+	memset(&sim_dma1, 0, sizeof(sim_dma1));
+	memset(sim_dma1_stream, 0, sizeof(sim_dma1_stream));
+	sim_primask = 0;
+	usart_len = usart_pos = 0;
+	usart_next_ps = PERIPH_SIM_NONE;
+	memset(nvic_enabled, 0, sizeof(nvic_enabled));
+	for(uint8_t i = 0; i < SIM_STREAMS; i++)
+		streams[i].active = false;
+	for(uint8_t i = 0; i < SIM_IRQS; i++)
+		irqs[i].pending = false;
+	tim1.running = tim5.running = tim8.running = false;
+	sampler = SAMPLER_NONE;
+	press_ps = PERIPH_SIM_NONE;
+	pressed = false;
+	state_clock = PERIPH_SIM_STATE_CLOCK_DEFAULT;
+	irq_latency_ps = 0;
+	button_delay_ps = PERIPH_SIM_BUTTON_DELAY_DEFAULT * PS_PER_US;
+	memset(&stats, 0, sizeof(stats));
+	stats.first_sample = PERIPH_SIM_NONE;
+	stats.handover_sample = PERIPH_SIM_NONE;
+}
+
+void periph_sim_set_state_clock(uint32_t hz){
+	if(hz != 0)
+		state_clock = hz;
+}
+
+void periph_sim_set_irq_latency(uint32_t ns){
+	irq_latency_ps = (uint64_t)ns * 1000;
+}
+
+void periph_sim_set_button_delay(uint32_t us){
+	button_delay_ps = (uint64_t)us * PS_PER_US;
+}
+
+void periph_sim_usart_rx(const void *data, uint32_t len){
+	if(usart_pos == usart_len)
+		usart_len = usart_pos = 0;
+	if(usart_len + len > usart_size){
+		usart_size = (usart_len + len) * 2;
+		usart_queue = realloc(usart_queue, usart_size);
+	}
+	memcpy(usart_queue + usart_len, data, len);
+	usart_len += len;
+	if(usart_next_ps == PERIPH_SIM_NONE && len != 0)
+		usart_next_ps = now_ps + usart_frame_ps();
+}
+
+uint32_t periph_sim_ipsr(void){
+	return (active_irq != NULL) ? active_irq->irq + 16 : 0;
+}
+
+void periph_sim_advance_us(uint64_t us){
+	run_until(now_ps + us * PS_PER_US);
+}
+
+void periph_sim_wait(void){
+	periph_sim_advance_us(PERIPH_SIM_WAIT_US);
+}
+
+uint64_t periph_sim_time_ns(void){
+	return now_ps / 1000;
+}
+
+const periph_sim_stats_t *periph_sim_get_stats(void){
+	return &stats;
+}
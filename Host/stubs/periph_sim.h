@@ -0,0 +1,234 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    periph_sim.h
+ * @brief   This file contains the simulation of the peripherals the acquisition drivers use, for
+ * 			the host build. hw_access.h includes it there, so the peripherals below are register
+ * 			blocks in memory instead of the ones of the board:
+ *
+ * 			TIM1, TIM8		update event (timing mode) and input capture on channel 2 (state mode,
+ * 							on an external clock), each raising a DMA request
+ * 			TIM5			update event as TRGO, starting TIM1 and TIM8 in trigger mode
+ * 			DMA2 streams	2, 3 and 5 move a byte of GPIOC IDR per request: NDTR, M0AR/M1AR,
+ * 							circular double buffer (DBM, CT), TC/HT/TE flags and their interrupts
+ * 			EXTI0			the user button, pressed a moment after its interrupt is enabled
+ * 			USART2			the receiver of the console: queued bytes arrive back to back at the
+ * 							rate of BRR, setting RXNE, or ORE if the last byte was not read. The
+ * 							handler is taken to read SR then DR, as USART2_IRQHandler does, so
+ * 							both flags are cleared once it returns. DMA1 stream 6 and GPIOD, the
+ * 							transmitter's, are only registers
+ * 			DWT				the cycle counter, at the core clock of the simulated time
+ * 			GPIOA, GPIOC, RCC, SYSCFG, DBGMCU, and the NVIC through cmsis_nvic_virtual.h
+ * 			PRIMASK			a flag only. Handlers run when time goes on, so a masked section
+ * 							cannot be interrupted; __WFI() moves the time on like HW_WAIT()
+ *
+ * 			The counters of the timers, CNT and the CCR2 of the last clock edge, and the cycle counter
+ * 			are brought up to the simulated time before each handler is called, for it to read.
+ *
+ * 			The simulation runs when time goes on: in now(), b_delay() and HW_WAIT(). It steps from
+ * 			event to event (sampling events, TIM5 update, button press, interrupts) and calls the
+ * 			interrupt handlers of the drivers. Time spent by the processor is not simulated, only
+ * 			the delay from a flag to its handler, see periph_sim_set_irq_latency.
+ *
+ * 			Sample k of a capture is what the sample source of host_set_sample_source gives at k,
+ * 			the k-th sampling event since a sampling timer started. So a capture that lost none of
+ * 			them holds consecutive samples of the source, and periph_sim_get_stats tells which.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __PERIPH_SIM_H__
+#define __PERIPH_SIM_H__
+#include "stm32f429xx.h"
+#include "stdint.h"
+#include "stdbool.h"
+
+#define PERIPH_SIM_NONE UINT64_MAX
+#define PERIPH_SIM_WAIT_US 100				//simulated time of one HW_WAIT()
+#define PERIPH_SIM_STATE_CLOCK_DEFAULT 1000000
+#define PERIPH_SIM_BUTTON_DELAY_DEFAULT 1000	//us from arming the button to pressing it
+
+typedef struct{
+	uint32_t captures;			//sampling timer starts since periph_sim_reset, the rest is per capture
+	uint64_t samples;			//sampling events
+	uint64_t stored;			//samples written by a stream, counted once
+	uint64_t dropped;			//samples between the first and last stored that no stream took
+	uint64_t first_sample;		//index of the first sample stored, PERIPH_SIM_NONE if none
+	uint64_t last_sample;		//index of the last sample stored
+	uint64_t handover_sample;	//first sample stream 2 stored after stream 3 had, the start of the
+								//post trigger fill of state trigger mode, PERIPH_SIM_NONE if none
+	uint32_t irqs;				//handlers called
+	uint32_t irqs_lost;			//interrupts raised again while still pending
+	uint32_t irq_latency_max_ns;
+	uint32_t transfer_errors;	//requests to a stream whose addresses are not simulated memory
+	uint32_t usart_received;	//bytes the usart receiver took off the line, since the reset
+	uint32_t usart_overruns;	//of those, bytes lost to ORE
+}periph_sim_stats_t;
+
+extern DMA_TypeDef sim_dma2;
+extern DMA_Stream_TypeDef sim_dma2_stream[8];
+extern TIM_TypeDef sim_tim1, sim_tim5, sim_tim8;
+extern GPIO_TypeDef sim_gpioa, sim_gpioc;
+extern EXTI_TypeDef sim_exti;
+extern SYSCFG_TypeDef sim_syscfg;
+extern RCC_TypeDef sim_rcc;
+extern DBGMCU_TypeDef sim_dbgmcu;
+extern DWT_Type sim_dwt;
+extern USART_TypeDef sim_usart2;
+extern GPIO_TypeDef sim_gpiod;
+extern DMA_TypeDef sim_dma1;
+extern DMA_Stream_TypeDef sim_dma1_stream[8];
+extern uint32_t sim_primask;
+
+#undef DMA2
+#undef DMA2_Stream2
+#undef DMA2_Stream3
+#undef DMA2_Stream5
+#undef TIM1
+#undef TIM5
+#undef TIM8
+#undef GPIOA
+#undef GPIOC
+#undef EXTI
+#undef SYSCFG
+#undef RCC
+#undef DBGMCU
+#undef DWT
+#undef USART2
+#undef GPIOD
+#undef DMA1
+#undef DMA1_Stream6
+#define DMA2			(&sim_dma2)
+#define DMA2_Stream2	(&sim_dma2_stream[2])
+#define DMA2_Stream3	(&sim_dma2_stream[3])
+#define DMA2_Stream5	(&sim_dma2_stream[5])
+#define TIM1			(&sim_tim1)
+#define TIM5			(&sim_tim5)
+#define TIM8			(&sim_tim8)
+#define GPIOA			(&sim_gpioa)
+#define GPIOC			(&sim_gpioc)
+#define EXTI			(&sim_exti)
+#define SYSCFG			(&sim_syscfg)
+#define RCC				(&sim_rcc)
+#define DBGMCU			(&sim_dbgmcu)
+#define DWT				(&sim_dwt)
+#define USART2			(&sim_usart2)
+#define GPIOD			(&sim_gpiod)
+#define DMA1			(&sim_dma1)
+#define DMA1_Stream6	(&sim_dma1_stream[6])
+
+#define __get_PRIMASK()		(sim_primask)
+#define __set_PRIMASK(x)	(sim_primask = (x))
+#define __disable_irq()		(sim_primask = 1)
+#define __enable_irq()		(sim_primask = 0)
+#define __get_IPSR()		periph_sim_ipsr()
+#undef __WFI
+#define __WFI()				periph_sim_wait()
+
+#define HW_WAIT() periph_sim_wait()
+
+/*
+ * Description: puts every simulated register back to zero, drops pending interrupts and sets the
+ * 				options below back to their defaults
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void periph_sim_reset(void);
+
+/*
+ * Description: sets the frequency of the external clock of state mode
+ * Parameters:
+ * 		uint32_t hz clock edges per second the input capture sees, not 0
+ * Returns:
+ *   		None
+ */
+void periph_sim_set_state_clock(uint32_t hz);
+
+/*
+ * Description: sets the delay from a DMA or EXTI flag to the call of its handler. A stream that
+ * 				stops at the end of its transfer loses the requests of that time
+ * Parameters:
+ * 		uint32_t ns delay in nanoseconds, 0 by default
+ * Returns:
+ *   		None
+ */
+void periph_sim_set_irq_latency(uint32_t ns);
+
+/*
+ * Description: sets when the button is pressed after its interrupt is enabled
+ * Parameters:
+ * 		uint32_t us delay in microseconds
+ * Returns:
+ *   		None
+ */
+void periph_sim_set_button_delay(uint32_t us);
+
+/*
+ * Description: queues bytes on the receive line of USART2. They arrive back to back after those
+ * 				still queued, the first a frame time after the call if the line is idle
+ * Parameters:
+ * 		const void *data bytes to send
+ * 		uint32_t len number of bytes
+ * Returns:
+ *   		None
+ */
+void periph_sim_usart_rx(const void *data, uint32_t len);
+
+/*
+ * Description: gives the exception number __get_IPSR() reads
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint32_t 16 plus the IRQ of the handler running, 0 in thread mode
+ */
+uint32_t periph_sim_ipsr(void);
+
+/*
+ * Description: moves the simulated time on, running the peripherals and interrupt handlers
+ * Parameters:
+ * 		uint64_t us microseconds
+ * Returns:
+ *   		None
+ */
+void periph_sim_advance_us(uint64_t us);
+
+/*
+ * Description: HW_WAIT() of the host build, moves the time on by PERIPH_SIM_WAIT_US
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		None
+ */
+void periph_sim_wait(void);
+
+/*
+ * Description: gives the simulated time
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		uint64_t nanoseconds since the start
+ */
+uint64_t periph_sim_time_ns(void);
+
+/*
+ * Description: gives the counters of the last capture
+ * Parameters:
+ * 		None
+ * Returns:
+ *   		const periph_sim_stats_t * counters, reset when a sampling timer starts
+ */
+const periph_sim_stats_t *periph_sim_get_stats(void);
+
+#endif
@@ -0,0 +1,190 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    ramdisk.c
+ * @brief   This file contains the host stand in for fatfs_sd.c, a RAM disk behind the same
+ * 			functions, so user_diskio.c, the sector cache, FatFs and user_fatfs.c run unchanged on
+ * 			top of it. The background stream moves one block per poll, like the SPI DMA does one
+ * 			block per transfer.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "host_stubs.h"
+#include "fatfs_sd.h"
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "user_diskio.h"
+#include "fatfs.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define RAMDISK_SECTOR_SIZE 512
+
+static uint8_t *disk = NULL;
+static uint32_t disk_sectors = 0;
+static DSTATUS status = STA_NOINIT;
+static int64_t writes_left = -1, reads_left = -1;
+static host_ramdisk_stats_t stats;
+
+static DWORD stream_sector;
+static BYTE *stream_buff;
+static UINT stream_count;
+static bool stream_error;
+
+void host_ramdisk_init(uint32_t sectors){
+	free(disk);
+	disk = calloc(sectors, RAMDISK_SECTOR_SIZE);
+	disk_sectors = sectors;
+	status = STA_NOINIT;
+	writes_left = reads_left = -1;
+	memset(&stats, 0, sizeof(stats));
+}
+
+void host_ramdisk_fail_after(int64_t write_after, int64_t read_after){
+	writes_left = write_after;
+	reads_left = read_after;
+}
+
+const host_ramdisk_stats_t *host_ramdisk_get_stats(void){
+	return &stats;
+}
+
+uint8_t *host_ramdisk_data(void){
+	return disk;
+}
+
+bool host_ramdisk_format(void){
+	static bool linked = false;
+	BYTE work[_MAX_SS];
+
+	if(!linked){
+		MX_FATFS_Init();
+		linked = true;
+	}
+	return f_mkfs(USERPath, FM_ANY, 0, work, sizeof(work)) == FR_OK;
+}
+
+//takes count sectors off a fault injection budget, false once it runs out
+static bool take(int64_t *left, UINT count){
+	if(*left < 0)
+		return true;
+	if(*left < count){
+		*left = 0;
+		stats.failed++;
+		return false;
+	}
+	*left -= count;
+	return true;
+}
+
+DSTATUS SD_disk_initialize(BYTE drv){
+	if(drv != 0 || disk == NULL)
+		return STA_NOINIT;
+	status &= ~STA_NOINIT;
+	return status;
+}
+
+DSTATUS SD_disk_status(BYTE drv){
+	if(drv != 0)
+		return STA_NOINIT;
+	return status;
+}
+
+DRESULT SD_disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count){
+	if(pdrv != 0 || count == 0)
+		return RES_PARERR;
+	if(status & STA_NOINIT)
+		return RES_NOTRDY;
+	if(sector + count > disk_sectors)
+		return RES_PARERR;
+	stats.reads++;
+	if(!take(&reads_left, count))
+		return RES_ERROR;
+	memcpy(buff, disk + (uint64_t)sector * RAMDISK_SECTOR_SIZE, count * RAMDISK_SECTOR_SIZE);
+	stats.sectors_read += count;
+	return RES_OK;
+}
+
+DRESULT SD_disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count){
+	if(pdrv != 0 || count == 0)
+		return RES_PARERR;
+	if(status & STA_NOINIT)
+		return RES_NOTRDY;
+	if(sector + count > disk_sectors)
+		return RES_PARERR;
+	stats.writes++;
+	if(!take(&writes_left, count))
+		return RES_ERROR;
+	memcpy(disk + (uint64_t)sector * RAMDISK_SECTOR_SIZE, buff, count * RAMDISK_SECTOR_SIZE);
+	stats.sectors_written += count;
+	return RES_OK;
+}
+
+DRESULT SD_disk_ioctl(BYTE drv, BYTE ctrl, void *buff){
+	if(drv != 0)
+		return RES_PARERR;
+	if(status & STA_NOINIT)
+		return RES_NOTRDY;
+
+	switch(ctrl){
+	case CTRL_SYNC:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD*)buff = disk_sectors;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD*)buff = RAMDISK_SECTOR_SIZE;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD*)buff = 1;
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+DRESULT SD_stream_open(DWORD sector){
+	if(status & STA_NOINIT)
+		return RES_NOTRDY;
+	stream_sector = sector;
+	stream_count = 0;
+	stream_error = false;
+	return RES_OK;
+}
+
+void SD_stream_read(BYTE* buff, UINT count){
+	if(stream_error || count == 0)
+		return;
+	stream_buff = buff;
+	stream_count = count;
+}
+
+int SD_stream_poll(void){
+	if(stream_error)
+		return -1;
+	if(stream_count == 0)
+		return 0;
+	if(SD_disk_read(0, stream_buff, stream_sector, 1) != RES_OK){
+		stream_error = true;
+		return -1;
+	}
+	stream_sector++;
+	stream_buff += RAMDISK_SECTOR_SIZE;
+	return --stream_count;
+}
+
+DRESULT SD_stream_close(void){
+	stream_count = 0;
+	return stream_error ? RES_ERROR : RES_OK;
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test.h
+ * @brief   This file contains the checks of the host tests. A failed check is reported on stderr,
+ * 			since stdout is the console and may be captured, and the test goes on so one run shows
+ * 			every failure. TEST_END gives the exit status for ctest.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#ifndef __TEST_H__
+#define __TEST_H__
+#include "stdio.h"
+#include "string.h"
+
+static int test_failures = 0;
+
+#define CHECK(cond) do{ \
+	if(!(cond)){ \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		test_failures++; \
+	} \
+}while(0)
+
+#define CHECK_EQ(a, b) do{ \
+	long long check_a = (long long)(a), check_b = (long long)(b); \
+	if(check_a != check_b){ \
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, \
+				check_a, check_b); \
+		test_failures++; \
+	} \
+}while(0)
+
+#define CHECK_STR(haystack, needle) do{ \
+	if(strstr((haystack), (needle)) == NULL){ \
+		fprintf(stderr, "%s:%d: \"%s\" not found in:\n%s\n", __FILE__, __LINE__, (needle), (haystack)); \
+		test_failures++; \
+	} \
+}while(0)
+
+#define RUN_TEST(fn) do{ \
+	int before = test_failures; \
+	fn(); \
+	fprintf(stderr, "%-40s %s\n", #fn, (test_failures == before) ? "ok" : "FAILED"); \
+}while(0)
+
+#define TEST_END() (test_failures ? 1 : 0)
+
+#endif
@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_acquisition.c
+ * @brief   This file contains the host tests of the acquisition drivers, run end to end on the
+ * 			simulated timers, DMA streams and button: timing mode, state mode on the button and on
+ * 			a trigger pattern. Each checks that the capture holds consecutive samples of the port,
+ * 			that the health counters of capture_health.c agree with what the simulation did, and
+ * 			reports the samples lost and the trigger latency.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "periph_sim.h"
+#include "fmc.h"
+#include "timing_mode_init.h"
+#include "timer_update_event.h"
+#include "state_mode.h"
+#include "capture_health.h"
+#include "stdlib.h"
+
+#define BLOCK 32768
+#define COUNT 4						//blocks of a capture, minus one
+#define TRIGGER_PIN 3
+#define TRIGGER_PATTERN 0xA5
+#define TRIGGER_AT 50000			//sample completing the pattern, in the second pre trigger half
+
+//a value no nearby sample has the same way, so a lost or repeated sample shows
+static uint8_t mixed(uint32_t i){
+	i ^= i >> 7;
+	i *= 0x9E3779B1u;
+	return (uint8_t)(i >> 24);
+}
+
+static void mixed_source(uint8_t *dest, uint32_t len, void *arg){
+	(void)arg;
+	for(uint32_t i = 0; i < len; i++)
+		dest[i] = mixed(i);
+}
+
+//mixed samples with the trigger pin low but for the pattern, sent first bit first, ending at
+//TRIGGER_AT
+static uint8_t triggered(uint32_t i){
+	uint8_t bit = 0;
+
+	if(i + 8 > TRIGGER_AT && i <= TRIGGER_AT)
+		bit = (TRIGGER_PATTERN >> (TRIGGER_AT - i)) & 1;
+	return (mixed(i) & ~(1 << TRIGGER_PIN)) | (bit << TRIGGER_PIN);
+}
+
+static uint8_t untriggered(uint32_t i){
+	return mixed(i) & ~(1 << TRIGGER_PIN);
+}
+
+static void trigger_source(uint8_t *dest, uint32_t len, void *arg){
+	uint8_t (*sample)(uint32_t) = arg;
+
+	for(uint32_t i = 0; i < len; i++)
+		dest[i] = sample(i);
+}
+
+//true if the capture holds the source from sample first on, skipping gap samples every block
+static bool consecutive(const uint8_t *capture, uint32_t len, uint8_t (*sample)(uint32_t), uint64_t first,
+		uint32_t gap){
+	for(uint32_t i = 0; i < len; i++){
+		uint64_t k = first + i + (uint64_t)(i / BLOCK) * gap;
+
+		if(capture[i] != sample((uint32_t)k)){
+			fprintf(stderr, "sample %u is not sample %llu of the source\n", i, (unsigned long long)k);
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint8_t *start(host_sample_source_t source, void *arg){
+	uint8_t *capture;
+
+	periph_sim_reset();
+	host_set_sample_source(source, arg);
+	capture = reserve_capture_region((COUNT + 1) * BLOCK);
+	CHECK(capture != NULL);
+	return capture;
+}
+
+static void test_timing_button(void){
+	uint8_t *capture = start(mixed_source, NULL);
+	const periph_sim_stats_t *stats = periph_sim_get_stats();
+	const capture_health_t *health = capture_health_get();
+
+	CHECK(timing_mode_init(BUTTON_MODE, FREQ_1000KHz, false, COUNT));
+	CHECK_EQ(stats->stored, (COUNT + 1) * BLOCK);
+	CHECK_EQ(stats->dropped, 0);
+	//the timer runs from the start, the stream from the press of the button 1ms later
+	CHECK(stats->first_sample >= 999 && stats->first_sample <= 1000);
+	CHECK(consecutive(capture, (COUNT + 1) * BLOCK, mixed, stats->first_sample, 0));
+	CHECK_EQ(health->blocks, COUNT + 1);
+	CHECK_EQ(health->lost_samples, 0);
+	CHECK_EQ(health->transfer_errors, 0);
+	CHECK(health->block_period_us >= BLOCK - 1 && health->block_period_us <= BLOCK + 1);
+	CHECK_EQ(get_sample_rate(), 1000000);
+	CHECK_EQ(get_trigger_position(), NO_TRIGGER_POSITION);
+	CHECK_EQ((sim_dma2_stream[5].CR & DMA_SxCR_EN), 0);
+	CHECK_EQ((sim_tim1.DIER & TIM_DIER_UDE), 0);
+}
+
+//the stream stops at the end of each block until its handler starts it again, the samples of
+//that time are lost
+static void test_timing_irq_latency(void){
+	uint8_t *capture = start(mixed_source, NULL);
+	const periph_sim_stats_t *stats = periph_sim_get_stats();
+
+	periph_sim_set_irq_latency(2500);		//two and a half samples at 1MHz
+	CHECK(timing_mode_init(BUTTON_MODE, FREQ_1000KHz, false, COUNT));
+	CHECK_EQ(stats->stored, (COUNT + 1) * BLOCK);
+	CHECK_EQ(stats->dropped, 2 * COUNT);
+	CHECK_EQ(stats->irq_latency_max_ns, 2500);
+	CHECK(consecutive(capture, (COUNT + 1) * BLOCK, mixed, stats->first_sample, 2));
+	//the firmware sees the same from the timer and the cycle counter alone
+	CHECK_EQ(capture_health_get()->lost_samples, stats->dropped);
+	CHECK_EQ(capture_health_get()->latency_max_ns, 2500);
+	fprintf(stderr, "  timing 1MHz, 2.5us interrupt latency: %llu of %llu samples lost\n",
+			(unsigned long long)stats->dropped, (unsigned long long)(stats->dropped + stats->stored));
+}
+
+//timing_mode_start, as SUMP uses it, starts without the button at any rate
+static void test_timing_start(void){
+	uint8_t *capture = start(mixed_source, NULL);
+	const periph_sim_stats_t *stats = periph_sim_get_stats();
+
+	CHECK_EQ(timing_mode_start(2000000, 0), 2000000);
+	while(!get_done())
+		HW_WAIT();
+	reset_done();
+	CHECK_EQ(stats->first_sample, 0);
+	CHECK_EQ(stats->stored, BLOCK);
+	CHECK(consecutive(capture, BLOCK, mixed, 0, 0));
+}
+
+//a capture running past the end of SDRAM ends on the transfer error of the stream and fails
+static void test_timing_transfer_error(void){
+	uint8_t *capture;
+
+	periph_sim_reset();
+	host_set_sample_source(mixed_source, NULL);
+	capture = reserve_capture_region(SDRAM_SIZE);
+	CHECK(capture != NULL);
+	CHECK(!timing_mode_init(BUTTON_MODE, FREQ_1000KHz, false, SDRAM_SIZE / BLOCK));
+	CHECK_EQ(capture_health_get()->transfer_errors, 1);
+	CHECK_EQ(capture_health_get()->blocks, SDRAM_SIZE / BLOCK);
+	CHECK_EQ((sim_dma2_stream[5].CR & DMA_SxCR_EN), 0);
+	CHECK_EQ((sim_tim1.DIER & TIM_DIER_UDE), 0);
+}
+
+static void test_state_button(void){
+	uint8_t *capture = start(mixed_source, NULL);
+	const periph_sim_stats_t *stats = periph_sim_get_stats();
+
+	periph_sim_set_state_clock(2000000);
+	CHECK(state_timing_init(RISING_EDGE, BUTTON_MODE, 0, COUNT, 0, 0));
+	CHECK_EQ(stats->stored, (COUNT + 1) * BLOCK);
+	CHECK_EQ(stats->dropped, 0);
+	CHECK(consecutive(capture, (COUNT + 1) * BLOCK, mixed, stats->first_sample, 0));
+	CHECK_EQ(get_sample_rate(), 0);
+	CHECK_EQ(get_trigger_position(), NO_TRIGGER_POSITION);
+	CHECK_EQ(capture_health_get()->blocks, COUNT + 1);
+	CHECK_EQ(capture_health_get()->lost_samples, CAPTURE_HEALTH_UNKNOWN);
+}
+
+//the capture is the two pre trigger halves then the fill of stream 2, which starts at the end of
+//the half after the one the trigger was found in. Twice, the second must not see the first trigger
+static void test_state_trigger(void){
+	for(uint8_t run = 0; run < 2; run++){
+		uint8_t *capture = start(trigger_source, triggered);
+		const periph_sim_stats_t *stats = periph_sim_get_stats();
+		uint64_t capture_start, latency;
+
+		CHECK(state_timing_init(RISING_EDGE, TRIG_MODE, TRIGGER_PATTERN, COUNT, TRIGGER_PIN, 1000));
+		CHECK_EQ(stats->dropped, 0);
+		CHECK_EQ(stats->handover_sample, 3 * BLOCK);
+		capture_start = stats->handover_sample - 2 * BLOCK;
+		CHECK(consecutive(capture, (COUNT + 1) * BLOCK, triggered, capture_start, 0));
+		CHECK_EQ(get_trigger_position(), TRIGGER_AT - capture_start);
+		CHECK_EQ((capture[get_trigger_position()] >> TRIGGER_PIN) & 1, TRIGGER_PATTERN & 1);
+		latency = stats->handover_sample - TRIGGER_AT;
+		CHECK(latency > 0 && latency <= 2 * BLOCK);
+		if(run == 0)
+			fprintf(stderr, "  state trigger at 1MHz: latency %llu samples, %llu lost\n",
+					(unsigned long long)latency, (unsigned long long)stats->dropped);
+	}
+}
+
+static void test_state_trigger_timeout(void){
+	uint32_t before;
+
+	start(trigger_source, untriggered);
+	before = host_time();
+	CHECK(!state_timing_init(RISING_EDGE, TRIG_MODE, TRIGGER_PATTERN, COUNT, TRIGGER_PIN, 50));
+	CHECK(host_time() - before >= 50);
+	CHECK_EQ((sim_dma2_stream[2].CR & DMA_SxCR_EN), 0);
+	CHECK_EQ((sim_dma2_stream[3].CR & DMA_SxCR_EN), 0);
+	CHECK_EQ(periph_sim_get_stats()->handover_sample, PERIPH_SIM_NONE);
+}
+
+int main(void){
+	RUN_TEST(test_timing_button);
+	RUN_TEST(test_timing_irq_latency);
+	RUN_TEST(test_timing_start);
+	RUN_TEST(test_timing_transfer_error);
+	RUN_TEST(test_state_button);
+	RUN_TEST(test_state_trigger);
+	RUN_TEST(test_state_trigger_timeout);
+	return TEST_END();
+}
@@ -0,0 +1,154 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_alloc.c
+ * @brief   This file contains the host tests of the SDRAM region allocator, on its own and as fmc.c
+ * 			uses it for captures and background saves.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "sdram_alloc.h"
+#include "fmc.h"
+
+#define ARENA_SIZE 0x10000
+#define HALF_SDRAM (SDRAM_SIZE / 2)		//a capture as large can be taken beside one being saved
+
+static uint8_t area[ARENA_SIZE];
+
+static void test_first_fit(void){
+	sdram_arena_t arena;
+	uint8_t *a, *b, *c;
+
+	sdram_arena_init(&arena, area, ARENA_SIZE);
+	a = sdram_alloc(&arena, "a", 0x1000, 1);
+	b = sdram_alloc(&arena, "b", 0x1000, 1);
+	c = sdram_alloc(&arena, "c", 0x1000, 1);
+	CHECK(a == area);
+	CHECK(b == area + 0x1000);
+	CHECK(c == area + 0x2000);
+	CHECK_EQ(arena.count, 3);
+
+	//the gap left by b is reused by an allocation that fits in it
+	CHECK(sdram_free(&arena, b));
+	CHECK(sdram_alloc(&arena, "d", 0x800, 1) == area + 0x1000);
+	CHECK(sdram_alloc(&arena, "e", 0x1000, 1) == area + 0x3000);
+	CHECK_EQ(sdram_free_bytes(&arena), ARENA_SIZE - 0x3800);
+	CHECK_EQ(sdram_largest_free(&arena), ARENA_SIZE - 0x4000);
+	CHECK_EQ(arena.peak, 0x4000);
+}
+
+static void test_alignment(void){
+	sdram_arena_t arena;
+	uint8_t *a, *b;
+
+	sdram_arena_init(&arena, area, ARENA_SIZE);
+	a = sdram_alloc(&arena, "a", 10, 1);
+	b = sdram_alloc(&arena, "b", 100, 1024);
+	CHECK(a == area);
+	CHECK(b == area + 1024);
+	CHECK_EQ(sdram_largest_free(&arena), ARENA_SIZE - 1124);
+	CHECK_EQ(sdram_largest_aligned(&arena, 1024, NULL), ARENA_SIZE - 2048);	//from the next 1KB
+	CHECK_EQ(sdram_largest_aligned(&arena, 3, NULL), 0);
+	CHECK_EQ(sdram_largest_aligned(&arena, 1024, b), ARENA_SIZE - 1024);		//b counted as free
+	CHECK_EQ(arena.count, 2);
+	CHECK(sdram_alloc(&arena, "c", 100, 3) == NULL);		//not a power of two
+	CHECK(sdram_alloc(&arena, "d", 0, 1) == NULL);
+	CHECK_EQ(arena.failures, 2);
+}
+
+static void test_full(void){
+	sdram_arena_t arena;
+
+	sdram_arena_init(&arena, area, ARENA_SIZE);
+	CHECK(sdram_alloc(&arena, "all", ARENA_SIZE, 1) == area);
+	CHECK(sdram_alloc(&arena, "more", 1, 1) == NULL);
+	CHECK_EQ(sdram_largest_free(&arena), 0);
+
+	sdram_arena_init(&arena, area, ARENA_SIZE);
+	for(int i = 0; i < SDRAM_MAX_REGIONS; i++)
+		CHECK(sdram_alloc(&arena, "small", 16, 1) != NULL);
+	CHECK(sdram_alloc(&arena, "one too many", 16, 1) == NULL);
+	CHECK_EQ(sdram_largest_free(&arena), 0);
+	CHECK_EQ(sdram_largest_aligned(&arena, 1, area + 16), ARENA_SIZE - SDRAM_MAX_REGIONS * 16);
+}
+
+static void test_alloc_at(void){
+	sdram_arena_t arena;
+
+	sdram_arena_init(&arena, area, ARENA_SIZE);
+	CHECK(sdram_alloc_at(&arena, "mid", area + 0x8000, 0x1000));
+	CHECK(!sdram_alloc_at(&arena, "overlap low", area + 0x7800, 0x1000));
+	CHECK(!sdram_alloc_at(&arena, "overlap high", area + 0x8800, 0x1000));
+	CHECK(!sdram_alloc_at(&arena, "past end", area + ARENA_SIZE - 0x10, 0x20));
+	CHECK(sdram_alloc_at(&arena, "below", area + 0x7000, 0x1000));
+	CHECK_EQ(arena.regions[0].offset, 0x7000);
+	CHECK_EQ(arena.regions[1].offset, 0x8000);
+
+	CHECK(sdram_find(&arena, area + 0x8FFF) == &arena.regions[1]);
+	CHECK(sdram_find(&arena, area + 0x9000) == NULL);
+	CHECK(sdram_check(&arena, area + 0x8800, 0x800));
+	CHECK(!sdram_check(&arena, area + 0x8800, 0x801));
+	CHECK(!sdram_free(&arena, area + 0x8001));
+}
+
+//captures move around saves in progress, as fmc.c places them
+static void test_capture_regions(void){
+	sdram_arena_t *arena = get_sdram_arena();
+	uint8_t *first, *second, *third;
+
+	CHECK_EQ(capture_room(), SDRAM_SIZE);
+	first = reserve_capture_region(HALF_SDRAM);
+	CHECK(first == SDRAM_BANK_ADDR);
+	CHECK(get_capture_address() == first);
+	CHECK_EQ(capture_room(), SDRAM_SIZE);			//the last capture is given back first
+	CHECK_EQ(arena->count, 1);
+	CHECK(!strcmp(sdram_find(arena, first)->name, SDRAM_CAPTURE_NAME));
+
+	//a new capture replaces the last one in place
+	second = reserve_capture_region(HALF_SDRAM);
+	CHECK(second == first);
+	CHECK_EQ(arena->count, 1);
+
+	//while the capture is saved, the next one goes elsewhere and the save keeps its samples
+	lock_sdram_region(second, HALF_SDRAM);
+	CHECK_EQ(capture_room(), HALF_SDRAM);			//the save keeps its half
+	CHECK(sdram_find(arena, second)->flags & SDRAM_REGION_LOCKED);
+	third = reserve_capture_region(HALF_SDRAM);
+	CHECK(third == SDRAM_BANK_ADDR + HALF_SDRAM);
+	CHECK_EQ(arena->count, 2);
+	CHECK(!strcmp(sdram_find(arena, second)->name, SDRAM_SAVING_NAME));
+	CHECK_EQ(capture_room(), HALF_SDRAM);					//the save keeps its half
+
+	//a larger capture has no room, the last one stays where it was
+	CHECK(reserve_capture_region(HALF_SDRAM + SDRAM_CAPTURE_ALIGN) == NULL);
+	CHECK(get_capture_address() == third);
+	CHECK(!strcmp(sdram_find(arena, third)->name, SDRAM_CAPTURE_NAME));
+
+	//the end of the save frees its region
+	unlock_sdram_region();
+	CHECK_EQ(arena->count, 1);
+	CHECK_EQ(sdram_room_after(third + 16), HALF_SDRAM - 16);
+	CHECK(reserve_capture_region(HALF_SDRAM) == SDRAM_BANK_ADDR);
+}
+
+int main(void){
+	RUN_TEST(test_first_fit);
+	RUN_TEST(test_alignment);
+	RUN_TEST(test_full);
+	RUN_TEST(test_alloc_at);
+	RUN_TEST(test_capture_regions);
+	return TEST_END();
+}
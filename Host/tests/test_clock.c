@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_clock.c
+ * @brief   This file contains the host tests of the clock configuration table and of what is
+ * 			derived from it: every entry must be one init_clocks can set, give exact sampling
+ * 			periods and a whole SysTick reload, and FMC timings that keep to the SDRAM datasheet.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "clock_config.h"
+#include "pll_clock.h"
+#include "timing_mode_init.h"
+#include "fmc.h"
+
+#define SD_INIT_CLOCK_HZ 400000
+
+static void test_table(void){
+	const clock_config_t *c160 = clock_config_by_id(CLOCK_CONFIG_160MHZ_HSI);
+	const clock_config_t *c180 = clock_config_by_id(CLOCK_CONFIG_180MHZ_HSE);
+
+	for(clock_config_id_t id = 0; id < CLOCK_CONFIGS; id++)
+		CHECK(clock_config_valid(clock_config_by_id(id)));
+	CHECK(clock_config_by_id(CLOCK_CONFIGS) == NULL);
+
+	//the former setting is still in the table as it was
+	CHECK_EQ(clock_config_sysclk(c160), 160000000);
+	CHECK_EQ(clock_config_apb1(c160), 40000000);
+	CHECK_EQ(clock_config_apb2(c160), 80000000);
+	CHECK(!clock_config_overdrive(c160));
+	CHECK_EQ(clock_config_flash_latency(c160), 5);
+
+	CHECK_EQ(clock_config_sysclk(c180), 180000000);
+	CHECK_EQ(clock_config_apb1(c180), 45000000);
+	CHECK_EQ(clock_config_apb2(c180), 90000000);
+	CHECK(clock_config_overdrive(c180));
+	CHECK_EQ(clock_config_flash_latency(c180), 5);
+	CHECK(clock_config_get() == c180);
+	CHECK_EQ(get_sysclk_freq(), 180000000);
+}
+
+static void test_limits(void){
+	clock_config_t c = *clock_config_by_id(CLOCK_CONFIG_180MHZ_HSE);
+
+	c.apb1_div = 2;		//APB1 at 90MHz
+	CHECK(!clock_config_valid(&c));
+	c = *clock_config_by_id(CLOCK_CONFIG_180MHZ_HSE);
+	c.plln = 192;		//192MHz
+	CHECK(!clock_config_valid(&c));
+	c = *clock_config_by_id(CLOCK_CONFIG_180MHZ_HSE);
+	c.pllm = 8;			//1MHz VCO input, VCO at 180MHz, 90MHz core
+	CHECK(clock_config_valid(&c));
+	c.pllq = 3;			//60MHz on the 48MHz output
+	CHECK(!clock_config_valid(&c));
+	c = *clock_config_by_id(CLOCK_CONFIG_168MHZ_HSE);
+	c.apb2_div = 1;		//the timers would not run at twice APB2
+	CHECK(!clock_config_valid(&c));
+}
+
+//every timing mode rate is a whole number of timer ticks, the SysTick reload is whole and fits,
+//the sd card can be identified below 400kHz
+static void test_derived(void){
+	for(clock_config_id_t id = 0; id < CLOCK_CONFIGS; id++){
+		const clock_config_t *c = clock_config_by_id(id);
+		uint32_t timer_clk = clock_config_apb2(c) * 2;
+		uint32_t hclk = clock_config_hclk(c);
+
+		for(timing_mode_freq_t f = FREQ_100KHz; f <= FREQ_1000KHz; f++){
+			CHECK_EQ(timer_clk % timing_freq_hz(f), 0);
+			CHECK(timer_clk / timing_freq_hz(f) - 1 <= 0xFFFF);
+		}
+		CHECK_EQ(hclk % (8 * 1000), 0);
+		CHECK(hclk / 8 / 1000 - 1 <= 0xFFFFFF);
+		CHECK(clock_config_apb2(c) / 256 <= SD_INIT_CLOCK_HZ);
+	}
+	CHECK_EQ(timing_freq_hz(FREQ_1000KHz + 1), 0);
+}
+
+//cycles of a field, at least the datasheet time
+static bool covers(uint8_t field, uint32_t ns, uint32_t sdclk){
+	return (uint64_t)(field + 1) * 1000000000 >= (uint64_t)ns * sdclk;
+}
+
+static void test_fmc_timings(void){
+	const fmc_profile_t *p = fmc_get_profile(FMC_PROFILE_DEFAULT);
+
+	//at 160MHz the values the SDRAM always ran with, with the refresh of the reference manual
+	CHECK_EQ(fmc_compute_timings(160000000), 1230);
+	CHECK_EQ(p->tmrd, 1);
+	CHECK_EQ(p->txsr, 5);
+	CHECK_EQ(p->tras, 3);
+	CHECK_EQ(p->trc, 5);
+	CHECK_EQ(p->twr, 1);
+	CHECK_EQ(p->trp, 1);
+	CHECK_EQ(p->trcd, 1);
+
+	//at 180MHz tRC takes one more cycle and tWR follows it
+	CHECK_EQ(fmc_compute_timings(180000000), 1386);
+	CHECK_EQ(p->txsr, 6);
+	CHECK_EQ(p->trc, 6);
+	CHECK_EQ(p->twr, 2);
+	CHECK_EQ(fmc_get_profile(3)->trp, 0);		//tight
+
+	for(clock_config_id_t id = 0; id < CLOCK_CONFIGS; id++){
+		uint32_t sdclk = clock_config_hclk(clock_config_by_id(id)) / 2;
+
+		CHECK(sdclk <= SDRAM_MAX_CLK);
+		fmc_compute_timings(sdclk * 2);
+		CHECK(covers(p->txsr, SDRAM_TXSR_NS, sdclk));
+		CHECK(covers(p->tras, SDRAM_TRAS_NS, sdclk));
+		CHECK(covers(p->trc, SDRAM_TRC_NS, sdclk));
+		CHECK(covers(p->trp, SDRAM_TRP_NS, sdclk));
+		CHECK(covers(p->trcd, SDRAM_TRCD_NS, sdclk));
+		CHECK(p->twr + 1 >= p->tras - p->trcd);
+		CHECK(p->twr + 1 >= p->trc - p->trcd - p->trp - 1);
+	}
+	fmc_compute_timings(get_ahb_clk_freq());
+}
+
+int main(void){
+	RUN_TEST(test_table);
+	RUN_TEST(test_limits);
+	RUN_TEST(test_derived);
+	RUN_TEST(test_fmc_timings);
+	return TEST_END();
+}
@@ -0,0 +1,218 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_cmd.c
+ * @brief   This file contains the host tests of the command processor, driven through the console
+ * 			as a user or a script would: typed and pasted lines, captures and decoding, and a SUMP
+ * 			host taking over the console for a moment.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "signals.h"
+#include "host_stubs.h"
+#include "cmd_processor.h"
+#include "sump.h"
+#include "stdlib.h"
+#include "ff.h"
+
+#define UART_SAMPLE_RATE 400000		//tmode -f 400
+
+//runs the command processor until every queued byte is used, returns the console output
+static char *run(const char *input){
+	host_console_type(input);
+	host_capture_begin();
+	while(host_console_pending())
+		run_command_processor();
+	run_command_processor();		//shows the next prompt
+	return host_capture_end(NULL);
+}
+
+//fills a capture with "OK\r\n" sent at 9600 baud on P0, repeated
+static void uart_source(uint8_t *dest, uint32_t len, void *arg){
+	uint32_t bit_q8 = (UART_SAMPLE_RATE << 8) / 9600;
+	const char *text = "OK\r\n";
+	signal_t sig;
+
+	(void)arg;
+	signal_init(&sig, dest, len, 0xFF);
+	while(sig.len < len){
+		signal_hold(&sig, 200);
+		for(const char *c = text; *c; c++)
+			signal_uart(&sig, 0, (uint8_t)*c, 8, UART_PARITY_NONE, 1, bit_q8);
+	}
+}
+
+static void test_tokens(void){
+	uint8_t line[] = "  tmode -f 200  -s m\r";
+	uint8_t argc = 0, *argv[CMD_PROCESSOR_ARGV_SIZE];
+	uint8_t many[CMD_PROCESSOR_ARGV_SIZE * 2 * 2 + 1];
+
+	get_tokens(line, &argc, argv);
+	CHECK_EQ(argc, 5);
+	CHECK(!strcmp((char*)argv[0], "tmode"));
+	CHECK(!strcmp((char*)argv[2], "200"));
+	CHECK(!strcmp((char*)argv[4], "m"));
+
+	uint8_t empty[] = "   \r";
+	argc = 0;
+	get_tokens(empty, &argc, argv);
+	CHECK_EQ(argc, 0);
+	CHECK(argv[0] == NULL);
+
+	//more tokens than argv holds, the extra ones are dropped and argv still ends with NULL
+	for(uint32_t i = 0; i < CMD_PROCESSOR_ARGV_SIZE * 2; i++){
+		many[2 * i] = 'a';
+		many[2 * i + 1] = ' ';
+	}
+	many[sizeof(many) - 2] = '\r';
+	argc = 0;
+	get_tokens(many, &argc, argv);
+	CHECK_EQ(argc, CMD_PROCESSOR_ARGV_SIZE - 1);
+	CHECK(argv[argc] == NULL);
+}
+
+static void test_unknown_and_help(void){
+	char *out = run("bogus\r");
+
+	CHECK_STR(out, "> bogus\r\n");
+	CHECK_STR(out, "Unknown Command");
+	free(out);
+
+	out = run("HeLp\r");
+	CHECK_STR(out, "Commands Available");
+	CHECK_STR(out, "MEMBENCH");
+	free(out);
+}
+
+//a pasted script arrives in one burst, every line of it runs in order
+static void test_paste(void){
+	char *out = run("tmode -f 400 -m button -i none -s s\rmem\rbogus\r");
+	char *capture, *mem, *unknown;
+
+	capture = strstr(out, "Logic Capture Completed successfully");
+	mem = strstr(out, "Region");
+	unknown = strstr(out, "Unknown Command");
+	CHECK(capture != NULL && mem != NULL && unknown != NULL);
+	CHECK(capture < mem && mem < unknown);
+	CHECK_STR(out, "capture ");
+	free(out);
+}
+
+static void test_capture_and_decode(void){
+	uint32_t before = host_capture_count();
+	char *out;
+
+	host_set_sample_source(uart_source, NULL);
+	out = run("tmode -f 400 -m button -i none -s s\ranalyse -m uart -s a -t 0 -b auto\r");
+	host_set_sample_source(NULL, NULL);
+
+	CHECK_EQ(host_capture_count(), before + 1);
+	CHECK_STR(out, "Detected baud rate: 9600");
+	CHECK_STR(out, "DATA 4f 'O'");
+	CHECK_STR(out, "DATA 4b 'K'");
+	CHECK(strstr(out, "FRAMING ERROR") == NULL);
+	free(out);
+}
+
+//perf shows the sections that ran since the last perf, the decoder and the handler of the capture
+static void test_perf(void){
+	char *out;
+
+	free(run("perf\r"));
+	host_set_sample_source(uart_source, NULL);
+	free(run("tmode -f 400 -m button -i none -s s\ranalyse -m uart -s a -t 0 -b auto\r"));
+	host_set_sample_source(NULL, NULL);
+
+	out = run("perf\r");
+	CHECK_STR(out, "dma2 s5 irq");
+	CHECK_STR(out, "uart decode");
+	CHECK(strstr(out, "i2c decode") == NULL);
+	CHECK_STR(out, "Interrupt entry latency");
+	free(out);
+
+	out = run("perf\r");
+	CHECK(strstr(out, "uart decode") == NULL);
+	free(out);
+}
+
+//generated traffic becomes the last capture, the analysers run on it like on a real one
+static void test_gen(void){
+	char *out = run("gen -m uart -k 64 -e 5 -z 3\ranalyse -m uart -s a -t 0 -b auto\r");
+
+	CHECK_STR(out, "64 KB at 1000000 Hz, bus at 115200, seed 3");
+	CHECK_STR(out, "Detected baud rate: 115200");
+	CHECK_STR(out, "FRAMING ERROR");
+	free(out);
+
+	out = run("gen -m usb\rgen -m can -b 400000\r");
+	CHECK_STR(out, "Unknown protocol");
+	CHECK_STR(out, "does not fit the sample rate");
+	free(out);
+}
+
+//a SUMP host identifies itself at the start of a line, the console comes back after it leaves
+static void test_sump_session(void){
+	const uint8_t sump[] = {SUMP_RESET, SUMP_RESET, SUMP_RESET, SUMP_RESET, SUMP_RESET, SUMP_ID, '\r'};
+	char *out;
+
+	host_console_push(sump, sizeof(sump));
+	out = run("mem\r");
+	CHECK_STR(out, "1ALS");
+	CHECK_STR(out, "> mem\r\n");
+	CHECK(strstr(out, "1ALS") < strstr(out, "mem"));
+	free(out);
+}
+
+//runs a script from the RAM disk, a failed step stops it
+static char *run_script(const char *text){
+	char cmd[] = "run -f steps.txt\r";
+	FATFS fs;
+	FIL fil;
+	UINT written;
+
+	CHECK(f_mount(&fs, "", 1) == FR_OK);
+	CHECK(f_open(&fil, "steps.txt", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+	CHECK(f_write(&fil, text, strlen(text), &written) == FR_OK);
+	CHECK(f_close(&fil) == FR_OK);
+	CHECK(f_mount(NULL, "", 0) == FR_OK);
+	return run(cmd);
+}
+
+//a bad option and an analyser that cannot run are failed steps
+static void test_failed_steps(void){
+	char *out = run_script("tmode -q\r\nmem\r\n");
+
+	CHECK_STR(out, "Step 1 failed, script stopped");
+	free(out);
+
+	out = run_script("gen -m uart -r 100000 -k 64\r\nanalyse -m 1wire -s a\r\nmem\r\n");
+	CHECK_STR(out, "Step 2 failed, script stopped");
+	free(out);
+}
+
+int main(void){
+	host_ramdisk_init(8192);
+	CHECK(host_ramdisk_format());
+
+	RUN_TEST(test_tokens);
+	RUN_TEST(test_unknown_and_help);
+	RUN_TEST(test_paste);
+	RUN_TEST(test_capture_and_decode);
+	RUN_TEST(test_perf);
+	RUN_TEST(test_gen);
+	RUN_TEST(test_sump_session);
+	RUN_TEST(test_failed_steps);
+	return TEST_END();
+}
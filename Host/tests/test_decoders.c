@@ -0,0 +1,214 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_decoders.c
+ * @brief   This file contains the host tests of the protocol decoders and the bit rate detection,
+ * 			on waveforms built by signals.c. Captures are also fed in small blocks, to check that
+ * 			frames spanning two blocks decode the same.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "signals.h"
+#include "host_stubs.h"
+#include "uart_analyser.h"
+#include "i2c_analyser.h"
+#include "onewire_analyser.h"
+#include "can_analyser.h"
+#include "bit_timing.h"
+#include "stdlib.h"
+
+#define SAMPLE_RATE 1000000
+#define CAPTURE_LEN 65536
+#define SMALL_BLOCK 7			//block length that splits every frame
+#define MAX_EVENTS 32
+
+static uint8_t capture[CAPTURE_LEN];
+
+static uart_frame_t uart_frames[MAX_EVENTS];
+static int uart_count;
+static onewire_event_t onewire_events[MAX_EVENTS];
+static int onewire_count;
+static can_frame_t can_frames[MAX_EVENTS];
+static int can_count;
+
+static void on_uart(const uart_frame_t *frame, void *arg){
+	(void)arg;
+	if(uart_count < MAX_EVENTS)
+		uart_frames[uart_count++] = *frame;
+}
+
+static void on_onewire(const onewire_event_t *event, void *arg){
+	(void)arg;
+	if(onewire_count < MAX_EVENTS)
+		onewire_events[onewire_count++] = *event;
+}
+
+static void on_can(const can_frame_t *frame, void *arg){
+	(void)arg;
+	if(can_count < MAX_EVENTS)
+		can_frames[can_count++] = *frame;
+}
+
+//TX on P0 sends "Hi", RX on P1 answers with a parity error
+static uint32_t build_uart(uint32_t bit_q8){
+	signal_t sig;
+
+	signal_init(&sig, capture, CAPTURE_LEN, 0xFF);
+	signal_hold(&sig, 100);
+	signal_uart(&sig, 0, 'H', 8, UART_PARITY_EVEN, 1, bit_q8);
+	signal_uart(&sig, 0, 'i', 8, UART_PARITY_EVEN, 1, bit_q8);
+	signal_hold(&sig, 50);
+	signal_uart(&sig, 1, 0x5A, 8, UART_PARITY_ODD, 1, bit_q8);	//0x5A has even ones, so odd parity is wrong for even
+	signal_hold(&sig, 100);
+	return sig.len;
+}
+
+static void check_uart_frames(void){
+	CHECK_EQ(uart_count, 3);
+	CHECK_EQ(uart_frames[0].data, 'H');
+	CHECK_EQ(uart_frames[0].channel, 0);
+	CHECK_EQ(uart_frames[0].flags, 0);
+	CHECK_EQ(uart_frames[0].position, 100);
+	CHECK_EQ(uart_frames[1].data, 'i');
+	CHECK_EQ(uart_frames[2].data, 0x5A);
+	CHECK_EQ(uart_frames[2].channel, 1);
+	CHECK_EQ(uart_frames[2].flags, UART_FRAME_ERR_PARITY);
+}
+
+static void test_uart(void){
+	uint32_t bit_q8 = rate_to_bit_period(115200, SAMPLE_RATE);
+	uint32_t len = build_uart(bit_q8);
+	uart_config_t config = {{0, 1}, 8, UART_PARITY_EVEN, 1, bit_q8, on_uart, NULL};
+	uart_analyser_t ctx;
+
+	uart_count = 0;
+	CHECK(uart_analyser_init(&ctx, &config));
+	uart_analyser_process(&ctx, capture, len);
+	check_uart_frames();
+
+	uart_count = 0;
+	CHECK(uart_analyser_init(&ctx, &config));
+	for(uint32_t i = 0; i < len; i += SMALL_BLOCK)
+		uart_analyser_process(&ctx, capture + i, (len - i < SMALL_BLOCK) ? len - i : SMALL_BLOCK);
+	check_uart_frames();
+}
+
+static void test_bit_period(void){
+	static const uint32_t rates[] = {9600, 19200, 57600, 115200, 230400};
+	uint32_t bit_q8 = rate_to_bit_period(115200, SAMPLE_RATE);
+	uint32_t len = build_uart(bit_q8);
+	uint32_t detected = detect_bit_period(capture, len, 0x03);
+
+	//within 2% of the real period
+	CHECK(detected > bit_q8 - bit_q8 / 50 && detected < bit_q8 + bit_q8 / 50);
+	CHECK_EQ(bit_period_to_rate(detected, SAMPLE_RATE, rates, 5), 115200);
+	CHECK_EQ(detect_bit_period(capture, len, 0x80), 0);	//no edges on P7
+}
+
+static void test_i2c(void){
+	i2c_analyser_t ctx;
+	signal_t sig;
+	char *out;
+
+	signal_init(&sig, capture, CAPTURE_LEN, 0x03);
+	signal_hold(&sig, 20);
+	signal_i2c_start(&sig, 0, 1, 5);
+	signal_i2c_byte(&sig, 0, 1, 0x50 << 1, true, 5);
+	signal_i2c_byte(&sig, 0, 1, 0xA5, false, 5);
+	signal_i2c_stop(&sig, 0, 1, 5);
+
+	host_capture_begin();
+	i2c_analyser_init(&ctx, 0, 1);
+	for(uint32_t i = 0; i < sig.len; i += SMALL_BLOCK)
+		i2c_analyser_process(&ctx, capture + i, (sig.len - i < SMALL_BLOCK) ? sig.len - i : SMALL_BLOCK);
+	out = host_capture_end(NULL);
+
+	CHECK_STR(out, "START DETECTED AT 30");
+	CHECK_STR(out, "ADDR: 	  50\r\nRW:   	  0\r\nACK/NACK: 0");
+	CHECK_STR(out, "DATA: 	  a5\r\nACK/NACK: 1");
+	CHECK_STR(out, "STOP DETECTED");
+	free(out);
+}
+
+static void test_onewire(void){
+	uint8_t rom[8] = {0x28, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0};
+	onewire_analyser_t ctx;
+	signal_t sig;
+
+	rom[7] = onewire_crc8(rom, 7);
+	signal_init(&sig, capture, CAPTURE_LEN, 0x04);
+	signal_hold(&sig, 100);
+	signal_onewire_reset(&sig, 2, SAMPLE_RATE / 1000000, true);
+	signal_onewire_byte(&sig, 2, SAMPLE_RATE / 1000000, ONEWIRE_CMD_READ_ROM);
+	for(int i = 0; i < 8; i++)
+		signal_onewire_byte(&sig, 2, SAMPLE_RATE / 1000000, rom[i]);
+	signal_onewire_reset(&sig, 2, SAMPLE_RATE / 1000000, false);
+
+	onewire_count = 0;
+	CHECK(onewire_analyser_init(&ctx, 2, SAMPLE_RATE, on_onewire, NULL));
+	for(uint32_t i = 0; i < sig.len; i += SMALL_BLOCK)
+		onewire_analyser_process(&ctx, capture + i, (sig.len - i < SMALL_BLOCK) ? sig.len - i : SMALL_BLOCK);
+
+	CHECK(onewire_count >= 5);
+	CHECK_EQ(onewire_events[0].type, ONEWIRE_EVENT_RESET);
+	CHECK_EQ(onewire_events[1].type, ONEWIRE_EVENT_PRESENCE);
+	CHECK_EQ(onewire_events[2].type, ONEWIRE_EVENT_ROM_COMMAND);
+	CHECK_EQ(onewire_events[2].value, ONEWIRE_CMD_READ_ROM);
+	CHECK_EQ(onewire_events[3].type, ONEWIRE_EVENT_ROM_ID);
+	CHECK_EQ(onewire_events[3].value & 0xFF, 0x28);
+	CHECK(onewire_events[3].crc_ok);
+	CHECK_EQ(onewire_events[4].type, ONEWIRE_EVENT_RESET);
+	CHECK_EQ(ctx.crc_errors, 0);
+}
+
+static void test_can(void){
+	const uint8_t data[] = {0x00, 0xFF, 0x12};	//long runs, so stuff bits are needed
+	const uint32_t samples_per_bit = 8;
+	can_analyser_t ctx;
+	signal_t sig;
+
+	signal_init(&sig, capture, CAPTURE_LEN, 0x01);
+	signal_hold(&sig, 12 * samples_per_bit);
+	signal_can(&sig, 0, samples_per_bit, 0x123, data, sizeof(data), false);
+	signal_can(&sig, 0, samples_per_bit, 0x7FF, data, 0, false);
+	signal_can(&sig, 0, samples_per_bit, 0x001, data, 2, true);
+
+	can_count = 0;
+	CHECK(can_analyser_init(&ctx, 0, samples_per_bit << 8, on_can, NULL));
+	for(uint32_t i = 0; i < sig.len; i += SMALL_BLOCK)
+		can_analyser_process(&ctx, capture + i, (sig.len - i < SMALL_BLOCK) ? sig.len - i : SMALL_BLOCK);
+
+	CHECK_EQ(can_count, 3);
+	CHECK_EQ(can_frames[0].id, 0x123);
+	CHECK_EQ(can_frames[0].dlc, 3);
+	CHECK(!memcmp(can_frames[0].data, data, sizeof(data)));
+	CHECK_EQ(can_frames[0].flags, 0);
+	CHECK_EQ(can_frames[0].position, 12 * samples_per_bit);
+	CHECK_EQ(can_frames[1].id, 0x7FF);
+	CHECK_EQ(can_frames[1].dlc, 0);
+	CHECK_EQ(can_frames[1].flags, 0);
+	CHECK_EQ(can_frames[2].id, 0x001);
+	CHECK_EQ(can_frames[2].flags, CAN_FRAME_ERR_CRC);
+	CHECK_EQ(ctx.errors, 1);
+}
+
+int main(void){
+	RUN_TEST(test_uart);
+	RUN_TEST(test_bit_period);
+	RUN_TEST(test_i2c);
+	RUN_TEST(test_onewire);
+	RUN_TEST(test_can);
+	return TEST_END();
+}
@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_dump.c
+ * @brief   This file contains the host tests of the dump transfer. The frames sent on the console are
+ * 			decoded as a host would: COBS, CRC, header and run length encoding, and the samples put
+ * 			back together must be the ones sent.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "dump.h"
+#include "stdlib.h"
+
+#define SAMPLES_LEN 5000
+
+static uint8_t samples[SAMPLES_LEN];
+static uint8_t rebuilt[SAMPLES_LEN];
+
+typedef struct{
+	uint32_t frames;
+	uint32_t bad;			//frames with a wrong CRC or length
+	uint32_t rle;			//frames run length encoded
+	int32_t last_seq;
+	bool last_seen;
+}decoded_t;
+
+static uint32_t get_le(const uint8_t *src, uint8_t len){
+	uint32_t value = 0;
+	for(uint8_t i = 0; i < len; i++)
+		value |= (uint32_t)src[i] << (8 * i);
+	return value;
+}
+
+static uint32_t cobs_decode(const uint8_t *src, uint32_t len, uint8_t *dest){
+	uint32_t in = 0, out = 0;
+
+	while(in < len){
+		uint8_t code = src[in++];
+		for(uint8_t i = 1; i < code && in < len; i++)
+			dest[out++] = src[in++];
+		if(code != 0xFF && in < len)
+			dest[out++] = 0;
+	}
+	return out;
+}
+
+//puts the samples of one decoded frame in rebuilt
+static void decode_frame(const uint8_t *raw, uint32_t len, decoded_t *result){
+	uint32_t offset, count, payload_len;
+	const uint8_t *payload = raw + DUMP_HEADER_SIZE;
+
+	if(len < DUMP_HEADER_SIZE + DUMP_CRC_SIZE ||
+			dump_crc32(raw, len - DUMP_CRC_SIZE) != get_le(raw + len - DUMP_CRC_SIZE, 4)){
+		result->bad++;
+		return;
+	}
+	offset = get_le(raw + 3, 4);
+	count = get_le(raw + 7, 4);
+	payload_len = len - DUMP_HEADER_SIZE - DUMP_CRC_SIZE;
+	result->frames++;
+	result->last_seq = get_le(raw, 2);
+	if(raw[2] & DUMP_FLAG_LAST)
+		result->last_seen = true;
+
+	if(raw[2] & DUMP_FLAG_RLE){
+		uint32_t in = 0, out = offset;
+		result->rle++;
+		while(in < payload_len){
+			uint8_t value = payload[in++];
+			uint32_t run = 0, shift = 0;
+			do{
+				run |= (uint32_t)(payload[in] & 0x7F) << shift;
+				shift += 7;
+			}while(payload[in++] & 0x80);
+			while(run-- && out < SAMPLES_LEN)
+				rebuilt[out++] = value;
+		}
+		if(out != offset + count)
+			result->bad++;
+	}else{
+		if(payload_len != count)
+			result->bad++;
+		memcpy(rebuilt + offset, payload, count);
+	}
+}
+
+//decodes every frame of a console capture
+static void decode_stream(const uint8_t *stream, size_t len, decoded_t *result){
+	uint8_t raw[DUMP_FRAME_MAX];
+	size_t start = 0;
+
+	memset(result, 0, sizeof(*result));
+	result->last_seq = -1;
+	CHECK(len > 0 && stream[0] == 0);	//the transfer opens with a delimiter
+	for(size_t i = 1; i < len; i++){
+		if(stream[i] != 0)
+			continue;
+		if(i - start > 1)
+			decode_frame(raw, cobs_decode(stream + start + 1, i - start - 1, raw), result);
+		start = i;
+	}
+}
+
+static uint8_t *run_dump(uint32_t offset, uint32_t len, bool rle, dump_stats_t *stats, size_t *out_len,
+		bool *ended){
+	host_capture_begin();
+	*ended = dump_run(samples, offset, len, rle, stats);
+	return (uint8_t*)host_capture_end(out_len);
+}
+
+static void test_cobs(void){
+	uint8_t src[600], enc[610], dec[610];
+	uint32_t len;
+
+	for(int i = 0; i < 600; i++)
+		src[i] = (i % 300 == 0) ? 0 : (uint8_t)i;
+	len = dump_cobs_encode(src, sizeof(src), enc);
+	CHECK(len <= sizeof(src) + sizeof(src) / 254 + 1);
+	CHECK(memchr(enc, 0, len) == NULL);
+	CHECK_EQ(cobs_decode(enc, len, dec), sizeof(src));
+	CHECK(!memcmp(src, dec, sizeof(src)));
+}
+
+static void test_raw(void){
+	dump_stats_t stats;
+	decoded_t result;
+	size_t len;
+	bool ended;
+	uint8_t *out;
+
+	for(int i = 0; i < SAMPLES_LEN; i++)
+		samples[i] = (uint8_t)(i * 7 + (i >> 3));
+	memset(rebuilt, 0xEE, sizeof(rebuilt));
+	out = run_dump(0, SAMPLES_LEN, false, &stats, &len, &ended);
+	decode_stream(out, len, &result);
+
+	CHECK(ended);
+	CHECK_EQ(result.bad, 0);
+	CHECK_EQ(result.frames, (SAMPLES_LEN + DUMP_PAYLOAD_MAX - 1) / DUMP_PAYLOAD_MAX);
+	CHECK_EQ(stats.frames, result.frames);
+	CHECK_EQ(stats.bytes_out, len);
+	CHECK(result.last_seen);
+	CHECK(!memcmp(samples, rebuilt, SAMPLES_LEN));
+	free(out);
+}
+
+//idle stretches shrink, busy ones are sent raw and never grow
+static void test_rle(void){
+	dump_stats_t stats;
+	decoded_t result;
+	size_t len;
+	bool ended;
+	uint8_t *out;
+
+	memset(samples, 0x01, 2000);
+	for(int i = 2000; i < SAMPLES_LEN; i++)
+		samples[i] = (uint8_t)i;
+	memset(rebuilt, 0xEE, sizeof(rebuilt));
+	out = run_dump(100, SAMPLES_LEN - 100, true, &stats, &len, &ended);
+	decode_stream(out, len, &result);
+
+	CHECK(ended);
+	CHECK_EQ(result.bad, 0);
+	CHECK(result.rle >= 1);
+	CHECK(result.frames < (SAMPLES_LEN - 100) / DUMP_PAYLOAD_MAX + 1);
+	CHECK(!memcmp(samples + 100, rebuilt + 100, SAMPLES_LEN - 100));
+	free(out);
+}
+
+//a request for a lost frame after the last one sends it again, a quit stops the transfer
+static void test_nak_and_quit(void){
+	const uint8_t nak[] = {DUMP_NAK, 1, 0};
+	const uint8_t old[] = {DUMP_NAK, 0xFF, 0x7F};
+	const uint8_t quit[] = {DUMP_QUIT};
+	dump_stats_t stats;
+	decoded_t result;
+	size_t len;
+	bool ended;
+	uint8_t *out;
+
+	for(int i = 0; i < SAMPLES_LEN; i++)
+		samples[i] = (uint8_t)(i ^ 0x5A);
+	CHECK(host_console_push_at(host_time() + 10, nak, sizeof(nak)));
+	CHECK(host_console_push_at(host_time() + 20, old, sizeof(old)));
+	out = run_dump(0, 1000, false, &stats, &len, &ended);
+	decode_stream(out, len, &result);
+	CHECK(ended);
+	CHECK_EQ(stats.resent, 1);
+	CHECK_EQ(stats.missed, 1);
+	CHECK_EQ(result.frames, stats.frames + 1);
+	CHECK_EQ(result.last_seq, 1);		//the frame sent again comes last
+	free(out);
+
+	CHECK(host_console_push_at(host_time() + 10, quit, sizeof(quit)));
+	out = run_dump(0, 1000, false, &stats, &len, &ended);
+	CHECK(!ended);
+	CHECK_EQ(host_console_pending(), 0);
+	free(out);
+}
+
+int main(void){
+	RUN_TEST(test_cobs);
+	RUN_TEST(test_raw);
+	RUN_TEST(test_rle);
+	RUN_TEST(test_nak_and_quit);
+	return TEST_END();
+}
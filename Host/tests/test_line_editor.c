@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_line_editor.c
+ * @brief   This file contains the host tests of the console line editor: echo, backspace,
+ * 			overflow and a pasted burst holding several lines.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "line_editor.h"
+#include "stdlib.h"
+
+static line_editor_t editor;
+
+//feeds a string, returns the number of lines it completed
+static int feed(const char *text){
+	int lines = 0;
+
+	while(*text)
+		lines += line_editor_feed(&editor, (uint8_t)*text++);
+	return lines;
+}
+
+static void test_echo(void){
+	char *out;
+
+	line_editor_reset(&editor);
+	host_capture_begin();
+	CHECK_EQ(feed("help\r"), 1);
+	out = host_capture_end(NULL);
+	CHECK(!strcmp(out, "help\r\n"));
+	CHECK(!memcmp(editor.line, "help\r", 5));
+	CHECK_EQ(editor.len, 5);
+	free(out);
+}
+
+static void test_backspace(void){
+	char *out;
+
+	line_editor_reset(&editor);
+	host_capture_begin();
+	feed("\b\bmew\b\bem\r");
+	out = host_capture_end(NULL);
+	CHECK(!memcmp(editor.line, "mem\r", 4));
+	CHECK_EQ(editor.len, 4);
+	CHECK(!strcmp(out, "mew\b \b\b \bem\r\n"));	//nothing is echoed for a backspace at the start
+	free(out);
+}
+
+static void test_overflow(void){
+	char *out;
+
+	line_editor_reset(&editor);
+	editor.overflows = 0;
+	host_capture_begin();
+	for(int i = 0; i < LINE_EDITOR_SIZE + 10; i++)
+		CHECK_EQ(line_editor_feed(&editor, 'a'), 0);
+	//the line still ends, its carriage return always has room
+	CHECK_EQ(line_editor_feed(&editor, '\r'), 1);
+	out = host_capture_end(NULL);
+	CHECK_EQ(editor.len, LINE_EDITOR_SIZE);
+	CHECK_EQ(editor.line[LINE_EDITOR_SIZE - 1], '\r');
+	CHECK_EQ(editor.overflows, 11);
+	free(out);
+}
+
+//a paste delivers several lines at once, each one ends where its carriage return is
+static void test_paste(void){
+	const char *burst = "tmode -f 200\rsave -w\rmem\r";
+	const char *expect[] = {"tmode -f 200\r", "save -w\r", "mem\r"};
+	int line = 0;
+	char *out;
+
+	line_editor_reset(&editor);
+	host_capture_begin();
+	for(const char *p = burst; *p; p++){
+		if(line_editor_feed(&editor, (uint8_t)*p)){
+			CHECK(line < 3);
+			CHECK(!memcmp(editor.line, expect[line], strlen(expect[line])));
+			line++;
+			line_editor_reset(&editor);
+		}
+	}
+	out = host_capture_end(NULL);
+	CHECK_EQ(line, 3);
+	free(out);
+}
+
+int main(void){
+	RUN_TEST(test_echo);
+	RUN_TEST(test_backspace);
+	RUN_TEST(test_overflow);
+	RUN_TEST(test_paste);
+	return TEST_END();
+}
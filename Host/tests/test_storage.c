@@ -0,0 +1,247 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_storage.c
+ * @brief   This file contains the host tests of the capture files: background save, read back,
+ * 			streaming and text files, through user_fatfs.c, FatFs, the sector cache and a RAM disk.
+ * 			The RAM disk is also made to fail, to check that errors end jobs cleanly.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "user_fatfs.h"
+#include "timing_mode_init.h"
+#include "timer_update_event.h"
+#include "fmc.h"
+#include "ff.h"
+#include "diskio.h"
+#include "sector_cache.h"
+#include "capture_health.h"
+
+#define DISK_SECTORS 32768			//16 MB
+#define CAPTURE_LEN (256 * 1024)
+#define ODD_LEN (CAPTURE_LEN - 100)	//not whole sectors, written through fatfs
+#define SAMPLE_RATE 400000
+
+static uint8_t readback[CAPTURE_LEN];
+static uint8_t expected[CAPTURE_LEN];
+
+static void fill_pattern(uint8_t *dest, uint32_t len, uint8_t seed){
+	for(uint32_t i = 0; i < len; i++)
+		dest[i] = (uint8_t)(i * 13 + seed + (i >> 9));
+}
+
+static uint8_t *take_capture(uint32_t len, uint8_t seed){
+	uint8_t *samples = reserve_capture_region(len);
+	capture_health_t health = {.blocks = len / 32768, .lost_samples = seed, .latency_max_ns = 1500 + seed};
+
+	fill_pattern(samples, len, seed);
+	capture_health_set(&health);
+	set_sample_rate(SAMPLE_RATE);
+	set_trigger_position(NO_TRIGGER_POSITION);
+	set_capture_length(len);
+	return samples;
+}
+
+//runs a save to its end, returns the polls it took
+static uint32_t save(const uint8_t *samples, uint32_t len){
+	uint32_t polls = 0;
+
+	if(!user_fatfs_save_start(samples, len))
+		return 0;
+	while(user_fatfs_save_poll())
+		polls++;
+	return polls + 1;
+}
+
+static void check_file(const char *filename, const uint8_t *samples, uint32_t len){
+	capture_info_t info;
+
+	memset(readback, 0, sizeof(readback));
+	CHECK(user_fatfs_read_capture(filename, readback, sizeof(readback), &info));
+	CHECK_EQ(info.sample_rate, SAMPLE_RATE);
+	CHECK_EQ(info.sample_count, len);
+	CHECK(info.trigger_position == CAPTURE_NO_TRIGGER);
+	CHECK_EQ(info.health.blocks, len / 32768);
+	CHECK_EQ(info.health.latency_max_ns, 1500 + info.health.lost_samples);
+	CHECK(!memcmp(readback, samples, len));
+}
+
+static void test_save_and_read(void){
+	uint8_t *samples = take_capture(CAPTURE_LEN, 1);
+	const save_job_t *job = user_fatfs_get_save_job();
+
+	CHECK(save(samples, CAPTURE_LEN) > 1);
+	CHECK_EQ(job->state, SAVE_JOB_DONE);
+	CHECK_EQ(job->written, CAPTURE_LEN);
+	CHECK(sdram_find(get_sdram_arena(), samples)->flags == 0);	//unlocked at the end
+	check_file(job->filename, samples, CAPTURE_LEN);
+
+	samples = take_capture(ODD_LEN, 2);
+	CHECK(save(samples, ODD_LEN) > 1);
+	CHECK_EQ(job->state, SAVE_JOB_DONE);
+	check_file(job->filename, samples, ODD_LEN);
+}
+
+//the next capture is taken while the save of the last one runs
+static void test_capture_during_save(void){
+	uint8_t *first = take_capture(CAPTURE_LEN, 3);
+	uint8_t *second;
+	const save_job_t *job = user_fatfs_get_save_job();
+	char filename[sizeof(job->filename)];
+
+	CHECK(user_fatfs_save_start(first, CAPTURE_LEN));
+	strcpy(filename, job->filename);
+	CHECK(user_fatfs_save_poll());
+	second = take_capture(CAPTURE_LEN, 4);
+	CHECK(second != first);
+	CHECK(!user_fatfs_save_start(second, CAPTURE_LEN));		//one save at a time
+	CHECK(!user_fatfs_read_capture(filename, readback, sizeof(readback), NULL));
+	while(user_fatfs_save_poll());
+	CHECK_EQ(job->state, SAVE_JOB_DONE);
+	CHECK(sdram_find(get_sdram_arena(), first) == NULL);	//the saving region went with the save
+
+	fill_pattern(expected, CAPTURE_LEN, 3);
+	check_file(filename, expected, CAPTURE_LEN);
+}
+
+static void test_stream(void){
+	uint8_t *samples = take_capture(CAPTURE_LEN, 5);
+	const save_job_t *job = user_fatfs_get_save_job();
+	capture_stream_stats_t stats;
+	capture_info_t info;
+	const uint8_t *block;
+	uint32_t len, total = 0;
+	bool same = true;
+
+	CHECK(save(samples, CAPTURE_LEN) > 1);
+	CHECK(user_fatfs_stream_open(job->filename, &info));
+	CHECK_EQ(info.sample_count, CAPTURE_LEN);
+	while((block = user_fatfs_stream_next(&len)) != NULL){
+		if(total + len > CAPTURE_LEN || memcmp(block, samples + total, len))
+			same = false;
+		total += len;
+		user_fatfs_stream_poll();
+	}
+	CHECK(same);
+	CHECK_EQ(total, CAPTURE_LEN);
+	CHECK(user_fatfs_stream_close(&stats));
+	CHECK(stats.read_ahead);
+	CHECK_EQ(stats.bytes, CAPTURE_LEN);
+}
+
+static void test_text_file(void){
+	const char text[] = "tmode -f 200\r\nsave -w\r\n";
+	char dest[64];
+	FATFS fs;
+	FIL fil;
+	UINT written;
+	uint32_t len = 0;
+
+	CHECK(f_mount(&fs, "", 1) == FR_OK);
+	CHECK(f_open(&fil, "test.txt", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+	CHECK(f_write(&fil, text, strlen(text), &written) == FR_OK);
+	CHECK(f_close(&fil) == FR_OK);
+	CHECK(f_mount(NULL, "", 0) == FR_OK);
+
+	CHECK(user_fatfs_read_file("test.txt", dest, sizeof(dest), &len));
+	CHECK_EQ(len, strlen(text));
+	CHECK(!strcmp(dest, text));
+	CHECK(!user_fatfs_read_file("test.txt", dest, 8, &len));	//too long for the buffer
+	CHECK(!user_fatfs_read_file("none.txt", dest, sizeof(dest), &len));
+}
+
+static void test_write_fault(void){
+	uint8_t *samples = take_capture(CAPTURE_LEN, 6);
+	const save_job_t *job = user_fatfs_get_save_job();
+
+	host_ramdisk_fail_after(64, -1);
+	save(samples, CAPTURE_LEN);
+	host_ramdisk_fail_after(-1, -1);
+	CHECK_EQ(job->state, SAVE_JOB_FAILED);
+	CHECK(job->written < CAPTURE_LEN);
+	CHECK(host_ramdisk_get_stats()->failed > 0);
+	CHECK(sdram_find(get_sdram_arena(), samples)->flags == 0);
+
+	//the card is usable again once it stops failing
+	CHECK(save(samples, CAPTURE_LEN) > 1);
+	CHECK_EQ(job->state, SAVE_JOB_DONE);
+}
+
+static void test_read_fault(void){
+	uint8_t *samples = take_capture(CAPTURE_LEN, 7);
+	const save_job_t *job = user_fatfs_get_save_job();
+	capture_info_t info;
+	uint32_t len, total = 0;
+
+	CHECK(save(samples, CAPTURE_LEN) > 1);
+	CHECK(user_fatfs_stream_open(job->filename, &info));
+	host_ramdisk_fail_after(-1, 100);
+	while(user_fatfs_stream_next(&len) != NULL)
+		total += len;
+	host_ramdisk_fail_after(-1, -1);
+	CHECK(total < CAPTURE_LEN);
+	CHECK(!user_fatfs_stream_close(NULL));
+
+	//and the file reads whole afterwards
+	check_file(job->filename, samples, CAPTURE_LEN);
+}
+
+//a sync the card fails keeps the sectors dirty in the cache, the next one writes them and the file
+//reads back whole from the card once remounted
+static void test_sync_fault(void){
+	const char text[] = "sector cache write back after a failed sync\r\n";
+	char dest[64];
+	FATFS fs;
+	FIL fil;
+	UINT written;
+	uint32_t dirty, len = 0;
+
+	CHECK(f_mount(&fs, "", 1) == FR_OK);
+	CHECK(f_open(&fil, "sync.txt", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+	CHECK(f_write(&fil, text, strlen(text), &written) == FR_OK);
+
+	host_ramdisk_fail_after(0, -1);
+	CHECK(f_sync(&fil) == FR_DISK_ERR);
+	dirty = sector_cache_dirty_count();
+	CHECK(dirty > 0);
+	CHECK(disk_ioctl(0, CTRL_SYNC, NULL) == RES_ERROR);
+	CHECK_EQ(sector_cache_dirty_count(), dirty);
+
+	host_ramdisk_fail_after(-1, -1);
+	CHECK(disk_ioctl(0, CTRL_SYNC, NULL) == RES_OK);
+	CHECK_EQ(sector_cache_dirty_count(), 0);
+	CHECK(f_close(&fil) == FR_OK);
+	CHECK(f_mount(NULL, "", 0) == FR_OK);
+
+	//mounting again starts from an empty cache, so this comes from the card
+	CHECK(user_fatfs_read_file("sync.txt", dest, sizeof(dest), &len));
+	CHECK_EQ(len, strlen(text));
+	CHECK(!strcmp(dest, text));
+}
+
+int main(void){
+	host_ramdisk_init(DISK_SECTORS);
+	CHECK(host_ramdisk_format());
+
+	RUN_TEST(test_save_and_read);
+	RUN_TEST(test_capture_during_save);
+	RUN_TEST(test_stream);
+	RUN_TEST(test_text_file);
+	RUN_TEST(test_write_fault);
+	RUN_TEST(test_read_fault);
+	RUN_TEST(test_sync_fault);
+	return TEST_END();
+}
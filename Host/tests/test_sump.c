@@ -0,0 +1,329 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_sump.c
+ * @brief   This file contains the host tests of the SUMP protocol: command parsing, configuration,
+ * 			metadata, triggers, and whole sessions as PulseView runs them.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#define _GNU_SOURCE		//posix_openpt and the rest of the pseudo terminal calls
+#include "test.h"
+#include "host_stubs.h"
+#include "sump.h"
+#include "uart.h"
+#include "fmc.h"
+#include "timing_mode_init.h"
+#include "timer_update_event.h"
+#include "stdlib.h"
+#include "fcntl.h"
+#include "poll.h"
+#include "termios.h"
+#include "unistd.h"
+#include "sys/wait.h"
+
+#define PTY_TIMEOUT_MS 5000		//a reply left in a buffer never comes, so the client gives up
+
+#define TRIGGER_SAMPLE 5000		//first sample with P7 high in ramp_source
+
+//sample i is i / 4, so the value tells where a sample came from
+static void ramp_source(uint8_t *dest, uint32_t len, void *arg){
+	(void)arg;
+	for(uint32_t i = 0; i < len; i++)
+		dest[i] = (i < TRIGGER_SAMPLE) ? (uint8_t)((i / 4) & 0x7F) : 0x80;
+}
+
+static void put_long(uint8_t *dest, uint8_t cmd, uint32_t arg){
+	dest[0] = cmd;
+	for(int i = 0; i < 4; i++)
+		dest[1 + i] = (uint8_t)(arg >> (8 * i));
+}
+
+static void test_parser(void){
+	const uint8_t bytes[] = {SUMP_RESET, SUMP_SET_DIVIDER, 0x63, 0x00, 0x00, 0x00, SUMP_ID};
+	sump_parser_t parser = { 0 };
+	uint8_t cmds[4], n = 0, cmd;
+	uint32_t args[4], arg;
+
+	for(uint32_t i = 0; i < sizeof(bytes); i++){
+		if(sump_parse(&parser, bytes[i], &cmd, &arg)){
+			cmds[n] = cmd;
+			args[n++] = arg;
+		}
+	}
+	CHECK_EQ(n, 3);
+	CHECK_EQ(cmds[0], SUMP_RESET);
+	CHECK_EQ(cmds[1], SUMP_SET_DIVIDER);
+	CHECK_EQ(args[1], 0x63);
+	CHECK_EQ(cmds[2], SUMP_ID);
+	CHECK_EQ(parser.len, 0);
+}
+
+static void test_config(void){
+	sump_config_t config;
+
+	sump_config_reset(&config);
+	CHECK_EQ(sump_sample_rate(&config), SUMP_MAX_SAMPLE_RATE);
+	CHECK_EQ(sump_bytes_per_sample(&config), 1);
+
+	sump_apply(&config, SUMP_SET_DIVIDER, 999);
+	CHECK_EQ(sump_sample_rate(&config), SUMP_CLOCK / 1000);
+	sump_apply(&config, SUMP_SET_DIVIDER, 0);
+	CHECK_EQ(sump_sample_rate(&config), SUMP_MAX_SAMPLE_RATE);	//limited
+
+	sump_apply(&config, SUMP_SET_READ_DELAY, (3 << 16) | 255);
+	CHECK_EQ(config.read_count, 1024);
+	CHECK_EQ(config.delay_count, 16);
+	sump_apply(&config, SUMP_SET_READ_COUNT, 1023);
+	CHECK_EQ(config.read_count, 4096);
+
+	sump_apply(&config, SUMP_SET_FLAGS, 0);
+	CHECK_EQ(sump_bytes_per_sample(&config), 4);
+	sump_apply(&config, SUMP_SET_TRIGGER_MASK, 0x81);
+	sump_apply(&config, SUMP_SET_TRIGGER_VALUE, 0x01);
+	CHECK_EQ(config.trigger_mask, 0x81);
+	CHECK_EQ(config.trigger_value, 0x01);
+}
+
+static void test_metadata(void){
+	uint8_t meta[64];
+	uint32_t len = sump_metadata(meta, sizeof(meta));
+
+	CHECK(len > 0 && len <= sizeof(meta));
+	CHECK_EQ(meta[0], 0x01);
+	CHECK(!strcmp((char*)meta + 1, "LogiProbe"));
+	//the memory is what the free SDRAM holds, all of it before any capture
+	CHECK_EQ(meta[21], 0x21);
+	CHECK_EQ(((uint32_t)meta[22] << 24) | (meta[23] << 16) | (meta[24] << 8) | meta[25], SDRAM_SIZE);
+	CHECK_EQ(meta[len - 1], 0x00);
+	CHECK_EQ(sump_metadata(meta, 10), 0);
+}
+
+static void test_find_trigger(void){
+	uint8_t samples[100] = { 0 };
+
+	samples[40] = 0x03;
+	samples[70] = 0x01;
+	CHECK_EQ(sump_find_trigger(samples, 0, 100, 0x01, 0x01), 40);
+	CHECK_EQ(sump_find_trigger(samples, 41, 100, 0x01, 0x01), 70);
+	CHECK_EQ(sump_find_trigger(samples, 0, 100, 0x03, 0x03), 40);
+	CHECK_EQ(sump_find_trigger(samples, 0, 40, 0x01, 0x01), SUMP_NO_TRIGGER);
+	CHECK_EQ(sump_find_trigger(samples, 0, 100, 0x00, 0xFF), 0);	//no channel to wait for
+}
+
+//sends a session and returns what came back. The last byte ends it a second after the others, so
+//that a capture, which takes its simulated time, is over before it arrives
+static uint8_t *session(const uint8_t *bytes, uint32_t len, size_t *out_len){
+	host_console_push(bytes + 1, len - 2);
+	host_console_push_at(host_time() + 1000, bytes + len - 1, 1);
+	host_capture_begin();
+	sump_run(bytes[0]);
+	return (uint8_t*)host_capture_end(out_len);
+}
+
+static void test_session_id(void){
+	const uint8_t bytes[] = {SUMP_RESET, SUMP_RESET, SUMP_RESET, SUMP_RESET, SUMP_RESET, SUMP_ID,
+			SUMP_METADATA, '\r'};
+	uint8_t meta[64];
+	uint32_t meta_len = sump_metadata(meta, sizeof(meta));
+	size_t len;
+	uint8_t *out = session(bytes, sizeof(bytes), &len);
+
+	CHECK_EQ(len, 4 + meta_len);
+	CHECK(!memcmp(out, "1ALS", 4));
+	CHECK(!memcmp(out + 4, meta, meta_len));
+	CHECK_EQ(host_console_pending(), 0);
+	free(out);
+}
+
+//samples come back last first
+static void test_session_capture(void){
+	uint8_t bytes[32];
+	uint32_t n = 0;
+	size_t len;
+	uint8_t *out;
+	bool reversed = true;
+
+	bytes[n++] = SUMP_RESET;
+	put_long(bytes + n, SUMP_SET_DIVIDER, 99);		//1 MHz
+	n += 5;
+	put_long(bytes + n, SUMP_SET_READ_DELAY, (255 << 16) | 255);	//1024 samples
+	n += 5;
+	bytes[n++] = SUMP_RUN;
+	bytes[n++] = '\r';
+
+	host_set_sample_source(ramp_source, NULL);
+	out = session(bytes, n, &len);
+	CHECK_EQ(len, 1024);
+	for(uint32_t i = 0; i < 1024 && i < len; i++)
+		reversed &= (out[i] == (uint8_t)(((1023 - i) / 4) & 0x7F));
+	CHECK(reversed);
+	CHECK_EQ(get_sample_rate(), 1000000);
+	CHECK_EQ(get_capture_length(), 1024);
+	free(out);
+}
+
+//with a trigger the samples sent are centred on it as read and delay counts ask
+static void test_session_trigger(void){
+	uint8_t bytes[32];
+	uint32_t n = 0;
+	size_t len;
+	uint8_t *out;
+
+	bytes[n++] = SUMP_RESET;
+	put_long(bytes + n, SUMP_SET_READ_DELAY, (63 << 16) | 127);	//512 samples, 256 after the trigger
+	n += 5;
+	put_long(bytes + n, SUMP_SET_TRIGGER_MASK, 0x80);
+	n += 5;
+	put_long(bytes + n, SUMP_SET_TRIGGER_VALUE, 0x80);
+	n += 5;
+	bytes[n++] = SUMP_RUN;
+	bytes[n++] = '\r';
+
+	host_set_sample_source(ramp_source, NULL);
+	out = session(bytes, n, &len);
+	CHECK_EQ(len, 512);
+	CHECK_EQ(get_trigger_position(), TRIGGER_SAMPLE);
+	if(len == 512){
+		CHECK_EQ(out[0], 0x80);					//last sample sent, after the trigger
+		CHECK_EQ(out[255], 0x80);				//the trigger sample
+		CHECK_EQ(out[256], ((TRIGGER_SAMPLE - 1) / 4) & 0x7F);
+		CHECK_EQ(out[511], ((TRIGGER_SAMPLE - 256) / 4) & 0x7F);
+	}
+	free(out);
+	host_set_sample_source(NULL, NULL);
+}
+
+//with SDRAM taken by other regions nothing is sent, the refusal is counted for mem
+static void test_session_no_room(void){
+	uint8_t bytes[32];
+	uint8_t *filler[SDRAM_MAX_REGIONS];
+	uint32_t n = 0, fills = 0, captures = sump_get_stats()->captures;
+	size_t len;
+	uint8_t *out;
+
+	bytes[n++] = SUMP_RESET;
+	put_long(bytes + n, SUMP_SET_READ_COUNT, 131072 / 4 - 1);
+	n += 5;
+	bytes[n++] = SUMP_RUN;
+	bytes[n++] = '\r';
+
+	reserve_capture_region(SDRAM_CAPTURE_ALIGN);		//the region the capture gives back is small
+	while(fills < SDRAM_MAX_REGIONS - 1 && sdram_largest_free(get_sdram_arena()) != 0){
+		filler[fills] = sdram_alloc(get_sdram_arena(), "filler", sdram_largest_free(get_sdram_arena()), 1);
+		fills++;
+	}
+	out = session(bytes, n, &len);
+	CHECK_EQ(len, 0);
+	CHECK_EQ(sump_get_stats()->refused, 1);
+	CHECK_EQ(sump_get_stats()->refused_len, 131072);
+	CHECK_EQ(sump_get_stats()->captures, captures);
+	CHECK_EQ(host_console_pending(), 0);
+	free(out);
+	while(fills)
+		sdram_free(get_sdram_arena(), filler[--fills]);
+}
+
+//reads what a client expects back, false if it does not come in time
+static bool pty_read(int fd, uint8_t *buf, uint32_t len){
+	uint32_t got = 0;
+
+	while(got < len){
+		struct pollfd p = { fd, POLLIN, 0 };
+		ssize_t n;
+
+		if(poll(&p, 1, PTY_TIMEOUT_MS) <= 0)
+			return false;
+		n = read(fd, buf + got, len - got);
+		if(n <= 0)
+			return false;
+		got += n;
+	}
+	return true;
+}
+
+//a client talks to sump_run in another process over a pseudo terminal in raw mode, as PulseView
+//does over the serial port: it only sees a reply once the firmware has flushed it
+static void test_session_pty(void){
+	uint8_t cmds[32], reply[1024], meta[64];
+	uint32_t meta_len = sump_metadata(meta, sizeof(meta));
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	struct termios raw;
+	uint32_t n = 0;
+	int status = -1;
+	bool reversed = true;
+	pid_t pid;
+
+	CHECK(master >= 0);
+	if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+		return;
+	int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	CHECK(slave >= 0);
+	tcgetattr(slave, &raw);
+	cfmakeraw(&raw);
+	tcsetattr(slave, TCSANOW, &raw);
+
+	fflush(stdout);
+	pid = fork();
+	if(pid == 0){
+		close(master);
+		host_console_attach(slave);
+		host_set_sample_source(ramp_source, NULL);
+		sump_run(get_char());
+		_exit(0);
+	}
+	close(slave);
+
+	memset(cmds, SUMP_RESET, 5);
+	cmds[5] = SUMP_ID;
+	write(master, cmds, 6);
+	CHECK(pty_read(master, reply, 4));
+	CHECK(!memcmp(reply, "1ALS", 4));
+
+	cmds[0] = SUMP_METADATA;
+	write(master, cmds, 1);
+	CHECK(pty_read(master, reply, meta_len));
+	CHECK(!memcmp(reply, meta, meta_len));
+
+	put_long(cmds + n, SUMP_SET_DIVIDER, 99);
+	n += 5;
+	put_long(cmds + n, SUMP_SET_READ_DELAY, (255 << 16) | 255);
+	n += 5;
+	cmds[n++] = SUMP_RUN;
+	write(master, cmds, n);
+	CHECK(pty_read(master, reply, 1024));
+	for(uint32_t i = 0; i < 1024; i++)
+		reversed &= (reply[i] == (uint8_t)(((1023 - i) / 4) & 0x7F));
+	CHECK(reversed);
+
+	write(master, "\r", 1);
+	waitpid(pid, &status, 0);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	close(master);
+}
+
+int main(void){
+	host_ramdisk_init(8192);
+
+	RUN_TEST(test_parser);
+	RUN_TEST(test_config);
+	RUN_TEST(test_metadata);
+	RUN_TEST(test_find_trigger);
+	RUN_TEST(test_session_id);
+	RUN_TEST(test_session_capture);
+	RUN_TEST(test_session_trigger);
+	RUN_TEST(test_session_no_room);
+	RUN_TEST(test_session_pty);
+	return TEST_END();
+}
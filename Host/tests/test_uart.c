@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_uart.c
+ * @brief   This file contains the host tests of the receive path of uart.c, the USART2 interrupt
+ * 			and its ring buffer, on the simulated usart of periph_sim. It is linked with uart.c in
+ * 			place of the console stub, so nothing here may print through put_char.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "periph_sim.h"
+#include "uart.h"
+#include "pll_clock.h"
+
+#define BURST_LEN 65536
+#define FASTEST_BAUD 5000000	//the highest rate the baud command offers, 9 APB1 clocks a bit
+
+static uint8_t burst[BURST_LEN];
+
+static void fill_burst(uint32_t seed){
+	for(uint32_t i = 0; i < BURST_LEN; i++)
+		burst[i] = (uint8_t)((i * 7 + seed) ^ (i >> 8));
+}
+
+//time of a 8N1 frame at the rate the usart was set to
+static uint64_t frame_ns(uint32_t baud){
+	return 10ULL * 1000000000 / baud;
+}
+
+//a burst at full line rate, read as it comes, arrives whole and in order
+static void burst_at(uint32_t baud){
+	uart_rx_stats_t before = *uart_get_rx_stats();
+	const uart_rx_stats_t *after = (const uart_rx_stats_t*)uart_get_rx_stats();
+	uint64_t start = periph_sim_time_ns();
+	uint32_t same = 0;
+
+	CHECK(uart_set_baud(baud) != 0);
+	fill_burst(baud);
+	periph_sim_usart_rx(burst, BURST_LEN);
+	for(uint32_t i = 0; i < BURST_LEN; i++)
+		same += (get_char() == burst[i]);
+	CHECK_EQ(same, BURST_LEN);
+	CHECK_EQ(after->received - before.received, BURST_LEN);
+	CHECK_EQ(after->dropped - before.dropped, 0);
+	CHECK_EQ(after->overruns - before.overruns, 0);
+	CHECK_EQ(after->errors - before.errors, 0);
+	CHECK(!char_available());
+
+	//back to back: no more than a frame and the last wait of get_char beyond the line time
+	uint64_t elapsed = periph_sim_time_ns() - start;
+	uint64_t line = BURST_LEN * (uint64_t)1000000000 * 10 / uart_get_baud();
+	CHECK(elapsed >= line - frame_ns(uart_get_baud()));
+	CHECK(elapsed <= line + frame_ns(uart_get_baud()) + PERIPH_SIM_WAIT_US * 1000);
+}
+
+static void test_burst_default(void){
+	burst_at(UART_DEFAULT_BAUD);
+}
+
+static void test_burst_fastest(void){
+	burst_at(FASTEST_BAUD);
+	uart_set_baud(UART_DEFAULT_BAUD);
+}
+
+//a reader that stays away longer than the ring buffer lasts loses the bytes past it, counted
+static void test_ring_full(void){
+	uart_rx_stats_t before = *uart_get_rx_stats();
+	const uart_rx_stats_t *after = (const uart_rx_stats_t*)uart_get_rx_stats();
+	uint32_t extra = 100, same = 0;
+
+	fill_burst(1);
+	periph_sim_usart_rx(burst, UART_RX_BUFFER_SIZE + extra);
+	periph_sim_advance_us((UART_RX_BUFFER_SIZE + extra + 1) * frame_ns(uart_get_baud()) / 1000);
+	CHECK_EQ(after->dropped - before.dropped, extra);
+	CHECK_EQ(after->peak, UART_RX_BUFFER_SIZE);
+	for(uint32_t i = 0; i < UART_RX_BUFFER_SIZE; i++)
+		same += (get_char() == burst[i]);
+	CHECK_EQ(same, UART_RX_BUFFER_SIZE);
+	CHECK(!char_available());
+}
+
+//a handler later than a frame time lets the next byte overrun the one waiting in DR
+static void test_overrun(void){
+	uart_rx_stats_t before = *uart_get_rx_stats();
+	const uart_rx_stats_t *after = (const uart_rx_stats_t*)uart_get_rx_stats();
+	uint32_t len = 64;
+
+	CHECK(uart_set_baud(FASTEST_BAUD) != 0);
+	periph_sim_set_irq_latency((uint32_t)(frame_ns(uart_get_baud()) * 3 / 2));
+	fill_burst(2);
+	periph_sim_usart_rx(burst, len);
+	periph_sim_advance_us(1000);
+	CHECK(after->overruns - before.overruns > 0);
+	CHECK_EQ(after->overruns - before.overruns, periph_sim_get_stats()->usart_overruns);
+	CHECK_EQ((after->received - before.received) + (after->overruns - before.overruns), len);
+	while(char_available())
+		get_char();
+	periph_sim_set_irq_latency(0);
+	uart_set_baud(UART_DEFAULT_BAUD);
+}
+
+int main(void){
+	periph_sim_reset();
+	init_uart();
+
+	RUN_TEST(test_burst_default);
+	RUN_TEST(test_burst_fastest);
+	RUN_TEST(test_ring_full);
+	RUN_TEST(test_overrun);
+	return TEST_END();
+}
@@ -0,0 +1,292 @@
+/*******************************************************************************
+ * Copyright (C) 2023 by PRANJAL GUPTA
+ *
+ * Redistribution, modification or use of this software in source or binary
+ * forms is permitted as long as the files maintain this copyright. Users are
+ * permitted to modify this and use it to learn about the field of embedded
+ * software. PRANJAL GUPTA and the University of Colorado are not liable for
+ * any misuse of this material.
+ * ****************************************************************************/
+
+/**
+ * @file    test_wavegen.c
+ * @brief   This file contains the host tests of the traffic generator: each decoder must find
+ * 			exactly the events the generator lists, through jitter, glitches and protocol errors,
+ * 			fed in blocks that split frames. SPI, which has no decoder, is checked by sampling
+ * 			MOSI and MISO on the rising edges of SCK.
+ *
+ * @author  Pranjal Gupta
+ * @date    12/17/2023
+ *
+ */
+
+#include "test.h"
+#include "host_stubs.h"
+#include "wavegen.h"
+#include "uart_analyser.h"
+#include "i2c_analyser.h"
+#include "onewire_analyser.h"
+#include "can_analyser.h"
+#include "bit_timing.h"
+#include "stdlib.h"
+
+#define SAMPLE_RATE 1000000
+#define CAPTURE_LEN (256 * 1024)
+#define BLOCK 4093					//block length that splits frames at varying places
+#define MAX_EVENTS 16384
+
+static uint8_t capture[CAPTURE_LEN];
+static wavegen_event_t expected[MAX_EVENTS];
+static wavegen_event_t decoded[MAX_EVENTS];
+static uint32_t decoded_count;
+
+static void add(wavegen_event_type_t type, uint64_t position, uint64_t value, uint16_t id, uint8_t len,
+		uint8_t flags){
+	if(decoded_count < MAX_EVENTS){
+		wavegen_event_t event = {type, (uint32_t)position, value, id, len, flags};
+		decoded[decoded_count] = event;
+	}
+	decoded_count++;
+}
+
+static void on_uart(const uart_frame_t *frame, void *arg){
+	(void)arg;
+	add(WAVEGEN_EVENT_UART_FRAME, frame->position, frame->data, 0, 0,
+			(frame->flags & UART_FRAME_ERR_FRAMING) ? WAVEGEN_FLAG_ERROR : 0);
+}
+
+static void on_onewire(const onewire_event_t *event, void *arg){
+	static const wavegen_event_type_t types[] = {WAVEGEN_EVENT_ONEWIRE_RESET, WAVEGEN_EVENT_ONEWIRE_PRESENCE,
+			WAVEGEN_EVENT_ONEWIRE_NO_PRESENCE, WAVEGEN_EVENT_ONEWIRE_ROM_COMMAND, WAVEGEN_EVENT_ONEWIRE_ROM_ID,
+			WAVEGEN_EVENT_ONEWIRE_FUNCTION_COMMAND, WAVEGEN_EVENT_ONEWIRE_DATA};
+	uint8_t flags = 0;
+
+	(void)arg;
+	if(event->type == ONEWIRE_EVENT_INVALID_SLOT){
+		add((wavegen_event_type_t)(WAVEGEN_EVENT_CAN_FRAME + 1), event->position, event->value, 0, 0, 0);//matches nothing
+		return;
+	}
+	if(event->type == ONEWIRE_EVENT_NO_PRESENCE || (event->type == ONEWIRE_EVENT_ROM_ID && !event->crc_ok))
+		flags = WAVEGEN_FLAG_ERROR;
+	add(types[event->type], event->position, event->value, 0, 0, flags);
+}
+
+static void on_can(const can_frame_t *frame, void *arg){
+	uint64_t value = 0;
+
+	(void)arg;
+	for(uint8_t i = 0; i < frame->dlc; i++)
+		value |= (uint64_t)frame->data[i] << (8 * i);
+	add(WAVEGEN_EVENT_CAN_FRAME, frame->position, value, frame->id, frame->dlc,
+			(frame->flags & CAN_FRAME_ERR_CRC) ? WAVEGEN_FLAG_ERROR : 0);
+}
+
+static wavegen_config_t config_of(wavegen_protocol_t protocol, uint32_t seed){
+	wavegen_config_t config;
+
+	wavegen_default_config(&config, protocol, SAMPLE_RATE);
+	config.jitter = 15;
+	config.glitches = 30;
+	config.errors = 10;
+	config.seed = seed;
+	return config;
+}
+
+static uint32_t generate(const wavegen_config_t *config, wavegen_stats_t *stats){
+	CHECK(wavegen_generate(config, capture, CAPTURE_LEN, expected, MAX_EVENTS, stats));
+	CHECK(stats->events > 100 && stats->events <= MAX_EVENTS);
+	CHECK(stats->samples <= CAPTURE_LEN && stats->samples > CAPTURE_LEN - CAPTURE_LEN / 8);
+	decoded_count = 0;
+	return stats->events;
+}
+
+//the decoded events are the expected ones, compared on what the decoder reports
+static bool same_events(uint32_t count, bool positions, bool lengths){
+	if(decoded_count != count){
+		fprintf(stderr, "%u events decoded, %u expected\n", decoded_count, count);
+	}
+	for(uint32_t i = 0; i < count && i < decoded_count; i++){
+		const wavegen_event_t *e = &expected[i], *d = &decoded[i];
+		if(e->type != d->type || e->value != d->value || e->id != d->id || (lengths && e->len != d->len)
+				|| (e->flags & WAVEGEN_FLAG_ERROR) != (d->flags & WAVEGEN_FLAG_ERROR)
+				|| (positions && e->position != d->position)){
+			fprintf(stderr, "event %u: type %d value %llx at %u expected, type %d value %llx at %u decoded\n",
+					i, e->type, (unsigned long long)e->value, e->position, d->type,
+					(unsigned long long)d->value, d->position);
+			return false;
+		}
+	}
+	return decoded_count == count;
+}
+
+static void test_uart(void){
+	wavegen_config_t config = config_of(WAVEGEN_UART, 7);
+	uart_config_t uart = {{0, UART_ANALYSER_NO_PIN}, 8, UART_PARITY_NONE, 1, 0, on_uart, NULL};
+	wavegen_stats_t stats;
+	uart_analyser_t ctx;
+	uint32_t count;
+
+	config.bus_rate = 9600;		//the default rate leaves no room for a glitch beside the jitter
+	count = generate(&config, &stats);
+
+	uart.bit_period_q8 = rate_to_bit_period(config.bus_rate, SAMPLE_RATE);
+	CHECK(uart_analyser_init(&ctx, &uart));
+	for(uint32_t i = 0; i < CAPTURE_LEN; i += BLOCK)
+		uart_analyser_process(&ctx, capture + i, (CAPTURE_LEN - i < BLOCK) ? CAPTURE_LEN - i : BLOCK);
+	CHECK(same_events(count, true, false));
+	CHECK(stats.glitches > 0);
+	CHECK(stats.errors > 0);
+	CHECK_EQ(ctx.errors, stats.errors);
+}
+
+//the decoder only prints, the expected text is made from the events
+static void test_i2c(void){
+	wavegen_config_t config = config_of(WAVEGEN_I2C, 11);
+	wavegen_stats_t stats;
+	i2c_analyser_t ctx;
+	uint32_t count = generate(&config, &stats);
+	size_t size = (size_t)count * 64 + 1, used = 0;
+	char *want = malloc(size), *out;
+
+	for(uint32_t i = 0; i < count; i++){
+		const wavegen_event_t *e = &expected[i];
+		uint8_t nack = (e->flags & WAVEGEN_FLAG_NACK) ? 1 : 0;
+		switch(e->type){
+		case WAVEGEN_EVENT_I2C_START:
+			used += snprintf(want + used, size - used, "START DETECTED AT %u\r\n", e->position);
+			break;
+		case WAVEGEN_EVENT_I2C_REPEATED_START:
+			used += snprintf(want + used, size - used, "REPEATED START DETECTED AT %u\r\n", e->position);
+			break;
+		case WAVEGEN_EVENT_I2C_STOP:
+			used += snprintf(want + used, size - used, "STOP DETECTED AT %u\r\n", e->position);
+			break;
+		case WAVEGEN_EVENT_I2C_ADDRESS:
+			used += snprintf(want + used, size - used, "ADDR: \t  %x\r\nRW:   \t  %x\r\nACK/NACK: %x\r\n",
+					(unsigned)e->value, (e->flags & WAVEGEN_FLAG_READ) ? 1 : 0, nack);
+			break;
+		default:
+			used += snprintf(want + used, size - used, "DATA: \t  %x\r\nACK/NACK: %x\r\n", (unsigned)e->value, nack);
+			break;
+		}
+	}
+
+	host_capture_begin();
+	i2c_analyser_init(&ctx, config.pins[0], config.pins[1]);
+	for(uint32_t i = 0; i < CAPTURE_LEN; i += BLOCK)
+		i2c_analyser_process(&ctx, capture + i, (CAPTURE_LEN - i < BLOCK) ? CAPTURE_LEN - i : BLOCK);
+	out = host_capture_end(NULL);
+
+	CHECK(!strcmp(out, want));
+	CHECK(stats.glitches > 0);
+	free(out);
+	free(want);
+}
+
+//sampled on the rising edges of SCK while CS is low
+static void test_spi(void){
+	wavegen_config_t config = config_of(WAVEGEN_SPI, 13);
+	uint8_t sck = config.pins[0], mosi = config.pins[1], miso = config.pins[2], cs = config.pins[3];
+	wavegen_stats_t stats;
+	uint32_t count = generate(&config, &stats);
+	uint32_t bits = 0, start = 0;
+	uint8_t out = 0, in = 0;
+
+	for(uint32_t i = 1; i < CAPTURE_LEN; i++){
+		uint8_t previous = capture[i - 1], sample = capture[i];
+		if((sample >> cs) & 1){
+			CHECK_EQ(bits, 0);
+			continue;
+		}
+		if(!((previous >> sck) & 1) && ((sample >> sck) & 1)){
+			out = (out << 1) | ((sample >> mosi) & 1);
+			in = (in << 1) | ((sample >> miso) & 1);
+			if(++bits == 8){
+				add(WAVEGEN_EVENT_SPI_BYTE, start, out, in, 0, 0);
+				bits = 0;
+			}
+		}else if(bits == 0 && ((previous >> sck) & 1) && !((sample >> sck) & 1)){
+			start = i;//the next byte starts on the falling edge of the last
+		}
+	}
+	CHECK(same_events(count, false, false));
+	CHECK(stats.glitches > 0);
+}
+
+static void test_onewire(void){
+	wavegen_config_t config = config_of(WAVEGEN_ONEWIRE, 17);
+	wavegen_stats_t stats;
+	onewire_analyser_t ctx;
+	uint32_t count = generate(&config, &stats);
+
+	CHECK(onewire_analyser_init(&ctx, config.pins[0], SAMPLE_RATE, on_onewire, NULL));
+	for(uint32_t i = 0; i < CAPTURE_LEN; i += BLOCK)
+		onewire_analyser_process(&ctx, capture + i, (CAPTURE_LEN - i < BLOCK) ? CAPTURE_LEN - i : BLOCK);
+	CHECK(same_events(count, true, false));
+	CHECK_EQ(stats.glitches, 0);
+	CHECK(stats.errors > 0);
+}
+
+static void test_can(void){
+	wavegen_config_t config = config_of(WAVEGEN_CAN, 19);
+	wavegen_stats_t stats;
+	can_analyser_t ctx;
+	uint32_t count;
+
+	config.bus_rate = 100000;
+	count = generate(&config, &stats);
+
+	CHECK(can_analyser_init(&ctx, config.pins[0], (SAMPLE_RATE / config.bus_rate) << 8, on_can, NULL));
+	for(uint32_t i = 0; i < CAPTURE_LEN; i += BLOCK)
+		can_analyser_process(&ctx, capture + i, (CAPTURE_LEN - i < BLOCK) ? CAPTURE_LEN - i : BLOCK);
+	CHECK(same_events(count, true, true));
+	CHECK(stats.glitches > 0);
+	CHECK_EQ(ctx.errors, stats.errors);
+}
+
+//the same seed gives the same samples, the list only holds what fits, the end of the buffer is idle
+static void test_reproducible(void){
+	static uint8_t again[CAPTURE_LEN];
+	wavegen_config_t config = config_of(WAVEGEN_UART, 23);
+	wavegen_stats_t stats, stats_again;
+
+	CHECK(wavegen_generate(&config, capture, CAPTURE_LEN, NULL, 0, &stats));
+	CHECK(wavegen_generate(&config, again, CAPTURE_LEN, expected, 10, &stats_again));
+	CHECK(!memcmp(capture, again, CAPTURE_LEN));
+	CHECK_EQ(stats.events, stats_again.events);
+	CHECK_EQ(expected[9].type, WAVEGEN_EVENT_UART_FRAME);
+	for(uint32_t i = stats.samples; i < CAPTURE_LEN; i++)
+		CHECK_EQ(capture[i], 0xFF);
+
+	config.seed = 24;
+	CHECK(wavegen_generate(&config, again, CAPTURE_LEN, NULL, 0, &stats_again));
+	CHECK(memcmp(capture, again, CAPTURE_LEN) != 0);
+}
+
+static void test_invalid(void){
+	wavegen_config_t config;
+	wavegen_stats_t stats;
+
+	wavegen_default_config(&config, WAVEGEN_I2C, SAMPLE_RATE);
+	config.pins[1] = config.pins[0];
+	CHECK(!wavegen_generate(&config, capture, CAPTURE_LEN, NULL, 0, &stats));
+	wavegen_default_config(&config, WAVEGEN_CAN, SAMPLE_RATE);
+	config.bus_rate = SAMPLE_RATE / 2;
+	CHECK(!wavegen_generate(&config, capture, CAPTURE_LEN, NULL, 0, &stats));
+	wavegen_default_config(&config, WAVEGEN_UART, SAMPLE_RATE);
+	config.jitter = WAVEGEN_JITTER_MAX + 1;
+	CHECK(!wavegen_generate(&config, capture, CAPTURE_LEN, NULL, 0, &stats));
+	CHECK_EQ(wavegen_protocol_by_name("1WIRE"), WAVEGEN_ONEWIRE);
+	CHECK_EQ(wavegen_protocol_by_name("usb"), WAVEGEN_PROTOCOLS);
+}
+
+int main(void){
+	RUN_TEST(test_uart);
+	RUN_TEST(test_i2c);
+	RUN_TEST(test_spi);
+	RUN_TEST(test_onewire);
+	RUN_TEST(test_can);
+	RUN_TEST(test_reproducible);
+	RUN_TEST(test_invalid);
+	return TEST_END();
+}